@@ -20,7 +20,7 @@
 *
 * Author: Frank Schwab
 *
-* Version: 2.3.0
+* Version: 2.32.8
 *
 * Example program to show correct and incorrect password storage with the PBKDF2 function
 *
@@ -30,6 +30,43 @@
 *     2017-03-03: V2.1.0: Cleaned up data types for counts and lengths
 *     2017-03-03: V2.2.0: Removed unnecessary methods and make hex char conversion to byte a bit faster
 *     2023-08-12: V2.3.0: This is C, not C++, so set correct file extension
+*     2026-10-14: V2.4.0: Batch mode that processes many records from a file or stdin in one process
+*     2026-10-14: V2.5.0: Cache the algorithm providers and their hash lengths per hash type
+*     2026-10-14: V2.6.0: Multi-threaded batch mode with the Windows thread pool
+*     2026-10-14: V2.7.0: Multi-buffer SIMD engine for SHA-1 and SHA-256
+*     2026-10-14: V2.8.0: Single-stream engine for SHA-1 and SHA-256 with the SHA extensions
+*     2026-10-14: V2.9.0: Benchmark mode with latency statistics and iterations per second
+*     2026-10-14: V2.10.0: Calibration of the iteration count to a target duration
+*     2026-10-14: V2.11.0: Derived keys that are longer than one hash block
+*     2026-10-14: V2.12.0: Verify mode that compares the derived key with an expected key
+*     2026-10-14: V2.13.0: Take the buffers of a record from a reusable arena instead of the heap
+*     2026-10-14: V2.14.0: Buffered output of the batch results
+*     2026-10-14: V2.15.0: Read batch files through a memory mapping
+*     2026-10-14: V2.16.0: Hex conversions with SSE4.1 and lookup tables, and hex output without blanks
+*     2026-10-14: V2.17.0: Base64, PHC and binary output formats
+*     2026-10-14: V2.18.0: Server mode with requests on a named pipe
+*     2026-10-14: V2.19.0: Profile with the durations of the processing phases
+*     2026-10-14: V2.20.0: ETW events for the derivations
+*     2026-10-14: V2.21.0: Portable engine and comparison of the keys of two engines that run at the same time
+*     2026-10-14: V2.22.0: Derivation with checkpoints that can be resumed and a higher iteration count limit
+*     2026-10-14: V2.23.0: Chain state of a derived key and extension of a derived key to a higher iteration count
+*     2026-10-14: V2.24.0: GPU engine for batches with CNG as the fallback
+*     2026-10-14: V2.25.0: Memory-mapped cache of derived keys
+*     2026-10-14: V2.26.0: Salt sweep that prepares the HMAC key of the password only once
+*     2026-10-14: V2.27.0: Parameter grid with pinned worker threads and a CSV or JSON matrix
+*     2026-10-14: V2.28.0: Scaling benchmark with pinned threads and the clock frequency under load
+*     2026-10-14: V2.29.0: UTF-8 input encoding and password conversion in one pass without a copy for ASCII and UTF-8
+*     2026-10-14: V2.30.0: Batch pipeline that reads and writes chunks while the workers derive the keys of the chunk in between
+*     2026-10-14: V2.31.0: Constant-time comparison and hash type range from the library interface
+*     2026-10-14: V2.32.0: Server scheduler with a CPU budget, a concurrency cap and a latency target
+*     2026-10-14: V2.32.1: Checkpoint files without a value of the password besides U and T
+*     2026-10-14: V2.32.2: Server scheduler with a queue of deferred requests instead of waiting server threads
+*     2026-10-14: V2.32.3: Group lists of the GPU engine from the arena of the records
+*     2026-10-14: V2.32.4: One batch worker with the GPU engine that derives each chunk as one group
+*     2026-10-14: V2.32.5: Salt sweep with the selected engine and prepared portable HMAC keys for SHA-384 and SHA-512
+*     2026-10-14: V2.32.6: Report lines from stdin that are too long instead of splitting them
+*     2026-10-14: V2.32.7: Derive the keys of the CNG engine with the library instead of an own provider cache
+*     2026-10-14: V2.32.8: Count all cores for the scaling benchmark, independent of the number of threads
 */
 
 /*
@@ -41,7 +78,19 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <bcrypt.h>
+#include <powerbase.h>
+#include <TraceLoggingProvider.h>
+#include <winmeta.h>
+
+#include "PBKDF2Api.h"
+#include "PBKDF2Base64.h"
+#include "PBKDF2Cache.h"
+#include "PBKDF2Gpu.h"
+#include "PBKDF2Hex.h"
+#include "PBKDF2Native.h"
+#include "PBKDF2Portable.h"
 
  /*
   * DEFINES
@@ -53,15 +102,12 @@
 // Size of buffer for error messages
 #define ERROR_BUFFER_SIZE 511
 
-/*
- * TYPEDEFS
- */
+// Size of buffer for result lines, which contain the salt and the derived key as text, or for binary results
+#define RESULT_BUFFER_SIZE 4095
 
 /*
- * TOCTET is a data type that defines 8 binary bits and is *not* a character
- * (Welcome to the strange world of C).
+ * TYPEDEFS
  */
-typedef UCHAR TOCTET;
 
 /*
  * Define a default "unsuccessful" NT STATUS for initialization.
@@ -72,10 +118,10 @@ typedef UCHAR TOCTET;
 #endif
 
 /*
- * Minimum and maximum values for the hash type
+ * Minimum and maximum values for the hash type. They are the same as in the library interface.
  */
-#define MIN_HASH_TYPE 1
-#define MAX_HASH_TYPE 5
+#define MIN_HASH_TYPE PBKDF2_MIN_HASH_TYPE
+#define MAX_HASH_TYPE PBKDF2_MAX_HASH_TYPE
 
 /*
  * Minimum and maximum value of the salt if it is interpreted as an integer
@@ -89,14 +135,32 @@ typedef UCHAR TOCTET;
 #define MIN_ITERATION_COUNT 1
 #define MAX_ITERATION_COUNT 5000000
 
+/*
+ * Maximum iteration count that can be allowed for a derivation with checkpoints
+ */
+#define MAX_CHECKPOINT_ITERATION_COUNT INT_MAX
+
+/*
+ * Minimum and maximum size of the derived key in bytes
+ */
+#define MIN_DERIVED_KEY_SIZE 1
+#define MAX_DERIVED_KEY_SIZE 256
+
 
 /*
  * Argument macros
  */
-#define ARGV_HASH_TYPE       argv[1]
-#define ARGV_SALT            argv[2]
-#define ARGV_ITERATION_COUNT argv[3]
-#define ARGV_PASSWORD        argv[4]
+#define ARGV_HASH_TYPE       positionalArgs[0]
+#define ARGV_SALT            positionalArgs[1]
+#define ARGV_ITERATION_COUNT positionalArgs[2]
+#define ARGV_PASSWORD        positionalArgs[3]
+
+/*
+ * Positions of the arguments of a salt sweep, which takes the salts from a file
+ */
+#define SWEEP_ARGV_HASH_TYPE       positionalArgs[0]
+#define SWEEP_ARGV_ITERATION_COUNT positionalArgs[1]
+#define SWEEP_ARGV_PASSWORD        positionalArgs[2]
 
 /*
  * Macros for error checking
@@ -108,14 +172,14 @@ typedef UCHAR TOCTET;
 /*
  * Variables for duration measurement
  */
-LARGE_INTEGER startTickValue;
 double tickDuration = 0.0;
 
 /*
- * Start the timer for duration measurement
+ * Start the timer for duration measurement.
+ * The start value is kept by the caller, so that several threads can measure durations at the same time.
  */
-void startTimer() {
-	QueryPerformanceCounter(&startTickValue);
+void startTimer(LARGE_INTEGER* const pStartTickValue) {
+	QueryPerformanceCounter(pStartTickValue);
 }
 
 /*
@@ -132,19 +196,19 @@ void getTickDuration() {
 /*
  * Get the number of elapsed timer ticks
  */
-long long getElapsedTicks() {
+long long getElapsedTicks(const LARGE_INTEGER* const pStartTickValue) {
 	LARGE_INTEGER now;
 
 	QueryPerformanceCounter(&now);
 
-	return (now.QuadPart - startTickValue.QuadPart);
+	return (now.QuadPart - pStartTickValue->QuadPart);
 }
 
 /*
  * Get elapsed time
  */
-double getElapsedTime() {
-	long long elapsedTicks = getElapsedTicks();
+double getElapsedTime(const LARGE_INTEGER* const pStartTickValue) {
+	long long elapsedTicks = getElapsedTicks(pStartTickValue);
 
 	if (tickDuration == 0.0)
 		getTickDuration();
@@ -152,6 +216,67 @@ double getElapsedTime() {
 	return (elapsedTicks * tickDuration);
 }
 
+/*
+ * Phases of the processing of a record that are measured separately with the profile option
+ */
+typedef enum {
+	PHASE_PARSE,           // Conversion of hash type, salt and iteration count
+	PHASE_ENCODING,        // Conversion of the password into the bytes that are hashed
+	PHASE_DERIVE,          // pbkdf2_derive or the native engine
+	PHASE_FORMAT,          // Formatting of the result
+	PHASE_OUTPUT,          // Writing of the result
+	PHASE_COUNT
+} PHASE;
+
+/*
+ * Display names of the phases, indexed by PHASE
+ */
+const TCHAR* const PHASE_NAME[PHASE_COUNT] = { _T("Parse"), _T("Encoding"), _T("Derive"), _T("Format"), _T("Output") };
+
+/*
+ * Elapsed timer ticks and number of measurements of each phase.
+ * Each thread has its own profile, so the measurements do not need to be synchronized.
+ */
+typedef struct {
+	long long ticks[PHASE_COUNT];
+	int count[PHASE_COUNT];
+} PHASE_PROFILE;
+
+/*
+ * Clear all measurements of a profile
+ */
+void initializePhaseProfile(PHASE_PROFILE* const pProfile) {
+	memset(pProfile, 0, sizeof(PHASE_PROFILE));
+}
+
+/*
+ * Start the measurement of a phase. Nothing is measured if there is no profile.
+ */
+void startPhase(const PHASE_PROFILE* const pProfile, LARGE_INTEGER* const pStartTickValue) {
+	if (pProfile != NULL)
+		startTimer(pStartTickValue);
+}
+
+/*
+ * End the measurement of a phase and add its duration to the profile
+ */
+void endPhase(PHASE_PROFILE* const pProfile, const PHASE phase, const LARGE_INTEGER* const pStartTickValue) {
+	if (pProfile != NULL) {
+		pProfile->ticks[phase] += getElapsedTicks(pStartTickValue);
+		pProfile->count[phase]++;
+	}
+}
+
+/*
+ * Add the measurements of a profile to a total profile
+ */
+void addPhaseProfile(PHASE_PROFILE* const pTotalProfile, const PHASE_PROFILE* const pProfile) {
+	for (int i = 0; i < PHASE_COUNT; i++) {
+		pTotalProfile->ticks[i] += pProfile->ticks[i];
+		pTotalProfile->count[i] += pProfile->count[i];
+	}
+}
+
 
 /*
  * Convert a string into an integer with bounds checking
@@ -161,6 +286,9 @@ int getIntegerArg(const TCHAR* pArgName, const TCHAR* pArg, const int minValue,
 
 	RESET_ERROR_MSG;
 
+	// _ttoi only sets errno on errors, so it has to be reset for repeated calls
+	errno = 0;
+
 	result = _ttoi(pArg);
 
 	if (errno != 0) {
@@ -185,116 +313,151 @@ int getIntegerArg(const TCHAR* pArgName, const TCHAR* pArg, const int minValue,
 }
 
 /*
- * Hexadecimal characters for conversion into a hex string
+ * Size of the blocks of an arena. It is large enough for all buffers of a full group of batch records.
+ */
+#define ARENA_BLOCK_SIZE 262144
+
+/*
+ * Alignment of the buffers that are taken from an arena
+ */
+#define ARENA_ALIGNMENT 16
+
+/*
+ * One block of an arena. The buffers follow the header.
+ */
+typedef struct ARENA_BLOCK {
+	struct ARENA_BLOCK* pNext;
+	int size;
+} ARENA_BLOCK;
+
+/*
+ * Size of the block header, rounded up so that the first buffer is aligned
+ */
+#define ARENA_HEADER_SIZE ((int)((sizeof(ARENA_BLOCK) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1)))
+
+/*
+ * A bump allocator for the short-lived buffers of the records. The buffers are not freed one by one,
+ * but the whole arena is reset when the records are done. The blocks are kept, so that an arena
+ * that has been used once does not need any heap calls for further records of the same size.
+ * An arena must only be used by one thread. An arena that is all zeros is empty and can be used.
  */
-const TCHAR* const HEX_DIGITS = _T("0123456789ABCDEF");
+typedef struct {
+	ARENA_BLOCK* pFirstBlock;
+	ARENA_BLOCK* pActBlock;   // NULL if nothing has been allocated since the last reset
+	int usedSize;             // Number of bytes used in the actual block
+} ARENA;
 
 /*
- * Convert a byte buffer into a string of hexadecimal characters separated by blanks
+ * Initialize an empty arena
  */
-TCHAR* bytesToHex(const TOCTET* const byteBuffer, const int bufferSize) {
-	int resultSize = bufferSize * 3;
+void initializeArena(ARENA* const pArena) {
+	pArena->pFirstBlock = NULL;
+	pArena->pActBlock = NULL;
+	pArena->usedSize = 0;
+}
 
-	TCHAR* pResult = (TCHAR*)malloc(resultSize * sizeof(TCHAR));
+/*
+ * Take a buffer from an arena. A new block is only allocated from the heap if the remaining blocks are too small.
+ * Returns NULL if the heap has no memory for a new block.
+ */
+void* allocateFromArena(ARENA* const pArena, const int size) {
+	const int alignedSize = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
 
-	if (pResult != NULL) {
-		TCHAR* pActResult = pResult;
-		const TOCTET* pActByte = byteBuffer;
+	while ((pArena->pActBlock == NULL) || (pArena->usedSize + alignedSize > pArena->pActBlock->size)) {
+		ARENA_BLOCK* pNextBlock = (pArena->pActBlock != NULL) ? pArena->pActBlock->pNext : pArena->pFirstBlock;
 
-		for (int j = 1; j <= bufferSize; j++) {
-			int v = (*pActByte) & 0xff;
+		if (pNextBlock == NULL) {
+			const int blockSize = max(alignedSize, ARENA_BLOCK_SIZE - ARENA_HEADER_SIZE);
 
-			*pActResult = HEX_DIGITS[v >> 4]; pActResult++;
+			pNextBlock = (ARENA_BLOCK*)malloc(ARENA_HEADER_SIZE + blockSize);
 
-			*pActResult = HEX_DIGITS[v & 0x0f]; pActResult++;
+			if (pNextBlock == NULL)
+				return NULL;
 
-			*pActResult = ' '; pActResult++;
+			pNextBlock->pNext = NULL;
+			pNextBlock->size = blockSize;
 
-			pActByte++;
+			if (pArena->pActBlock != NULL)
+				pArena->pActBlock->pNext = pNextBlock;
+			else
+				pArena->pFirstBlock = pNextBlock;
 		}
 
-		pActResult--;
-		*pActResult = _T('\0');
+		pArena->pActBlock = pNextBlock;
+		pArena->usedSize = 0;
 	}
 
-	return pResult;
+	void* const result = (TOCTET*)pArena->pActBlock + ARENA_HEADER_SIZE + pArena->usedSize;
+
+	pArena->usedSize += alignedSize;
+
+	return result;
 }
 
 /*
- * Get the value of one hexadecimal character as a byte
+ * Make all buffers of an arena available again. The blocks are kept for the next records.
  */
-TOCTET getHexCharValue(const TCHAR hexChar) {
-	int workValue;
+void resetArena(ARENA* const pArena) {
+	pArena->pActBlock = NULL;
+	pArena->usedSize = 0;
+}
 
-	/*
-	 * This method works on a very low level. It subtracts the base values
-	 * of the valid characters to obtain the corresponding byte value.
-	 */
-	workValue = (int)hexChar - (int)_T('0');
+/*
+ * Free all blocks of an arena
+ */
+void releaseArena(ARENA* const pArena) {
+	ARENA_BLOCK* pBlock = pArena->pFirstBlock;
 
-	if (workValue >= 0)
-		if (workValue <= 9)
-			return (TOCTET)workValue;
-		else {
-			workValue -= _T('A') - _T('0') - 10;
-			if (workValue >= 10)
-				if (workValue <= 15)
-					return (TOCTET)workValue;
-				else {
-					workValue -= _T('a') - _T('A');
-					if (workValue >= 10)
-						if (workValue <= 15)
-							return (TOCTET)workValue;
-				}
-		}
+	while (pBlock != NULL) {
+		ARENA_BLOCK* const pNextBlock = pBlock->pNext;
 
-	// If we get here the character was not a valid hex character
-	return (TOCTET)255;
+		free((void*)pBlock);
+
+		pBlock = pNextBlock;
+	}
+
+	initializeArena(pArena);
 }
 
 /*
- * Convert a string of upper case hexadecimal characters into a byte array
+ * Convert a byte buffer into a string of hexadecimal characters that are separated by blanks if hasSeparator is set
  */
-TOCTET* hexStringToByteArray(const TCHAR* const pHexText, const int hexTextSize, int* const pByteArraySize, TCHAR* const errorBuffer, const int errorBufferSize) {
-	RESET_ERROR_MSG;
+TCHAR* bytesToHex(ARENA* const pArena, const TOCTET* const byteBuffer, const int bufferSize, const BOOLEAN hasSeparator) {
+	TCHAR* pResult = (TCHAR*)allocateFromArena(pArena, (hexGetEncodedSize(bufferSize, hasSeparator) + 1) * sizeof(TCHAR));
 
-	BOOLEAN isHexTextSizeOdd = ((hexTextSize & 1) != 0);
+	if (pResult != NULL)
+		hexEncode(byteBuffer, bufferSize, pResult, hasSeparator);
 
-	int allocationSize = (hexTextSize >> 1);
-	
-	if (isHexTextSizeOdd)
-		allocationSize++;
-	
-	*pByteArraySize = allocationSize;
+	return pResult;
+}
+
+/*
+ * Convert a byte buffer into a Base64 string that is padded with '=' if hasPadding is set
+ */
+TCHAR* bytesToBase64(ARENA* const pArena, const TOCTET* const byteBuffer, const int bufferSize, const BOOLEAN hasPadding) {
+	TCHAR* pResult = (TCHAR*)allocateFromArena(pArena, (base64GetEncodedSize(bufferSize, hasPadding) + 1) * sizeof(TCHAR));
 
-	TOCTET* result = (TOCTET*) malloc(allocationSize);
+	if (pResult != NULL)
+		base64Encode(byteBuffer, bufferSize, pResult, hasPadding);
 
-	if (result != NULL) {
-		const TCHAR* pActChar = pHexText;
-		TOCTET* pActByte = result;
-		TOCTET actValue;
-		TOCTET byteValue = 0;
+	return pResult;
+}
 
-		BOOLEAN isLowNibble = isHexTextSizeOdd;
+/*
+ * Convert a string of hexadecimal characters into a byte array
+ */
+TOCTET* hexStringToByteArray(ARENA* const pArena, const TCHAR* const pHexText, const int hexTextSize, int* const pByteArraySize, TCHAR* const errorBuffer, const int errorBufferSize) {
+	RESET_ERROR_MSG;
 
-		for (int actPos = 1; actPos <= hexTextSize; actPos++) {
-			actValue = getHexCharValue(*pActChar);
+	*pByteArraySize = (hexTextSize + 1) >> 1;
 
-			if (actValue <= 15) {
-				if (isLowNibble) {
-					*pActByte = (byteValue | actValue);
-					pActByte++;
-				} else
-					byteValue = (TOCTET) (actValue << 4);
-			} else {
-				_stprintf_s(errorBuffer, errorBufferSize, _T("Invalid hex character \'%c\' at position %d of hex string \"%s\"\n"), *pActChar, actPos, pHexText);
-				break;
-			}
+	TOCTET* result = (TOCTET*) allocateFromArena(pArena, *pByteArraySize);
 
-			isLowNibble = !isLowNibble;
+	if (result != NULL) {
+		const int errorPos = hexDecode(pHexText, hexTextSize, result);
 
-			pActChar++;
-		}
+		if (errorPos >= 0)
+			_stprintf_s(errorBuffer, errorBufferSize, _T("Invalid hex character \'%c\' at position %d of hex string \"%s\"\n"), pHexText[errorPos], errorPos + 1, pHexText);
 	} else
 		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for hex conversion byte array\n"), *pByteArraySize);
 
@@ -304,59 +467,73 @@ TOCTET* hexStringToByteArray(const TCHAR* const pHexText, const int hexTextSize,
 /*
  * Convert a string of hexadecimal characters into a byte array
  */
-void safeHexStringToByteArray(TCHAR* const hexText, TOCTET** byteArray, int* const byteArraySize, TCHAR* const errorBuffer, const int errorBufferSize) {
+void safeHexStringToByteArray(ARENA* const pArena, TCHAR* const hexText, TOCTET** byteArray, int* const byteArraySize, TCHAR* const errorBuffer, const int errorBufferSize) {
 	const int hexTextSize = (int) _tcslen(hexText);
 
-	*byteArray = hexStringToByteArray(hexText, hexTextSize, byteArraySize, errorBuffer, errorBufferSize);
+	*byteArray = hexStringToByteArray(pArena, hexText, hexTextSize, byteArraySize, errorBuffer, errorBufferSize);
 }
 
-#ifndef _UNICODE
 /*
- * If we are in ANSI mode we need a method to convert an ANSI string into an UTF-16 string
+ * Number of UTF-16 characters that an ANSI password may have to be converted in a stack buffer.
+ * The UTF-16 form of a longer password is put into the arena.
  */
-void getPasswordUTF16Encoding(const TCHAR* const password,
-										const int passwordSize,
-										wchar_t** passwordInUTF16,
-										int* const pPasswordInUTF16Size,
-										TCHAR* const errorBuffer,
-										const int errorBufferSize) {
-	RESET_ERROR_MSG;
+#define PASSWORD_STACK_BUFFER_SIZE 256
 
-	int bufferSize;
-
-	*pPasswordInUTF16Size = MultiByteToWideChar(CP_ACP, 0, password, passwordSize, NULL, 0);
+/*
+ * Maximum number of UTF-8 bytes of a UTF-16 character. A surrogate pair has 2 characters and 4 bytes.
+ */
+#define MAX_UTF8_BYTES_PER_UTF16_CHAR 3
 
-	bufferSize = *pPasswordInUTF16Size * sizeof(wchar_t);
-	*passwordInUTF16 = (wchar_t*)malloc(bufferSize);
+/*
+ * Check if a text only consists of ASCII characters, whose UTF-8 encoding is the same as their ANSI encoding
+ */
+BOOLEAN isAsciiText(const TCHAR* const text, const int textSize) {
+	for (int i = 0; i < textSize; i++)
+		if ((_TUCHAR)text[i] >= 0x80)
+			return FALSE;
 
-	if (*passwordInUTF16 != NULL)
-		MultiByteToWideChar(CP_ACP, 0, password, passwordSize, *passwordInUTF16, *pPasswordInUTF16Size);
-	else
-		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for passwordInUTF16\n"), bufferSize);
+	return TRUE;
 }
-#endif
 
-void getPasswordUTF8EncodingFromUTF16(const TCHAR* const password,
+/*
+ * Convert an UTF-16 string into UTF-8 in one pass. The buffer is taken from the arena with the maximum size that
+ * the UTF-8 encoding can have, so the size does not need to be calculated by a separate call.
+ */
+void getPasswordUTF8EncodingFromUTF16(ARENA* const pArena,
+												  const wchar_t* const password,
 												  const int passwordSize,
 												  TOCTET** passwordInUTF8, 
 												  int* const pPasswordInUTF8Size, 
 												  TCHAR* const errorBuffer,
 												  const int errorBufferSize) {
-	*pPasswordInUTF8Size = WideCharToMultiByte(CP_UTF8, 0, password, passwordSize, NULL, 0, NULL, NULL);
+	const int bufferSize = passwordSize * MAX_UTF8_BYTES_PER_UTF16_CHAR;
 
-	*passwordInUTF8 = (TOCTET*)malloc(*pPasswordInUTF8Size);
+	*pPasswordInUTF8Size = 0;
+	*passwordInUTF8 = (TOCTET*)allocateFromArena(pArena, bufferSize);
 
-	if (*passwordInUTF8 != NULL)
-		WideCharToMultiByte(CP_UTF8, 0, password, passwordSize, (LPSTR)*passwordInUTF8, *pPasswordInUTF8Size, NULL, NULL);
-	else
-		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for passwordInUTF8\n"), *pPasswordInUTF8Size);
+	if (*passwordInUTF8 == NULL) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for passwordInUTF8\n"), bufferSize);
+		return;
+	}
+
+	if (passwordSize > 0) {
+		*pPasswordInUTF8Size = WideCharToMultiByte(CP_UTF8, 0, password, passwordSize, (LPSTR)*passwordInUTF8, bufferSize, NULL, NULL);
+
+		if (*pPasswordInUTF8Size == 0)
+			_stprintf_s(errorBuffer, errorBufferSize, _T("Error %d returned by WideCharToMultiByte\n"), GetLastError());
+	}
 }
 
 /*
- * Convert the password from the native format (Unicode or ANSI) into the UTF-8 encoding as a byte array
+ * Convert the password from the native format (Unicode or ANSI) into the UTF-8 encoding as a byte array.
+ * passwordCodePage is the code page of an ANSI password. It is CP_UTF8 if the password is read as UTF-8 text.
+ * An ANSI password that is already UTF-8 or only consists of ASCII characters is used as it is without a copy.
+ * Other ANSI passwords are converted to UTF-16 in a stack buffer and from there to UTF-8, with one call for each step.
  */
-void getPasswordUTF8Encoding(const TCHAR* const password,
+void getPasswordUTF8Encoding(ARENA* const pArena,
+									  const TCHAR* const password,
 									  const int passwordSize,
+									  const UINT passwordCodePage,
 									  TOCTET** passwordInUTF8,
 									  int* const pPasswordInUTF8Size,
 									  TCHAR* const errorBuffer,
@@ -364,36 +541,87 @@ void getPasswordUTF8Encoding(const TCHAR* const password,
 	RESET_ERROR_MSG;
 
 #ifdef _UNICODE
-	/*
-	 * If we are in Unicode mode we just convert the UTF-16 characters to UTF-8
-	 */
-	getPasswordUTF8EncodingFromUTF16(password, passwordSize, passwordInUTF8, pPasswordInUTF8Size, errorBuffer, errorBufferSize);
+	UNREFERENCED_PARAMETER(passwordCodePage);
+
+	if (isAsciiText(password, passwordSize)) {
+		/*
+		 * ASCII characters only need to be narrowed to bytes
+		 */
+		*passwordInUTF8 = (TOCTET*)allocateFromArena(pArena, passwordSize);
+
+		if (*passwordInUTF8 != NULL) {
+			for (int i = 0; i < passwordSize; i++)
+				(*passwordInUTF8)[i] = (TOCTET)password[i];
+
+			*pPasswordInUTF8Size = passwordSize;
+		} else
+			_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for passwordInUTF8\n"), passwordSize);
+	} else
+		/*
+		 * If we are in Unicode mode we just convert the UTF-16 characters to UTF-8
+		 */
+		getPasswordUTF8EncodingFromUTF16(pArena, password, passwordSize, passwordInUTF8, pPasswordInUTF8Size, errorBuffer, errorBufferSize);
 #else
+	if ((passwordCodePage == CP_UTF8) || (GetACP() == CP_UTF8) || isAsciiText(password, passwordSize)) {
+		/*
+		 * The bytes of the password already are its UTF-8 encoding
+		 */
+		*passwordInUTF8 = (TOCTET*)password;
+		*pPasswordInUTF8Size = passwordSize;
+
+		return;
+	}
+
 	/*
-	 * If we are in ANSI mode we first need to convert the ANSI characters to UTF-16 and then from UTF-16 to UTF-8
+	 * If we are in ANSI mode we first need to convert the ANSI characters to UTF-16 and then from UTF-16 to UTF-8.
+	 * An ANSI character never becomes more than one UTF-16 character.
 	 */
+	wchar_t stackBuffer[PASSWORD_STACK_BUFFER_SIZE];
+	wchar_t* passwordInUnicode = stackBuffer;
 
-	 // First convert ANSI to UTF-16
-	int passwordInUnicodeSize;
-	wchar_t* passwordInUnicode;
+	if (passwordSize > PASSWORD_STACK_BUFFER_SIZE) {
+		const int bufferSize = passwordSize * sizeof(wchar_t);
 
-	getPasswordUTF16Encoding(password, passwordSize, &passwordInUnicode, &passwordInUnicodeSize, errorBuffer, errorBufferSize);
+		passwordInUnicode = (wchar_t*)allocateFromArena(pArena, bufferSize);
+
+		if (passwordInUnicode == NULL) {
+			_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for passwordInUTF16\n"), bufferSize);
+			return;
+		}
+	}
 
-	if (passwordInUnicode != NULL) {
-		// Then convert UTF-16 to UTF-8
-		getPasswordUTF8EncodingFromUTF16(passwordInUnicode, passwordInUnicodeSize, passwordInUTF8, pPasswordInUTF8Size, errorBuffer, errorBufferSize);
+	const int passwordInUnicodeSize = MultiByteToWideChar(passwordCodePage, 0, password, passwordSize, passwordInUnicode, passwordSize);
 
-		free((void*) passwordInUnicode);
+	if (passwordInUnicodeSize == 0) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Error %d returned by MultiByteToWideChar\n"), GetLastError());
+		return;
 	}
+
+	// Then convert UTF-16 to UTF-8. A UTF-16 buffer from the arena is given back together with the arena.
+	getPasswordUTF8EncodingFromUTF16(pArena, passwordInUnicode, passwordInUnicodeSize, passwordInUTF8, pPasswordInUTF8Size, errorBuffer, errorBufferSize);
 #endif
 }
 
+// List of hash algorithms that can be used
+LPCWSTR HASH_ALGORITHM[5] = { BCRYPT_SHA1_ALGORITHM, BCRYPT_SHA256_ALGORITHM, BCRYPT_SHA384_ALGORITHM, BCRYPT_SHA512_ALGORITHM, BCRYPT_SHA512_ALGORITHM };
+
+/*
+ * Names of the hash algorithms in PHC strings, indexed like HASH_ALGORITHM
+ */
+const TCHAR* const PHC_HASH_NAME[5] = { _T("sha1"), _T("sha256"), _T("sha384"), _T("sha512"), _T("sha512") };
+
 /*
  * Calculate the value of PBKDF2 for a password in UTF-8 encoding, a salt as a byte array an an iteration count.
+ * The library opens the algorithm providers once and shares them between all threads, so repeated calls only pay for the derivation itself.
+ * The derived key has requestedKeySize bytes. If this is 0 it has the size of the hash value. It is taken from the arena.
+ * If there is a profile the derivation is measured in it.
  */
 void calculatePBKDF2(TOCTET** ppDerivedKey,
 							int* const pDerivedKeySize,
-							LPCWSTR pHashType,
+							const int requestedKeySize,
+							ARENA* const pArena,
+							PHASE_PROFILE* const pProfile,
+							const int hashType,
 							TOCTET* pSalt,
 							int saltSize,
 							int iterationCount,
@@ -401,53 +629,32 @@ void calculatePBKDF2(TOCTET** ppDerivedKey,
 							int passwordSize,
 							TCHAR* const errorBuffer,
 							const int errorBufferSize) {
-	BCRYPT_ALG_HANDLE handleHash = NULL;
+	LARGE_INTEGER startTickValue;
 
-	ULONG outputSize;
+	RESET_ERROR_MSG;
 
-	NTSTATUS status = NTSTATUS_UNSUCCESSFUL;
+	*pDerivedKeySize = (requestedKeySize > 0) ? requestedKeySize : (int)pbkdf2_get_hash_size(hashType + MIN_HASH_TYPE);
 
-	const TCHAR* const apiErrorMessage = _T("Error 0x%x returned by %s\n");
+	if (*pDerivedKeySize == 0) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not open the algorithm provider of %ws\n"), HASH_ALGORITHM[hashType]);
+		return;
+	}
 
-	RESET_ERROR_MSG;
+	// Allocate space for the hash result
+	*ppDerivedKey = (TOCTET*)allocateFromArena(pArena, *pDerivedKeySize);
 
-	//Open an algorithm handle to an HMAC
-	if (NT_SUCCESS(status = BCryptOpenAlgorithmProvider(
-		&handleHash,
-		pHashType,
-		NULL,
-		BCRYPT_ALG_HANDLE_HMAC_FLAG))) {
-		// Get the size of the hash
-		if (NT_SUCCESS(status = BCryptGetProperty(handleHash,
-																BCRYPT_HASH_LENGTH,
-																(PUCHAR)pDerivedKeySize,
-																(ULONG)sizeof(int),
-																(ULONG*)&outputSize,
-																(ULONG)0))) {
-			// Allocate space for the hash result
-			*ppDerivedKey = (TOCTET*)malloc(*pDerivedKeySize);
-
-			if (*ppDerivedKey != NULL) {
-				//Calculate PBKDF2 with the hash
-				if (!NT_SUCCESS(status = BCryptDeriveKeyPBKDF2(
-					handleHash,
-					password,
-					(ULONG)passwordSize,
-					(PUCHAR)pSalt,
-					(ULONG)saltSize,
-					(ULONGLONG)iterationCount,
-					(PUCHAR)*ppDerivedKey,
-					(ULONG)*pDerivedKeySize,
-					(ULONG)0)))
-					_stprintf_s(errorBuffer, errorBufferSize, apiErrorMessage, status, _T("BCryptDeriveKeyPBKDF2"));
-			} else
-				_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for hash value\n"), *pDerivedKeySize);
-		} else
-			_stprintf_s(errorBuffer, errorBufferSize, apiErrorMessage, status, _T("BCryptGetProperty"));
+	if (*ppDerivedKey == NULL) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not allocate %d bytes for hash value\n"), *pDerivedKeySize);
+		return;
+	}
 
-		BCryptCloseAlgorithmProvider(handleHash, (ULONG)0);
-	} else
-		_stprintf_s(errorBuffer, errorBufferSize, apiErrorMessage, status, _T("BCryptOpenAlgorithmProvider"));
+	//Calculate PBKDF2 with the hash
+	startPhase(pProfile, &startTickValue);
+	const PBKDF2_RESULT result = pbkdf2_derive(hashType + MIN_HASH_TYPE, password, (ULONG)passwordSize, pSalt, (ULONG)saltSize, (ULONG)iterationCount, *ppDerivedKey, (ULONG)*pDerivedKeySize);
+	endPhase(pProfile, PHASE_DERIVE, &startTickValue);
+
+	if (result != PBKDF2_OK)
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Error %d returned by %s\n"), result, _T("pbkdf2_derive"));
 }
 
 /*
@@ -460,6 +667,15 @@ BOOLEAN isHandleRedirected(const HANDLE handle) {
 	return (GetConsoleMode(handle, &mode) == 0);
 }
 
+/*
+* Write bytes to a file handle
+*/
+void writeBytes(const HANDLE fileHandle, const void* const bytes, const int byteCount) {
+	DWORD bytesWritten;
+
+	WriteFile(fileHandle, bytes, (DWORD)byteCount, &bytesWritten, NULL);
+}
+
 /*
 * Write a text buffer to a file handle
 */
@@ -477,207 +693,5818 @@ void writeBuffer(const HANDLE fileHandle, const BOOLEAN isRedirected, TCHAR* con
 
 		WriteConsole(fileHandle, text, (DWORD)_tcslen(text), &charsWritten, NULL);  // This writes characters
 	} else {
-		WriteFile(fileHandle, text, (DWORD)_tcslen(text) * sizeof(TCHAR), &charsWritten, NULL); // But this writes bytes
+		writeBytes(fileHandle, text, (int)(_tcslen(text) * sizeof(TCHAR))); // But this writes bytes
 	}
 }
 
-// List of hash algorithms that can be used
-LPCWSTR HASH_ALGORITHM[5] = { BCRYPT_SHA1_ALGORITHM, BCRYPT_SHA256_ALGORITHM, BCRYPT_SHA384_ALGORITHM, BCRYPT_SHA512_ALGORITHM, BCRYPT_SHA512_ALGORITHM };
-
 /*
- * The main program
+ * Write the number of measurements, the total and the mean duration of each phase that has been measured
  */
-int _tmain(const int argc, TCHAR* const argv[]) {
-	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];  // Bloody stupid null termination character
-
-	int returnValue = 0;
+void writePhaseProfile(const PHASE_PROFILE* const pProfile, const HANDLE fileHandle, const BOOLEAN isRedirected) {
+	TCHAR lineBuffer[ERROR_BUFFER_SIZE + 1];
 
-	HANDLE outputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-	HANDLE errorHandle = GetStdHandle(STD_ERROR_HANDLE);
+	if (tickDuration == 0.0)
+		getTickDuration();
 
-	BOOLEAN isOutputRedirected = isHandleRedirected(outputHandle);
-	BOOLEAN isErrorRedirected = isHandleRedirected(errorHandle);
+	for (int i = 0; i < PHASE_COUNT; i++)
+		if (pProfile->count[i] > 0) {
+			const double totalDuration = pProfile->ticks[i] * tickDuration;
 
-	TOCTET* releasePassword = NULL;
-	TOCTET* releaseSalt = NULL;
-	TOCTET* releaseDerivedKey = NULL;
+			_stprintf_s(lineBuffer, ERROR_BUFFER_SIZE, _T("Phase: %s, Count: %d, Total: %.3f ms, Mean: %.3f us\n"), PHASE_NAME[i], pProfile->count[i], totalDuration * 1000, totalDuration * 1000000 / pProfile->count[i]);
+			writeBuffer(fileHandle, isRedirected, lineBuffer);
+		}
+}
 
-	if (argc >= 5) {
-		//Should I do it right or not?
-		BOOLEAN doItRight = (argc >= 6);
+/*
+ * Size of the buffer of an output writer in characters. It is below the 64 KB that WriteConsole can write at once.
+ */
+#define OUTPUT_BUFFER_SIZE 16383
 
-		// 1. Get the hash type
+/*
+ * Size of the buffer of an output writer in bytes
+ */
+#define OUTPUT_BUFFER_BYTE_SIZE (OUTPUT_BUFFER_SIZE * (int)sizeof(TCHAR))
 
-		int hashType;
+/*
+ * An output writer that collects texts and writes them with one writeBuffer call when its buffer is full.
+ * This saves one system call and, in the ANSI version, one OEM conversion per text.
+ * Bytes that are not text can only be written if the output is redirected.
+ */
+typedef struct {
+	HANDLE fileHandle;
+	BOOLEAN isRedirected;
+	int usedSize;                            // Number of bytes in the buffer
+	TCHAR buffer[OUTPUT_BUFFER_SIZE + 1];
+} OUTPUT_WRITER;
 
-		hashType = getIntegerArg(_T("hashType"), ARGV_HASH_TYPE, MIN_HASH_TYPE, MAX_HASH_TYPE, errorBuffer, ERROR_BUFFER_SIZE) - 1;
+/*
+ * Initialize an output writer for a file handle
+ */
+void initializeOutputWriter(OUTPUT_WRITER* const pWriter, const HANDLE fileHandle, const BOOLEAN isRedirected) {
+	pWriter->fileHandle = fileHandle;
+	pWriter->isRedirected = isRedirected;
+	pWriter->usedSize = 0;
+	pWriter->buffer[0] = _T('\0');
+}
 
-		if (IS_ERROR_MSG_SET) {
-			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+/*
+ * Write the texts that have been collected in an output writer
+ */
+void flushOutputWriter(OUTPUT_WRITER* const pWriter) {
+	if (pWriter->usedSize > 0) {
+		if (pWriter->isRedirected)
+			writeBytes(pWriter->fileHandle, pWriter->buffer, pWriter->usedSize);
+		else {
+			pWriter->buffer[pWriter->usedSize / sizeof(TCHAR)] = _T('\0');
 
-			returnValue = 2;
-			goto Exit;
+			writeBuffer(pWriter->fileHandle, FALSE, pWriter->buffer);
 		}
 
-		// 2. Get the salt
-
-		int salt;
-		int saltArraySize;
-		TOCTET* saltArray;
+		pWriter->usedSize = 0;
+	}
+}
 
-		if (doItRight) {
-			/*
-			* If we should do it right we interpret the salt as an array of bytes
-			*/
-			safeHexStringToByteArray(ARGV_SALT, &saltArray, &saltArraySize, errorBuffer, ERROR_BUFFER_SIZE);
-			releaseSalt = saltArray;
-		} else {
-			/*
-			* If we should to it wrong we interpret the salt as an integer
-			*/
-			salt = getIntegerArg(_T("salt"), ARGV_SALT, MIN_SALT, MAX_SALT, errorBuffer, ERROR_BUFFER_SIZE);
+/*
+ * Add bytes to an output writer. The buffer is written first if the bytes do not fit into it.
+ * Bytes that are more than the whole buffer are written directly.
+ */
+void writeOutputBytes(OUTPUT_WRITER* const pWriter, const void* const bytes, const int byteCount) {
+	if (pWriter->usedSize + byteCount > OUTPUT_BUFFER_BYTE_SIZE)
+		flushOutputWriter(pWriter);
 
-			saltArraySize = sizeof(salt);
-			saltArray = (TOCTET*)&salt;
-		}
+	if (byteCount <= OUTPUT_BUFFER_BYTE_SIZE) {
+		memcpy((BYTE*)pWriter->buffer + pWriter->usedSize, bytes, byteCount);
 
-		if (IS_ERROR_MSG_SET) {
-			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+		pWriter->usedSize += byteCount;
+	} else
+		writeBytes(pWriter->fileHandle, bytes, byteCount);
+}
 
-			returnValue = 2;
-			goto Exit;
-		}
+/*
+ * Add a text to an output writer. A text that is larger than the whole buffer is written directly.
+ */
+void writeOutput(OUTPUT_WRITER* const pWriter, TCHAR* const text) {
+	const int textByteCount = (int)(_tcslen(text) * sizeof(TCHAR));
 
-		// 3. Get the iteration count
+	if (textByteCount <= OUTPUT_BUFFER_BYTE_SIZE)
+		writeOutputBytes(pWriter, text, textByteCount);
+	else {
+		flushOutputWriter(pWriter);
 
-		int iterationCount = getIntegerArg(_T("iterationCount"), ARGV_ITERATION_COUNT, MIN_ITERATION_COUNT, MAX_ITERATION_COUNT, errorBuffer, ERROR_BUFFER_SIZE);
+		writeBuffer(pWriter->fileHandle, pWriter->isRedirected, text);
+	}
+}
 
-		if (IS_ERROR_MSG_SET) {
-			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+/*
+ * Engines that can calculate PBKDF2
+ */
+typedef enum {
+	ENGINE_CNG,    // The CNG function BCryptDeriveKeyPBKDF2
+	ENGINE_SIMD,   // The native multi-buffer engine that calculates several derivations at once in SIMD lanes
+	ENGINE_SHANI,  // The native single-stream engine that uses the SHA extensions of the processor
+	ENGINE_PORTABLE, // The portable reference engine that neither uses CNG nor processor specific code
+	ENGINE_GPU       // The GPU engine that calculates many derivations at once in a Direct3D 11 compute shader
+} DERIVATION_ENGINE;
 
-			returnValue = 2;
-			goto Exit;
-		}
+/*
+ * Formats of the salt and the derived key in the result line
+ */
+typedef enum {
+	OUTPUT_FORMAT_HEX,       // Hex bytes separated by blanks
+	OUTPUT_FORMAT_COMPACT,   // Hex bytes without separators
+	OUTPUT_FORMAT_BASE64,    // Base64 with padding
+	OUTPUT_FORMAT_PHC,       // PHC string "$pbkdf2-<hash>$i=<iterationCount>$<salt>$<key>" with Base64 without padding
+	OUTPUT_FORMAT_BINARY     // Size of the derived key and the derived key as bytes
+} OUTPUT_FORMAT;
 
-		// 4. Get the password
+/*
+ * Number of bytes of the key size in front of a derived key in the binary format
+ */
+#define BINARY_KEY_SIZE_SIZE 2
 
-		//Attention: password has been converted from OEM code page to Windows character set (A) or UTF-16 (W)!
-		const TCHAR* const password = ARGV_PASSWORD;
-		const int passwordSize = (int) _tcslen(password);
+/*
+ * Binary result of a record with an error
+ */
+const TOCTET EMPTY_BINARY_RESULT[BINARY_KEY_SIZE_SIZE] = { 0, 0 };
 
-		int passwordBytesSize = 0;
-		TOCTET* passwordBytes = NULL;
+/*
+ * Display names of the engines, indexed by DERIVATION_ENGINE
+ */
+const TCHAR* const ENGINE_DISPLAY_NAME[] = { _T("CNG"), _T("SIMD"), _T("SHA-NI"), _T("Portable"), _T("GPU") };
 
-		if (doItRight) {
-			/*
-			 * If we should do it right we now get the UTF-8 encoding of the password
-			 */
-			int passwordInUTF8Size = 0;
-			TOCTET* passwordInUTF8 = NULL;
+/*
+ * Native hash function of each index of HASH_ALGORITHM. NATIVE_HASH_NONE means that the native engine does not support it.
+ */
+const NATIVE_HASH NATIVE_HASH_OF_HASH_TYPE[MAX_HASH_TYPE] = { NATIVE_HASH_SHA1, NATIVE_HASH_SHA256, NATIVE_HASH_NONE, NATIVE_HASH_NONE, NATIVE_HASH_NONE };
 
-			getPasswordUTF8Encoding(password, passwordSize, &passwordInUTF8, &passwordInUTF8Size, errorBuffer, ERROR_BUFFER_SIZE);
+/*
+ * Portable hash function of each index of HASH_ALGORITHM
+ */
+const PORTABLE_HASH PORTABLE_HASH_OF_HASH_TYPE[MAX_HASH_TYPE] = { PORTABLE_HASH_SHA1, PORTABLE_HASH_SHA256, PORTABLE_HASH_SHA384, PORTABLE_HASH_SHA512, PORTABLE_HASH_SHA512 };
 
-			if (IS_ERROR_MSG_NOT_SET) {
-				passwordBytesSize = passwordInUTF8Size;
-				passwordBytes = passwordInUTF8;
-				releasePassword = passwordInUTF8;
-			} else {
-				writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+/*
+ * Maximum number of records that are derived together. This is the lane count of the widest multi-buffer kernel.
+ */
+#define MAX_DERIVATION_GROUP_SIZE 16
 
-				returnValue = 3;
-				goto Exit;
-			}
-		} else {
-			/*
-			 * If we should do it wrong we use the password as it is. I.e. ANSI characters in ANSI mode and UTF-16 characters in Unicode mode.
-			 */
-			passwordBytesSize = (int)(_tcslen(password) * sizeof(TCHAR));
-			passwordBytes = (TOCTET*)password;
-		}
+/*
+ * One record with its parameters converted into the form that is needed for the derivation, and its result.
+ * All buffers of the record are taken from its arena, so they are given back when the arena is reset.
+ */
+typedef struct {
+	ARENA* pArena;
+	PHASE_PROFILE* pProfile;  // NULL if the phases are not measured
+	int hashType;
+	int iterationCount;
+	int salt;                 // The salt as an integer, if it is not interpreted as a byte array
+	TOCTET* saltArray;
+	int saltArraySize;
+	const TCHAR* password;    // The password as text for the result line
+	TOCTET* passwordBytes;
+	int passwordBytesSize;
+	BOOLEAN doItRight;
+	int requestedKeySize;     // 0 means the size of the hash value
+	BOOLEAN isBlockParallel;  // The blocks of a multi-block key may be calculated on several threads
+	TOCTET* derivedKey;
+	int derivedKeySize;
+	double duration;
+	int returnValue;
+	TOCTET* expectedKey;      // NULL if the derived key is not verified
+	int expectedKeySize;
+	BOOLEAN isMatch;          // The derived key is equal to the expected key
+	TOCTET* cacheTag;         // NULL if the derived key is not stored in the result cache
+	BOOLEAN isCached;         // The derived key has been taken from the result cache
+	TCHAR errorText[ERROR_BUFFER_SIZE + 1];
+} DERIVATION_RECORD;
 
-		/*
-		 * Finally we get to the point. Here we calculate the PBKDF2 and measure the time duration needed to calculate it
-		 */
-		int derivedKeySize = 0;
-		TOCTET* pDerivedKey = NULL;
+/*
+ * Initialize a record, so that it can be released even if it has not been prepared completely
+ */
+void initializeRecord(DERIVATION_RECORD* const pRecord, ARENA* const pArena, const TCHAR* const password, const BOOLEAN doItRight) {
+	pRecord->pArena = pArena;
+	pRecord->pProfile = NULL;
+	pRecord->password = password;
+	pRecord->doItRight = doItRight;
+	pRecord->requestedKeySize = 0;
+	pRecord->isBlockParallel = FALSE;
+	pRecord->saltArray = NULL;
+	pRecord->passwordBytes = NULL;
+	pRecord->derivedKey = NULL;
+	pRecord->derivedKeySize = 0;
+	pRecord->expectedKey = NULL;
+	pRecord->expectedKeySize = 0;
+	pRecord->cacheTag = NULL;
+	pRecord->isCached = FALSE;
+	pRecord->isMatch = FALSE;
+	pRecord->duration = 0.0;
+	pRecord->returnValue = 0;
+	pRecord->errorText[0] = _T('\0');
+}
 
-		startTimer();
-		calculatePBKDF2(&pDerivedKey, &derivedKeySize, HASH_ALGORITHM[hashType], saltArray, saltArraySize, iterationCount, passwordBytes, passwordBytesSize, errorBuffer, ERROR_BUFFER_SIZE);
-		double duration = getElapsedTime();
+/*
+ * Convert hash type, salt, iteration count and password of a record into the form that is needed for the derivation.
+ * If there is a profile it is kept in the record, so that all phases of the record are measured in it.
+ * The iteration count must not be larger than maxIterationCount.
+ * passwordCodePage is the code page of the password in ANSI mode, i.e. CP_ACP for the command line or the input code page for records.
+ * Returns the exit code of the program for this record. On errors the error message is in the record.
+ */
+int prepareRecord(DERIVATION_RECORD* const pRecord,
+						ARENA* const pArena,
+						PHASE_PROFILE* const pProfile,
+						const TCHAR* const hashTypeText,
+						TCHAR* const saltText,
+						const TCHAR* const iterationCountText,
+						const TCHAR* const password,
+						const UINT passwordCodePage,
+						const BOOLEAN doItRight,
+						const int requestedKeySize,
+						const int maxIterationCount) {
+	TCHAR* const errorBuffer = pRecord->errorText;
+	const int errorBufferSize = ERROR_BUFFER_SIZE;
 
-		releaseDerivedKey = pDerivedKey;
+	LARGE_INTEGER startTickValue;
 
-		if (IS_ERROR_MSG_NOT_SET) {
-			TCHAR* saltText;
+	initializeRecord(pRecord, pArena, password, doItRight);
 
-			if (doItRight)
-				saltText = bytesToHex(saltArray, saltArraySize);
-			else {
-				saltText = (TCHAR*)malloc(20 * sizeof(TCHAR));
+	pRecord->pProfile = pProfile;
+	pRecord->requestedKeySize = requestedKeySize;
 
-				if (saltText != NULL)
-					_itot_s(*(int*)saltArray, saltText, 20, 10);
-			}
+	startPhase(pProfile, &startTickValue);
 
-			if (saltText != NULL) {
-				// Print the parameters and the result
-				const TCHAR* const pbkdf2AsText = bytesToHex(pDerivedKey, derivedKeySize);
-				_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("HashType: %ws, Salt: %s, IterationCount: %d, Password: \'%s\', PBKDF2: %s\n"), HASH_ALGORITHM[hashType], saltText, iterationCount, password, pbkdf2AsText);
-				writeBuffer(outputHandle, isOutputRedirected, errorBuffer);
+	// 1. Get the hash type
 
-				free((void*)saltText);
-				free((void*)pbkdf2AsText);
+	pRecord->hashType = getIntegerArg(_T("hashType"), hashTypeText, MIN_HASH_TYPE, MAX_HASH_TYPE, errorBuffer, errorBufferSize) - 1;
 
-				// Print the time measurement
-				_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Duration: %d ms\n"), lround(duration * 1000));
-				writeBuffer(outputHandle, isOutputRedirected, errorBuffer);
-			} else {
-				_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("Could not allocate salt text array\n"));
-				writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	if (IS_ERROR_MSG_SET) {
+		pRecord->returnValue = 2;
+		return pRecord->returnValue;
+	}
 
-				returnValue = 3;
-				goto Exit;
-			}
-		} else {
-			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	// 2. Get the salt
 
-			returnValue = 2;
-			goto Exit;
-		}
+	if (doItRight) {
+		/*
+		* If we should do it right we interpret the salt as an array of bytes
+		*/
+		safeHexStringToByteArray(pArena, saltText, &pRecord->saltArray, &pRecord->saltArraySize, errorBuffer, errorBufferSize);
 	} else {
-		_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("Not enough arguments\n"));
-		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+		/*
+		* If we should to it wrong we interpret the salt as an integer
+		*/
+		pRecord->salt = getIntegerArg(_T("salt"), saltText, MIN_SALT, MAX_SALT, errorBuffer, errorBufferSize);
 
-		_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("Usage: pbkdf2 <hashType> <salt> <iterationCount> <password> [doItRight]\n"));
-		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+		pRecord->saltArraySize = sizeof(pRecord->salt);
+		pRecord->saltArray = (TOCTET*)&pRecord->salt;
+	}
 
-		_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("       hashType: 1=SHA-1, 2=SHA-256, 3=SHA384, 5=SHA512\n"));
-		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	if (IS_ERROR_MSG_SET) {
+		pRecord->returnValue = 2;
+		return pRecord->returnValue;
+	}
 
-		_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("       doItRight: If present the salt is interpreted as a byte array and\n"));
-		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	// 3. Get the iteration count
 
-		_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("                  the password is converted to UTF-8 before hashing\n"));
-		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	pRecord->iterationCount = getIntegerArg(_T("iterationCount"), iterationCountText, MIN_ITERATION_COUNT, maxIterationCount, errorBuffer, errorBufferSize);
 
-		_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("                  Otherwise the salt is interpreted as an integer and\n"));
-		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	if (IS_ERROR_MSG_SET) {
+		pRecord->returnValue = 2;
+		return pRecord->returnValue;
+	}
 
-		_tcscpy_s(errorBuffer, sizeof(errorBuffer), _T("                  the password is used in the ANSI or UTF-16 encoding\n"));
-		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	endPhase(pProfile, PHASE_PARSE, &startTickValue);
 
-		returnValue = 1;
-	}
+	// 4. Get the password
 
-Exit:
-	if (releasePassword != NULL)
-		free((void*)releasePassword);
+	startPhase(pProfile, &startTickValue);
+
+	//Attention: password has been converted from OEM code page to Windows character set (A) or UTF-16 (W)!
+	const int passwordSize = (int) _tcslen(password);
+
+	if (doItRight) {
+		/*
+		 * If we should do it right we now get the UTF-8 encoding of the password
+		 */
+		int passwordInUTF8Size = 0;
+		TOCTET* passwordInUTF8 = NULL;
+
+		getPasswordUTF8Encoding(pArena, password, passwordSize, passwordCodePage, &passwordInUTF8, &passwordInUTF8Size, errorBuffer, errorBufferSize);
+
+		if (IS_ERROR_MSG_NOT_SET) {
+			pRecord->passwordBytesSize = passwordInUTF8Size;
+			pRecord->passwordBytes = passwordInUTF8;
+		} else
+			pRecord->returnValue = 3;
+	} else {
+		/*
+		 * If we should do it wrong we use the password as it is. I.e. ANSI characters in ANSI mode and UTF-16 characters in Unicode mode.
+		 */
+		pRecord->passwordBytesSize = (int)(passwordSize * sizeof(TCHAR));
+		pRecord->passwordBytes = (TOCTET*)password;
+	}
+
+	endPhase(pProfile, PHASE_ENCODING, &startTickValue);
+
+	return pRecord->returnValue;
+}
+
+/*
+ * Remove the blanks from a text in place, so that a key can be given in the blank separated output format
+ */
+void removeBlanks(TCHAR* const text) {
+	TCHAR* pDestination = text;
+
+	for (const TCHAR* pSource = text; *pSource != _T('\0'); pSource++)
+		if (*pSource != _T(' ')) {
+			*pDestination = *pSource;
+			pDestination++;
+		}
+
+	*pDestination = _T('\0');
+}
+
+/*
+ * Set the expected key of a prepared record. The derived key then gets the size of the expected key.
+ * Returns the exit code of the program for this record. On errors the error message is in the record.
+ */
+int prepareVerification(DERIVATION_RECORD* const pRecord, TCHAR* const expectedKeyText) {
+	TCHAR* const errorBuffer = pRecord->errorText;
+
+	removeBlanks(expectedKeyText);
+
+	if (*expectedKeyText != _T('\0')) {
+		safeHexStringToByteArray(pRecord->pArena, expectedKeyText, &pRecord->expectedKey, &pRecord->expectedKeySize, errorBuffer, ERROR_BUFFER_SIZE);
+
+		if (IS_ERROR_MSG_SET)
+			pRecord->returnValue = (pRecord->expectedKey == NULL) ? 3 : 2;
+		else if (pRecord->expectedKeySize > MAX_DERIVED_KEY_SIZE) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("\"%s\" is larger than maximum value of %d bytes\n"), _T("expectedKey"), MAX_DERIVED_KEY_SIZE);
+			pRecord->returnValue = 2;
+		} else
+			pRecord->requestedKeySize = pRecord->expectedKeySize;
+	} else {
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("\"%s\" is empty\n"), _T("expectedKey"));
+		pRecord->returnValue = 2;
+	}
+
+	return pRecord->returnValue;
+}
+
+/*
+ * Compare the derived key of a record with its expected key, if it has one
+ */
+void verifyRecord(DERIVATION_RECORD* const pRecord) {
+	if ((pRecord->returnValue == 0) && (pRecord->expectedKey != NULL))
+		pRecord->isMatch = (pRecord->derivedKeySize == pRecord->expectedKeySize) && pbkdf2_is_equal(pRecord->derivedKey, pRecord->expectedKey, (ULONG)pRecord->expectedKeySize);
+}
+
+/*
+ * Texts of the verification result, indexed by the isMatch flag of a record
+ */
+const TCHAR* const VERIFICATION_RESULT_TEXT[] = { _T("failed"), _T("passed") };
+
+/*
+ * ETW provider for the derivation events. Its GUID is derived from its name, so it can also be enabled as "*PBKDF2WinCTester".
+ */
+TRACELOGGING_DEFINE_PROVIDER(traceProvider,
+									  "PBKDF2WinCTester",
+									  (0xa3dc7098, 0x8e31, 0x5fac, 0x80, 0x2b, 0x38, 0xc5, 0xba, 0x37, 0x9a, 0x9b));
+
+/*
+ * Names of the engines in the ETW events, indexed by DERIVATION_ENGINE
+ */
+const char* const ENGINE_TRACE_NAME[] = { "CNG", "SIMD", "SHA-NI", "Portable", "GPU" };
+
+/*
+ * Write the start event of the derivation of recordCount records with the same hash type and iteration count.
+ * The events never contain passwords, salts or keys. If nobody listens to the provider nothing is written
+ * and FALSE is returned, so that the stop event is skipped, too. The activity id connects the start with the stop event.
+ */
+BOOLEAN traceDerivationStart(GUID* const pActivityId, const DERIVATION_ENGINE engine, const int hashType, const int iterationCount, const int recordCount) {
+	if (!TraceLoggingProviderEnabled(traceProvider, WINEVENT_LEVEL_INFO, 0))
+		return FALSE;
+
+	EventActivityIdControl(EVENT_ACTIVITY_CTRL_CREATE_ID, pActivityId);
+
+	TraceLoggingWriteActivity(traceProvider,
+									  "Derivation",
+									  pActivityId,
+									  NULL,
+									  TraceLoggingOpcode(WINEVENT_OPCODE_START),
+									  TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+									  TraceLoggingString(ENGINE_TRACE_NAME[engine], "Engine"),
+									  TraceLoggingWideString(HASH_ALGORITHM[hashType], "HashType"),
+									  TraceLoggingInt32(iterationCount, "IterationCount"),
+									  TraceLoggingInt32(recordCount, "RecordCount"));
+
+	return TRUE;
+}
+
+/*
+ * Write the stop event of a derivation with its duration in milliseconds and the exit code of its first record
+ */
+void traceDerivationStop(const GUID* const pActivityId, const DERIVATION_RECORD* const pRecord, const double duration) {
+	TraceLoggingWriteActivity(traceProvider,
+									  "Derivation",
+									  pActivityId,
+									  NULL,
+									  TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+									  TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+									  TraceLoggingWideString(HASH_ALGORITHM[pRecord->hashType], "HashType"),
+									  TraceLoggingInt32(pRecord->iterationCount, "IterationCount"),
+									  TraceLoggingInt32(pRecord->derivedKeySize, "KeySize"),
+									  TraceLoggingFloat64(duration * 1000, "DurationMs"),
+									  TraceLoggingInt32(pRecord->returnValue, "ReturnValue"));
+}
+
+/*
+ * Derive the key of a record with CNG and measure the time duration needed to calculate it
+ */
+void deriveRecordWithCNG(DERIVATION_RECORD* const pRecord) {
+	TCHAR* const errorBuffer = pRecord->errorText;
+
+	LARGE_INTEGER startTickValue;
+
+	GUID activityId;
+
+	const BOOLEAN isTraced = traceDerivationStart(&activityId, ENGINE_CNG, pRecord->hashType, pRecord->iterationCount, 1);
+
+	startTimer(&startTickValue);
+	calculatePBKDF2(&pRecord->derivedKey, &pRecord->derivedKeySize, pRecord->requestedKeySize, pRecord->pArena, pRecord->pProfile, pRecord->hashType, pRecord->saltArray, pRecord->saltArraySize, pRecord->iterationCount, pRecord->passwordBytes, pRecord->passwordBytesSize, errorBuffer, ERROR_BUFFER_SIZE);
+	pRecord->duration = getElapsedTime(&startTickValue);
+
+	if (IS_ERROR_MSG_SET)
+		pRecord->returnValue = 2;
+
+	if (isTraced)
+		traceDerivationStop(&activityId, pRecord, pRecord->duration);
+}
+
+/*
+ * Derive the keys of a group of records with the same hash type and iteration count with the native multi-buffer engine.
+ * As the records are derived at the same time, each one is assigned an equal share of the duration.
+ */
+void deriveRecordGroupWithSimd(DERIVATION_RECORD* const records[], const int recordCount) {
+	NATIVE_PBKDF2_REQUEST requests[MAX_DERIVATION_GROUP_SIZE];
+
+	const NATIVE_HASH hash = NATIVE_HASH_OF_HASH_TYPE[records[0]->hashType];
+	const int digestSize = nativeGetDigestSize(hash);
+
+	BOOLEAN isAllocated = TRUE;
+
+	for (int i = 0; i < recordCount; i++) {
+		DERIVATION_RECORD* const pRecord = records[i];
+
+		pRecord->derivedKeySize = (pRecord->requestedKeySize > 0) ? pRecord->requestedKeySize : digestSize;
+		pRecord->derivedKey = (TOCTET*)allocateFromArena(pRecord->pArena, pRecord->derivedKeySize);
+
+		isAllocated = isAllocated && (pRecord->derivedKey != NULL);
+
+		requests[i].password = pRecord->passwordBytes;
+		requests[i].passwordSize = (ULONG)pRecord->passwordBytesSize;
+		requests[i].salt = pRecord->saltArray;
+		requests[i].saltSize = (ULONG)pRecord->saltArraySize;
+		requests[i].derivedKey = pRecord->derivedKey;
+		requests[i].derivedKeySize = (ULONG)pRecord->derivedKeySize;
+	}
+
+	LARGE_INTEGER startTickValue;
+
+	GUID activityId;
+
+	const BOOLEAN isTraced = traceDerivationStart(&activityId, ENGINE_SIMD, records[0]->hashType, records[0]->iterationCount, recordCount);
+
+	startTimer(&startTickValue);
+
+	const BOOLEAN isDerived = isAllocated && nativePBKDF2MultiBuffer(hash, (ULONG)records[0]->iterationCount, requests, recordCount);
+
+	// The group is measured once in the profile of its first record
+	endPhase(records[0]->pProfile, PHASE_DERIVE, &startTickValue);
+
+	const double duration = getElapsedTime(&startTickValue) / recordCount;
+
+	for (int i = 0; i < recordCount; i++) {
+		DERIVATION_RECORD* const pRecord = records[i];
+
+		pRecord->duration = duration;
+
+		if (!isDerived) {
+			_stprintf_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate memory for the multi-buffer engine\n"));
+			pRecord->returnValue = 3;
+		}
+	}
+
+	if (isTraced)
+		traceDerivationStop(&activityId, records[0], duration * recordCount);
+}
+
+/*
+ * Derive the key of a record with the native SHA extensions engine and measure the time duration needed to calculate it
+ */
+void deriveRecordWithShaNi(DERIVATION_RECORD* const pRecord) {
+	const NATIVE_HASH hash = NATIVE_HASH_OF_HASH_TYPE[pRecord->hashType];
+
+	pRecord->derivedKeySize = (pRecord->requestedKeySize > 0) ? pRecord->requestedKeySize : nativeGetDigestSize(hash);
+	pRecord->derivedKey = (TOCTET*)allocateFromArena(pRecord->pArena, pRecord->derivedKeySize);
+
+	if (pRecord->derivedKey != NULL) {
+		NATIVE_PBKDF2_REQUEST request;
+
+		request.password = pRecord->passwordBytes;
+		request.passwordSize = (ULONG)pRecord->passwordBytesSize;
+		request.salt = pRecord->saltArray;
+		request.saltSize = (ULONG)pRecord->saltArraySize;
+		request.derivedKey = pRecord->derivedKey;
+		request.derivedKeySize = (ULONG)pRecord->derivedKeySize;
+
+		LARGE_INTEGER startTickValue;
+
+		GUID activityId;
+
+		const BOOLEAN isTraced = traceDerivationStart(&activityId, ENGINE_SHANI, pRecord->hashType, pRecord->iterationCount, 1);
+
+		startTimer(&startTickValue);
+		nativePBKDF2ShaNi(hash, (ULONG)pRecord->iterationCount, &request, pRecord->isBlockParallel);
+		pRecord->duration = getElapsedTime(&startTickValue);
+
+		endPhase(pRecord->pProfile, PHASE_DERIVE, &startTickValue);
+
+		if (isTraced)
+			traceDerivationStop(&activityId, pRecord, pRecord->duration);
+	} else {
+		_stprintf_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate %d bytes for hash value\n"), pRecord->derivedKeySize);
+		pRecord->returnValue = 3;
+	}
+}
+
+/*
+ * Derive the key of a record with the portable engine and measure the time duration needed to calculate it
+ */
+void deriveRecordWithPortable(DERIVATION_RECORD* const pRecord) {
+	const PORTABLE_HASH hash = PORTABLE_HASH_OF_HASH_TYPE[pRecord->hashType];
+
+	pRecord->derivedKeySize = (pRecord->requestedKeySize > 0) ? pRecord->requestedKeySize : portableGetDigestSize(hash);
+	pRecord->derivedKey = (TOCTET*)allocateFromArena(pRecord->pArena, pRecord->derivedKeySize);
+
+	if (pRecord->derivedKey != NULL) {
+		LARGE_INTEGER startTickValue;
+
+		GUID activityId;
+
+		const BOOLEAN isTraced = traceDerivationStart(&activityId, ENGINE_PORTABLE, pRecord->hashType, pRecord->iterationCount, 1);
+
+		startTimer(&startTickValue);
+		portablePBKDF2(hash, pRecord->passwordBytes, (ULONG)pRecord->passwordBytesSize, pRecord->saltArray, (ULONG)pRecord->saltArraySize, (ULONG)pRecord->iterationCount, pRecord->derivedKey, (ULONG)pRecord->derivedKeySize);
+		pRecord->duration = getElapsedTime(&startTickValue);
+
+		endPhase(pRecord->pProfile, PHASE_DERIVE, &startTickValue);
+
+		if (isTraced)
+			traceDerivationStop(&activityId, pRecord, pRecord->duration);
+	} else {
+		_stprintf_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate %d bytes for hash value\n"), pRecord->derivedKeySize);
+		pRecord->returnValue = 3;
+	}
+}
+
+/*
+ * Derive the keys of the records with the GPU engine. All records with the same hash type and iteration count are derived together.
+ * Records that already have an error or a key from the result cache are skipped.
+ * Records with hash types that the GPU does not support, and groups that the GPU could not derive, are derived with CNG.
+ * As the records of a group are derived at the same time, each one is assigned an equal share of the duration.
+ * The lists of the groups are taken from the arena of the records, which they all share.
+ */
+void deriveRecordsWithGpu(DERIVATION_RECORD* const records, const int recordCount) {
+	ARENA* const pArena = records[0].pArena;
+
+	BOOLEAN* const isDerived = (BOOLEAN*)allocateFromArena(pArena, recordCount * sizeof(BOOLEAN));
+	DERIVATION_RECORD** const group = (DERIVATION_RECORD**)allocateFromArena(pArena, recordCount * sizeof(DERIVATION_RECORD*));
+	NATIVE_PBKDF2_REQUEST* const requests = (NATIVE_PBKDF2_REQUEST*)allocateFromArena(pArena, recordCount * sizeof(NATIVE_PBKDF2_REQUEST));
+
+	const BOOLEAN isAllocated = (isDerived != NULL) && (group != NULL) && (requests != NULL);
+
+	if (isAllocated)
+		for (int i = 0; i < recordCount; i++)
+			isDerived[i] = (records[i].returnValue != 0) || records[i].isCached;
+
+	for (int i = 0; i < recordCount; i++) {
+		DERIVATION_RECORD* const pRecord = &records[i];
+
+		if ((pRecord->returnValue != 0) || pRecord->isCached)
+			continue;
+
+		const NATIVE_HASH hash = NATIVE_HASH_OF_HASH_TYPE[pRecord->hashType];
+
+		if (!isAllocated || (hash == NATIVE_HASH_NONE)) {
+			deriveRecordWithCNG(pRecord);
+			continue;
+		}
+
+		if (isDerived[i])
+			continue;
+
+		const int digestSize = nativeGetDigestSize(hash);
+
+		int groupSize = 0;
+
+		for (int j = i; j < recordCount; j++) {
+			DERIVATION_RECORD* const pMember = &records[j];
+
+			if (isDerived[j] || (pMember->hashType != pRecord->hashType) || (pMember->iterationCount != pRecord->iterationCount))
+				continue;
+
+			isDerived[j] = TRUE;
+
+			pMember->derivedKeySize = (pMember->requestedKeySize > 0) ? pMember->requestedKeySize : digestSize;
+			pMember->derivedKey = (TOCTET*)allocateFromArena(pMember->pArena, pMember->derivedKeySize);
+
+			if (pMember->derivedKey == NULL) {
+				_stprintf_s(pMember->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate %d bytes for hash value\n"), pMember->derivedKeySize);
+				pMember->returnValue = 3;
+				continue;
+			}
+
+			requests[groupSize].password = pMember->passwordBytes;
+			requests[groupSize].passwordSize = (ULONG)pMember->passwordBytesSize;
+			requests[groupSize].salt = pMember->saltArray;
+			requests[groupSize].saltSize = (ULONG)pMember->saltArraySize;
+			requests[groupSize].derivedKey = pMember->derivedKey;
+			requests[groupSize].derivedKeySize = (ULONG)pMember->derivedKeySize;
+
+			group[groupSize] = pMember;
+			groupSize++;
+		}
+
+		if (groupSize == 0)
+			continue;
+
+		LARGE_INTEGER startTickValue;
+
+		GUID activityId;
+
+		const BOOLEAN isTraced = traceDerivationStart(&activityId, ENGINE_GPU, pRecord->hashType, pRecord->iterationCount, groupSize);
+
+		startTimer(&startTickValue);
+
+		if (gpuPBKDF2(hash, (ULONG)pRecord->iterationCount, requests, groupSize)) {
+			// The group is measured once in the profile of its first record
+			endPhase(group[0]->pProfile, PHASE_DERIVE, &startTickValue);
+
+			const double duration = getElapsedTime(&startTickValue) / groupSize;
+
+			for (int j = 0; j < groupSize; j++)
+				group[j]->duration = duration;
+
+			if (isTraced)
+				traceDerivationStop(&activityId, group[0], duration * groupSize);
+		} else {
+			if (isTraced)
+				traceDerivationStop(&activityId, group[0], getElapsedTime(&startTickValue));
+
+			// CNG allocates the derived keys again, which is fine for an arena
+			for (int j = 0; j < groupSize; j++)
+				deriveRecordWithCNG(group[j]);
+		}
+	}
+}
+
+/*
+ * Derive the keys of records with the selected engine.
+ * Records that already have an error or a key from the result cache are skipped. The SIMD engine derives all records
+ * with the same hash type and iteration count together. The native engines use CNG for the hash types they do not support.
+ * The portable engine supports all hash types. The GPU engine derives the records in groups of its own.
+ */
+void deriveRecordsWithEngine(DERIVATION_RECORD* const records, const int recordCount, const DERIVATION_ENGINE engine) {
+	// The GPU engine derives larger groups than the other engines
+	if (engine == ENGINE_GPU) {
+		deriveRecordsWithGpu(records, recordCount);
+		return;
+	}
+
+	BOOLEAN isDerived[MAX_DERIVATION_GROUP_SIZE];
+	DERIVATION_RECORD* group[MAX_DERIVATION_GROUP_SIZE];
+
+	for (int i = 0; i < recordCount; i++)
+		isDerived[i] = (records[i].returnValue != 0) || records[i].isCached;
+
+	for (int i = 0; i < recordCount; i++)
+		if (!isDerived[i]) {
+			DERIVATION_RECORD* const pRecord = &records[i];
+
+			if ((engine == ENGINE_SIMD) && (NATIVE_HASH_OF_HASH_TYPE[pRecord->hashType] != NATIVE_HASH_NONE)) {
+				int groupSize = 0;
+
+				for (int j = i; j < recordCount; j++)
+					if (!isDerived[j] && (records[j].hashType == pRecord->hashType) && (records[j].iterationCount == pRecord->iterationCount)) {
+						group[groupSize] = &records[j];
+						groupSize++;
+
+						isDerived[j] = TRUE;
+					}
+
+				deriveRecordGroupWithSimd(group, groupSize);
+			} else if ((engine == ENGINE_SHANI) && (NATIVE_HASH_OF_HASH_TYPE[pRecord->hashType] != NATIVE_HASH_NONE)) {
+				deriveRecordWithShaNi(pRecord);
+
+				isDerived[i] = TRUE;
+			} else if (engine == ENGINE_PORTABLE) {
+				deriveRecordWithPortable(pRecord);
+
+				isDerived[i] = TRUE;
+			} else {
+				deriveRecordWithCNG(pRecord);
+
+				isDerived[i] = TRUE;
+			}
+		}
+}
+
+/*
+ * Result cache of the derived keys. NULL if no cache is used.
+ */
+static RESULT_CACHE* pResultCache = NULL;
+
+/*
+ * Look up the derived key of a record in the result cache. Returns TRUE if the key has been found.
+ * The tag of a record that is not in the cache is kept, so that its key can be stored when it has been derived.
+ */
+BOOLEAN lookupCachedRecord(DERIVATION_RECORD* const pRecord) {
+	const int derivedKeySize = (pRecord->requestedKeySize > 0) ? pRecord->requestedKeySize : portableGetDigestSize(PORTABLE_HASH_OF_HASH_TYPE[pRecord->hashType]);
+
+	TOCTET* const tag = (TOCTET*)allocateFromArena(pRecord->pArena, CACHE_TAG_SIZE);
+	TOCTET* const derivedKey = (TOCTET*)allocateFromArena(pRecord->pArena, derivedKeySize);
+
+	// A record that can not be looked up is simply derived
+	if ((tag == NULL) || (derivedKey == NULL) ||
+		 !cacheGetTag(pResultCache, pRecord->hashType, pRecord->iterationCount, pRecord->saltArray, pRecord->saltArraySize, pRecord->passwordBytes, pRecord->passwordBytesSize, derivedKeySize, tag))
+		return FALSE;
+
+	if (cacheLookup(pResultCache, tag, derivedKey, derivedKeySize)) {
+		pRecord->derivedKey = derivedKey;
+		pRecord->derivedKeySize = derivedKeySize;
+		pRecord->isCached = TRUE;
+	} else
+		pRecord->cacheTag = tag;
+
+	return pRecord->isCached;
+}
+
+/*
+ * Derive the keys of records. If there is a result cache, the keys of the records that are in the cache are taken from it,
+ * and the keys of all other records are derived with the selected engine and stored in the cache.
+ * The duration of a record from the cache is the duration of its lookup.
+ */
+void deriveRecords(DERIVATION_RECORD* const records, const int recordCount, const DERIVATION_ENGINE engine) {
+	if (pResultCache == NULL) {
+		deriveRecordsWithEngine(records, recordCount, engine);
+		return;
+	}
+
+	for (int i = 0; i < recordCount; i++) {
+		DERIVATION_RECORD* const pRecord = &records[i];
+
+		if (pRecord->returnValue == 0) {
+			LARGE_INTEGER startTickValue;
+
+			startTimer(&startTickValue);
+
+			if (lookupCachedRecord(pRecord)) {
+				pRecord->duration = getElapsedTime(&startTickValue);
+
+				endPhase(pRecord->pProfile, PHASE_DERIVE, &startTickValue);
+			}
+		}
+	}
+
+	deriveRecordsWithEngine(records, recordCount, engine);
+
+	for (int i = 0; i < recordCount; i++) {
+		const DERIVATION_RECORD* const pRecord = &records[i];
+
+		if ((pRecord->returnValue == 0) && (pRecord->cacheTag != NULL))
+			cacheStore(pResultCache, pRecord->cacheTag, pRecord->derivedKey, pRecord->derivedKeySize);
+	}
+}
+
+/*
+ * Convert bytes of a record into text in an output format
+ */
+TCHAR* bytesToFormat(ARENA* const pArena, const TOCTET* const byteBuffer, const int bufferSize, const OUTPUT_FORMAT outputFormat) {
+	switch (outputFormat) {
+		case OUTPUT_FORMAT_BASE64:
+			return bytesToBase64(pArena, byteBuffer, bufferSize, TRUE);
+
+		case OUTPUT_FORMAT_PHC:
+			return bytesToBase64(pArena, byteBuffer, bufferSize, FALSE);
+
+		default:
+			return bytesToHex(pArena, byteBuffer, bufferSize, (BOOLEAN)(outputFormat == OUTPUT_FORMAT_HEX));
+	}
+}
+
+/*
+ * Format a derived record in the binary format, i.e. the size of the derived key in little endian byte order
+ * followed by the derived key. Returns the size of the result in bytes.
+ */
+int formatBinaryRecordResult(const DERIVATION_RECORD* const pRecord, TOCTET* const resultBuffer) {
+	resultBuffer[0] = (TOCTET)pRecord->derivedKeySize;
+	resultBuffer[1] = (TOCTET)(pRecord->derivedKeySize >> 8);
+
+	memcpy(resultBuffer + BINARY_KEY_SIZE_SIZE, pRecord->derivedKey, pRecord->derivedKeySize);
+
+	return BINARY_KEY_SIZE_SIZE + pRecord->derivedKeySize;
+}
+
+/*
+ * Format the parameters and the result of a derived record as a result line in the output format.
+ * A PHC string only contains the hash type, the iteration count, the salt and the derived key.
+ * As the binary format is not text the size of the result in bytes is returned. It is 0 if there is an error.
+ */
+int formatRecordResult(DERIVATION_RECORD* const pRecord, const OUTPUT_FORMAT outputFormat, TCHAR* const resultBuffer, const int resultBufferSize) {
+	LARGE_INTEGER startTickValue;
+
+	startPhase(pRecord->pProfile, &startTickValue);
+
+	if (outputFormat == OUTPUT_FORMAT_BINARY) {
+		const int resultSize = formatBinaryRecordResult(pRecord, (TOCTET*)resultBuffer);
+
+		endPhase(pRecord->pProfile, PHASE_FORMAT, &startTickValue);
+
+		return resultSize;
+	}
+
+	TCHAR* saltAsText;
+
+	// A PHC string always contains the bytes of the salt that have been hashed
+	if (pRecord->doItRight || (outputFormat == OUTPUT_FORMAT_PHC))
+		saltAsText = bytesToFormat(pRecord->pArena, pRecord->saltArray, pRecord->saltArraySize, outputFormat);
+	else {
+		saltAsText = (TCHAR*)allocateFromArena(pRecord->pArena, 20 * sizeof(TCHAR));
+
+		if (saltAsText != NULL)
+			_itot_s(*(int*)pRecord->saltArray, saltAsText, 20, 10);
+	}
+
+	if (saltAsText != NULL) {
+		const TCHAR* const pbkdf2AsText = bytesToFormat(pRecord->pArena, pRecord->derivedKey, pRecord->derivedKeySize, outputFormat);
+
+		if (pbkdf2AsText != NULL) {
+			if (outputFormat == OUTPUT_FORMAT_PHC)
+				_stprintf_s(resultBuffer, resultBufferSize, _T("$pbkdf2-%s$i=%d$%s$%s\n"), PHC_HASH_NAME[pRecord->hashType], pRecord->iterationCount, saltAsText, pbkdf2AsText);
+			else
+				_stprintf_s(resultBuffer, resultBufferSize, _T("HashType: %ws, Salt: %s, IterationCount: %d, Password: \'%s\', PBKDF2: %s\n"), HASH_ALGORITHM[pRecord->hashType], saltAsText, pRecord->iterationCount, pRecord->password, pbkdf2AsText);
+		} else {
+			_tcscpy_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate key text array\n"));
+
+			pRecord->returnValue = 3;
+		}
+	} else {
+		_tcscpy_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate salt text array\n"));
+
+		pRecord->returnValue = 3;
+	}
+
+	endPhase(pRecord->pProfile, PHASE_FORMAT, &startTickValue);
+
+	return (pRecord->returnValue == 0) ? (int)(_tcslen(resultBuffer) * sizeof(TCHAR)) : 0;
+}
+
+/*
+ * Process one record of hash type, salt, iteration count and password.
+ * On success the result line is written into the result buffer and the duration of the derivation is returned in pDuration.
+ * The size of the result in bytes is returned in pResultSize, as the binary format is not text.
+ * If there is a profile the phases of the record are measured in it.
+ * If there is an expected key the derived key is only compared with it and the result line just tells if it is equal.
+ * As the record is derived alone, the blocks of a multi-block key are calculated in parallel.
+ * The return value is the exit code of the program for this record. It is 5 if the derived key is not the expected key.
+ */
+int processRecord(const TCHAR* const hashTypeText,
+						TCHAR* const saltText,
+						const TCHAR* const iterationCountText,
+						const TCHAR* const password,
+						const BOOLEAN doItRight,
+						const int requestedKeySize,
+						TCHAR* const expectedKeyText,
+						const DERIVATION_ENGINE engine,
+						const OUTPUT_FORMAT outputFormat,
+						PHASE_PROFILE* const pProfile,
+						TCHAR* const resultBuffer,
+						const int resultBufferSize,
+						int* const pResultSize,
+						double* const pDuration,
+						TCHAR* const errorBuffer,
+						const int errorBufferSize) {
+	DERIVATION_RECORD record;
+
+	ARENA arena;
+
+	initializeArena(&arena);
+
+	*pResultSize = 0;
+
+	if ((prepareRecord(&record, &arena, pProfile, hashTypeText, saltText, iterationCountText, password, CP_ACP, doItRight, requestedKeySize, MAX_ITERATION_COUNT) == 0) &&
+		 ((expectedKeyText == NULL) || (prepareVerification(&record, expectedKeyText) == 0))) {
+		record.isBlockParallel = TRUE;
+
+		/*
+		 * Finally we get to the point. Here we calculate the PBKDF2 and measure the time duration needed to calculate it
+		 */
+		deriveRecords(&record, 1, engine);
+
+		*pDuration = record.duration;
+
+		if (record.returnValue == 0) {
+			if (record.expectedKey != NULL) {
+				verifyRecord(&record);
+
+				*pResultSize = (int)(_stprintf_s(resultBuffer, resultBufferSize, _T("Verification: %s\n"), VERIFICATION_RESULT_TEXT[record.isMatch]) * sizeof(TCHAR));
+			} else
+				*pResultSize = formatRecordResult(&record, outputFormat, resultBuffer, resultBufferSize);
+		}
+	}
+
+	if (record.returnValue != 0)
+		_tcscpy_s(errorBuffer, errorBufferSize, record.errorText);
+
+	const BOOLEAN isVerificationFailed = (record.returnValue == 0) && (record.expectedKey != NULL) && !record.isMatch;
+
+	releaseArena(&arena);
+
+	return isVerificationFailed ? 5 : record.returnValue;
+}
+
+/*
+ * Iteration count for the validation of the native engines
+ */
+#define VALIDATION_ITERATION_COUNT 100
+
+/*
+ * Number of requests for the validation of the single-stream engine
+ */
+#define SINGLE_STREAM_VALIDATION_REQUEST_COUNT 4
+
+/*
+ * Check that a native or the GPU engine yields the same derived keys as CNG. The validation uses passwords that are
+ * longer and shorter than a hash block, salts of different sizes and derived keys with more than one block.
+ * Returns FALSE and sets the error message if the results differ.
+ */
+BOOLEAN validateNativeEngine(const DERIVATION_ENGINE engine, TCHAR* const errorBuffer, const int errorBufferSize) {
+	NATIVE_PBKDF2_REQUEST requests[MAX_DERIVATION_GROUP_SIZE + 1];
+	TOCTET passwords[MAX_DERIVATION_GROUP_SIZE + 1][80];
+	TOCTET salts[MAX_DERIVATION_GROUP_SIZE + 1][24];
+	TOCTET derivedKeys[MAX_DERIVATION_GROUP_SIZE + 1][2 * NATIVE_MAX_DIGEST_SIZE];
+	TOCTET referenceKey[2 * NATIVE_MAX_DIGEST_SIZE];
+
+	RESET_ERROR_MSG;
+
+	/*
+	 * For the SIMD engine one more request than there are lanes. All requests but the first one have two blocks,
+	 * so that full lane groups, a partial lane group and the scalar code for a single remaining block are checked.
+	 * The GPU engine gets as many requests as the widest multi-buffer kernel has lanes plus one.
+	 */
+	const int requestCount = (engine == ENGINE_SIMD) ? nativeGetMultiBufferLaneCount() + 1 : ((engine == ENGINE_GPU) ? MAX_DERIVATION_GROUP_SIZE + 1 : SINGLE_STREAM_VALIDATION_REQUEST_COUNT);
+
+	for (int hashType = 0; (hashType < MAX_HASH_TYPE) && IS_ERROR_MSG_NOT_SET; hashType++) {
+		const NATIVE_HASH hash = NATIVE_HASH_OF_HASH_TYPE[hashType];
+
+		if (hash == NATIVE_HASH_NONE)
+			continue;
+
+		const ULONG digestSize = (ULONG)nativeGetDigestSize(hash);
+
+		for (int i = 0; i < requestCount; i++) {
+			requests[i].passwordSize = (ULONG)((i * 5) % sizeof(passwords[i]) + 1);
+			requests[i].saltSize = (ULONG)((i * 3) % sizeof(salts[i]) + 1);
+
+			for (ULONG j = 0; j < requests[i].passwordSize; j++)
+				passwords[i][j] = (TOCTET)('!' + (i + j) % 90);
+
+			for (ULONG j = 0; j < requests[i].saltSize; j++)
+				salts[i][j] = (TOCTET)(i * 37 + j);
+
+			requests[i].password = passwords[i];
+			requests[i].salt = salts[i];
+			requests[i].derivedKey = derivedKeys[i];
+			requests[i].derivedKeySize = (i == 0) ? digestSize - 3 : 2 * digestSize - 3;
+		}
+
+		if (engine == ENGINE_SIMD) {
+			if (!nativePBKDF2MultiBuffer(hash, VALIDATION_ITERATION_COUNT, requests, requestCount)) {
+				_tcscpy_s(errorBuffer, errorBufferSize, _T("Could not allocate memory for the multi-buffer engine\n"));
+				break;
+			}
+		} else if (engine == ENGINE_GPU) {
+			if (!gpuPBKDF2(hash, VALIDATION_ITERATION_COUNT, requests, requestCount)) {
+				_tcscpy_s(errorBuffer, errorBufferSize, _T("GPU engine could not calculate the derived keys\n"));
+				break;
+			}
+		} else
+			for (int i = 0; i < requestCount; i++)
+				nativePBKDF2ShaNi(hash, VALIDATION_ITERATION_COUNT, &requests[i], TRUE);
+
+		for (int i = 0; (i < requestCount) && IS_ERROR_MSG_NOT_SET; i++) {
+			const PBKDF2_RESULT result = pbkdf2_derive(hashType + MIN_HASH_TYPE,
+																	 requests[i].password,
+																	 requests[i].passwordSize,
+																	 requests[i].salt,
+																	 requests[i].saltSize,
+																	 VALIDATION_ITERATION_COUNT,
+																	 referenceKey,
+																	 requests[i].derivedKeySize);
+
+			if (result == PBKDF2_OK) {
+				if (memcmp(referenceKey, derivedKeys[i], requests[i].derivedKeySize) != 0)
+					_stprintf_s(errorBuffer, errorBufferSize, _T("%s engine result for %ws differs from CNG\n"), ENGINE_DISPLAY_NAME[engine], HASH_ALGORITHM[hashType]);
+			} else
+				_stprintf_s(errorBuffer, errorBufferSize, _T("Error %d returned by %s\n"), result, _T("pbkdf2_derive"));
+		}
+	}
+
+	return IS_ERROR_MSG_NOT_SET;
+}
+
+/*
+ * Separator of the fields in a batch record
+ */
+#define BATCH_FIELD_SEPARATOR _T(',')
+
+/*
+ * Character that starts a comment line in a batch file
+ */
+#define BATCH_COMMENT_CHAR '#'
+
+/*
+ * Maximum length of one line in a batch file
+ */
+#define MAX_BATCH_LINE_SIZE 1023
+
+/*
+ * Name of the batch file that means "read from stdin"
+ */
+#define BATCH_STDIN_NAME _T("-")
+
+/*
+ * Number of records that are read and processed together in batch mode
+ */
+#define BATCH_CHUNK_SIZE 1024
+
+/*
+ * Size of the views of a memory mapped batch file
+ */
+#define BATCH_VIEW_SIZE (64 * 1024 * 1024)
+
+/*
+ * Maximum number of bytes of a chunk of records. A view is moved when less than this remains in it.
+ */
+#define BATCH_CHUNK_MAX_BYTES (BATCH_CHUNK_SIZE * (MAX_BATCH_LINE_SIZE + 2))
+
+/*
+ * Number of chunks in the batch pipeline. While the workers derive the keys of one chunk,
+ * the results of the chunk before are written and the chunk after is read.
+ */
+#define BATCH_PIPELINE_DEPTH 3
+
+/*
+ * Minimum and maximum number of worker threads. A thread count of 0 means "one thread per logical processor".
+ */
+#define MIN_THREAD_COUNT 0
+#define MAX_THREAD_COUNT 256
+
+/*
+ * One record of a batch together with its result
+ */
+typedef struct {
+	int lineNumber;
+	const char* pLine;        // Line in the view of a mapped batch file that still has to be converted into recordText, or NULL
+	int lineSize;             // Size of the line without the line end. It is larger than MAX_BATCH_LINE_SIZE if the line is too long.
+	int returnValue;
+	BOOLEAN isMatch;
+	double duration;
+	int resultSize;           // Size of the result in bytes, as the binary format is not text
+	TCHAR recordText[MAX_BATCH_LINE_SIZE + 1];
+	TCHAR resultText[RESULT_BUFFER_SIZE + 1];  // The result line, the binary result or the error message
+} BATCH_RECORD;
+
+/*
+ * The records of a batch chunk that are shared by all workers
+ */
+typedef struct {
+	BATCH_RECORD* records;
+	int recordCount;
+	volatile LONG nextRecordIndex;
+	int groupSize;               // Number of records that a worker takes from the chunk at once
+	BOOLEAN doItRight;
+	int requestedKeySize;
+	BOOLEAN isVerify;            // The records contain an expected key that the derived key is compared with
+	DERIVATION_ENGINE engine;
+	OUTPUT_FORMAT outputFormat;
+	BOOLEAN isProfiled;          // The phases are measured in the profiles of the workers
+} BATCH_CONTEXT;
+
+/*
+ * A batch worker. Each worker has its own arena for the buffers of the records, so that the workers do not compete for the heap.
+ */
+typedef struct {
+	PTP_WORK work;
+	BATCH_CONTEXT* pContext;
+	ARENA arena;
+	PHASE_PROFILE profile;
+	DERIVATION_RECORD* derivations;  // One derivation per record of a group
+} BATCH_WORKER;
+
+/*
+ * Get the next field of a batch record. The field is terminated in place and
+ * the returned pointer points to the start of the following field or is NULL if there is none.
+ */
+TCHAR* splitBatchField(TCHAR* const field) {
+	TCHAR* pSeparator = _tcschr(field, BATCH_FIELD_SEPARATOR);
+
+	if (pSeparator != NULL) {
+		*pSeparator = _T('\0');
+		pSeparator++;
+	}
+
+	return pSeparator;
+}
+
+/*
+ * Split a record into the fields "hashType,salt,iterationCount,password" or, if isVerify is set,
+ * "hashType,salt,iterationCount,expectedKey,password". Returns the password or NULL if the record does not have enough fields.
+ */
+TCHAR* splitRecordFields(TCHAR* const recordText,
+								 const BOOLEAN isVerify,
+								 TCHAR** const pHashTypeText,
+								 TCHAR** const pSaltText,
+								 TCHAR** const pIterationCountText,
+								 TCHAR** const pExpectedKeyText) {
+	*pHashTypeText = recordText;
+	*pSaltText = splitBatchField(recordText);
+	*pIterationCountText = (*pSaltText != NULL) ? splitBatchField(*pSaltText) : NULL;
+	*pExpectedKeyText = (isVerify && (*pIterationCountText != NULL)) ? splitBatchField(*pIterationCountText) : NULL;
+
+	if (isVerify)
+		return (*pExpectedKeyText != NULL) ? splitBatchField(*pExpectedKeyText) : NULL;
+	else
+		return (*pIterationCountText != NULL) ? splitBatchField(*pIterationCountText) : NULL;
+}
+
+/*
+ * Code page of the records of batch files and of the server requests. It is CP_ACP, i.e. the Windows character set
+ * like the command line arguments, or CP_UTF8 if the records are UTF-8 text.
+ */
+static UINT inputCodePage = CP_ACP;
+
+/*
+ * Remove trailing line end characters from a line
+ */
+void stripLineEnd(char* const line) {
+	size_t lineSize = strlen(line);
+
+	while ((lineSize > 0) && ((line[lineSize - 1] == '\n') || (line[lineSize - 1] == '\r'))) {
+		lineSize--;
+		line[lineSize] = '\0';
+	}
+}
+
+/*
+ * Convert a line of a mapped batch file into the record text. The line must not be longer than MAX_BATCH_LINE_SIZE.
+ */
+void convertMappedLine(BATCH_RECORD* const pRecord) {
+#ifdef _UNICODE
+	// Batch files are read in the input code page
+	const int textSize = MultiByteToWideChar(inputCodePage, 0, pRecord->pLine, pRecord->lineSize, pRecord->recordText, MAX_BATCH_LINE_SIZE);
+
+	pRecord->recordText[textSize] = _T('\0');
+#else
+	memcpy(pRecord->recordText, pRecord->pLine, pRecord->lineSize);
+
+	pRecord->recordText[pRecord->lineSize] = '\0';
+#endif
+}
+
+/*
+ * Process a group of consecutive batch records and store the result line or the error message in each record.
+ * The records of a group are derived together, so that the SIMD engine can put them into its lanes.
+ * Their buffers are taken from the arena, which is reset when the group is done.
+ * Lines of a mapped batch file are converted here, so that the workers convert them in parallel.
+ * The derivations must have room for recordCount records.
+ */
+void processBatchRecordGroup(BATCH_RECORD* const records,
+									  const int recordCount,
+									  DERIVATION_RECORD* const derivations,
+									  ARENA* const pArena,
+									  PHASE_PROFILE* const pProfile,
+									  const BATCH_CONTEXT* const pContext) {
+	for (int i = 0; i < recordCount; i++) {
+		const BOOLEAN isLineTooLong = (records[i].lineSize > MAX_BATCH_LINE_SIZE);
+
+		if (isLineTooLong)
+			*records[i].recordText = _T('\0');
+		else if (records[i].pLine != NULL)
+			convertMappedLine(&records[i]);
+
+		TCHAR* hashTypeText;
+		TCHAR* saltText;
+		TCHAR* iterationCountText;
+		TCHAR* expectedKeyText;
+
+		TCHAR* const password = splitRecordFields(records[i].recordText, pContext->isVerify, &hashTypeText, &saltText, &iterationCountText, &expectedKeyText);
+
+		if (password != NULL) {
+			if ((prepareRecord(&derivations[i], pArena, pProfile, hashTypeText, saltText, iterationCountText, password, inputCodePage, pContext->doItRight, pContext->requestedKeySize, MAX_ITERATION_COUNT) == 0) && pContext->isVerify)
+				prepareVerification(&derivations[i], expectedKeyText);
+		} else {
+			initializeRecord(&derivations[i], pArena, password, pContext->doItRight);
+
+			if (isLineTooLong)
+				_stprintf_s(derivations[i].errorText, ERROR_BUFFER_SIZE, _T("Line is longer than %d characters\n"), MAX_BATCH_LINE_SIZE);
+			else
+				_stprintf_s(derivations[i].errorText, ERROR_BUFFER_SIZE, _T("Record does not have the format \"%s\"\n"), pContext->isVerify ? _T("hashType,salt,iterationCount,expectedKey,password") : _T("hashType,salt,iterationCount,password"));
+
+			derivations[i].returnValue = 2;
+		}
+	}
+
+	deriveRecords(derivations, recordCount, pContext->engine);
+
+	for (int i = 0; i < recordCount; i++) {
+		BATCH_RECORD* const pRecord = &records[i];
+		DERIVATION_RECORD* const pDerivation = &derivations[i];
+
+		if (pDerivation->returnValue == 0) {
+			if (pContext->isVerify) {
+				verifyRecord(pDerivation);
+
+				pRecord->resultSize = (int)(_stprintf_s(pRecord->resultText, RESULT_BUFFER_SIZE, _T("Line %d: %s\n"), pRecord->lineNumber, VERIFICATION_RESULT_TEXT[pDerivation->isMatch]) * sizeof(TCHAR));
+			} else
+				pRecord->resultSize = formatRecordResult(pDerivation, pContext->outputFormat, pRecord->resultText, RESULT_BUFFER_SIZE);
+		}
+
+		pRecord->isMatch = pDerivation->isMatch;
+
+		if (pDerivation->returnValue != 0)
+			_stprintf_s(pRecord->resultText, RESULT_BUFFER_SIZE, _T("Line %d: %s"), pRecord->lineNumber, pDerivation->errorText);
+
+		pRecord->returnValue = pDerivation->returnValue;
+		pRecord->duration = pDerivation->duration;
+	}
+
+	resetArena(pArena);
+}
+
+/*
+ * Process groups of batch records until there are no more unprocessed records in the chunk
+ */
+void processBatchRecords(BATCH_WORKER* const pWorker) {
+	BATCH_CONTEXT* const pContext = pWorker->pContext;
+
+	const int groupSize = pContext->groupSize;
+
+	int groupStart;
+
+	while ((groupStart = InterlockedAdd(&pContext->nextRecordIndex, groupSize) - groupSize) < pContext->recordCount)
+		processBatchRecordGroup(&pContext->records[groupStart], min(groupSize, pContext->recordCount - groupStart), pWorker->derivations, &pWorker->arena, pContext->isProfiled ? &pWorker->profile : NULL, pContext);
+}
+
+/*
+ * Thread pool callback of a batch worker
+ */
+VOID CALLBACK batchWorkCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work) {
+	UNREFERENCED_PARAMETER(instance);
+	UNREFERENCED_PARAMETER(work);
+
+	processBatchRecords((BATCH_WORKER*)context);
+}
+
+/*
+ * Read the next chunk of records from the batch file. Returns the number of records read.
+ * The rest of a line that is too long is skipped, and its record gets a line size that is larger than MAX_BATCH_LINE_SIZE.
+ */
+int readBatchChunk(FILE* const batchFile, BATCH_RECORD* const records, int* const pLineNumber) {
+	char lineBuffer[MAX_BATCH_LINE_SIZE + 2];   // Line end and null termination character
+
+	int recordCount = 0;
+
+	while ((recordCount < BATCH_CHUNK_SIZE) && (fgets(lineBuffer, sizeof(lineBuffer), batchFile) != NULL)) {
+		(*pLineNumber)++;
+
+		const size_t readSize = strlen(lineBuffer);
+
+		BOOLEAN isLineTooLong = FALSE;
+
+		// A full buffer without a line end is a line that is too long, unless only the \n of a \r\n is left
+		if ((readSize == MAX_BATCH_LINE_SIZE + 1) && (lineBuffer[readSize - 1] != '\n')) {
+			int c = getc(batchFile);
+
+			isLineTooLong = (lineBuffer[readSize - 1] != '\r') || (c != '\n');
+
+			while ((c != '\n') && (c != EOF))
+				c = getc(batchFile);
+		}
+
+		stripLineEnd(lineBuffer);
+
+		if ((*lineBuffer == '\0') || (*lineBuffer == BATCH_COMMENT_CHAR))
+			continue;
+
+		BATCH_RECORD* const pRecord = &records[recordCount];
+
+		pRecord->lineNumber = *pLineNumber;
+		pRecord->pLine = NULL;
+		pRecord->lineSize = isLineTooLong ? MAX_BATCH_LINE_SIZE + 1 : (int)strlen(lineBuffer);
+
+#ifdef _UNICODE
+		// Batch files are read in the input code page
+		if (MultiByteToWideChar(inputCodePage, 0, lineBuffer, -1, pRecord->recordText, MAX_BATCH_LINE_SIZE + 1) == 0)
+			*pRecord->recordText = _T('\0');
+#else
+		strcpy_s(pRecord->recordText, MAX_BATCH_LINE_SIZE + 1, lineBuffer);
+#endif
+
+		recordCount++;
+	}
+
+	return recordCount;
+}
+
+/*
+ * A batch file that is read through a memory mapping. The file is mapped in views of BATCH_VIEW_SIZE bytes,
+ * so that files of any size can be read, and the lines are taken directly from the view.
+ */
+typedef struct {
+	HANDLE fileHandle;
+	HANDLE mappingHandle;     // NULL if the file is empty, as an empty file can not be mapped
+	LONGLONG fileSize;
+	LONGLONG position;        // Offset of the next line in the file
+	LONGLONG viewOffset;
+	const char* pView;        // NULL if no view is mapped
+	const char* pRetiredView; // View that has been replaced while the records of the chunk before may still point into it, or NULL
+	SIZE_T viewSize;
+	DWORD allocationGranularity;
+	BOOLEAN isSkippingLine;   // The rest of a line that is too long has to be skipped
+	BOOLEAN isMappingFailed;
+} MAPPED_BATCH_FILE;
+
+/*
+ * Open a batch file and create a mapping for it. Returns FALSE if the file can not be opened or mapped.
+ */
+BOOLEAN openMappedBatchFile(MAPPED_BATCH_FILE* const pFile, const TCHAR* const batchFileName) {
+	SYSTEM_INFO systemInfo;
+	LARGE_INTEGER fileSize;
+
+	GetSystemInfo(&systemInfo);
+
+	pFile->mappingHandle = NULL;
+	pFile->fileSize = 0;
+	pFile->position = 0;
+	pFile->viewOffset = 0;
+	pFile->pView = NULL;
+	pFile->pRetiredView = NULL;
+	pFile->viewSize = 0;
+	pFile->allocationGranularity = systemInfo.dwAllocationGranularity;
+	pFile->isSkippingLine = FALSE;
+	pFile->isMappingFailed = FALSE;
+
+	pFile->fileHandle = CreateFile(batchFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (pFile->fileHandle == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	if (!GetFileSizeEx(pFile->fileHandle, &fileSize))
+		return FALSE;
+
+	pFile->fileSize = fileSize.QuadPart;
+
+	if (pFile->fileSize > 0)
+		pFile->mappingHandle = CreateFileMapping(pFile->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	return (pFile->fileSize == 0) || (pFile->mappingHandle != NULL);
+}
+
+/*
+ * Close a mapped batch file
+ */
+void closeMappedBatchFile(MAPPED_BATCH_FILE* const pFile) {
+	if (pFile->pView != NULL)
+		UnmapViewOfFile(pFile->pView);
+
+	if (pFile->pRetiredView != NULL)
+		UnmapViewOfFile(pFile->pRetiredView);
+
+	if (pFile->mappingHandle != NULL)
+		CloseHandle(pFile->mappingHandle);
+
+	if (pFile->fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(pFile->fileHandle);
+}
+
+/*
+ * Unmap the retired view of a mapped batch file. This must only be called when no records of an earlier chunk are in work any more.
+ */
+void releaseRetiredBatchView(MAPPED_BATCH_FILE* const pFile) {
+	if (pFile->pRetiredView != NULL) {
+		UnmapViewOfFile(pFile->pRetiredView);
+
+		pFile->pRetiredView = NULL;
+	}
+}
+
+/*
+ * Make sure that the view of a mapped batch file contains a whole chunk of records from the actual position on.
+ * The view is only moved if less than BATCH_CHUNK_MAX_BYTES remain in it and it does not already reach the end of the file.
+ * A replaced view is retired, as the records of the chunk before may still be converted by the workers.
+ * If there already is a retired view the replaced view has no records in work, because the chunk that is read has none yet.
+ */
+BOOLEAN mapBatchView(MAPPED_BATCH_FILE* const pFile) {
+	const LONGLONG viewEnd = pFile->viewOffset + (LONGLONG)pFile->viewSize;
+
+	if ((pFile->pView != NULL) && ((viewEnd == pFile->fileSize) || (viewEnd - pFile->position >= BATCH_CHUNK_MAX_BYTES)))
+		return TRUE;
+
+	if (pFile->pRetiredView == NULL)
+		pFile->pRetiredView = pFile->pView;
+	else if (pFile->pView != NULL)
+		UnmapViewOfFile(pFile->pView);
+
+	pFile->pView = NULL;
+
+	// A view has to start at a multiple of the allocation granularity
+	pFile->viewOffset = pFile->position - (pFile->position % pFile->allocationGranularity);
+	pFile->viewSize = (SIZE_T)min(pFile->fileSize - pFile->viewOffset, (LONGLONG)BATCH_VIEW_SIZE);
+
+	pFile->pView = (const char*)MapViewOfFile(pFile->mappingHandle, FILE_MAP_READ, (DWORD)(pFile->viewOffset >> 32), (DWORD)(pFile->viewOffset & 0xffffffff), pFile->viewSize);
+
+	return (pFile->pView != NULL);
+}
+
+/*
+ * Take the records of the next chunk from the view of a mapped batch file. The records only point to their lines in the view.
+ * A line that is cut at the end of the view ends the chunk, so that it is read from the next view.
+ * Only a line that does not even fit into a whole view is taken as it is and reported as too long.
+ */
+int scanBatchView(MAPPED_BATCH_FILE* const pFile, BATCH_RECORD* const records, int* const pLineNumber) {
+	const char* const pViewEnd = pFile->pView + pFile->viewSize;
+	const BOOLEAN isFileEndInView = (pFile->viewOffset + (LONGLONG)pFile->viewSize == pFile->fileSize);
+
+	const char* pLine = pFile->pView + (SIZE_T)(pFile->position - pFile->viewOffset);
+
+	int recordCount = 0;
+
+	while ((recordCount < BATCH_CHUNK_SIZE) && (pLine < pViewEnd)) {
+		const char* pLineEnd = (const char*)memchr(pLine, '\n', (size_t)(pViewEnd - pLine));
+		const char* pNextLine;
+
+		const BOOLEAN isCut = (pLineEnd == NULL) && !isFileEndInView;
+
+		if (isCut && (pViewEnd - pLine < BATCH_CHUNK_MAX_BYTES))
+			break;
+
+		if (pLineEnd != NULL)
+			pNextLine = pLineEnd + 1;
+		else {
+			pLineEnd = pViewEnd;
+			pNextLine = pViewEnd;
+		}
+
+		if (!pFile->isSkippingLine) {
+			(*pLineNumber)++;
+
+			while ((pLineEnd > pLine) && (*(pLineEnd - 1) == '\r'))
+				pLineEnd--;
+
+			if ((pLineEnd > pLine) && (*pLine != BATCH_COMMENT_CHAR)) {
+				BATCH_RECORD* const pRecord = &records[recordCount];
+
+				pRecord->lineNumber = *pLineNumber;
+				pRecord->pLine = pLine;
+				pRecord->lineSize = (int)min(pLineEnd - pLine, (LONGLONG)MAX_BATCH_LINE_SIZE + 1);
+
+				recordCount++;
+			}
+		}
+
+		pFile->isSkippingLine = isCut;
+
+		pLine = pNextLine;
+	}
+
+	pFile->position = pFile->viewOffset + (LONGLONG)(pLine - pFile->pView);
+
+	return recordCount;
+}
+
+/*
+ * Read the next chunk of records from a mapped batch file. Returns the number of records read.
+ * The lines of the records stay valid until the next chunk is read.
+ */
+int readMappedBatchChunk(MAPPED_BATCH_FILE* const pFile, BATCH_RECORD* const records, int* const pLineNumber) {
+	int recordCount = 0;
+
+	// A chunk may end without records if the view had to be moved, so scan until there are records or the file is done
+	while ((recordCount == 0) && (pFile->position < pFile->fileSize)) {
+		if (!mapBatchView(pFile)) {
+			pFile->isMappingFailed = TRUE;
+			break;
+		}
+
+		recordCount = scanBatchView(pFile, records, pLineNumber);
+	}
+
+	return recordCount;
+}
+
+/*
+ * Read the next chunk of records from stdin or from the mapped batch file. Returns the number of records read.
+ */
+int readNextBatchChunk(FILE* const batchFile, MAPPED_BATCH_FILE* const pMappedFile, BATCH_RECORD* const records, int* const pLineNumber) {
+	return (batchFile != NULL) ? readBatchChunk(batchFile, records, pLineNumber) : readMappedBatchChunk(pMappedFile, records, pLineNumber);
+}
+
+/*
+ * Totals of all chunks of a batch
+ */
+typedef struct {
+	int recordCount;
+	int errorCount;
+	int failedCount;
+	double totalDuration;
+	int returnValue;          // Exit code of the first record with an error, or 0
+} BATCH_TOTALS;
+
+/*
+ * Write the results of a chunk in input order and add them to the totals
+ */
+void writeBatchResults(BATCH_RECORD* const records,
+							  const int recordCount,
+							  const BOOLEAN isVerify,
+							  const OUTPUT_FORMAT outputFormat,
+							  OUTPUT_WRITER* const pOutputWriter,
+							  PHASE_PROFILE* const pProfile,
+							  BATCH_TOTALS* const pTotals,
+							  const HANDLE errorHandle,
+							  const BOOLEAN isErrorRedirected) {
+	for (int i = 0; i < recordCount; i++) {
+		BATCH_RECORD* const pRecord = &records[i];
+
+		if (pRecord->returnValue == 0) {
+			LARGE_INTEGER startTickValue;
+
+			startPhase(pProfile, &startTickValue);
+			writeOutputBytes(pOutputWriter, pRecord->resultText, pRecord->resultSize);
+			endPhase(pProfile, PHASE_OUTPUT, &startTickValue);
+
+			if (isVerify && !pRecord->isMatch)
+				pTotals->failedCount++;
+		} else {
+			// In the binary format a record with an error has a key size of 0, so that the results still correspond to the records
+			if (outputFormat == OUTPUT_FORMAT_BINARY)
+				writeOutputBytes(pOutputWriter, EMPTY_BINARY_RESULT, BINARY_KEY_SIZE_SIZE);
+
+			// Errors are rare and written directly. The results before them are written first, so that the order is kept on the console.
+			flushOutputWriter(pOutputWriter);
+
+			writeBuffer(errorHandle, isErrorRedirected, pRecord->resultText);
+
+			pTotals->errorCount++;
+
+			if (pTotals->returnValue == 0)
+				pTotals->returnValue = pRecord->returnValue;
+		}
+
+		pTotals->totalDuration += pRecord->duration;
+	}
+
+	pTotals->recordCount += recordCount;
+}
+
+/*
+ * Process all records of a batch file. Each line has the format "hashType,salt,iterationCount,password".
+ * In verify mode each line has the format "hashType,salt,iterationCount,expectedKey,password" and
+ * only the result of the comparison with the expected key is written.
+ * The password is the remainder of the line, so it may contain the separator character.
+ * Empty lines and lines that start with '#' are ignored.
+ *
+ * The records are read in chunks that go through a pipeline of BATCH_PIPELINE_DEPTH chunks.
+ * While the records of one chunk are distributed over the worker threads, the results of the chunk before
+ * are written in input order and the chunk after is read, so reading and writing are hidden behind the derivations
+ * and the memory stays bounded by the chunks of the pipeline.
+ * The result lines are collected in an output writer, so that they are written in large blocks.
+ * A batch file is read through a memory mapping. Only stdin is read line by line.
+ * All GPU calls go through the lock of the one device, so with the GPU engine there is a single worker
+ * that submits each chunk as one group. More workers would only wait for the lock with smaller groups.
+ */
+int processBatch(const TCHAR* const batchFileName,
+					  const BOOLEAN doItRight,
+					  const int requestedKeySize,
+					  const BOOLEAN isVerify,
+					  const int threadCount,
+					  const DERIVATION_ENGINE engine,
+					  const OUTPUT_FORMAT outputFormat,
+					  const BOOLEAN isProfiled,
+					  const HANDLE outputHandle,
+					  const BOOLEAN isOutputRedirected,
+					  const HANDLE errorHandle,
+					  const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	const int workerCount = (engine == ENGINE_GPU) ? 1 : threadCount;
+
+	PHASE_PROFILE profile;
+
+	initializePhaseProfile(&profile);
+
+	PHASE_PROFILE* const pProfile = isProfiled ? &profile : NULL;
+
+	FILE* batchFile = NULL;
+
+	MAPPED_BATCH_FILE mappedFile;
+
+	mappedFile.fileHandle = INVALID_HANDLE_VALUE;
+	mappedFile.mappingHandle = NULL;
+	mappedFile.pView = NULL;
+	mappedFile.pRetiredView = NULL;
+
+	BATCH_RECORD* chunks[BATCH_PIPELINE_DEPTH] = { NULL };
+	BATCH_WORKER* workers = NULL;
+	OUTPUT_WRITER* pOutputWriter = NULL;
+
+	PTP_POOL pool = NULL;
+	TP_CALLBACK_ENVIRON callbackEnvironment;
+
+	InitializeThreadpoolEnvironment(&callbackEnvironment);
+
+	if (_tcscmp(batchFileName, BATCH_STDIN_NAME) == 0)
+		batchFile = stdin;
+	else
+		if (!openMappedBatchFile(&mappedFile, batchFileName)) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not open batch file \"%s\"\n"), batchFileName);
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 4;
+			goto Exit;
+		}
+
+	BOOLEAN isChunkMissing = FALSE;
+
+	for (int i = 0; i < BATCH_PIPELINE_DEPTH; i++)
+		if ((chunks[i] = (BATCH_RECORD*)malloc(BATCH_CHUNK_SIZE * sizeof(BATCH_RECORD))) == NULL)
+			isChunkMissing = TRUE;
+
+	workers = (BATCH_WORKER*)calloc(workerCount, sizeof(BATCH_WORKER));
+	pOutputWriter = (OUTPUT_WRITER*)malloc(sizeof(OUTPUT_WRITER));
+
+	if (isChunkMissing || (workers == NULL) || (pOutputWriter == NULL)) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate batch buffers\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	initializeOutputWriter(pOutputWriter, outputHandle, isOutputRedirected);
+
+	BATCH_CONTEXT context;
+
+	context.records = NULL;
+	context.recordCount = 0;
+	context.doItRight = doItRight;
+	context.requestedKeySize = requestedKeySize;
+	context.isVerify = isVerify;
+	context.engine = engine;
+	context.outputFormat = outputFormat;
+	context.isProfiled = isProfiled;
+	context.groupSize = (engine == ENGINE_SIMD) ? nativeGetMultiBufferLaneCount() : ((engine == ENGINE_GPU) ? BATCH_CHUNK_SIZE : 1);
+
+	for (int i = 0; i < workerCount; i++) {
+		workers[i].pContext = &context;
+
+		if ((workers[i].derivations = (DERIVATION_RECORD*)malloc(context.groupSize * sizeof(DERIVATION_RECORD))) == NULL) {
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate batch buffers\n"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 3;
+			goto Exit;
+		}
+	}
+
+	/*
+	 * The workers run in a private thread pool that has exactly one thread per worker.
+	 * This is also true for a single worker, so that the main thread can read and write while it derives.
+	 */
+	pool = CreateThreadpool(NULL);
+
+	if (pool != NULL) {
+		SetThreadpoolThreadMaximum(pool, (DWORD)workerCount);
+
+		if (!SetThreadpoolThreadMinimum(pool, (DWORD)workerCount)) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("SetThreadpoolThreadMinimum"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 3;
+			goto Exit;
+		}
+
+		SetThreadpoolCallbackPool(&callbackEnvironment, pool);
+
+		for (int i = 0; i < workerCount; i++)
+			if ((workers[i].work = CreateThreadpoolWork(batchWorkCallback, &workers[i], &callbackEnvironment)) == NULL) {
+				_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateThreadpoolWork"));
+				writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+				returnValue = 3;
+				goto Exit;
+			}
+	} else {
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateThreadpool"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	int lineNumber = 0;
+
+	BATCH_TOTALS totals;
+
+	memset(&totals, 0, sizeof(totals));
+
+	LARGE_INTEGER batchStartTickValue;
+
+	startTimer(&batchStartTickValue);
+
+	/*
+	 * In each step of the pipeline the chunk in the derive slot is derived by the workers, the chunk before it is written
+	 * and the chunk after it is read. The chunk that has been read is derived in the next step.
+	 */
+	int deriveSlot = 0;
+	int deriveRecordCount = readNextBatchChunk(batchFile, &mappedFile, chunks[deriveSlot], &lineNumber);
+	int writeRecordCount = 0;
+
+	while ((deriveRecordCount > 0) || (writeRecordCount > 0)) {
+		const int writeSlot = (deriveSlot + BATCH_PIPELINE_DEPTH - 1) % BATCH_PIPELINE_DEPTH;
+		const int readSlot = (deriveSlot + 1) % BATCH_PIPELINE_DEPTH;
+
+		if (deriveRecordCount > 0) {
+			context.records = chunks[deriveSlot];
+			context.recordCount = deriveRecordCount;
+			context.nextRecordIndex = 0;
+
+			for (int i = 0; i < workerCount; i++)
+				SubmitThreadpoolWork(workers[i].work);
+		}
+
+		writeBatchResults(chunks[writeSlot], writeRecordCount, isVerify, outputFormat, pOutputWriter, pProfile, &totals, errorHandle, isErrorRedirected);
+
+		const int readRecordCount = (deriveRecordCount > 0) ? readNextBatchChunk(batchFile, &mappedFile, chunks[readSlot], &lineNumber) : 0;
+
+		if (deriveRecordCount > 0)
+			for (int i = 0; i < workerCount; i++)
+				WaitForThreadpoolWorkCallbacks(workers[i].work, FALSE);
+
+		// The lines of the derived chunk are converted, so a view that has been replaced while it was read is not needed any more
+		if (batchFile == NULL)
+			releaseRetiredBatchView(&mappedFile);
+
+		writeRecordCount = deriveRecordCount;
+		deriveRecordCount = readRecordCount;
+		deriveSlot = readSlot;
+	}
+
+	returnValue = totals.returnValue;
+
+	double elapsedTime = getElapsedTime(&batchStartTickValue);
+
+	if ((batchFile == NULL) && mappedFile.isMappingFailed) {
+		flushOutputWriter(pOutputWriter);
+
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("MapViewOfFile"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 4;
+	}
+
+	if (isVerify)
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Records: %d, Errors: %d, Failed: %d, Threads: %d, Duration: %d ms, Elapsed: %d ms\n"), totals.recordCount, totals.errorCount, totals.failedCount, workerCount, lround(totals.totalDuration * 1000), lround(elapsedTime * 1000));
+	else
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Records: %d, Errors: %d, Threads: %d, Duration: %d ms, Elapsed: %d ms\n"), totals.recordCount, totals.errorCount, workerCount, lround(totals.totalDuration * 1000), lround(elapsedTime * 1000));
+
+	// The summary is text, so it is not mixed into binary results
+	if (outputFormat == OUTPUT_FORMAT_BINARY) {
+		flushOutputWriter(pOutputWriter);
+
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	} else {
+		writeOutput(pOutputWriter, errorBuffer);
+
+		flushOutputWriter(pOutputWriter);
+	}
+
+	if (isProfiled) {
+		for (int i = 0; i < workerCount; i++)
+			addPhaseProfile(&profile, &workers[i].profile);
+
+		if (outputFormat == OUTPUT_FORMAT_BINARY)
+			writePhaseProfile(&profile, errorHandle, isErrorRedirected);
+		else
+			writePhaseProfile(&profile, outputHandle, isOutputRedirected);
+	}
+
+	// Errors take precedence over failed verifications
+	if ((returnValue == 0) && (totals.failedCount > 0))
+		returnValue = 5;
+
+Exit:
+	if (workers != NULL) {
+		for (int i = 0; i < workerCount; i++) {
+			if (workers[i].work != NULL)
+				CloseThreadpoolWork(workers[i].work);
+
+			releaseArena(&workers[i].arena);
+
+			if (workers[i].derivations != NULL)
+				free((void*)workers[i].derivations);
+		}
+
+		free((void*)workers);
+	}
+
+	if (pool != NULL)
+		CloseThreadpool(pool);
+
+	DestroyThreadpoolEnvironment(&callbackEnvironment);
+
+	for (int i = 0; i < BATCH_PIPELINE_DEPTH; i++)
+		if (chunks[i] != NULL)
+			free((void*)chunks[i]);
+
+	if (pOutputWriter != NULL)
+		free((void*)pOutputWriter);
+
+	if (batchFile == NULL)
+		closeMappedBatchFile(&mappedFile);
+
+	return returnValue;
+}
+
+/*
+ * Prefix of the names of named pipes. It is added to a pipe name that does not start with it.
+ */
+#define PIPE_NAME_PREFIX _T("\\\\.\\pipe\\")
+
+/*
+ * Maximum size of a pipe name including the prefix
+ */
+#define MAX_PIPE_NAME_SIZE 256
+
+/*
+ * Number of pipe instances per server thread, i.e. the number of clients per thread that can be connected at the same time
+ */
+#define SERVER_INSTANCES_PER_THREAD 4
+
+/*
+ * Maximum size of a request in bytes
+ */
+#define MAX_SERVER_REQUEST_SIZE MAX_BATCH_LINE_SIZE
+
+/*
+ * Maximum size of a response in bytes. A response in the Windows character set may need 2 bytes per character.
+ */
+#define MAX_SERVER_RESPONSE_SIZE (2 * RESULT_BUFFER_SIZE)
+
+/*
+ * Commands of the requests
+ */
+#define SERVER_COMMAND_DERIVE _T("derive")
+#define SERVER_COMMAND_VERIFY _T("verify")
+
+/*
+ * States of a pipe connection, i.e. the operation that the connection waits for
+ */
+typedef enum {
+	CONNECTION_STATE_CONNECTING,   // Waiting for a client
+	CONNECTION_STATE_READING,      // Waiting for a request
+	CONNECTION_STATE_DEFERRED,     // Waiting in the queue of the scheduler for the derivation of the request
+	CONNECTION_STATE_WRITING,      // Waiting for the response to be sent
+	CONNECTION_STATE_CLOSED        // The pipe instance could not be reused
+} CONNECTION_STATE;
+
+/*
+ * Decisions of the scheduler about the derivation of a request
+ */
+typedef enum {
+	ADMISSION_NONE,                // The request has not been given to the scheduler yet
+	ADMISSION_DEFERRED,            // The request waits in the queue of the scheduler
+	ADMISSION_GRANTED,             // The derivation may start
+	ADMISSION_SHED                 // The request gets an error, as its wait is longer than the latency target
+} ADMISSION;
+
+/*
+ * One instance of the named pipe. There is at most one pending operation per instance,
+ * so the instance is only used by one server thread at a time. A deferred request has no pending operation,
+ * but it is owned by the scheduler until the scheduler posts it to the completion port.
+ */
+typedef struct PIPE_CONNECTION {
+	OVERLAPPED overlapped;         // Must be the first member, as the connection is found by the address of its completed OVERLAPPED structure
+	HANDLE pipeHandle;
+	CONNECTION_STATE state;
+	BOOLEAN isRequestTooLong;
+	DWORD requestSize;
+	DWORD responseSize;
+	ADMISSION admission;
+	double predictedCost;                    // Predicted seconds of the derivation of the request
+	LARGE_INTEGER admissionTickValue;        // Time at which the request has been given to the scheduler
+	struct PIPE_CONNECTION* pNextDeferred;   // Next request in the queue of the scheduler
+	char request[MAX_SERVER_REQUEST_SIZE + 1];
+	char response[MAX_SERVER_RESPONSE_SIZE];
+} PIPE_CONNECTION;
+
+/*
+ * Limits of the settings of the server scheduler
+ */
+#define MIN_CPU_BUDGET 1
+#define MAX_CPU_BUDGET 100
+#define MIN_LATENCY_TARGET 1
+#define MAX_LATENCY_TARGET 600000
+
+/*
+ * Time in seconds for which the CPU budget can be saved up for a burst of requests
+ */
+#define SCHEDULER_BURST_TIME 1.0
+
+/*
+ * Weight of a new measurement in the moving average of the cost of an iteration
+ */
+#define SCHEDULER_COST_WEIGHT 0.125
+
+/*
+ * Iteration count and number of the derivations that measure the cost of an iteration of each hash type when the server starts,
+ * and the size of their password and salt
+ */
+#define SCHEDULER_PROBE_ITERATION_COUNT 10000
+#define SCHEDULER_PROBE_COUNT 2
+#define SCHEDULER_PROBE_DATA_SIZE 16
+
+/*
+ * Shortest and longest time in seconds that the timer of the scheduler is set to. A longer wait takes several timer periods.
+ */
+#define SCHEDULER_MIN_TIMER_WAIT 0.001
+#define SCHEDULER_MAX_TIMER_WAIT (MAX_LATENCY_TARGET / 1000.0)
+
+/*
+ * Time in seconds after which the scheduler tries again to post a request that could not be posted to the completion port
+ */
+#define SCHEDULER_RETRY_TIME 0.01
+
+/*
+ * Settings of the scheduler of the server. The scheduler is only used if one of them is set.
+ */
+typedef struct {
+	int cpuBudget;            // Percentage of the time of all logical processors that the derivations may use, MAX_CPU_BUDGET if there is no budget
+	int maxConcurrentCount;   // Maximum number of derivations at the same time, 0 if there is no cap besides the thread count
+	int latencyTarget;        // Maximum time in ms that a request may wait for its derivation, 0 if there is no target
+} SCHEDULER_SETTINGS;
+
+/*
+ * The scheduler in front of the derivations of the server.
+ * A derivation may start when there are fewer than maxConcurrentCount derivations and the CPU budget has credit left.
+ * Otherwise its request is put into a queue and the server thread goes back to the completion port to serve the other connections.
+ * The requests of the queue are decided in their order when a derivation is finished and when the timer fires,
+ * which is set to the time when the credit is positive again or the first request reaches the latency target.
+ * A decided request is posted with its connection to the completion port, so the next free server thread processes it.
+ * The credit grows with the budget while time passes and each derivation is charged with its measured duration.
+ * The cost of an iteration is measured for each hash type, so that the wait of a request can be predicted.
+ * A request whose predicted or actual wait is longer than the latency target is shed.
+ */
+typedef struct {
+	SRWLOCK lock;
+	HANDLE completionPort;                 // The decided requests of the queue are posted to it
+	PTP_TIMER timer;
+	PIPE_CONNECTION* pFirstDeferred;       // The queue of the requests that wait for their derivation, in the order of their arrival
+	PIPE_CONNECTION* pLastDeferred;
+	int maxConcurrentCount;
+	int activeCount;
+	double budget;                         // Seconds of processor time per second, 0 if there is no budget
+	double credit;                         // Seconds of processor time that may be used. A charge can make it negative.
+	LARGE_INTEGER refillTickValue;
+	double latencyTarget;                  // Seconds, 0 if there is no target
+	double pendingCost;                    // Predicted seconds of the derivations that are active or waiting
+	double iterationCost[MAX_HASH_TYPE];   // Moving average of the measured seconds per iteration, 0 if nothing has been measured
+	int shedCount;
+} SERVER_SCHEDULER;
+
+/*
+ * Check if any of the scheduler settings is set
+ */
+BOOLEAN isSchedulerUsed(const SCHEDULER_SETTINGS* const pSettings) {
+	return (pSettings->cpuBudget < MAX_CPU_BUDGET) || (pSettings->maxConcurrentCount > 0) || (pSettings->latencyTarget > 0);
+}
+
+/*
+ * Initialize the scheduler. Without a concurrency cap each server thread may derive at the same time.
+ */
+void initializeScheduler(SERVER_SCHEDULER* const pScheduler, const SCHEDULER_SETTINGS* const pSettings, const int threadCount) {
+	memset(pScheduler, 0, sizeof(SERVER_SCHEDULER));
+
+	InitializeSRWLock(&pScheduler->lock);
+
+	pScheduler->maxConcurrentCount = (pSettings->maxConcurrentCount > 0) ? min(pSettings->maxConcurrentCount, threadCount) : threadCount;
+
+	if (pSettings->cpuBudget < MAX_CPU_BUDGET)
+		pScheduler->budget = pSettings->cpuBudget / 100.0 * GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+
+	pScheduler->credit = pScheduler->budget * SCHEDULER_BURST_TIME;
+	pScheduler->latencyTarget = pSettings->latencyTarget / 1000.0;
+
+	startTimer(&pScheduler->refillTickValue);
+}
+
+/*
+ * Add the credit of the time since the last refill. The lock must be held.
+ */
+void refillCredit(SERVER_SCHEDULER* const pScheduler) {
+	if (pScheduler->budget > 0.0) {
+		const double elapsedTime = getElapsedTime(&pScheduler->refillTickValue);
+
+		pScheduler->credit = min(pScheduler->credit + elapsedTime * pScheduler->budget, pScheduler->budget * SCHEDULER_BURST_TIME);
+	}
+
+	startTimer(&pScheduler->refillTickValue);
+}
+
+/*
+ * Get the time in seconds until the credit is positive again. The lock must be held.
+ */
+double getCreditWaitTime(const SERVER_SCHEDULER* const pScheduler) {
+	return ((pScheduler->budget > 0.0) && (pScheduler->credit <= 0.0)) ? -pScheduler->credit / pScheduler->budget : 0.0;
+}
+
+/*
+ * Check if a derivation may start now. The lock must be held.
+ */
+BOOLEAN isDerivationAdmissible(const SERVER_SCHEDULER* const pScheduler) {
+	return (pScheduler->activeCount < pScheduler->maxConcurrentCount) && ((pScheduler->budget == 0.0) || (pScheduler->credit > 0.0));
+}
+
+/*
+ * Predict the time in seconds that a new request has to wait. The pending derivations are processed at the rate
+ * of the concurrency cap or of the budget, whichever is lower. The lock must be held.
+ */
+double getPredictedWaitTime(const SERVER_SCHEDULER* const pScheduler) {
+	double rate = (double)pScheduler->maxConcurrentCount;
+
+	if ((pScheduler->budget > 0.0) && (pScheduler->budget < rate))
+		rate = pScheduler->budget;
+
+	return max(pScheduler->pendingCost / rate, getCreditWaitTime(pScheduler));
+}
+
+/*
+ * Set the timer of the scheduler to fire after a time in seconds. The time is clamped to the range of the timer
+ * before it is converted, so that a long wait for credit can not overflow the due time.
+ */
+void setSchedulerTimer(SERVER_SCHEDULER* const pScheduler, const double waitTime) {
+	const double clampedWaitTime = min(max(waitTime, SCHEDULER_MIN_TIMER_WAIT), SCHEDULER_MAX_TIMER_WAIT);
+
+	ULARGE_INTEGER dueTime;
+	FILETIME dueFileTime;
+
+	// A negative due time is relative to the current time in units of 100 ns
+	dueTime.QuadPart = (ULONGLONG)(-(LONGLONG)ceil(clampedWaitTime * 1.0e7));
+
+	dueFileTime.dwLowDateTime = dueTime.LowPart;
+	dueFileTime.dwHighDateTime = dueTime.HighPart;
+
+	SetThreadpoolTimer(pScheduler->timer, &dueFileTime, 0, 0);
+}
+
+/*
+ * Decide about the requests at the front of the queue: A request that has waited for the latency target is shed
+ * and a request whose derivation may start is admitted. As the queue is in the order of arrival, the first request
+ * has waited the longest, so the deciding stops at the first request that has to wait further.
+ * Each decided request is posted with its connection to the completion port. If requests are left in the queue,
+ * the timer is set to the time when the credit is positive again or the first request reaches the latency target.
+ * The lock must be held.
+ */
+void dispatchDeferredRequests(SERVER_SCHEDULER* const pScheduler) {
+	double waitTime = SCHEDULER_MAX_TIMER_WAIT;
+
+	refillCredit(pScheduler);
+
+	while (pScheduler->pFirstDeferred != NULL) {
+		PIPE_CONNECTION* const pConnection = pScheduler->pFirstDeferred;
+
+		if ((pScheduler->latencyTarget > 0.0) && (getElapsedTime(&pConnection->admissionTickValue) >= pScheduler->latencyTarget)) {
+			pConnection->admission = ADMISSION_SHED;
+
+			pScheduler->pendingCost = max(pScheduler->pendingCost - pConnection->predictedCost, 0.0);
+			pScheduler->shedCount++;
+		} else if (isDerivationAdmissible(pScheduler)) {
+			pConnection->admission = ADMISSION_GRANTED;
+
+			pScheduler->activeCount++;
+		} else
+			break;
+
+		pScheduler->pFirstDeferred = pConnection->pNextDeferred;
+
+		if (pScheduler->pFirstDeferred == NULL)
+			pScheduler->pLastDeferred = NULL;
+
+		// A request that can not be posted stays at the front of the queue and is tried again later
+		if (!PostQueuedCompletionStatus(pScheduler->completionPort, 0, 0, &pConnection->overlapped)) {
+			if (pConnection->admission == ADMISSION_GRANTED)
+				pScheduler->activeCount--;
+			else {
+				pScheduler->pendingCost += pConnection->predictedCost;
+				pScheduler->shedCount--;
+			}
+
+			pConnection->admission = ADMISSION_DEFERRED;
+
+			if (pScheduler->pFirstDeferred == NULL)
+				pScheduler->pLastDeferred = pConnection;
+
+			pScheduler->pFirstDeferred = pConnection;
+
+			waitTime = SCHEDULER_RETRY_TIME;
+			break;
+		}
+	}
+
+	if (pScheduler->pFirstDeferred != NULL) {
+		if ((pScheduler->budget > 0.0) && (pScheduler->credit <= 0.0))
+			waitTime = min(waitTime, getCreditWaitTime(pScheduler));
+
+		if (pScheduler->latencyTarget > 0.0)
+			waitTime = min(waitTime, pScheduler->latencyTarget - getElapsedTime(&pScheduler->pFirstDeferred->admissionTickValue));
+
+		setSchedulerTimer(pScheduler, waitTime);
+	}
+}
+
+/*
+ * Thread pool callback of the timer of the scheduler
+ */
+VOID CALLBACK schedulerTimerCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer) {
+	UNREFERENCED_PARAMETER(instance);
+	UNREFERENCED_PARAMETER(timer);
+
+	SERVER_SCHEDULER* const pScheduler = (SERVER_SCHEDULER*)context;
+
+	AcquireSRWLockExclusive(&pScheduler->lock);
+
+	dispatchDeferredRequests(pScheduler);
+
+	ReleaseSRWLockExclusive(&pScheduler->lock);
+}
+
+/*
+ * Start the scheduler with the completion port that it posts the decided requests to.
+ * Returns FALSE if the timer could not be created.
+ */
+BOOLEAN startScheduler(SERVER_SCHEDULER* const pScheduler, const HANDLE completionPort) {
+	pScheduler->completionPort = completionPort;
+	pScheduler->timer = CreateThreadpoolTimer(schedulerTimerCallback, pScheduler, NULL);
+
+	return (pScheduler->timer != NULL);
+}
+
+/*
+ * Stop the timer of the scheduler and wait for a running callback, so that nothing is posted to the completion port anymore
+ */
+void stopScheduler(SERVER_SCHEDULER* const pScheduler) {
+	if (pScheduler->timer != NULL) {
+		SetThreadpoolTimer(pScheduler->timer, NULL, 0, 0);
+		WaitForThreadpoolTimerCallbacks(pScheduler->timer, TRUE);
+		CloseThreadpoolTimer(pScheduler->timer);
+
+		pScheduler->timer = NULL;
+	}
+}
+
+/*
+ * Measure the cost of an iteration of each hash type before the first request, so that the wait of the first requests
+ * can be predicted, too. The first derivation of a hash type also opens its algorithm handle, so the last one is used.
+ * A hash type whose derivation fails keeps a cost of 0 until a request of it has been derived.
+ */
+void measureIterationCosts(SERVER_SCHEDULER* const pScheduler, const DERIVATION_ENGINE engine, ARENA* const pArena) {
+	TOCTET probeData[SCHEDULER_PROBE_DATA_SIZE];
+
+	for (int i = 0; i < SCHEDULER_PROBE_DATA_SIZE; i++)
+		probeData[i] = (TOCTET)('a' + i);
+
+	for (int hashType = 0; hashType < MAX_HASH_TYPE; hashType++)
+		for (int i = 0; i < SCHEDULER_PROBE_COUNT; i++) {
+			DERIVATION_RECORD record;
+
+			initializeRecord(&record, pArena, NULL, TRUE);
+
+			record.hashType = hashType;
+			record.iterationCount = SCHEDULER_PROBE_ITERATION_COUNT;
+			record.saltArray = probeData;
+			record.saltArraySize = SCHEDULER_PROBE_DATA_SIZE;
+			record.passwordBytes = probeData;
+			record.passwordBytesSize = SCHEDULER_PROBE_DATA_SIZE;
+
+			deriveRecordsWithEngine(&record, 1, engine);
+
+			if (record.returnValue == 0)
+				pScheduler->iterationCost[hashType] = record.duration / record.iterationCount;
+
+			resetArena(pArena);
+		}
+}
+
+/*
+ * Give the derivation of a request with hashType and iterationCount to the scheduler.
+ * Returns ADMISSION_GRANTED if the derivation may start now and ADMISSION_SHED if the derivations before it will already take
+ * longer than the latency target. Otherwise the request is put into the queue and ADMISSION_DEFERRED is returned.
+ * The connection of a deferred request belongs to the scheduler until it is posted to the completion port, so the caller must not touch it.
+ */
+ADMISSION requestAdmission(SERVER_SCHEDULER* const pScheduler, PIPE_CONNECTION* const pConnection, const int hashType, const int iterationCount) {
+	ADMISSION admission;
+
+	AcquireSRWLockExclusive(&pScheduler->lock);
+
+	refillCredit(pScheduler);
+
+	startTimer(&pConnection->admissionTickValue);
+
+	pConnection->predictedCost = pScheduler->iterationCost[hashType] * iterationCount;
+
+	if ((pScheduler->pFirstDeferred == NULL) && isDerivationAdmissible(pScheduler)) {
+		admission = ADMISSION_GRANTED;
+
+		pScheduler->activeCount++;
+		pScheduler->pendingCost += pConnection->predictedCost;
+	} else if ((pScheduler->latencyTarget > 0.0) && (getPredictedWaitTime(pScheduler) > pScheduler->latencyTarget)) {
+		admission = ADMISSION_SHED;
+
+		pScheduler->shedCount++;
+	} else {
+		admission = ADMISSION_DEFERRED;
+
+		pScheduler->pendingCost += pConnection->predictedCost;
+
+		pConnection->state = CONNECTION_STATE_DEFERRED;
+		pConnection->admission = ADMISSION_DEFERRED;
+		pConnection->pNextDeferred = NULL;
+
+		if (pScheduler->pLastDeferred == NULL)
+			pScheduler->pFirstDeferred = pConnection;
+		else
+			pScheduler->pLastDeferred->pNextDeferred = pConnection;
+
+		pScheduler->pLastDeferred = pConnection;
+
+		// This sets the timer for the new request, if it is the only one
+		dispatchDeferredRequests(pScheduler);
+	}
+
+	ReleaseSRWLockExclusive(&pScheduler->lock);
+
+	return admission;
+}
+
+/*
+ * Finish an admitted derivation. Its measured duration is charged to the credit and updates the cost of an iteration.
+ * A key from the result cache has not been derived, so it does not change the cost.
+ * Then the requests in the queue that may start now are posted to the completion port.
+ */
+void finishDerivation(SERVER_SCHEDULER* const pScheduler, const DERIVATION_RECORD* const pRecord, const double predictedCost) {
+	AcquireSRWLockExclusive(&pScheduler->lock);
+
+	refillCredit(pScheduler);
+
+	pScheduler->activeCount--;
+	pScheduler->pendingCost = max(pScheduler->pendingCost - predictedCost, 0.0);
+
+	if ((pRecord->returnValue == 0) && !pRecord->isCached) {
+		const double cost = pRecord->duration / pRecord->iterationCount;
+		double* const pIterationCost = &pScheduler->iterationCost[pRecord->hashType];
+
+		if (pScheduler->budget > 0.0)
+			pScheduler->credit -= pRecord->duration;
+
+		*pIterationCost = (*pIterationCost == 0.0) ? cost : *pIterationCost + (cost - *pIterationCost) * SCHEDULER_COST_WEIGHT;
+	}
+
+	dispatchDeferredRequests(pScheduler);
+
+	ReleaseSRWLockExclusive(&pScheduler->lock);
+}
+
+/*
+ * Data that is shared by all server threads
+ */
+typedef struct {
+	HANDLE completionPort;
+	BOOLEAN doItRight;
+	int requestedKeySize;
+	DERIVATION_ENGINE engine;
+	OUTPUT_FORMAT outputFormat;
+	BOOLEAN isScheduled;          // The derivations go through the scheduler
+	SERVER_SCHEDULER scheduler;
+	volatile LONG requestCount;
+	volatile LONG errorCount;
+} SERVER_CONTEXT;
+
+/*
+ * A server thread. Each thread has its own arena for the buffers of a request.
+ */
+typedef struct {
+	HANDLE threadHandle;
+	SERVER_CONTEXT* pContext;
+	ARENA arena;
+	TCHAR requestText[MAX_SERVER_REQUEST_SIZE + 1];
+	TCHAR resultText[RESULT_BUFFER_SIZE + 1];
+} SERVER_WORKER;
+
+/*
+ * Completion port of the server. The console control handler posts the stop packets to it.
+ */
+static HANDLE serverCompletionPort = NULL;
+
+/*
+ * Number of server threads, i.e. the number of stop packets that are needed to stop the server
+ */
+static int serverThreadCount = 0;
+
+/*
+ * Stop the server on Ctrl+C, Ctrl+Break and when the console is closed.
+ * An empty completion packet without an OVERLAPPED structure stops one server thread.
+ */
+BOOL WINAPI serverControlHandler(DWORD controlType) {
+	if (serverCompletionPort != NULL) {
+		for (int i = 0; i < serverThreadCount; i++)
+			PostQueuedCompletionStatus(serverCompletionPort, 0, 0, NULL);
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Wait for a client on a pipe instance. If a client connected before the wait started there is no completion,
+ * so one is posted. The instance is closed if it can not wait for clients anymore.
+ */
+void startConnecting(PIPE_CONNECTION* const pConnection, const HANDLE completionPort) {
+	memset(&pConnection->overlapped, 0, sizeof(OVERLAPPED));
+
+	pConnection->state = CONNECTION_STATE_CONNECTING;
+
+	if (!ConnectNamedPipe(pConnection->pipeHandle, &pConnection->overlapped))
+		switch (GetLastError()) {
+			case ERROR_IO_PENDING:
+				break;
+
+			case ERROR_PIPE_CONNECTED:
+				PostQueuedCompletionStatus(completionPort, 0, 0, &pConnection->overlapped);
+				break;
+
+			default:
+				pConnection->state = CONNECTION_STATE_CLOSED;
+		}
+}
+
+/*
+ * Disconnect the client of a pipe instance and wait for the next one
+ */
+void resetConnection(PIPE_CONNECTION* const pConnection, const HANDLE completionPort) {
+	DisconnectNamedPipe(pConnection->pipeHandle);
+
+	startConnecting(pConnection, completionPort);
+}
+
+/*
+ * Wait for the next request or for the remainder of a request that is too long.
+ * As the pipe is associated with the completion port, a read that succeeds at once is completed there, too.
+ */
+void startReading(PIPE_CONNECTION* const pConnection, const HANDLE completionPort) {
+	memset(&pConnection->overlapped, 0, sizeof(OVERLAPPED));
+
+	pConnection->state = CONNECTION_STATE_READING;
+
+	if (!ReadFile(pConnection->pipeHandle, pConnection->request, MAX_SERVER_REQUEST_SIZE, NULL, &pConnection->overlapped)) {
+		const DWORD lastError = GetLastError();
+
+		if ((lastError != ERROR_IO_PENDING) && (lastError != ERROR_MORE_DATA))
+			resetConnection(pConnection, completionPort);
+	}
+}
+
+/*
+ * Send the response of a request
+ */
+void startWriting(PIPE_CONNECTION* const pConnection, const HANDLE completionPort) {
+	memset(&pConnection->overlapped, 0, sizeof(OVERLAPPED));
+
+	pConnection->state = CONNECTION_STATE_WRITING;
+
+	if (!WriteFile(pConnection->pipeHandle, pConnection->response, pConnection->responseSize, NULL, &pConnection->overlapped))
+		if (GetLastError() != ERROR_IO_PENDING)
+			resetConnection(pConnection, completionPort);
+}
+
+/*
+ * Store a text as the response of a connection. The response is sent in the input code page, just like the request.
+ */
+void setTextResponse(PIPE_CONNECTION* const pConnection, const TCHAR* const text) {
+#ifdef _UNICODE
+	pConnection->responseSize = (DWORD)WideCharToMultiByte(inputCodePage, 0, text, (int)wcslen(text), pConnection->response, MAX_SERVER_RESPONSE_SIZE, NULL, NULL);
+#else
+	pConnection->responseSize = (DWORD)strlen(text);
+
+	memcpy(pConnection->response, text, pConnection->responseSize);
+#endif
+}
+
+/*
+ * Derive the key of a request if the scheduler admits it. A request that is shed gets an error.
+ * Returns FALSE if the request has been deferred. Its connection is posted to the completion port when the scheduler
+ * has decided about it, and then the request is processed once more with the decision in the connection.
+ */
+BOOLEAN deriveScheduledRecord(DERIVATION_RECORD* const pRecord, PIPE_CONNECTION* const pConnection, SERVER_WORKER* const pWorker) {
+	SERVER_CONTEXT* const pContext = pWorker->pContext;
+
+	ADMISSION admission = pConnection->admission;
+
+	if (admission == ADMISSION_NONE) {
+		admission = requestAdmission(&pContext->scheduler, pConnection, pRecord->hashType, pRecord->iterationCount);
+
+		if (admission == ADMISSION_DEFERRED)
+			return FALSE;
+	}
+
+	if (admission == ADMISSION_GRANTED) {
+		deriveRecords(pRecord, 1, pContext->engine);
+
+		finishDerivation(&pContext->scheduler, pRecord, pConnection->predictedCost);
+	} else {
+		_stprintf_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Server is busy, the request has been shed after %d ms\n"), (int)lround(getElapsedTime(&pConnection->admissionTickValue) * 1000));
+
+		pRecord->returnValue = 3;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Process the request of a connection and store the response in the connection.
+ * A request is a record of a batch file with the command "derive" or "verify" in front of it:
+ *
+ *    derive,hashType,salt,iterationCount,password
+ *    verify,hashType,salt,iterationCount,expectedKey,password
+ *
+ * The response of "derive" is the result line in the output format. The response of "verify" is the result of the comparison.
+ * If the request has an error the response is the error message that starts with "Error: ".
+ * In the binary format the response of a request with an error is a key size of 0.
+ * Returns FALSE if the scheduler has deferred the request. Then there is no response yet and the connection must not be touched.
+ */
+BOOLEAN processServerRequest(PIPE_CONNECTION* const pConnection, SERVER_WORKER* const pWorker) {
+	SERVER_CONTEXT* const pContext = pWorker->pContext;
+
+	const int requestSize = (int)pConnection->requestSize;
+
+	DERIVATION_RECORD record;
+
+	// A deferred request is counted when it arrives, not when it is processed again
+	if (pConnection->admission == ADMISSION_NONE)
+		InterlockedIncrement(&pContext->requestCount);
+
+	if (pConnection->isRequestTooLong) {
+		initializeRecord(&record, &pWorker->arena, NULL, pContext->doItRight);
+
+		_stprintf_s(record.errorText, ERROR_BUFFER_SIZE, _T("Request is longer than %d bytes\n"), MAX_SERVER_REQUEST_SIZE);
+
+		record.returnValue = 2;
+	} else {
+#ifdef _UNICODE
+		const int textSize = MultiByteToWideChar(inputCodePage, 0, pConnection->request, requestSize, pWorker->requestText, MAX_SERVER_REQUEST_SIZE);
+
+		pWorker->requestText[textSize] = _T('\0');
+#else
+		memcpy(pWorker->requestText, pConnection->request, requestSize);
+
+		pWorker->requestText[requestSize] = '\0';
+#endif
+
+		// A client may terminate the request with a line end
+		TCHAR* const pLineEnd = _tcspbrk(pWorker->requestText, _T("\r\n"));
+
+		if (pLineEnd != NULL)
+			*pLineEnd = _T('\0');
+
+		TCHAR* const commandText = pWorker->requestText;
+		TCHAR* const recordText = splitBatchField(commandText);
+
+		const BOOLEAN isVerify = (_tcscmp(commandText, SERVER_COMMAND_VERIFY) == 0);
+
+		TCHAR* hashTypeText = NULL;
+		TCHAR* saltText = NULL;
+		TCHAR* iterationCountText = NULL;
+		TCHAR* expectedKeyText = NULL;
+		TCHAR* password = NULL;
+
+		if ((recordText != NULL) && (isVerify || (_tcscmp(commandText, SERVER_COMMAND_DERIVE) == 0)))
+			password = splitRecordFields(recordText, isVerify, &hashTypeText, &saltText, &iterationCountText, &expectedKeyText);
+
+		if (password != NULL) {
+			if ((prepareRecord(&record, &pWorker->arena, NULL, hashTypeText, saltText, iterationCountText, password, inputCodePage, pContext->doItRight, pContext->requestedKeySize, MAX_ITERATION_COUNT) == 0) && isVerify)
+				prepareVerification(&record, expectedKeyText);
+
+			if (record.returnValue == 0) {
+				if (pContext->isScheduled) {
+					if (!deriveScheduledRecord(&record, pConnection, pWorker)) {
+						resetArena(&pWorker->arena);
+
+						return FALSE;
+					}
+				} else
+					deriveRecords(&record, 1, pContext->engine);
+			}
+		} else {
+			initializeRecord(&record, &pWorker->arena, NULL, pContext->doItRight);
+
+			_stprintf_s(record.errorText, ERROR_BUFFER_SIZE, _T("Request does not have the format \"%s\" or \"%s\"\n"), _T("derive,hashType,salt,iterationCount,password"), _T("verify,hashType,salt,iterationCount,expectedKey,password"));
+
+			record.returnValue = 2;
+		}
+
+		if (record.returnValue == 0) {
+			if (isVerify) {
+				verifyRecord(&record);
+
+				_stprintf_s(pWorker->resultText, RESULT_BUFFER_SIZE, _T("Verification: %s\n"), VERIFICATION_RESULT_TEXT[record.isMatch]);
+
+				setTextResponse(pConnection, pWorker->resultText);
+			} else {
+				const int resultSize = formatRecordResult(&record, pContext->outputFormat, pWorker->resultText, RESULT_BUFFER_SIZE);
+
+				if (pContext->outputFormat == OUTPUT_FORMAT_BINARY) {
+					memcpy(pConnection->response, pWorker->resultText, resultSize);
+
+					pConnection->responseSize = (DWORD)resultSize;
+				} else if (record.returnValue == 0)
+					setTextResponse(pConnection, pWorker->resultText);
+			}
+		}
+	}
+
+	if (record.returnValue != 0) {
+		InterlockedIncrement(&pContext->errorCount);
+
+		if (pContext->outputFormat == OUTPUT_FORMAT_BINARY) {
+			memcpy(pConnection->response, EMPTY_BINARY_RESULT, BINARY_KEY_SIZE_SIZE);
+
+			pConnection->responseSize = BINARY_KEY_SIZE_SIZE;
+		} else {
+			_stprintf_s(pWorker->resultText, RESULT_BUFFER_SIZE, _T("Error: %s"), record.errorText);
+
+			setTextResponse(pConnection, pWorker->resultText);
+		}
+	}
+
+	pConnection->isRequestTooLong = FALSE;
+	pConnection->admission = ADMISSION_NONE;
+
+	resetArena(&pWorker->arena);
+
+	return TRUE;
+}
+
+/*
+ * Handle a completed operation of a pipe instance and start the next operation
+ */
+void handleServerCompletion(PIPE_CONNECTION* const pConnection, const DWORD byteCount, const DWORD completionError, SERVER_WORKER* const pWorker) {
+	const HANDLE completionPort = pWorker->pContext->completionPort;
+
+	switch (pConnection->state) {
+		case CONNECTION_STATE_CONNECTING:
+			if (completionError == ERROR_SUCCESS) {
+				pConnection->isRequestTooLong = FALSE;
+
+				startReading(pConnection, completionPort);
+			} else
+				resetConnection(pConnection, completionPort);
+			break;
+
+		case CONNECTION_STATE_READING:
+			if (completionError == ERROR_MORE_DATA) {
+				// The rest of a request that is too long is read and dropped
+				pConnection->isRequestTooLong = TRUE;
+
+				startReading(pConnection, completionPort);
+			} else if (completionError == ERROR_SUCCESS) {
+				pConnection->requestSize = byteCount;
+
+				if (processServerRequest(pConnection, pWorker))
+					startWriting(pConnection, completionPort);
+			} else
+				resetConnection(pConnection, completionPort);
+			break;
+
+		case CONNECTION_STATE_DEFERRED:
+			// The scheduler has admitted or shed the request
+			processServerRequest(pConnection, pWorker);
+
+			startWriting(pConnection, completionPort);
+			break;
+
+		case CONNECTION_STATE_WRITING:
+			if (completionError == ERROR_SUCCESS)
+				startReading(pConnection, completionPort);
+			else
+				resetConnection(pConnection, completionPort);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Thread function of a server thread. It handles completed pipe operations until it gets a stop packet.
+ */
+DWORD WINAPI serverThread(LPVOID parameter) {
+	SERVER_WORKER* const pWorker = (SERVER_WORKER*)parameter;
+
+	for (;;) {
+		DWORD byteCount;
+		ULONG_PTR completionKey;
+		LPOVERLAPPED pOverlapped;
+
+		const BOOL isSuccess = GetQueuedCompletionStatus(pWorker->pContext->completionPort, &byteCount, &completionKey, &pOverlapped, INFINITE);
+
+		if (pOverlapped == NULL)
+			break;
+
+		handleServerCompletion((PIPE_CONNECTION*)pOverlapped, byteCount, isSuccess ? ERROR_SUCCESS : GetLastError(), pWorker);
+	}
+
+	return 0;
+}
+
+/*
+ * Run as a server that processes derive and verify requests of clients on a named pipe.
+ * The pipe instances are associated with one I/O completion port that is served by threadCount threads,
+ * so the requests of SERVER_INSTANCES_PER_THREAD clients per thread are processed concurrently.
+ * The library opens the algorithm providers once and shares them across all threads, so a request does not pay for opening them.
+ * If any scheduler setting is set, the derivations go through the scheduler, which caps their number and
+ * processor time and sheds the requests that would wait longer than the latency target.
+ * The requests that have to wait are queued by the scheduler, so no server thread is blocked by a waiting request.
+ * The server runs until it is stopped with Ctrl+C. Then it writes the number of processed requests and errors.
+ */
+int processServer(const TCHAR* const pipeNameArg,
+						const BOOLEAN doItRight,
+						const int requestedKeySize,
+						const int threadCount,
+						const DERIVATION_ENGINE engine,
+						const OUTPUT_FORMAT outputFormat,
+						const SCHEDULER_SETTINGS* const pSchedulerSettings,
+						const HANDLE outputHandle,
+						const BOOLEAN isOutputRedirected,
+						const HANDLE errorHandle,
+						const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+	TCHAR pipeName[MAX_PIPE_NAME_SIZE + 1];
+
+	int returnValue = 0;
+
+	const int connectionCount = threadCount * SERVER_INSTANCES_PER_THREAD;
+
+	PIPE_CONNECTION* connections = NULL;
+	SERVER_WORKER* workers = NULL;
+
+	SERVER_CONTEXT context;
+
+	context.completionPort = NULL;
+	context.doItRight = doItRight;
+	context.requestedKeySize = requestedKeySize;
+	context.engine = engine;
+	context.outputFormat = outputFormat;
+	context.isScheduled = isSchedulerUsed(pSchedulerSettings);
+	context.requestCount = 0;
+	context.errorCount = 0;
+
+	initializeScheduler(&context.scheduler, pSchedulerSettings, threadCount);
+
+	if (_tcsncmp(pipeNameArg, PIPE_NAME_PREFIX, _tcslen(PIPE_NAME_PREFIX)) == 0)
+		_tcscpy_s(pipeName, MAX_PIPE_NAME_SIZE, pipeNameArg);
+	else
+		_stprintf_s(pipeName, MAX_PIPE_NAME_SIZE, _T("%s%s"), PIPE_NAME_PREFIX, pipeNameArg);
+
+	connections = (PIPE_CONNECTION*)calloc(connectionCount, sizeof(PIPE_CONNECTION));
+	workers = (SERVER_WORKER*)calloc(threadCount, sizeof(SERVER_WORKER));
+
+	if ((connections == NULL) || (workers == NULL)) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate server buffers\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	for (int i = 0; i < connectionCount; i++)
+		connections[i].pipeHandle = INVALID_HANDLE_VALUE;
+
+	if ((context.completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, (DWORD)threadCount)) == NULL) {
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateIoCompletionPort"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	if (context.isScheduled) {
+		if (!startScheduler(&context.scheduler, context.completionPort)) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateThreadpoolTimer"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 3;
+			goto Exit;
+		}
+
+		// The arena of the first thread is used before the thread is started
+		if (context.scheduler.latencyTarget > 0.0)
+			measureIterationCosts(&context.scheduler, engine, &workers[0].arena);
+	}
+
+	/*
+	 * The first instance makes sure that no other server uses the pipe name. Remote clients are not accepted.
+	 */
+	for (int i = 0; i < connectionCount; i++) {
+		PIPE_CONNECTION* const pConnection = &connections[i];
+
+		pConnection->pipeHandle = CreateNamedPipe(pipeName,
+																PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | ((i == 0) ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+																PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+																(DWORD)connectionCount,
+																MAX_SERVER_RESPONSE_SIZE,
+																MAX_SERVER_REQUEST_SIZE,
+																0,
+																NULL);
+
+		if (pConnection->pipeHandle == INVALID_HANDLE_VALUE) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not create pipe \"%s\" (error %d)\n"), pipeName, GetLastError());
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 4;
+			goto Exit;
+		}
+
+		if (CreateIoCompletionPort(pConnection->pipeHandle, context.completionPort, 0, 0) == NULL) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateIoCompletionPort"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 3;
+			goto Exit;
+		}
+	}
+
+	serverCompletionPort = context.completionPort;
+	serverThreadCount = threadCount;
+
+	SetConsoleCtrlHandler(serverControlHandler, TRUE);
+
+	for (int i = 0; i < connectionCount; i++)
+		startConnecting(&connections[i], context.completionPort);
+
+	for (int i = 0; i < threadCount; i++) {
+		workers[i].pContext = &context;
+
+		if ((workers[i].threadHandle = CreateThread(NULL, 0, serverThread, &workers[i], 0, NULL)) == NULL) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateThread"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			// The threads that are already running are stopped like with Ctrl+C
+			serverControlHandler(CTRL_C_EVENT);
+
+			returnValue = 3;
+			break;
+		}
+	}
+
+	if (returnValue == 0) {
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Listening on \"%s\" with %d threads and %d pipe instances, press Ctrl+C to stop\n"), pipeName, threadCount, connectionCount);
+		writeBuffer(outputHandle, isOutputRedirected, errorBuffer);
+	}
+
+	for (int i = 0; i < threadCount; i++)
+		if (workers[i].threadHandle != NULL)
+			WaitForSingleObject(workers[i].threadHandle, INFINITE);
+
+	SetConsoleCtrlHandler(serverControlHandler, FALSE);
+
+	serverCompletionPort = NULL;
+
+	// The pending operations are cancelled and finished before their OVERLAPPED structures are freed
+	for (int i = 0; i < connectionCount; i++) {
+		DWORD byteCount;
+
+		CancelIoEx(connections[i].pipeHandle, &connections[i].overlapped);
+		GetOverlappedResult(connections[i].pipeHandle, &connections[i].overlapped, &byteCount, TRUE);
+	}
+
+	if (context.isScheduled)
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Requests: %d, Errors: %d, Shed: %d, Threads: %d\n"), context.requestCount, context.errorCount, context.scheduler.shedCount, threadCount);
+	else
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Requests: %d, Errors: %d, Threads: %d\n"), context.requestCount, context.errorCount, threadCount);
+	writeBuffer(outputHandle, isOutputRedirected, errorBuffer);
+
+Exit:
+	// The timer of the scheduler posts deferred connections, so it is stopped before they are freed
+	stopScheduler(&context.scheduler);
+
+	if (connections != NULL) {
+		for (int i = 0; i < connectionCount; i++)
+			if (connections[i].pipeHandle != INVALID_HANDLE_VALUE)
+				CloseHandle(connections[i].pipeHandle);
+
+		free((void*)connections);
+	}
+
+	if (workers != NULL) {
+		for (int i = 0; i < threadCount; i++) {
+			if (workers[i].threadHandle != NULL)
+				CloseHandle(workers[i].threadHandle);
+
+			releaseArena(&workers[i].arena);
+		}
+
+		free((void*)workers);
+	}
+
+	if (context.completionPort != NULL)
+		CloseHandle(context.completionPort);
+
+	return returnValue;
+}
+
+/*
+ * Maximum number of values in a list of benchmark parameters
+ */
+#define MAX_BENCH_VALUE_COUNT 16
+
+/*
+ * Minimum and maximum values of the benchmark parameters
+ */
+#define MIN_REPETITION_COUNT 1
+#define MAX_REPETITION_COUNT 100000
+#define MIN_WARMUP_COUNT 0
+#define MAX_WARMUP_COUNT 1000
+#define MIN_BENCH_PASSWORD_SIZE 1
+#define MAX_BENCH_PASSWORD_SIZE 1024
+#define MIN_BENCH_SALT_SIZE 1
+#define MAX_BENCH_SALT_SIZE 1024
+
+/*
+ * A list of values of a benchmark parameter
+ */
+typedef struct {
+	int value[MAX_BENCH_VALUE_COUNT];
+	int count;
+} BENCH_VALUE_LIST;
+
+/*
+ * Parameters of the benchmark. Each hash type is measured with each combination of
+ * iteration count, password size and salt size.
+ */
+typedef struct {
+	int repetitionCount;   // 0 if the program is not in benchmark mode
+	int warmupCount;
+	BENCH_VALUE_LIST iterationCounts;
+	BENCH_VALUE_LIST passwordSizes;
+	BENCH_VALUE_LIST saltSizes;
+} BENCH_SETTINGS;
+
+/*
+ * Parse a comma separated list of integers. The list text is split in place.
+ */
+void parseIntegerList(const TCHAR* const pArgName,
+							 TCHAR* const listText,
+							 const int minValue,
+							 const int maxValue,
+							 BENCH_VALUE_LIST* const pList,
+							 TCHAR* const errorBuffer,
+							 const int errorBufferSize) {
+	RESET_ERROR_MSG;
+
+	pList->count = 0;
+
+	TCHAR* valueText = listText;
+
+	while ((valueText != NULL) && IS_ERROR_MSG_NOT_SET) {
+		TCHAR* const nextValueText = splitBatchField(valueText);
+
+		if (pList->count < MAX_BENCH_VALUE_COUNT) {
+			pList->value[pList->count] = getIntegerArg(pArgName, valueText, minValue, maxValue, errorBuffer, errorBufferSize);
+			pList->count++;
+		} else
+			_stprintf_s(errorBuffer, errorBufferSize, _T("\"%s\" has more than %d values\n"), pArgName, MAX_BENCH_VALUE_COUNT);
+
+		valueText = nextValueText;
+	}
+}
+
+/*
+ * Compare two durations for qsort
+ */
+int compareDurations(const void* const pLeft, const void* const pRight) {
+	const double left = *(const double*)pLeft;
+	const double right = *(const double*)pRight;
+
+	return (left > right) - (left < right);
+}
+
+/*
+ * Get the value at a percentile of sorted durations with the nearest-rank method
+ */
+double getPercentile(const double* const sortedDurations, const int count, const int percentile) {
+	int rank = (count * percentile + 99) / 100;
+
+	if (rank < 1)
+		rank = 1;
+
+	return sortedDurations[rank - 1];
+}
+
+/*
+ * Get the median of sorted durations
+ */
+double getMedian(const double* const sortedDurations, const int count) {
+	if ((count & 1) != 0)
+		return sortedDurations[count >> 1];
+	else
+		return (sortedDurations[(count >> 1) - 1] + sortedDurations[count >> 1]) / 2.0;
+}
+
+/*
+ * Check if a hash type uses the same algorithm as a smaller hash type, so that it does not need to be measured again
+ */
+BOOLEAN isDuplicateHashType(const int hashType) {
+	for (int i = 0; i < hashType; i++)
+		if (wcscmp(HASH_ALGORITHM[i], HASH_ALGORITHM[hashType]) == 0)
+			return TRUE;
+
+	return FALSE;
+}
+
+/*
+ * Measure one combination of hash type, iteration count, password size and salt size.
+ * Each repetition derives a group of records at once, so that the SIMD engine can fill its lanes.
+ * The latency of a record is the duration of its group, the throughput counts the iterations of all records of the group.
+ * The durations of the repetitions are returned in durations. If there is a profile the phases of the repetitions are measured in it.
+ */
+int benchmarkCombination(const int hashType,
+								 const int iterationCount,
+								 TOCTET* const password,
+								 const int passwordSize,
+								 TOCTET* const salt,
+								 const int saltSize,
+								 const int groupSize,
+								 const DERIVATION_ENGINE engine,
+								 const BENCH_SETTINGS* const pSettings,
+								 PHASE_PROFILE* const pProfile,
+								 double* const durations,
+								 TCHAR* const errorBuffer,
+								 const int errorBufferSize) {
+	DERIVATION_RECORD records[MAX_DERIVATION_GROUP_SIZE];
+
+	ARENA arena;
+
+	initializeArena(&arena);
+
+	int returnValue = 0;
+
+	const int runCount = pSettings->warmupCount + pSettings->repetitionCount;
+
+	for (int run = 0; (run < runCount) && (returnValue == 0); run++) {
+		for (int i = 0; i < groupSize; i++) {
+			initializeRecord(&records[i], &arena, NULL, TRUE);
+
+			// The warm-up runs are not measured
+			records[i].pProfile = (run >= pSettings->warmupCount) ? pProfile : NULL;
+			records[i].hashType = hashType;
+			records[i].iterationCount = iterationCount;
+			records[i].saltArray = salt;
+			records[i].saltArraySize = saltSize;
+			records[i].passwordBytes = password;
+			records[i].passwordBytesSize = passwordSize;
+		}
+
+		LARGE_INTEGER startTickValue;
+
+		startTimer(&startTickValue);
+		deriveRecords(records, groupSize, engine);
+		const double duration = getElapsedTime(&startTickValue);
+
+		if (run >= pSettings->warmupCount)
+			durations[run - pSettings->warmupCount] = duration;
+
+		for (int i = 0; i < groupSize; i++)
+			if ((records[i].returnValue != 0) && (returnValue == 0)) {
+				_tcscpy_s(errorBuffer, errorBufferSize, records[i].errorText);
+				returnValue = records[i].returnValue;
+			}
+
+		resetArena(&arena);
+	}
+
+	releaseArena(&arena);
+
+	return returnValue;
+}
+
+/*
+ * Run the benchmark. All hash types are measured with all combinations of the benchmark parameters.
+ * For each combination minimum, median and 99th percentile of the latency and the iterations per second on one core are written.
+ * With a profile the phases of the measured repetitions of each combination are written, too.
+ */
+int processBenchmark(const BENCH_SETTINGS* const pSettings,
+							const DERIVATION_ENGINE engine,
+							const BOOLEAN isProfiled,
+							const HANDLE outputHandle,
+							const BOOLEAN isOutputRedirected,
+							const HANDLE errorHandle,
+							const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+	TCHAR resultBuffer[ERROR_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	TOCTET* const password = (TOCTET*)malloc(MAX_BENCH_PASSWORD_SIZE);
+	TOCTET* const salt = (TOCTET*)malloc(MAX_BENCH_SALT_SIZE);
+	double* const durations = (double*)malloc(pSettings->repetitionCount * sizeof(double));
+
+	if ((password == NULL) || (salt == NULL) || (durations == NULL)) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate benchmark buffers\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	// The password consists of printable ASCII characters, so it is the same in all encodings
+	for (int i = 0; i < MAX_BENCH_PASSWORD_SIZE; i++)
+		password[i] = (TOCTET)('a' + i % 26);
+
+	for (int i = 0; i < MAX_BENCH_SALT_SIZE; i++)
+		salt[i] = (TOCTET)(i * 37 + 11);
+
+	_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("Engine: %s, Warm-up: %d, Repetitions: %d\n"), ENGINE_DISPLAY_NAME[engine], pSettings->warmupCount, pSettings->repetitionCount);
+	writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+	for (int hashType = 0; (hashType < MAX_HASH_TYPE) && (returnValue == 0); hashType++) {
+		if (isDuplicateHashType(hashType))
+			continue;
+
+		// The SIMD engine derives as many records at once as it has lanes
+		const BOOLEAN isNativeHash = (NATIVE_HASH_OF_HASH_TYPE[hashType] != NATIVE_HASH_NONE);
+		const int groupSize = (isNativeHash && (engine == ENGINE_SIMD)) ? nativeGetMultiBufferLaneCount() : ((isNativeHash && (engine == ENGINE_GPU)) ? MAX_DERIVATION_GROUP_SIZE : 1);
+
+		for (int i = 0; (i < pSettings->iterationCounts.count) && (returnValue == 0); i++)
+			for (int j = 0; (j < pSettings->passwordSizes.count) && (returnValue == 0); j++)
+				for (int k = 0; (k < pSettings->saltSizes.count) && (returnValue == 0); k++) {
+					const int iterationCount = pSettings->iterationCounts.value[i];
+					const int passwordSize = pSettings->passwordSizes.value[j];
+					const int saltSize = pSettings->saltSizes.value[k];
+
+					PHASE_PROFILE profile;
+
+					initializePhaseProfile(&profile);
+
+					returnValue = benchmarkCombination(hashType, iterationCount, password, passwordSize, salt, saltSize, groupSize, engine, pSettings, isProfiled ? &profile : NULL, durations, errorBuffer, ERROR_BUFFER_SIZE);
+
+					if (returnValue == 0) {
+						qsort(durations, pSettings->repetitionCount, sizeof(double), compareDurations);
+
+						const double median = getMedian(durations, pSettings->repetitionCount);
+
+						_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("HashType: %ws, IterationCount: %d, PasswordSize: %d, SaltSize: %d, Records: %d, Min: %.3f ms, Median: %.3f ms, P99: %.3f ms, Iterations/s: %.0f\n"),
+							HASH_ALGORITHM[hashType],
+							iterationCount,
+							passwordSize,
+							saltSize,
+							groupSize,
+							durations[0] * 1000,
+							median * 1000,
+							getPercentile(durations, pSettings->repetitionCount, 99) * 1000,
+							(median > 0.0) ? (double)groupSize * iterationCount / median : 0.0);
+						writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+						if (isProfiled)
+							writePhaseProfile(&profile, outputHandle, isOutputRedirected);
+					} else
+						writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+				}
+	}
+
+Exit:
+
+	if (password != NULL)
+		free((void*)password);
+
+	if (salt != NULL)
+		free((void*)salt);
+
+	if (durations != NULL)
+		free((void*)durations);
+
+	return returnValue;
+}
+
+/*
+ * Size of the salt of the parameter grid
+ */
+#define GRID_SALT_SIZE 16
+
+/*
+ * Number of password encodings of the parameter grid: The encoding of "doing it wrong" and UTF-8
+ */
+#define GRID_ENCODING_COUNT 2
+
+/*
+ * Names of the password encodings of the parameter grid. Without doItRight the password is used in the encoding of the TCHARs.
+ */
+#ifdef _UNICODE
+const TCHAR* const GRID_ENCODING_NAME[GRID_ENCODING_COUNT] = { _T("UTF-16"), _T("UTF-8") };
+#else
+const TCHAR* const GRID_ENCODING_NAME[GRID_ENCODING_COUNT] = { _T("ANSI"), _T("UTF-8") };
+#endif
+
+/*
+ * Formats of the matrix of the parameter grid
+ */
+typedef enum {
+	GRID_FORMAT_CSV = 0,
+	GRID_FORMAT_JSON = 1
+} GRID_FORMAT;
+
+/*
+ * One cell of the parameter grid with its measurement
+ */
+typedef struct {
+	int hashType;
+	int iterationCount;
+	int encoding;
+	int groupSize;
+	int returnValue;
+	int processorNumber;      // Logical processor of the worker that measured the cell, or -1 if the worker is not pinned
+	double minDuration;
+	double medianDuration;
+	double p99Duration;
+	TCHAR errorText[ERROR_BUFFER_SIZE + 1];
+} GRID_CELL;
+
+/*
+ * The cells of the parameter grid that are shared by all workers
+ */
+typedef struct {
+	GRID_CELL* cells;
+	int cellCount;
+	volatile LONG nextCellIndex;
+	TOCTET* passwordBytes[GRID_ENCODING_COUNT];
+	int passwordBytesSize[GRID_ENCODING_COUNT];
+	TOCTET salt[GRID_SALT_SIZE];
+	DERIVATION_ENGINE engine;
+	const BENCH_SETTINGS* pSettings;
+} GRID_CONTEXT;
+
+/*
+ * A worker of the parameter grid. Each worker is pinned to its own core if possible.
+ */
+typedef struct {
+	HANDLE threadHandle;
+	GRID_CONTEXT* pContext;
+	GROUP_AFFINITY affinity;
+	BOOLEAN isPinned;
+	int processorNumber;
+	double* durations;
+} GRID_WORKER;
+
+/*
+ * Maximum number of logical processors of a processor core
+ */
+#define MAX_CORE_PROCESSOR_COUNT ((int)(sizeof(KAFFINITY) * 8))
+
+/*
+ * Get the number of a logical processor over all processor groups
+ */
+int getProcessorNumber(const WORD group, const int bitIndex) {
+	int processorNumber = bitIndex;
+
+	for (WORD i = 0; i < group; i++)
+		processorNumber += (int)GetActiveProcessorCount(i);
+
+	return processorNumber;
+}
+
+/*
+ * Get the logical processors that threads are pinned to, one affinity per thread.
+ * In spread order the first logical processor of each core comes first, followed by the second one of each core and so on,
+ * so that the first pCoreCount threads do not share a core with SMT. In compact order the logical processors of a core follow each other.
+ * pCoreCount receives the number of all cores of the system, even if maxCount is smaller than the number of logical processors.
+ * Returns the number of logical processors that have been written to affinities, which has room for maxCount entries, or 0 on errors.
+ */
+int getProcessorAffinities(GROUP_AFFINITY* const affinities, int* const processorNumbers, const int maxCount, const BOOLEAN isCompact, int* const pCoreCount) {
+	DWORD bufferSize = 0;
+
+	*pCoreCount = 0;
+
+	GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &bufferSize);
+
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+		return 0;
+
+	BYTE* const buffer = (BYTE*)malloc(bufferSize);
+
+	if (buffer == NULL)
+		return 0;
+
+	int processorCount = 0;
+
+	if (GetLogicalProcessorInformationEx(RelationProcessorCore, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer, &bufferSize)) {
+		// All cores are counted, independent of the number of affinities that are collected
+		for (DWORD offset = 0; offset < bufferSize; offset += ((PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer + offset))->Size)
+			(*pCoreCount)++;
+
+		// Spread order takes the logical processor with the same rank of all cores in each pass, compact order takes all of one core
+		const int passCount = isCompact ? 1 : MAX_CORE_PROCESSOR_COUNT;
+
+		for (int pass = 0; (pass < passCount) && (processorCount < maxCount); pass++)
+			for (DWORD offset = 0; (offset < bufferSize) && (processorCount < maxCount); ) {
+				const PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInfo = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer + offset);
+				const GROUP_AFFINITY* const pCoreMask = &pInfo->Processor.GroupMask[0];
+
+				int rank = 0;
+
+				for (int bitIndex = 0; (bitIndex < MAX_CORE_PROCESSOR_COUNT) && (processorCount < maxCount); bitIndex++)
+					if ((pCoreMask->Mask & ((KAFFINITY)1 << bitIndex)) != 0) {
+						if (isCompact || (rank == pass)) {
+							memset(&affinities[processorCount], 0, sizeof(GROUP_AFFINITY));
+
+							affinities[processorCount].Group = pCoreMask->Group;
+							affinities[processorCount].Mask = (KAFFINITY)1 << bitIndex;
+
+							processorNumbers[processorCount] = getProcessorNumber(pCoreMask->Group, bitIndex);
+
+							processorCount++;
+						}
+
+						rank++;
+					}
+
+				offset += pInfo->Size;
+			}
+	}
+
+	free((void*)buffer);
+
+	return processorCount;
+}
+
+/*
+ * Measure cells of the parameter grid until there are no more unmeasured cells
+ */
+DWORD WINAPI gridThread(LPVOID parameter) {
+	GRID_WORKER* const pWorker = (GRID_WORKER*)parameter;
+	GRID_CONTEXT* const pContext = pWorker->pContext;
+
+	const int repetitionCount = pContext->pSettings->repetitionCount;
+
+	LONG cellIndex;
+
+	while ((cellIndex = InterlockedIncrement(&pContext->nextCellIndex) - 1) < pContext->cellCount) {
+		GRID_CELL* const pCell = &pContext->cells[cellIndex];
+
+		pCell->processorNumber = pWorker->isPinned ? pWorker->processorNumber : -1;
+		pCell->returnValue = benchmarkCombination(pCell->hashType,
+																pCell->iterationCount,
+																pContext->passwordBytes[pCell->encoding],
+																pContext->passwordBytesSize[pCell->encoding],
+																pContext->salt,
+																GRID_SALT_SIZE,
+																pCell->groupSize,
+																pContext->engine,
+																pContext->pSettings,
+																NULL,
+																pWorker->durations,
+																pCell->errorText,
+																ERROR_BUFFER_SIZE);
+
+		if (pCell->returnValue == 0) {
+			qsort(pWorker->durations, repetitionCount, sizeof(double), compareDurations);
+
+			pCell->minDuration = pWorker->durations[0];
+			pCell->medianDuration = getMedian(pWorker->durations, repetitionCount);
+			pCell->p99Duration = getPercentile(pWorker->durations, repetitionCount, 99);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Format one cell of the parameter grid as a CSV line or as a JSON object
+ */
+void formatGridCell(const GRID_CELL* const pCell, const GRID_CONTEXT* const pContext, const GRID_FORMAT gridFormat, const BOOLEAN isLastCell, TCHAR* const resultBuffer, const int resultBufferSize) {
+	const double iterationsPerSecond = (pCell->medianDuration > 0.0) ? (double)pCell->groupSize * pCell->iterationCount / pCell->medianDuration : 0.0;
+
+	if (gridFormat == GRID_FORMAT_JSON)
+		_stprintf_s(resultBuffer, resultBufferSize, _T("    { \"hashType\": \"%ws\", \"iterationCount\": %d, \"encoding\": \"%s\", \"passwordSize\": %d, \"records\": %d, \"processor\": %d, \"minMs\": %.3f, \"medianMs\": %.3f, \"p99Ms\": %.3f, \"iterationsPerSecond\": %.0f }%s\n"),
+						HASH_ALGORITHM[pCell->hashType],
+						pCell->iterationCount,
+						GRID_ENCODING_NAME[pCell->encoding],
+						pContext->passwordBytesSize[pCell->encoding],
+						pCell->groupSize,
+						pCell->processorNumber,
+						pCell->minDuration * 1000,
+						pCell->medianDuration * 1000,
+						pCell->p99Duration * 1000,
+						iterationsPerSecond,
+						isLastCell ? _T("") : _T(","));
+	else
+		_stprintf_s(resultBuffer, resultBufferSize, _T("%ws,%d,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.0f\n"),
+						HASH_ALGORITHM[pCell->hashType],
+						pCell->iterationCount,
+						GRID_ENCODING_NAME[pCell->encoding],
+						pContext->passwordBytesSize[pCell->encoding],
+						pCell->groupSize,
+						pCell->processorNumber,
+						pCell->minDuration * 1000,
+						pCell->medianDuration * 1000,
+						pCell->p99Duration * 1000,
+						iterationsPerSecond);
+}
+
+/*
+ * Measure the grid of all hash types, iteration counts and both password encodings and write it as a CSV or JSON matrix.
+ * The cells are distributed over threadCount workers. Each worker is pinned to its own processor core, so that
+ * the measurements are not disturbed by thread migrations or by a second worker on the same core.
+ * Cells with errors are not part of the matrix, their errors are written to the error output.
+ */
+int processGrid(const BENCH_SETTINGS* const pSettings,
+					 const TCHAR* const password,
+					 const int threadCount,
+					 const DERIVATION_ENGINE engine,
+					 const GRID_FORMAT gridFormat,
+					 const HANDLE outputHandle,
+					 const BOOLEAN isOutputRedirected,
+					 const HANDLE errorHandle,
+					 const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+	TCHAR resultBuffer[ERROR_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	ARENA arena;
+
+	initializeArena(&arena);
+
+	GRID_CONTEXT context;
+
+	const int maxCellCount = MAX_HASH_TYPE * MAX_BENCH_VALUE_COUNT * GRID_ENCODING_COUNT;
+
+	context.cells = (GRID_CELL*)malloc(maxCellCount * sizeof(GRID_CELL));
+	context.cellCount = 0;
+	context.nextCellIndex = 0;
+	context.engine = engine;
+	context.pSettings = pSettings;
+
+	GRID_WORKER* const workers = (GRID_WORKER*)calloc(threadCount, sizeof(GRID_WORKER));
+	GROUP_AFFINITY* const coreAffinities = (GROUP_AFFINITY*)malloc(threadCount * sizeof(GROUP_AFFINITY));
+	int* const coreProcessorNumbers = (int*)malloc(threadCount * sizeof(int));
+
+	if ((context.cells == NULL) || (workers == NULL) || (coreAffinities == NULL) || (coreProcessorNumbers == NULL)) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate grid buffers\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	// The password is used like a record with and without doItRight
+	const int passwordSize = (int)_tcslen(password);
+
+	context.passwordBytes[0] = (TOCTET*)password;
+	context.passwordBytesSize[0] = (int)(passwordSize * sizeof(TCHAR));
+
+	getPasswordUTF8Encoding(&arena, password, passwordSize, CP_ACP, &context.passwordBytes[1], &context.passwordBytesSize[1], errorBuffer, ERROR_BUFFER_SIZE);
+
+	if (IS_ERROR_MSG_SET) {
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	for (int i = 0; i < GRID_SALT_SIZE; i++)
+		context.salt[i] = (TOCTET)(i * 37 + 11);
+
+	for (int hashType = 0; hashType < MAX_HASH_TYPE; hashType++) {
+		if (isDuplicateHashType(hashType))
+			continue;
+
+		// The SIMD engine derives as many records at once as it has lanes
+		const BOOLEAN isNativeHash = (NATIVE_HASH_OF_HASH_TYPE[hashType] != NATIVE_HASH_NONE);
+		const int groupSize = (isNativeHash && (engine == ENGINE_SIMD)) ? nativeGetMultiBufferLaneCount() : ((isNativeHash && (engine == ENGINE_GPU)) ? MAX_DERIVATION_GROUP_SIZE : 1);
+
+		for (int i = 0; i < pSettings->iterationCounts.count; i++)
+			for (int encoding = 0; encoding < GRID_ENCODING_COUNT; encoding++) {
+				GRID_CELL* const pCell = &context.cells[context.cellCount];
+
+				pCell->hashType = hashType;
+				pCell->iterationCount = pSettings->iterationCounts.value[i];
+				pCell->encoding = encoding;
+				pCell->groupSize = groupSize;
+				pCell->returnValue = 0;
+				pCell->errorText[0] = _T('\0');
+
+				context.cellCount++;
+			}
+	}
+
+	int coreCount;
+
+	// Only the first logical processor of each core is used, so that the workers do not share a core
+	getProcessorAffinities(coreAffinities, coreProcessorNumbers, threadCount, FALSE, &coreCount);
+
+	if (coreCount < threadCount) {
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Only %d of %d grid threads can be pinned to their own core\n"), coreCount, threadCount);
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	}
+
+	for (int i = 0; i < threadCount; i++) {
+		GRID_WORKER* const pWorker = &workers[i];
+
+		pWorker->pContext = &context;
+
+		if ((pWorker->durations = (double*)malloc(pSettings->repetitionCount * sizeof(double))) == NULL) {
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate grid buffers\n"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 3;
+			goto Exit;
+		}
+	}
+
+	LARGE_INTEGER gridStartTickValue;
+
+	startTimer(&gridStartTickValue);
+
+	// The threads are pinned before they start, so that not even their first cell is measured on another processor
+	for (int i = 0; (i < threadCount) && (returnValue == 0); i++) {
+		GRID_WORKER* const pWorker = &workers[i];
+
+		if ((pWorker->threadHandle = CreateThread(NULL, 0, gridThread, pWorker, CREATE_SUSPENDED, NULL)) == NULL) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateThread"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			// The threads that are already running take the remaining cells
+			returnValue = 3;
+			break;
+		}
+
+		if (i < coreCount) {
+			pWorker->affinity = coreAffinities[i];
+			pWorker->processorNumber = coreProcessorNumbers[i];
+			pWorker->isPinned = SetThreadGroupAffinity(pWorker->threadHandle, &pWorker->affinity, NULL);
+		}
+
+		ResumeThread(pWorker->threadHandle);
+	}
+
+	for (int i = 0; i < threadCount; i++)
+		if (workers[i].threadHandle != NULL)
+			WaitForSingleObject(workers[i].threadHandle, INFINITE);
+
+	const double elapsedTime = getElapsedTime(&gridStartTickValue);
+
+	if (returnValue != 0)
+		goto Exit;
+
+	if (gridFormat == GRID_FORMAT_JSON) {
+		_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("{\n  \"engine\": \"%s\",\n  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"threads\": %d,\n  \"saltSize\": %d,\n  \"cells\": [\n"), ENGINE_DISPLAY_NAME[engine], pSettings->warmupCount, pSettings->repetitionCount, threadCount, GRID_SALT_SIZE);
+		writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+	} else {
+		_tcscpy_s(resultBuffer, ERROR_BUFFER_SIZE, _T("HashType,IterationCount,Encoding,PasswordSize,Records,Processor,MinMs,MedianMs,P99Ms,IterationsPerSecond\n"));
+		writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+	}
+
+	// The last cell without an error must not have a comma behind it in JSON
+	int lastCellIndex = -1;
+
+	for (int i = 0; i < context.cellCount; i++)
+		if (context.cells[i].returnValue == 0)
+			lastCellIndex = i;
+
+	int errorCount = 0;
+
+	for (int i = 0; i < context.cellCount; i++) {
+		const GRID_CELL* const pCell = &context.cells[i];
+
+		if (pCell->returnValue == 0) {
+			formatGridCell(pCell, &context, gridFormat, i == lastCellIndex, resultBuffer, ERROR_BUFFER_SIZE);
+			writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+		} else {
+			writeBuffer(errorHandle, isErrorRedirected, (TCHAR*)pCell->errorText);
+
+			errorCount++;
+
+			if (returnValue == 0)
+				returnValue = pCell->returnValue;
+		}
+	}
+
+	if (gridFormat == GRID_FORMAT_JSON) {
+		_tcscpy_s(resultBuffer, ERROR_BUFFER_SIZE, _T("  ]\n}\n"));
+		writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+	}
+
+	// The summary goes to the error output, so that the matrix can be read by other programs
+	_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Cells: %d, Errors: %d, Threads: %d, Elapsed: %d ms\n"), context.cellCount, errorCount, threadCount, lround(elapsedTime * 1000));
+	writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+Exit:
+	if (workers != NULL) {
+		for (int i = 0; i < threadCount; i++) {
+			if (workers[i].threadHandle != NULL)
+				CloseHandle(workers[i].threadHandle);
+
+			if (workers[i].durations != NULL)
+				free((void*)workers[i].durations);
+		}
+
+		free((void*)workers);
+	}
+
+	if (context.cells != NULL)
+		free((void*)context.cells);
+
+	if (coreAffinities != NULL)
+		free((void*)coreAffinities);
+
+	if (coreProcessorNumbers != NULL)
+		free((void*)coreProcessorNumbers);
+
+	releaseArena(&arena);
+
+	return returnValue;
+}
+
+/*
+ * Password and salt size of the scaling benchmark
+ */
+#define SCALING_PASSWORD_SIZE 16
+#define SCALING_SALT_SIZE     16
+
+/*
+ * Interval in milliseconds in which the clock frequency of the processors is sampled while a level of the scaling benchmark runs
+ */
+#define SCALING_SAMPLE_INTERVAL 100
+
+/*
+ * Pinning of the threads of the scaling benchmark
+ */
+typedef enum {
+	PINNING_SPREAD = 0,    // One thread per core first, then the SMT siblings
+	PINNING_COMPACT = 1,   // The logical processors of one core after each other
+	PINNING_OFF = 2        // The threads are not pinned
+} PINNING;
+
+/*
+ * Names of the pinnings, indexed by PINNING
+ */
+const TCHAR* const PINNING_NAME[] = { _T("spread"), _T("compact"), _T("off") };
+
+/*
+ * Power information of a logical processor as returned by CallNtPowerInformation.
+ * The SDK headers do not define this structure, so it is defined here as documented.
+ */
+typedef struct {
+	ULONG Number;
+	ULONG MaxMhz;
+	ULONG CurrentMhz;
+	ULONG MhzLimit;
+	ULONG MaxIdleState;
+	ULONG CurrentIdleState;
+} PROCESSOR_POWER_INFORMATION;
+
+/*
+ * The parameters of the scaling benchmark that are shared by all threads of a level
+ */
+typedef struct {
+	int hashType;
+	int iterationCount;
+	int groupSize;
+	DERIVATION_ENGINE engine;
+	const BENCH_SETTINGS* pSettings;
+	TOCTET password[SCALING_PASSWORD_SIZE];
+	TOCTET salt[SCALING_SALT_SIZE];
+} SCALING_CONTEXT;
+
+/*
+ * A thread of the scaling benchmark. Each thread has its own durations.
+ */
+typedef struct {
+	HANDLE threadHandle;
+	SCALING_CONTEXT* pContext;
+	GROUP_AFFINITY affinity;
+	BOOLEAN isPinned;
+	int processorNumber;
+	double* durations;        // The durations of the measured repetitions
+	int returnValue;
+	TCHAR errorText[ERROR_BUFFER_SIZE + 1];
+} SCALING_WORKER;
+
+/*
+ * Run the repetitions of one thread of the scaling benchmark
+ */
+DWORD WINAPI scalingThread(LPVOID parameter) {
+	SCALING_WORKER* const pWorker = (SCALING_WORKER*)parameter;
+	SCALING_CONTEXT* const pContext = pWorker->pContext;
+
+	pWorker->returnValue = benchmarkCombination(pContext->hashType,
+															  pContext->iterationCount,
+															  pContext->password,
+															  SCALING_PASSWORD_SIZE,
+															  pContext->salt,
+															  SCALING_SALT_SIZE,
+															  pContext->groupSize,
+															  pContext->engine,
+															  pContext->pSettings,
+															  NULL,
+															  pWorker->durations,
+															  pWorker->errorText,
+															  ERROR_BUFFER_SIZE);
+
+	return 0;
+}
+
+/*
+ * Get the average current clock frequency that CallNtPowerInformation reports for the processors that the threads of a level are pinned to,
+ * or for all processors if the threads are not pinned. Many systems report the nominal frequency there instead of the actual one.
+ * Returns 0 if the power information can not be read.
+ */
+ULONG getAverageClockFrequency(const SCALING_WORKER* const workers,
+										 const int threadCount,
+										 PROCESSOR_POWER_INFORMATION* const powerInformation,
+										 const int processorCount,
+										 ULONG* const pMaxFrequency) {
+	if (!NT_SUCCESS(CallNtPowerInformation(ProcessorInformation, NULL, 0, powerInformation, (ULONG)(processorCount * sizeof(PROCESSOR_POWER_INFORMATION)))))
+		return 0;
+
+	ULONGLONG frequencySum = 0;
+
+	int sampleCount = 0;
+
+	for (int i = 0; i < threadCount; i++)
+		if (workers[i].isPinned && (workers[i].processorNumber < processorCount)) {
+			frequencySum += powerInformation[workers[i].processorNumber].CurrentMhz;
+			sampleCount++;
+		}
+
+	if (sampleCount == 0)
+		for (int i = 0; i < processorCount; i++) {
+			frequencySum += powerInformation[i].CurrentMhz;
+			sampleCount++;
+		}
+
+	*pMaxFrequency = powerInformation[0].MaxMhz;
+
+	return (sampleCount > 0) ? (ULONG)(frequencySum / sampleCount) : 0;
+}
+
+/*
+ * Run one level of the scaling benchmark with threadCount threads at the same time and write its line.
+ * The throughput of the level is the sum of the throughputs of its threads, the latencies are taken over the derivations of all threads.
+ * The reported clock frequency is sampled while the threads run, as turbo modes lower it when more cores are busy.
+ * The throughput of one thread on the first level is returned in pSingleThroughput, so that the efficiency of the other levels can be calculated.
+ */
+int runScalingLevel(SCALING_CONTEXT* const pContext,
+						  SCALING_WORKER* const workers,
+						  const int threadCount,
+						  const GROUP_AFFINITY* const affinities,
+						  const int* const processorNumbers,
+						  const int affinityCount,
+						  double* const allDurations,
+						  PROCESSOR_POWER_INFORMATION* const powerInformation,
+						  const int processorCount,
+						  double* const pSingleThroughput,
+						  const HANDLE outputHandle,
+						  const BOOLEAN isOutputRedirected,
+						  const HANDLE errorHandle,
+						  const BOOLEAN isErrorRedirected) {
+	TCHAR resultBuffer[ERROR_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	const int repetitionCount = pContext->pSettings->repetitionCount;
+
+	// The threads are pinned before they start, so that not even their first derivation is measured on another processor
+	for (int i = 0; i < threadCount; i++) {
+		SCALING_WORKER* const pWorker = &workers[i];
+
+		pWorker->pContext = pContext;
+		pWorker->isPinned = FALSE;
+		pWorker->processorNumber = -1;
+		pWorker->returnValue = 0;
+
+		if ((pWorker->threadHandle = CreateThread(NULL, 0, scalingThread, pWorker, CREATE_SUSPENDED, NULL)) == NULL) {
+			_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("CreateThread"));
+			writeBuffer(errorHandle, isErrorRedirected, resultBuffer);
+
+			returnValue = 3;
+			break;
+		}
+
+		if (i < affinityCount) {
+			pWorker->affinity = affinities[i];
+			pWorker->processorNumber = processorNumbers[i];
+			pWorker->isPinned = SetThreadGroupAffinity(pWorker->threadHandle, &pWorker->affinity, NULL);
+		}
+	}
+
+	// Threads that could be created are started anyway, so that they end
+	for (int i = 0; i < threadCount; i++)
+		if (workers[i].threadHandle != NULL)
+			ResumeThread(workers[i].threadHandle);
+
+	ULONG maxFrequency = 0;
+
+	// The first sample is taken right away, so that short levels are sampled, too
+	ULONGLONG frequencySum = getAverageClockFrequency(workers, threadCount, powerInformation, processorCount, &maxFrequency);
+
+	int sampleCount = (frequencySum > 0) ? 1 : 0;
+
+	for (int i = 0; i < threadCount; i++)
+		if (workers[i].threadHandle != NULL) {
+			while (WaitForSingleObject(workers[i].threadHandle, SCALING_SAMPLE_INTERVAL) == WAIT_TIMEOUT) {
+				const ULONG frequency = getAverageClockFrequency(workers, threadCount, powerInformation, processorCount, &maxFrequency);
+
+				if (frequency > 0) {
+					frequencySum += frequency;
+					sampleCount++;
+				}
+			}
+
+			CloseHandle(workers[i].threadHandle);
+			workers[i].threadHandle = NULL;
+		}
+
+	if (returnValue != 0)
+		return returnValue;
+
+	double throughput = 0.0;
+
+	int durationCount = 0;
+
+	for (int i = 0; i < threadCount; i++) {
+		const SCALING_WORKER* const pWorker = &workers[i];
+
+		if (pWorker->returnValue != 0) {
+			writeBuffer(errorHandle, isErrorRedirected, (TCHAR*)pWorker->errorText);
+
+			return pWorker->returnValue;
+		}
+
+		double threadDuration = 0.0;
+
+		for (int j = 0; j < repetitionCount; j++) {
+			threadDuration += pWorker->durations[j];
+			allDurations[durationCount] = pWorker->durations[j];
+			durationCount++;
+		}
+
+		if (threadDuration > 0.0)
+			throughput += (double)repetitionCount * pContext->groupSize / threadDuration;
+	}
+
+	if (threadCount == 1)
+		*pSingleThroughput = throughput;
+
+	qsort(allDurations, durationCount, sizeof(double), compareDurations);
+
+	const double efficiency = (*pSingleThroughput > 0.0) ? throughput / (*pSingleThroughput * threadCount) * 100.0 : 0.0;
+
+	int pinnedCount = 0;
+
+	for (int i = 0; i < threadCount; i++)
+		if (workers[i].isPinned)
+			pinnedCount++;
+
+	_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("Threads: %d, Pinned: %d, Derivations/s: %.1f, Iterations/s: %.0f, Efficiency: %.0f %%, Median: %.3f ms, P99: %.3f ms, Clock: %d MHz of %d MHz\n"),
+					threadCount,
+					pinnedCount,
+					throughput,
+					throughput * pContext->iterationCount,
+					efficiency,
+					getMedian(allDurations, durationCount) * 1000,
+					getPercentile(allDurations, durationCount, 99) * 1000,
+					(sampleCount > 0) ? (int)(frequencySum / sampleCount) : 0,
+					(int)maxFrequency);
+	writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+	return 0;
+}
+
+/*
+ * Run the scaling benchmark. One combination of hash type and iteration count is measured with 1, 2, 4 ... threads
+ * up to maxThreadCount threads that derive at the same time. maxThreadCount itself is always the last level.
+ * The threads are pinned to logical processors in spread or compact order, or not at all.
+ */
+int processScaling(const TCHAR* const hashTypeText,
+						 const TCHAR* const iterationCountText,
+						 const BENCH_SETTINGS* const pSettings,
+						 const int maxThreadCount,
+						 const PINNING pinning,
+						 const DERIVATION_ENGINE engine,
+						 const HANDLE outputHandle,
+						 const BOOLEAN isOutputRedirected,
+						 const HANDLE errorHandle,
+						 const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	SCALING_CONTEXT context;
+
+	context.hashType = getIntegerArg(_T("hashType"), hashTypeText, MIN_HASH_TYPE, MAX_HASH_TYPE, errorBuffer, ERROR_BUFFER_SIZE) - 1;
+
+	if (IS_ERROR_MSG_NOT_SET)
+		context.iterationCount = getIntegerArg(_T("iterationCount"), iterationCountText, MIN_ITERATION_COUNT, MAX_ITERATION_COUNT, errorBuffer, ERROR_BUFFER_SIZE);
+
+	if (IS_ERROR_MSG_SET) {
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		return 2;
+	}
+
+	// The SIMD engine derives as many records at once as it has lanes
+	const BOOLEAN isNativeHash = (NATIVE_HASH_OF_HASH_TYPE[context.hashType] != NATIVE_HASH_NONE);
+
+	context.groupSize = (isNativeHash && (engine == ENGINE_SIMD)) ? nativeGetMultiBufferLaneCount() : ((isNativeHash && (engine == ENGINE_GPU)) ? MAX_DERIVATION_GROUP_SIZE : 1);
+	context.engine = engine;
+	context.pSettings = pSettings;
+
+	// The password consists of printable ASCII characters, so it is the same in all encodings
+	for (int i = 0; i < SCALING_PASSWORD_SIZE; i++)
+		context.password[i] = (TOCTET)('a' + i % 26);
+
+	for (int i = 0; i < SCALING_SALT_SIZE; i++)
+		context.salt[i] = (TOCTET)(i * 37 + 11);
+
+	const int processorCount = (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+
+	SCALING_WORKER* const workers = (SCALING_WORKER*)calloc(maxThreadCount, sizeof(SCALING_WORKER));
+	GROUP_AFFINITY* const affinities = (GROUP_AFFINITY*)malloc(maxThreadCount * sizeof(GROUP_AFFINITY));
+	int* const processorNumbers = (int*)malloc(maxThreadCount * sizeof(int));
+	double* const allDurations = (double*)malloc(maxThreadCount * pSettings->repetitionCount * sizeof(double));
+	PROCESSOR_POWER_INFORMATION* const powerInformation = (PROCESSOR_POWER_INFORMATION*)malloc(processorCount * sizeof(PROCESSOR_POWER_INFORMATION));
+
+	if ((workers == NULL) || (affinities == NULL) || (processorNumbers == NULL) || (allDurations == NULL) || (powerInformation == NULL)) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate scaling buffers\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	for (int i = 0; i < maxThreadCount; i++)
+		if ((workers[i].durations = (double*)malloc(pSettings->repetitionCount * sizeof(double))) == NULL) {
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate scaling buffers\n"));
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 3;
+			goto Exit;
+		}
+
+	int coreCount;
+
+	// The cores are counted even without pinning, as they are needed to find the knee in the curve
+	int affinityCount = getProcessorAffinities(affinities, processorNumbers, maxThreadCount, pinning == PINNING_COMPACT, &coreCount);
+
+	if (pinning == PINNING_OFF)
+		affinityCount = 0;
+	else {
+		if (affinityCount < maxThreadCount) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Only %d of %d scaling threads can be pinned\n"), affinityCount, maxThreadCount);
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+		}
+	}
+
+	_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Engine: %s, HashType: %ws, IterationCount: %d, Records: %d, Warm-up: %d, Repetitions: %d, Processors: %d, Cores: %d, Pinning: %s\n"),
+					ENGINE_DISPLAY_NAME[engine],
+					HASH_ALGORITHM[context.hashType],
+					context.iterationCount,
+					context.groupSize,
+					pSettings->warmupCount,
+					pSettings->repetitionCount,
+					processorCount,
+					coreCount,
+					PINNING_NAME[pinning]);
+	writeBuffer(outputHandle, isOutputRedirected, errorBuffer);
+
+	double singleThroughput = 0.0;
+
+	for (int threadCount = 1; (returnValue == 0) && (threadCount <= maxThreadCount); threadCount = (threadCount < maxThreadCount) ? min(threadCount * 2, maxThreadCount) : maxThreadCount + 1)
+		returnValue = runScalingLevel(&context, workers, threadCount, affinities, processorNumbers, affinityCount, allDurations, powerInformation, processorCount, &singleThroughput, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+
+Exit:
+	if (workers != NULL) {
+		for (int i = 0; i < maxThreadCount; i++) {
+
+			if (workers[i].durations != NULL)
+				free((void*)workers[i].durations);
+		}
+
+		free((void*)workers);
+	}
+
+	if (affinities != NULL)
+		free((void*)affinities);
+
+	if (processorNumbers != NULL)
+		free((void*)processorNumbers);
+
+	if (allDurations != NULL)
+		free((void*)allDurations);
+
+	if (powerInformation != NULL)
+		free((void*)powerInformation);
+
+	return returnValue;
+}
+
+/*
+ * Minimum and maximum target duration of the calibration in milliseconds
+ */
+#define MIN_CALIBRATION_TARGET 1
+#define MAX_CALIBRATION_TARGET 60000
+
+/*
+ * Parameters of the calibration: The iteration count of the first measurement, the number of
+ * measurements whose median is used, the minimum duration in seconds that is needed for a reliable
+ * extrapolation, the maximum number of extrapolation steps and the relative tolerance that ends them.
+ */
+#define CALIBRATION_START_ITERATION_COUNT 1000
+#define CALIBRATION_REPETITION_COUNT 3
+#define CALIBRATION_MIN_DURATION 0.02
+#define CALIBRATION_MAX_STEP_COUNT 5
+#define CALIBRATION_TOLERANCE 0.02
+
+/*
+ * Size of the password and the salt that are used for the calibration
+ */
+#define CALIBRATION_DATA_SIZE 16
+
+/*
+ * Measure the median duration of a derivation with an iteration count
+ */
+int measureIterationCount(const int hashType,
+								  const int iterationCount,
+								  const DERIVATION_ENGINE engine,
+								  double* const pDuration,
+								  TCHAR* const errorBuffer,
+								  const int errorBufferSize) {
+	TOCTET password[CALIBRATION_DATA_SIZE];
+	TOCTET salt[CALIBRATION_DATA_SIZE];
+	double durations[CALIBRATION_REPETITION_COUNT];
+
+	BENCH_SETTINGS settings;
+
+	settings.repetitionCount = CALIBRATION_REPETITION_COUNT;
+	settings.warmupCount = 0;
+
+	for (int i = 0; i < CALIBRATION_DATA_SIZE; i++) {
+		password[i] = (TOCTET)('a' + i);
+		salt[i] = (TOCTET)(i * 37 + 11);
+	}
+
+	const int returnValue = benchmarkCombination(hashType, iterationCount, password, CALIBRATION_DATA_SIZE, salt, CALIBRATION_DATA_SIZE, 1, engine, &settings, NULL, durations, errorBuffer, errorBufferSize);
+
+	if (returnValue == 0) {
+		qsort(durations, CALIBRATION_REPETITION_COUNT, sizeof(double), compareDurations);
+
+		*pDuration = getMedian(durations, CALIBRATION_REPETITION_COUNT);
+	}
+
+	return returnValue;
+}
+
+/*
+ * Find the iteration count whose derivation takes the target duration in seconds.
+ * The duration is proportional to the iteration count, so the iteration count is first raised until the duration
+ * can be measured reliably and then extrapolated to the target until the measured duration is close enough.
+ * The iteration count is clamped to MAX_ITERATION_COUNT. In this case pIsClamped is set.
+ */
+int calibrateIterationCount(const int hashType,
+									 const double targetDuration,
+									 const DERIVATION_ENGINE engine,
+									 int* const pIterationCount,
+									 double* const pDuration,
+									 BOOLEAN* const pIsClamped,
+									 TCHAR* const errorBuffer,
+									 const int errorBufferSize) {
+	int iterationCount = CALIBRATION_START_ITERATION_COUNT;
+	double duration = 0.0;
+
+	*pIsClamped = FALSE;
+
+	int returnValue = measureIterationCount(hashType, iterationCount, engine, &duration, errorBuffer, errorBufferSize);
+
+	while ((returnValue == 0) && (duration < CALIBRATION_MIN_DURATION) && (duration < targetDuration) && (iterationCount < MAX_ITERATION_COUNT)) {
+		iterationCount = min(iterationCount * 10, MAX_ITERATION_COUNT);
+
+		returnValue = measureIterationCount(hashType, iterationCount, engine, &duration, errorBuffer, errorBufferSize);
+	}
+
+	for (int step = 0; (step < CALIBRATION_MAX_STEP_COUNT) && (returnValue == 0); step++) {
+		if (fabs(duration - targetDuration) <= targetDuration * CALIBRATION_TOLERANCE)
+			break;
+
+		const double estimate = (duration > 0.0) ? iterationCount * targetDuration / duration : (double)MAX_ITERATION_COUNT + 1.0;
+
+		*pIsClamped = (estimate > MAX_ITERATION_COUNT);
+
+		const int nextIterationCount = *pIsClamped ? MAX_ITERATION_COUNT : max((int)lround(estimate), MIN_ITERATION_COUNT);
+
+		if (nextIterationCount == iterationCount)
+			break;
+
+		iterationCount = nextIterationCount;
+
+		returnValue = measureIterationCount(hashType, iterationCount, engine, &duration, errorBuffer, errorBufferSize);
+	}
+
+	*pIterationCount = iterationCount;
+	*pDuration = duration;
+
+	return returnValue;
+}
+
+/*
+ * Calibrate the iteration count of a hash type to a target duration in milliseconds and write the recommended value
+ */
+int processCalibration(const TCHAR* const hashTypeText,
+							  const int targetTime,
+							  const DERIVATION_ENGINE engine,
+							  const HANDLE outputHandle,
+							  const BOOLEAN isOutputRedirected,
+							  const HANDLE errorHandle,
+							  const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+	TCHAR resultBuffer[ERROR_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	const int hashType = getIntegerArg(_T("hashType"), hashTypeText, MIN_HASH_TYPE, MAX_HASH_TYPE, errorBuffer, ERROR_BUFFER_SIZE) - 1;
+
+	if (IS_ERROR_MSG_SET) {
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		return 2;
+	}
+
+	int iterationCount;
+	double duration;
+	BOOLEAN isClamped;
+
+	returnValue = calibrateIterationCount(hashType, targetTime / 1000.0, engine, &iterationCount, &duration, &isClamped, errorBuffer, ERROR_BUFFER_SIZE);
+
+	if (returnValue == 0) {
+		_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("HashType: %ws, Target: %d ms, IterationCount: %d, Duration: %.1f ms\n"), HASH_ALGORITHM[hashType], targetTime, iterationCount, duration * 1000);
+		writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+		if (isClamped) {
+			_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("The target needs more than the maximum iteration count of %d\n"), MAX_ITERATION_COUNT);
+			writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+		}
+	} else
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+	return returnValue;
+}
+
+/*
+ * One side of a comparison. Each side has its own record and arena, so the two threads only share the algorithm providers of the library.
+ */
+typedef struct {
+	DERIVATION_ENGINE engine;
+	DERIVATION_RECORD record;
+	ARENA arena;
+} COMPARISON_SIDE;
+
+/*
+ * Thread pool callback that derives the key of the second side of a comparison
+ */
+VOID CALLBACK comparisonWorkCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work) {
+	UNREFERENCED_PARAMETER(instance);
+	UNREFERENCED_PARAMETER(work);
+
+	COMPARISON_SIDE* const pSide = (COMPARISON_SIDE*)context;
+
+	deriveRecords(&pSide->record, 1, pSide->engine);
+}
+
+/*
+ * Derive the key of one record with two engines at the same time, the first one on this thread and the second one
+ * on a thread of the default thread pool. The result line of the first engine is written, followed by the comparison
+ * of the keys and the durations of both engines. If the keys differ the result line of the second engine is written, too.
+ * Each side is derived on one thread, so that the durations can be compared.
+ * Returns 5 if the keys differ.
+ */
+int processComparison(const TCHAR* const hashTypeText,
+							 TCHAR* const saltText,
+							 const TCHAR* const iterationCountText,
+							 const TCHAR* const password,
+							 const BOOLEAN doItRight,
+							 const int requestedKeySize,
+							 const DERIVATION_ENGINE engine,
+							 const DERIVATION_ENGINE compareEngine,
+							 const OUTPUT_FORMAT outputFormat,
+							 const HANDLE outputHandle,
+							 const BOOLEAN isOutputRedirected,
+							 const HANDLE errorHandle,
+							 const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+	TCHAR resultBuffer[RESULT_BUFFER_SIZE + 1];
+	TCHAR lineBuffer[RESULT_BUFFER_SIZE + 1];
+
+	COMPARISON_SIDE sides[2];
+
+	int returnValue = 0;
+
+	RESET_ERROR_MSG;
+
+	sides[0].engine = engine;
+	sides[1].engine = compareEngine;
+
+	for (int i = 0; i < 2; i++) {
+		COMPARISON_SIDE* const pSide = &sides[i];
+
+		initializeArena(&pSide->arena);
+
+		if ((returnValue == 0) && (prepareRecord(&pSide->record, &pSide->arena, NULL, hashTypeText, saltText, iterationCountText, password, CP_ACP, doItRight, requestedKeySize, MAX_ITERATION_COUNT) != 0)) {
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, pSide->record.errorText);
+
+			returnValue = pSide->record.returnValue;
+		}
+	}
+
+	if (returnValue == 0) {
+		PTP_WORK work = CreateThreadpoolWork(comparisonWorkCallback, &sides[1], NULL);
+
+		if (work != NULL) {
+			SubmitThreadpoolWork(work);
+
+			deriveRecords(&sides[0].record, 1, sides[0].engine);
+
+			WaitForThreadpoolWorkCallbacks(work, FALSE);
+			CloseThreadpoolWork(work);
+
+			for (int i = 0; (i < 2) && (returnValue == 0); i++)
+				if (sides[i].record.returnValue != 0) {
+					_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("%s: %s"), ENGINE_DISPLAY_NAME[sides[i].engine], sides[i].record.errorText);
+
+					returnValue = sides[i].record.returnValue;
+				}
+		} else {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not create thread pool work: %lu\n"), GetLastError());
+
+			returnValue = 3;
+		}
+	}
+
+	if (returnValue == 0) {
+		const DERIVATION_RECORD* const pLeft = &sides[0].record;
+		const DERIVATION_RECORD* const pRight = &sides[1].record;
+
+		const BOOLEAN isEqual = (pLeft->derivedKeySize == pRight->derivedKeySize) && (memcmp(pLeft->derivedKey, pRight->derivedKey, pLeft->derivedKeySize) == 0);
+
+		for (int i = 0; (i < 2) && (returnValue == 0); i++)
+			if ((i == 0) || !isEqual) {
+				if (formatRecordResult(&sides[i].record, outputFormat, resultBuffer, RESULT_BUFFER_SIZE) > 0) {
+					// The result lines of different keys start with the name of their engine
+					if (!isEqual) {
+						_stprintf_s(lineBuffer, RESULT_BUFFER_SIZE, _T("%s: %s"), ENGINE_DISPLAY_NAME[sides[i].engine], resultBuffer);
+						writeBuffer(outputHandle, isOutputRedirected, lineBuffer);
+					} else
+						writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+				} else {
+					_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, sides[i].record.errorText);
+
+					returnValue = sides[i].record.returnValue;
+				}
+			}
+
+		if (returnValue == 0) {
+			const double ratio = (pLeft->duration > 0.0) ? pRight->duration / pLeft->duration : 0.0;
+
+			_stprintf_s(resultBuffer, RESULT_BUFFER_SIZE, _T("Comparison: %s, %s: %.3f ms, %s: %.3f ms, Ratio: %.2f\n"),
+							isEqual ? _T("equal") : _T("different"),
+							ENGINE_DISPLAY_NAME[sides[0].engine], pLeft->duration * 1000,
+							ENGINE_DISPLAY_NAME[sides[1].engine], pRight->duration * 1000,
+							ratio);
+			writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+			if (!isEqual)
+				returnValue = 5;
+		}
+	}
+
+	if (IS_ERROR_MSG_SET)
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+	for (int i = 0; i < 2; i++) {
+		releaseArena(&sides[i].arena);
+	}
+
+	return returnValue;
+}
+
+/*
+ * Identification and version of a checkpoint file
+ */
+#define CHECKPOINT_MAGIC      "PBKDF2CP"
+#define CHECKPOINT_MAGIC_SIZE 8
+#define CHECKPOINT_VERSION    2
+
+/*
+ * Number of iterations between two checks for a stop request or a due checkpoint
+ */
+#define CHECKPOINT_STEP_ITERATION_COUNT 10000
+
+/*
+ * Time in seconds between two checkpoints
+ */
+#define CHECKPOINT_INTERVAL 10.0
+
+/*
+ * Suffix of the temporary file that a checkpoint is written into
+ */
+#define CHECKPOINT_TEMP_FILE_SUFFIX _T(".tmp")
+
+/*
+ * Content of a checkpoint file. It is written as it is in memory, so it can only be read by the same build of the program.
+ * The state of the chain is as secret as the derived key.
+ */
+typedef struct {
+	char magic[CHECKPOINT_MAGIC_SIZE];
+	int version;
+	int hashType;
+	double duration;                          // Duration of the derivation up to this checkpoint in seconds
+	PORTABLE_PBKDF2_CHAIN chain;
+	TOCTET derivedKey[MAX_DERIVED_KEY_SIZE];  // The blocks of the derived key that are finished
+} CHECKPOINT;
+
+/*
+ * Is set when the derivation with checkpoints should be stopped after the next checkpoint
+ */
+static volatile BOOLEAN isCheckpointStopRequested = FALSE;
+
+/*
+ * Stop a derivation with checkpoints on Ctrl+C, Ctrl+Break and when the console is closed.
+ * The derivation writes a checkpoint before it stops.
+ */
+BOOL WINAPI checkpointControlHandler(DWORD controlType) {
+	UNREFERENCED_PARAMETER(controlType);
+
+	isCheckpointStopRequested = TRUE;
+
+	return TRUE;
+}
+
+/*
+ * Read a checkpoint file. If the file does not exist pIsLoaded is FALSE and 0 is returned.
+ * Returns 4 if the file can not be read or is not a checkpoint file of this program.
+ */
+int loadCheckpoint(const TCHAR* const fileName, CHECKPOINT* const pCheckpoint, BOOLEAN* const pIsLoaded, TCHAR* const errorBuffer, const int errorBufferSize) {
+	*pIsLoaded = FALSE;
+
+	const HANDLE fileHandle = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		const DWORD lastError = GetLastError();
+
+		if (lastError == ERROR_FILE_NOT_FOUND)
+			return 0;
+
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not open checkpoint file \"%s\": %lu\n"), fileName, lastError);
+
+		return 4;
+	}
+
+	DWORD bytesRead = 0;
+
+	const BOOL isRead = ReadFile(fileHandle, pCheckpoint, sizeof(CHECKPOINT), &bytesRead, NULL);
+
+	CloseHandle(fileHandle);
+
+	if (!isRead || (bytesRead != sizeof(CHECKPOINT)) ||
+		 (memcmp(pCheckpoint->magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_SIZE) != 0) || (pCheckpoint->version != CHECKPOINT_VERSION)) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("\"%s\" is not a checkpoint file of this program\n"), fileName);
+
+		return 4;
+	}
+
+	*pIsLoaded = TRUE;
+
+	return 0;
+}
+
+/*
+ * Write a checkpoint file. The checkpoint is written into a temporary file that replaces the checkpoint file,
+ * so that there always is a complete checkpoint file, even if the program is stopped while it is written.
+ * Returns 4 if the file can not be written.
+ */
+int saveCheckpoint(const TCHAR* const fileName, const CHECKPOINT* const pCheckpoint, TCHAR* const errorBuffer, const int errorBufferSize) {
+	TCHAR tempFileName[MAX_PATH + 1];
+
+	_stprintf_s(tempFileName, MAX_PATH, _T("%s%s"), fileName, CHECKPOINT_TEMP_FILE_SUFFIX);
+
+	const HANDLE fileHandle = CreateFile(tempFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not create checkpoint file \"%s\": %lu\n"), tempFileName, GetLastError());
+
+		return 4;
+	}
+
+	DWORD bytesWritten = 0;
+
+	const BOOL isWritten = WriteFile(fileHandle, pCheckpoint, sizeof(CHECKPOINT), &bytesWritten, NULL) && (bytesWritten == sizeof(CHECKPOINT)) && FlushFileBuffers(fileHandle);
+
+	CloseHandle(fileHandle);
+
+	if (!isWritten || !MoveFileEx(tempFileName, fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not write checkpoint file \"%s\": %lu\n"), fileName, GetLastError());
+
+		DeleteFile(tempFileName);
+
+		return 4;
+	}
+
+	return 0;
+}
+
+/*
+ * Overwrite a checkpoint file with zeros and delete it, so that the state of the derivation does not stay on the disk
+ */
+void deleteCheckpointFile(const TCHAR* const fileName) {
+	const HANDLE fileHandle = CreateFile(fileName, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		TOCTET zeros[sizeof(CHECKPOINT)];
+
+		DWORD bytesWritten;
+
+		memset(zeros, 0, sizeof(zeros));
+
+		WriteFile(fileHandle, zeros, sizeof(zeros), &bytesWritten, NULL);
+		FlushFileBuffers(fileHandle);
+
+		CloseHandle(fileHandle);
+
+		DeleteFile(fileName);
+	}
+}
+
+/*
+ * Derive the key of one record in steps with the portable engine and write a checkpoint file every CHECKPOINT_INTERVAL seconds.
+ * If the checkpoint file exists the derivation is resumed from it. The progress is written to the error output with each checkpoint.
+ * On Ctrl+C a checkpoint is written and 6 is returned, so that the derivation can be resumed with the same arguments.
+ * A checkpoint file is identified by the parameters and the salt of the record. It does not contain any value of the password
+ * but U and T, so a resumed derivation with a wrong password yields a wrong key.
+ * The checkpoint file and a temporary file that may be left over are cleared and deleted when the key is complete.
+ */
+int processCheckpointedRecord(const TCHAR* const hashTypeText,
+										TCHAR* const saltText,
+										const TCHAR* const iterationCountText,
+										const TCHAR* const password,
+										const BOOLEAN doItRight,
+										const int requestedKeySize,
+										const int maxIterationCount,
+										const TCHAR* const checkpointFileName,
+										const OUTPUT_FORMAT outputFormat,
+										const HANDLE outputHandle,
+										const BOOLEAN isOutputRedirected,
+										const HANDLE errorHandle,
+										const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+	TCHAR resultBuffer[RESULT_BUFFER_SIZE + 1];
+	TCHAR tempFileName[MAX_PATH + 1];
+
+	DERIVATION_RECORD record;
+
+	ARENA arena;
+
+	CHECKPOINT checkpoint;
+
+	BOOLEAN isLoaded = FALSE;
+
+	RESET_ERROR_MSG;
+
+	initializeArena(&arena);
+
+	int returnValue = prepareRecord(&record, &arena, NULL, hashTypeText, saltText, iterationCountText, password, CP_ACP, doItRight, requestedKeySize, maxIterationCount);
+
+	if (returnValue != 0)
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, record.errorText);
+	else
+		returnValue = loadCheckpoint(checkpointFileName, &checkpoint, &isLoaded, errorBuffer, ERROR_BUFFER_SIZE);
+
+	PORTABLE_PBKDF2_CHAIN* const pChain = &checkpoint.chain;
+
+	const ULONG passwordSize = (ULONG)record.passwordBytesSize;
+	const ULONG saltSize = (ULONG)record.saltArraySize;
+
+	if (returnValue == 0) {
+		const PORTABLE_HASH hash = PORTABLE_HASH_OF_HASH_TYPE[record.hashType];
+
+		record.derivedKeySize = (requestedKeySize > 0) ? requestedKeySize : portableGetDigestSize(hash);
+
+		if (isLoaded) {
+			if ((checkpoint.hashType != record.hashType) ||
+				 (pChain->iterationCount != (ULONG)record.iterationCount) ||
+				 (pChain->derivedKeySize != (ULONG)record.derivedKeySize) ||
+				 !portableIsChainOf(pChain, record.saltArray, saltSize)) {
+				_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Checkpoint file \"%s\" belongs to a different record\n"), checkpointFileName);
+
+				returnValue = 4;
+			} else {
+				_stprintf_s(resultBuffer, RESULT_BUFFER_SIZE, _T("Resuming at %.1f %%\n"), portableGetChainProgress(pChain) * 100);
+				writeBuffer(errorHandle, isErrorRedirected, resultBuffer);
+			}
+		} else {
+			memset(&checkpoint, 0, sizeof(CHECKPOINT));
+			memcpy(checkpoint.magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_SIZE);
+
+			checkpoint.version = CHECKPOINT_VERSION;
+			checkpoint.hashType = record.hashType;
+			checkpoint.duration = 0.0;
+
+			portableStartChain(pChain, hash, record.saltArray, saltSize, (ULONG)record.iterationCount, (ULONG)record.derivedKeySize);
+		}
+	}
+
+	if (returnValue == 0) {
+		const double previousDuration = checkpoint.duration;
+
+		LARGE_INTEGER startTickValue;
+		LARGE_INTEGER checkpointTickValue;
+
+		BOOLEAN isComplete = FALSE;
+
+		isCheckpointStopRequested = FALSE;
+
+		SetConsoleCtrlHandler(checkpointControlHandler, TRUE);
+
+		startTimer(&startTickValue);
+		startTimer(&checkpointTickValue);
+
+		while (!isComplete && (returnValue == 0) && !isCheckpointStopRequested) {
+			isComplete = portableContinueChain(pChain, record.passwordBytes, passwordSize, record.saltArray, saltSize, CHECKPOINT_STEP_ITERATION_COUNT, checkpoint.derivedKey);
+
+			if (!isComplete && (isCheckpointStopRequested || (getElapsedTime(&checkpointTickValue) >= CHECKPOINT_INTERVAL))) {
+				checkpoint.duration = previousDuration + getElapsedTime(&startTickValue);
+
+				returnValue = saveCheckpoint(checkpointFileName, &checkpoint, errorBuffer, ERROR_BUFFER_SIZE);
+
+				if (returnValue == 0) {
+					_stprintf_s(resultBuffer, RESULT_BUFFER_SIZE, _T("Progress: %.1f %%\n"), portableGetChainProgress(pChain) * 100);
+					writeBuffer(errorHandle, isErrorRedirected, resultBuffer);
+				}
+
+				startTimer(&checkpointTickValue);
+			}
+		}
+
+		SetConsoleCtrlHandler(checkpointControlHandler, FALSE);
+
+		if ((returnValue == 0) && isComplete) {
+			record.derivedKey = checkpoint.derivedKey;
+			record.duration = previousDuration + getElapsedTime(&startTickValue);
+
+			_stprintf_s(tempFileName, MAX_PATH, _T("%s%s"), checkpointFileName, CHECKPOINT_TEMP_FILE_SUFFIX);
+
+			deleteCheckpointFile(checkpointFileName);
+			deleteCheckpointFile(tempFileName);
+
+			const int resultSize = formatRecordResult(&record, outputFormat, resultBuffer, RESULT_BUFFER_SIZE);
+
+			if (resultSize > 0) {
+				if (outputFormat == OUTPUT_FORMAT_BINARY)
+					writeBytes(outputHandle, resultBuffer, resultSize);
+				else
+					writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+				// The duration is the sum of the durations of all runs
+				_stprintf_s(resultBuffer, RESULT_BUFFER_SIZE, _T("Duration: %d ms\n"), lround(record.duration * 1000));
+
+				if (outputFormat == OUTPUT_FORMAT_BINARY)
+					writeBuffer(errorHandle, isErrorRedirected, resultBuffer);
+				else
+					writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+			} else {
+				_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, record.errorText);
+
+				returnValue = record.returnValue;
+			}
+		} else if (returnValue == 0) {
+			_stprintf_s(resultBuffer, RESULT_BUFFER_SIZE, _T("Stopped at %.1f %%, the derivation is resumed with the same arguments\n"), portableGetChainProgress(pChain) * 100);
+			writeBuffer(errorHandle, isErrorRedirected, resultBuffer);
+
+			returnValue = 6;
+		}
+	}
+
+	if (IS_ERROR_MSG_SET)
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+	SecureZeroMemory(&checkpoint, sizeof(CHECKPOINT));
+
+	releaseArena(&arena);
+
+	return returnValue;
+}
+
+/*
+ * Size of the iteration count in front of the blocks of a chain state
+ */
+#define STATE_ITERATION_COUNT_SIZE 4
+
+/*
+ * Get the size in bytes of the chain state of a derived key. The state consists of the iteration count
+ * as a big endian 32 bit integer followed by U_n and T_n of each block. T_n of the last block is not truncated,
+ * so that it can be extended.
+ */
+int getChainStateSize(const int digestSize, const int derivedKeySize) {
+	const int blockCount = (derivedKeySize + digestSize - 1) / digestSize;
+
+	return STATE_ITERATION_COUNT_SIZE + (blockCount * 2 * digestSize);
+}
+
+/*
+ * Derive the key of a record with the portable engine from a chain state and update the state.
+ * If previousIterationCount is 0 the state is empty and the key is derived from the start.
+ * Otherwise the blocks in the state are extended from previousIterationCount to the iteration count of the record.
+ */
+void deriveRecordWithState(DERIVATION_RECORD* const pRecord, TOCTET* const state, const int previousIterationCount) {
+	const PORTABLE_HASH hash = PORTABLE_HASH_OF_HASH_TYPE[pRecord->hashType];
+	const int digestSize = portableGetDigestSize(hash);
+	const int blockCount = (pRecord->derivedKeySize + digestSize - 1) / digestSize;
+
+	pRecord->derivedKey = (TOCTET*)allocateFromArena(pRecord->pArena, pRecord->derivedKeySize);
+
+	if (pRecord->derivedKey != NULL) {
+		LARGE_INTEGER startTickValue;
+
+		GUID activityId;
+
+		const BOOLEAN isTraced = traceDerivationStart(&activityId, ENGINE_PORTABLE, pRecord->hashType, pRecord->iterationCount, 1);
+
+		startTimer(&startTickValue);
+
+		for (int blockIndex = 0; blockIndex < blockCount; blockIndex++) {
+			TOCTET* const u = state + STATE_ITERATION_COUNT_SIZE + (blockIndex * 2 * digestSize);
+			TOCTET* const t = u + digestSize;
+
+			int doneIterationCount = previousIterationCount;
+
+			if (doneIterationCount == 0) {
+				portableStartBlock(hash, pRecord->passwordBytes, (ULONG)pRecord->passwordBytesSize, pRecord->saltArray, (ULONG)pRecord->saltArraySize, (ULONG)(blockIndex + 1), u, t);
+
+				doneIterationCount = 1;
+			}
+
+			portableExtendBlock(hash, pRecord->passwordBytes, (ULONG)pRecord->passwordBytesSize, (ULONG)(pRecord->iterationCount - doneIterationCount), u, t);
+
+			memcpy(pRecord->derivedKey + (blockIndex * digestSize), t, min(digestSize, pRecord->derivedKeySize - (blockIndex * digestSize)));
+		}
+
+		pRecord->duration = getElapsedTime(&startTickValue);
+
+		state[0] = (TOCTET)(pRecord->iterationCount >> 24);
+		state[1] = (TOCTET)(pRecord->iterationCount >> 16);
+		state[2] = (TOCTET)(pRecord->iterationCount >> 8);
+		state[3] = (TOCTET)pRecord->iterationCount;
+
+		if (isTraced)
+			traceDerivationStop(&activityId, pRecord, pRecord->duration);
+	} else {
+		_stprintf_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate %d bytes for hash value\n"), pRecord->derivedKeySize);
+		pRecord->returnValue = 3;
+	}
+}
+
+/*
+ * Derive the key of one record with the portable engine and write the result line, the chain state and the duration.
+ * If there is a state text, the state is extended by iterationCount further iterations instead of deriving the key from the start.
+ * The iteration count in the result line is then the sum of the iteration count of the state and the further iterations.
+ */
+int processStateRecord(const TCHAR* const hashTypeText,
+							  TCHAR* const saltText,
+							  const TCHAR* const iterationCountText,
+							  const TCHAR* const password,
+							  const BOOLEAN doItRight,
+							  const int requestedKeySize,
+							  TCHAR* const stateText,
+							  const OUTPUT_FORMAT outputFormat,
+							  const HANDLE outputHandle,
+							  const BOOLEAN isOutputRedirected,
+							  const HANDLE errorHandle,
+							  const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+	TCHAR resultBuffer[RESULT_BUFFER_SIZE + 1];
+
+	DERIVATION_RECORD record;
+
+	ARENA arena;
+
+	TOCTET* state = NULL;
+	int stateSize = 0;
+
+	int previousIterationCount = 0;
+
+	RESET_ERROR_MSG;
+
+	initializeArena(&arena);
+
+	int returnValue = prepareRecord(&record, &arena, NULL, hashTypeText, saltText, iterationCountText, password, CP_ACP, doItRight, requestedKeySize, MAX_ITERATION_COUNT);
+
+	if (returnValue != 0)
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, record.errorText);
+	else {
+		const int digestSize = portableGetDigestSize(PORTABLE_HASH_OF_HASH_TYPE[record.hashType]);
+
+		record.derivedKeySize = (requestedKeySize > 0) ? requestedKeySize : digestSize;
+
+		const int expectedStateSize = getChainStateSize(digestSize, record.derivedKeySize);
+
+		if (stateText != NULL) {
+			removeBlanks(stateText);
+
+			safeHexStringToByteArray(&arena, stateText, &state, &stateSize, errorBuffer, ERROR_BUFFER_SIZE);
+
+			if (IS_ERROR_MSG_SET)
+				returnValue = (state == NULL) ? 3 : 2;
+			else if (stateSize != expectedStateSize) {
+				_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The state does not have the size of %d bytes of the hash type and key size\n"), expectedStateSize);
+
+				returnValue = 2;
+			} else {
+				previousIterationCount = (int)(((ULONG)state[0] << 24) | ((ULONG)state[1] << 16) | ((ULONG)state[2] << 8) | (ULONG)state[3]);
+
+				if ((previousIterationCount < MIN_ITERATION_COUNT) || (record.iterationCount > MAX_CHECKPOINT_ITERATION_COUNT - previousIterationCount)) {
+					_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The iteration count of the state must be between %d and %d\n"), MIN_ITERATION_COUNT, MAX_CHECKPOINT_ITERATION_COUNT - record.iterationCount);
+
+					returnValue = 2;
+				} else
+					record.iterationCount += previousIterationCount;
+			}
+		} else {
+			stateSize = expectedStateSize;
+			state = (TOCTET*)allocateFromArena(&arena, stateSize);
+
+			if (state == NULL) {
+				_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate %d bytes for the state\n"), stateSize);
+
+				returnValue = 3;
+			}
+		}
+	}
+
+	if (returnValue == 0) {
+		deriveRecordWithState(&record, state, previousIterationCount);
+
+		returnValue = record.returnValue;
+
+		if (returnValue == 0) {
+			const TCHAR* const stateAsText = bytesToHex(&arena, state, stateSize, FALSE);
+
+			if ((stateAsText != NULL) && (formatRecordResult(&record, outputFormat, resultBuffer, RESULT_BUFFER_SIZE) > 0)) {
+				writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+				_stprintf_s(resultBuffer, RESULT_BUFFER_SIZE, _T("State: %s\n"), stateAsText);
+				writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+				_stprintf_s(resultBuffer, RESULT_BUFFER_SIZE, _T("Duration: %d ms\n"), lround(record.duration * 1000));
+				writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+			} else {
+				returnValue = 3;
+
+				if (record.returnValue != 0)
+					_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, record.errorText);
+				else
+					_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate state text array\n"));
+			}
+		} else
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, record.errorText);
+	}
+
+	if (IS_ERROR_MSG_SET)
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+	if (state != NULL)
+		SecureZeroMemory(state, stateSize);
+
+	releaseArena(&arena);
+
+	return returnValue;
+}
+
+/*
+ * The HMAC key of the password of a salt sweep. It is prepared once and used for the salts of all lines.
+ * The native engines keep the hash states after the pads of SHA-1 and SHA-256, the portable engine the ones of all hash types.
+ */
+typedef struct {
+	BOOLEAN isPrepared;
+	NATIVE_HASH nativeHash;           // NATIVE_HASH_NONE if the hash type is calculated with the portable engine
+	NATIVE_HMAC_KEY nativeKey;
+	PORTABLE_HMAC_KEY portableKey;
+	int digestSize;
+} SWEEP_KEY;
+
+/*
+ * The parameters of a salt sweep that are the same for all lines
+ */
+typedef struct {
+	const TCHAR* hashTypeText;
+	const TCHAR* iterationCountText;  // Iteration count of the lines that do not have their own
+	const TCHAR* password;
+	BOOLEAN doItRight;
+	int requestedKeySize;
+	OUTPUT_FORMAT outputFormat;
+	DERIVATION_ENGINE engine;
+	SWEEP_KEY key;
+	ARENA arena;
+	DERIVATION_RECORD* derivations;   // One derivation per line of a group
+} SWEEP_CONTEXT;
+
+/*
+ * Prepare the HMAC key of the password of a record, unless it has already been prepared.
+ * The password is the same for all records of a sweep, so the key of the first record serves all of them.
+ * The native engines prepare the hash types they support, all other hash types are prepared by the portable engine.
+ */
+void prepareSweepKey(SWEEP_KEY* const pKey, const DERIVATION_RECORD* const pRecord, const DERIVATION_ENGINE engine) {
+	if (pKey->isPrepared)
+		return;
+
+	pKey->nativeHash = (engine == ENGINE_PORTABLE) ? NATIVE_HASH_NONE : NATIVE_HASH_OF_HASH_TYPE[pRecord->hashType];
+
+	if (pKey->nativeHash != NATIVE_HASH_NONE) {
+		nativePrepareHmacKey(&pKey->nativeKey, pKey->nativeHash, pRecord->passwordBytes, (ULONG)pRecord->passwordBytesSize);
+
+		pKey->digestSize = nativeGetDigestSize(pKey->nativeHash);
+	} else {
+		const PORTABLE_HASH hash = PORTABLE_HASH_OF_HASH_TYPE[pRecord->hashType];
+
+		portablePrepareHmacKey(&pKey->portableKey, hash, pRecord->passwordBytes, (ULONG)pRecord->passwordBytesSize);
+
+		pKey->digestSize = portableGetDigestSize(hash);
+	}
+
+	pKey->isPrepared = TRUE;
+}
+
+/*
+ * Release the HMAC key of a salt sweep
+ */
+void releaseSweepKey(SWEEP_KEY* const pKey) {
+	SecureZeroMemory(&pKey->nativeKey, sizeof(pKey->nativeKey));
+	SecureZeroMemory(&pKey->portableKey, sizeof(pKey->portableKey));
+
+	pKey->isPrepared = FALSE;
+}
+
+/*
+ * Derive the key of a record with the HMAC key of the password that the portable engine has prepared
+ */
+void deriveRecordWithPortableKey(DERIVATION_RECORD* const pRecord, const SWEEP_KEY* const pKey) {
+	pRecord->derivedKeySize = (pRecord->requestedKeySize > 0) ? pRecord->requestedKeySize : pKey->digestSize;
+	pRecord->derivedKey = (TOCTET*)allocateFromArena(pRecord->pArena, pRecord->derivedKeySize);
+
+	if (pRecord->derivedKey == NULL) {
+		_stprintf_s(pRecord->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate %d bytes for hash value\n"), pRecord->derivedKeySize);
+
+		pRecord->returnValue = 3;
+		return;
+	}
+
+	portablePBKDF2WithKey(&pKey->portableKey, pRecord->saltArray, (ULONG)pRecord->saltArraySize, (ULONG)pRecord->iterationCount, pRecord->derivedKey, (ULONG)pRecord->derivedKeySize);
+}
+
+/*
+ * Derive the keys of consecutive records with the prepared HMAC key of the password.
+ * CNG and the GPU engine key each derivation themselves, so they derive the records like in batch mode.
+ * With the SIMD engine records with the same iteration count are derived together, and each one is assigned an equal share of the duration.
+ */
+void deriveSweepRecords(DERIVATION_RECORD* const records, const int recordCount, SWEEP_KEY* const pKey, const DERIVATION_ENGINE engine) {
+	if ((engine == ENGINE_CNG) || (engine == ENGINE_GPU)) {
+		deriveRecordsWithEngine(records, recordCount, engine);
+		return;
+	}
+
+	NATIVE_PBKDF2_REQUEST requests[MAX_DERIVATION_GROUP_SIZE];
+	DERIVATION_RECORD* group[MAX_DERIVATION_GROUP_SIZE];
+
+	// The SHA-NI engine derives one record at a time, so that nativePBKDF2WithKey uses its single-stream kernels
+	const int maxGroupSize = (engine == ENGINE_SIMD) ? MAX_DERIVATION_GROUP_SIZE : 1;
+
+	LARGE_INTEGER startTickValue;
+
+	int i = 0;
+
+	while (i < recordCount) {
+		DERIVATION_RECORD* const pRecord = &records[i];
+
+		if (pRecord->returnValue != 0) {
+			i++;
+			continue;
+		}
+
+		prepareSweepKey(pKey, pRecord, engine);
+
+		if (pKey->nativeHash == NATIVE_HASH_NONE) {
+			startTimer(&startTickValue);
+			deriveRecordWithPortableKey(pRecord, pKey);
+			pRecord->duration = getElapsedTime(&startTickValue);
+
+			i++;
+			continue;
+		}
+
+		// Collect the following records with the same iteration count, so that they share the lanes of the multi-buffer kernels
+		int groupSize = 0;
+
+		BOOLEAN isAllocated = TRUE;
+
+		while ((i < recordCount) && (groupSize < maxGroupSize) &&
+				 ((records[i].returnValue != 0) || (records[i].iterationCount == pRecord->iterationCount))) {
+			DERIVATION_RECORD* const pMember = &records[i];
+
+			i++;
+
+			if (pMember->returnValue != 0)
+				continue;
+
+			pMember->derivedKeySize = (pMember->requestedKeySize > 0) ? pMember->requestedKeySize : pKey->digestSize;
+			pMember->derivedKey = (TOCTET*)allocateFromArena(pMember->pArena, pMember->derivedKeySize);
+
+			isAllocated = isAllocated && (pMember->derivedKey != NULL);
+
+			requests[groupSize].password = NULL;
+			requests[groupSize].passwordSize = 0;
+			requests[groupSize].salt = pMember->saltArray;
+			requests[groupSize].saltSize = (ULONG)pMember->saltArraySize;
+			requests[groupSize].derivedKey = pMember->derivedKey;
+			requests[groupSize].derivedKeySize = (ULONG)pMember->derivedKeySize;
+
+			group[groupSize] = pMember;
+			groupSize++;
+		}
+
+		startTimer(&startTickValue);
+
+		const BOOLEAN isDerived = isAllocated && nativePBKDF2WithKey(&pKey->nativeKey, (ULONG)pRecord->iterationCount, requests, groupSize);
+
+		const double duration = getElapsedTime(&startTickValue) / groupSize;
+
+		for (int j = 0; j < groupSize; j++) {
+			group[j]->duration = duration;
+
+			if (!isDerived) {
+				_stprintf_s(group[j]->errorText, ERROR_BUFFER_SIZE, _T("Could not allocate memory for the native engine\n"));
+				group[j]->returnValue = 3;
+			}
+		}
+	}
+}
+
+/*
+ * Process a group of consecutive lines of a salt sweep and store the result line or the error message in each record.
+ * A line is "salt" or "salt,iterationCount". The buffers of the group are taken from the arena, which is reset when the group is done.
+ */
+void processSweepRecordGroup(BATCH_RECORD* const records, const int recordCount, SWEEP_CONTEXT* const pContext) {
+	DERIVATION_RECORD* const derivations = pContext->derivations;
+
+	for (int i = 0; i < recordCount; i++) {
+		const BOOLEAN isLineTooLong = (records[i].lineSize > MAX_BATCH_LINE_SIZE);
+
+		if (isLineTooLong)
+			*records[i].recordText = _T('\0');
+		else if (records[i].pLine != NULL)
+			convertMappedLine(&records[i]);
+
+		TCHAR* const saltText = records[i].recordText;
+		const TCHAR* iterationCountText = splitBatchField(saltText);
+
+		if (iterationCountText == NULL)
+			iterationCountText = pContext->iterationCountText;
+
+		if (isLineTooLong) {
+			initializeRecord(&derivations[i], &pContext->arena, pContext->password, pContext->doItRight);
+
+			_stprintf_s(derivations[i].errorText, ERROR_BUFFER_SIZE, _T("Line is longer than %d characters\n"), MAX_BATCH_LINE_SIZE);
+
+			derivations[i].returnValue = 2;
+		} else
+			prepareRecord(&derivations[i], &pContext->arena, NULL, pContext->hashTypeText, saltText, iterationCountText, pContext->password, CP_ACP, pContext->doItRight, pContext->requestedKeySize, MAX_ITERATION_COUNT);
+	}
+
+	deriveSweepRecords(derivations, recordCount, &pContext->key, pContext->engine);
+
+	for (int i = 0; i < recordCount; i++) {
+		BATCH_RECORD* const pRecord = &records[i];
+		DERIVATION_RECORD* const pDerivation = &derivations[i];
+
+		if (pDerivation->returnValue == 0)
+			pRecord->resultSize = formatRecordResult(pDerivation, pContext->outputFormat, pRecord->resultText, RESULT_BUFFER_SIZE);
+
+		if (pDerivation->returnValue != 0)
+			_stprintf_s(pRecord->resultText, RESULT_BUFFER_SIZE, _T("Line %d: %s"), pRecord->lineNumber, pDerivation->errorText);
+
+		pRecord->returnValue = pDerivation->returnValue;
+		pRecord->duration = pDerivation->duration;
+	}
+
+	resetArena(&pContext->arena);
+}
+
+/*
+ * Derive the keys of one password with many salts that are read from a file or from stdin.
+ * With the native and the portable engines the HMAC key of the password is prepared only once, so that each salt only pays for its iterations.
+ * All results are written, the errors are written to the error output, and finally a summary is written.
+ * The return value is the exit code of the program. It is the exit code of the first line with an error.
+ */
+int processSaltSweep(const TCHAR* const saltFileName,
+							const TCHAR* const hashTypeText,
+							const TCHAR* const iterationCountText,
+							const TCHAR* const password,
+							const BOOLEAN doItRight,
+							const int requestedKeySize,
+							const DERIVATION_ENGINE engine,
+							const OUTPUT_FORMAT outputFormat,
+							const HANDLE outputHandle,
+							const BOOLEAN isOutputRedirected,
+							const HANDLE errorHandle,
+							const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	FILE* saltFile = NULL;
+
+	MAPPED_BATCH_FILE mappedFile;
+
+	mappedFile.fileHandle = INVALID_HANDLE_VALUE;
+	mappedFile.mappingHandle = NULL;
+	mappedFile.pView = NULL;
+	mappedFile.pRetiredView = NULL;
+
+	BATCH_RECORD* records = NULL;
+	OUTPUT_WRITER* pOutputWriter = NULL;
+	SWEEP_CONTEXT* pContext = (SWEEP_CONTEXT*)calloc(1, sizeof(SWEEP_CONTEXT));
+
+	if (pContext == NULL) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate salt sweep buffers\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		return 3;
+	}
+
+	initializeArena(&pContext->arena);
+
+	// The hash type is checked once, so that a wrong one is not reported for every line
+	getIntegerArg(_T("hashType"), hashTypeText, MIN_HASH_TYPE, MAX_HASH_TYPE, errorBuffer, ERROR_BUFFER_SIZE);
+
+	if (IS_ERROR_MSG_SET) {
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 2;
+		goto Exit;
+	}
+
+	if (_tcscmp(saltFileName, BATCH_STDIN_NAME) == 0)
+		saltFile = stdin;
+	else
+		if (!openMappedBatchFile(&mappedFile, saltFileName)) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not open salt file \"%s\"\n"), saltFileName);
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+			returnValue = 4;
+			goto Exit;
+		}
+
+	records = (BATCH_RECORD*)malloc(BATCH_CHUNK_SIZE * sizeof(BATCH_RECORD));
+	pOutputWriter = (OUTPUT_WRITER*)malloc(sizeof(OUTPUT_WRITER));
+	pContext->derivations = (DERIVATION_RECORD*)malloc(MAX_DERIVATION_GROUP_SIZE * sizeof(DERIVATION_RECORD));
+
+	if ((records == NULL) || (pOutputWriter == NULL) || (pContext->derivations == NULL)) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate salt sweep buffers\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 3;
+		goto Exit;
+	}
+
+	initializeOutputWriter(pOutputWriter, outputHandle, isOutputRedirected);
+
+	pContext->hashTypeText = hashTypeText;
+	pContext->iterationCountText = iterationCountText;
+	pContext->password = password;
+	pContext->doItRight = doItRight;
+	pContext->requestedKeySize = requestedKeySize;
+	pContext->outputFormat = outputFormat;
+	pContext->engine = engine;
+	pContext->key.nativeHash = NATIVE_HASH_NONE;
+
+	int lineNumber = 0;
+	int saltCount = 0;
+	int errorCount = 0;
+	int recordCount;
+
+	double totalDuration = 0.0;
+
+	LARGE_INTEGER sweepStartTickValue;
+
+	startTimer(&sweepStartTickValue);
+
+	while ((recordCount = (saltFile != NULL) ? readBatchChunk(saltFile, records, &lineNumber) : readMappedBatchChunk(&mappedFile, records, &lineNumber)) > 0) {
+		for (int groupStart = 0; groupStart < recordCount; groupStart += MAX_DERIVATION_GROUP_SIZE)
+			processSweepRecordGroup(&records[groupStart], min(MAX_DERIVATION_GROUP_SIZE, recordCount - groupStart), pContext);
+
+		// Write the results in input order
+		for (int i = 0; i < recordCount; i++) {
+			BATCH_RECORD* const pRecord = &records[i];
+
+			if (pRecord->returnValue == 0)
+				writeOutputBytes(pOutputWriter, pRecord->resultText, pRecord->resultSize);
+			else {
+				// In the binary format a line with an error has a key size of 0, so that the results still correspond to the lines
+				if (outputFormat == OUTPUT_FORMAT_BINARY)
+					writeOutputBytes(pOutputWriter, EMPTY_BINARY_RESULT, BINARY_KEY_SIZE_SIZE);
+
+				flushOutputWriter(pOutputWriter);
+
+				writeBuffer(errorHandle, isErrorRedirected, pRecord->resultText);
+
+				errorCount++;
+
+				if (returnValue == 0)
+					returnValue = pRecord->returnValue;
+			}
+
+			totalDuration += pRecord->duration;
+		}
+
+		saltCount += recordCount;
+	}
+
+	double elapsedTime = getElapsedTime(&sweepStartTickValue);
+
+	if ((saltFile == NULL) && mappedFile.isMappingFailed) {
+		flushOutputWriter(pOutputWriter);
+
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Error %d returned by %s\n"), GetLastError(), _T("MapViewOfFile"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		returnValue = 4;
+	}
+
+	_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Salts: %d, Errors: %d, Duration: %d ms, Elapsed: %d ms\n"), saltCount, errorCount, lround(totalDuration * 1000), lround(elapsedTime * 1000));
+
+	// The summary is text, so it is not mixed into binary results
+	if (outputFormat == OUTPUT_FORMAT_BINARY) {
+		flushOutputWriter(pOutputWriter);
+
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	} else {
+		writeOutput(pOutputWriter, errorBuffer);
+
+		flushOutputWriter(pOutputWriter);
+	}
+
+Exit:
+	releaseSweepKey(&pContext->key);
+	releaseArena(&pContext->arena);
+
+	if (pContext->derivations != NULL)
+		free((void*)pContext->derivations);
+
+	free((void*)pContext);
+
+	if (records != NULL)
+		free((void*)records);
+
+	if (pOutputWriter != NULL)
+		free((void*)pOutputWriter);
+
+	if (saltFile == NULL)
+		closeMappedBatchFile(&mappedFile);
+
+	return returnValue;
+}
+
+/*
+ * Write the usage information
+ */
+void writeUsage(const HANDLE errorHandle, const BOOLEAN isErrorRedirected) {
+	static const TCHAR* const USAGE_TEXT[] = {
+		_T("Usage: pbkdf2 [--dklen <keySize>] [--engine <engine>] [--format <format>] [--profile on] [--cache <file>] <hashType> <salt> <iterationCount> <password> [doItRight]\n"),
+		_T("       pbkdf2 --verify <expectedKey> [--engine <engine>] <hashType> <salt> <iterationCount> <password> [doItRight]\n"),
+		_T("       pbkdf2 --compare <engine> [--dklen <keySize>] [--engine <engine>] [--format <format>] <hashType> <salt> <iterationCount> <password> [doItRight]\n"),
+		_T("       pbkdf2 --checkpoint <file> [--max-iterations <count>] [--dklen <keySize>] [--format <format>] <hashType> <salt> <iterationCount> <password> [doItRight]\n"),
+		_T("       pbkdf2 --state on [--dklen <keySize>] [--format <format>] <hashType> <salt> <iterationCount> <password> [doItRight]\n"),
+		_T("       pbkdf2 --extend <state> [--dklen <keySize>] [--format <format>] <hashType> <salt> <additionalIterations> <password> [doItRight]\n"),
+		_T("       pbkdf2 --salts <saltFile> [--dklen <keySize>] [--engine <engine>] [--format <format>] <hashType> <iterationCount> <password> [doItRight]\n"),
+		_T("       pbkdf2 --batch <file> [--threads <threadCount>] [--dklen <keySize>] [--engine <engine>] [--format <format>] [--profile on] [--cache <file>]\n"),
+		_T("              [--input-encoding <inputEncoding>] [doItRight]\n"),
+		_T("       pbkdf2 --verify-batch <file> [--threads <threadCount>] [--engine <engine>] [--profile on] [--input-encoding <inputEncoding>] [doItRight]\n"),
+		_T("       pbkdf2 --server <pipeName> [--threads <threadCount>] [--dklen <keySize>] [--engine <engine>] [--format <format>]\n"),
+		_T("              [--input-encoding <inputEncoding>] [--cpu-budget <budget>] [--max-concurrent <concurrentCount>]\n"),
+		_T("              [--latency-target <latencyTarget>] [doItRight]\n"),
+		_T("       pbkdf2 --bench <repetitions> [--warmup <count>] [--iterations <list>]\n"),
+		_T("              [--password-sizes <list>] [--salt-sizes <list>] [--engine <engine>] [--profile on]\n"),
+		_T("       pbkdf2 --grid <repetitions> [--warmup <count>] [--iterations <list>] [--threads <threadCount>]\n"),
+		_T("              [--engine <engine>] [--grid-format <gridFormat>] <password>\n"),
+		_T("       pbkdf2 --scaling <repetitions> [--warmup <count>] [--threads <threadCount>] [--pinning <pinning>]\n"),
+		_T("              [--engine <engine>] <hashType> <iterationCount>\n"),
+		_T("       pbkdf2 --calibrate <targetTime> <hashType> [--engine <engine>]\n"),
+		_T("       hashType: 1=SHA-1, 2=SHA-256, 3=SHA384, 5=SHA512\n"),
+		_T("       doItRight: If present the salt is interpreted as a byte array and\n"),
+		_T("                  the password is converted to UTF-8 before hashing\n"),
+		_T("                  Otherwise the salt is interpreted as an integer and\n"),
+		_T("                  the password is used in the ANSI or UTF-16 encoding\n"),
+		_T("       file: File with one \"hashType,salt,iterationCount,password\" record per line\n"),
+		_T("             or \"-\" to read the records from stdin\n"),
+		_T("             With --verify-batch each record is \"hashType,salt,iterationCount,expectedKey,password\"\n"),
+		_T("       saltFile: File with one \"salt\" or \"salt,iterationCount\" line per derivation of the password or \"-\" for stdin,\n"),
+		_T("                 the HMAC key of the password is prepared only once for all salts\n"),
+		_T("       inputEncoding: ansi=Records in the Windows character set like the command line (default), utf8=Records in UTF-8,\n"),
+		_T("                      whose passwords are used without conversion in the ANSI build\n"),
+		_T("       expectedKey: Hex string of the key that the derived key is compared with, blanks are ignored\n"),
+		_T("       pipeName: Name of the named pipe with the requests \"derive,<record>\" and \"verify,<record>\",\n"),
+		_T("                 \"\\\\.\\pipe\\\" is added if the name does not start with it\n"),
+		_T("       budget: Percentage of the time of all logical processors that the server derivations may use (default 100)\n"),
+		_T("       concurrentCount: Maximum number of server derivations at the same time (default threadCount)\n"),
+		_T("       latencyTarget: Time in milliseconds that a server request may wait for its derivation before it is shed\n"),
+		_T("       threadCount: Number of worker threads in batch, server, grid and scaling mode (default 1, 0=one per logical processor)\n"),
+		_T("       keySize: Size of the derived key in bytes (default size of the hash value)\n"),
+		_T("       engine: cng=CNG BCryptDeriveKeyPBKDF2 (default), simd=Multi-buffer SIMD engine for SHA-1 and SHA-256,\n"),
+		_T("               shani=Single-stream engine with the SHA extensions for SHA-1 and SHA-256,\n"),
+		_T("               portable=Portable reference engine,\n"),
+		_T("               gpu=Direct3D 11 compute shader engine for batches with SHA-1 and SHA-256\n"),
+		_T("       --compare: Derive the key with both engines at the same time and compare the keys and durations\n"),
+		_T("       --checkpoint: Derive the key with the portable engine and save its state in the file every 10 seconds and on Ctrl+C,\n"),
+		_T("                     an existing file is resumed\n"),
+		_T("       --max-iterations: Highest allowed iteration count with --checkpoint (default 5000000)\n"),
+		_T("       --state on: Derive the key with the portable engine and write the chain state that --extend needs\n"),
+		_T("       state: Hex string of the chain state of a derived key, blanks are ignored\n"),
+		_T("       additionalIterations: Number of iterations that are added to the iteration count of the state\n"),
+		_T("       format: hex=Hex bytes separated by blanks (default), compact=Hex bytes without blanks,\n"),
+		_T("               base64=Base64, phc=PHC string with hash type, iteration count, salt and key,\n"),
+		_T("               binary=Key size and key as bytes, only if the output is redirected\n"),
+		_T("       --cache: Take the derived keys from the cache file and store new ones in it, also with --verify, --verify-batch and --server\n"),
+		_T("       --cache-size: Number of entries of a new cache file (default 65536)\n"),
+		_T("       --profile on: Write the durations of the phases parsing, encoding, derivation and output\n"),
+		_T("       repetitions: Number of measured derivations per benchmark combination\n"),
+		_T("       count: Number of warm-up derivations per benchmark combination (default 1)\n"),
+		_T("       list: Comma separated values (default iterations 1000,10000,100000, sizes 16)\n"),
+		_T("       --grid: Measure all hash types and iteration counts with the password in both encodings on threads\n"),
+		_T("               that are pinned to their own core, and write the matrix\n"),
+		_T("       gridFormat: csv=Comma separated values with a header line (default), json=JSON object\n"),
+		_T("       --scaling: Measure the throughput with 1, 2, 4 ... threads up to threadCount (default one per logical processor)\n"),
+		_T("       pinning: spread=One thread per core first, then the SMT siblings (default), compact=The logical processors\n"),
+		_T("                of a core after each other, off=No pinning\n"),
+		_T("       targetTime: Duration of one derivation in milliseconds that the iteration count is calibrated to\n")
+	};
+
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+
+	for (int i = 0; i < (int)(sizeof(USAGE_TEXT) / sizeof(USAGE_TEXT[0])); i++) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, USAGE_TEXT[i]);
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	}
+}
+
+/*
+ * Prefix of all options
+ */
+#define OPTION_PREFIX _T("--")
+#define OPTION_PREFIX_SIZE 2
+
+/*
+ * Options
+ */
+#define BATCH_OPTION          _T("--batch")
+#define THREADS_OPTION        _T("--threads")
+#define ENGINE_OPTION         _T("--engine")
+#define BENCH_OPTION          _T("--bench")
+#define WARMUP_OPTION         _T("--warmup")
+#define ITERATIONS_OPTION     _T("--iterations")
+#define PASSWORD_SIZES_OPTION _T("--password-sizes")
+#define SALT_SIZES_OPTION     _T("--salt-sizes")
+#define CALIBRATE_OPTION      _T("--calibrate")
+#define DKLEN_OPTION          _T("--dklen")
+#define VERIFY_OPTION         _T("--verify")
+#define VERIFY_BATCH_OPTION   _T("--verify-batch")
+#define FORMAT_OPTION         _T("--format")
+#define SERVER_OPTION         _T("--server")
+#define PROFILE_OPTION        _T("--profile")
+#define COMPARE_OPTION        _T("--compare")
+#define CHECKPOINT_OPTION     _T("--checkpoint")
+#define MAX_ITERATIONS_OPTION _T("--max-iterations")
+#define STATE_OPTION          _T("--state")
+#define EXTEND_OPTION         _T("--extend")
+#define CACHE_OPTION          _T("--cache")
+#define CACHE_SIZE_OPTION     _T("--cache-size")
+#define SALTS_OPTION          _T("--salts")
+#define GRID_OPTION           _T("--grid")
+#define GRID_FORMAT_OPTION    _T("--grid-format")
+#define SCALING_OPTION        _T("--scaling")
+#define PINNING_OPTION        _T("--pinning")
+#define INPUT_ENCODING_OPTION _T("--input-encoding")
+#define CPU_BUDGET_OPTION     _T("--cpu-budget")
+#define MAX_CONCURRENT_OPTION _T("--max-concurrent")
+#define LATENCY_TARGET_OPTION _T("--latency-target")
+
+/*
+ * Limits and default of the number of entries of a new result cache file
+ */
+#define MIN_CACHE_ENTRY_COUNT     CACHE_WAY_COUNT
+#define MAX_CACHE_ENTRY_COUNT     1048576
+#define DEFAULT_CACHE_ENTRY_COUNT 65536
+
+/*
+ * Names of the engines for the engine option
+ */
+#define ENGINE_NAME_CNG   _T("cng")
+#define ENGINE_NAME_SIMD  _T("simd")
+#define ENGINE_NAME_SHANI _T("shani")
+#define ENGINE_NAME_PORTABLE _T("portable")
+#define ENGINE_NAME_GPU   _T("gpu")
+
+/*
+ * Values of the profile and state options
+ */
+#define PROFILE_VALUE_ON  _T("on")
+#define PROFILE_VALUE_OFF _T("off")
+
+/*
+ * Names of the output formats for the format option
+ */
+#define FORMAT_NAME_HEX     _T("hex")
+#define FORMAT_NAME_COMPACT _T("compact")
+#define FORMAT_NAME_BASE64  _T("base64")
+#define FORMAT_NAME_PHC     _T("phc")
+#define FORMAT_NAME_BINARY  _T("binary")
+
+/*
+ * Names of the matrix formats of the parameter grid
+ */
+#define GRID_FORMAT_NAME_CSV  _T("csv")
+#define GRID_FORMAT_NAME_JSON _T("json")
+
+/*
+ * Names of the encodings of the records for the input encoding option
+ */
+#define INPUT_ENCODING_NAME_ANSI _T("ansi")
+#define INPUT_ENCODING_NAME_UTF8 _T("utf8")
+
+/*
+ * Options of the program
+ */
+typedef struct {
+	const TCHAR* batchFileName;   // NULL if the program is not in batch mode
+	const TCHAR* pipeName;        // NULL if the program is not in server mode
+	int threadCount;
+	BOOLEAN isThreadCountSet;     // The thread count has been given, otherwise the scaling benchmark uses all logical processors
+	int derivedKeySize;           // 0 means the size of the hash value
+	DERIVATION_ENGINE engine;
+	OUTPUT_FORMAT outputFormat;
+	BOOLEAN isProfiled;           // The durations of the processing phases are measured and written
+	BOOLEAN isCompared;           // The key of a single record is also derived with compareEngine
+	DERIVATION_ENGINE compareEngine;
+	const TCHAR* checkpointFileName;  // NULL if the key is not derived with checkpoints
+	int maxIterationCount;
+	BOOLEAN isStateWritten;       // The key is derived with the portable engine and its chain state is written
+	TCHAR* extendStateText;       // NULL if no chain state is extended
+	const TCHAR* cacheFileName;   // NULL if no result cache is used
+	int cacheEntryCount;          // Number of entries of a new result cache file
+	const TCHAR* saltFileName;    // NULL if the program does not sweep over the salts of a file
+	BENCH_SETTINGS bench;
+	int gridRepetitionCount;      // 0 if the program is not in parameter grid mode
+	GRID_FORMAT gridFormat;
+	int scalingRepetitionCount;   // 0 if the program is not in scaling benchmark mode
+	PINNING pinning;
+	UINT inputCodePage;           // Code page of the records of batch files and server requests
+	SCHEDULER_SETTINGS scheduler;
+	int calibrationTarget;        // 0 if the program is not in calibration mode
+	TCHAR* expectedKeyText;       // NULL if the derived key of a single record is not verified
+	BOOLEAN isBatchVerify;        // The batch file contains expected keys
+} PROGRAM_OPTIONS;
+
+/*
+ * Get the value of an option, i.e. the argument that follows the option
+ */
+TCHAR* getOptionValue(const int argc, TCHAR* const argv[], int* const pArgIndex, TCHAR* const errorBuffer, const int errorBufferSize) {
+	const TCHAR* const optionName = argv[*pArgIndex];
+
+	(*pArgIndex)++;
+
+	if (*pArgIndex < argc)
+		return argv[*pArgIndex];
+	else {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Option \"%s\" needs a value\n"), optionName);
+
+		return NULL;
+	}
+}
+
+/*
+ * Get the engine of an engine name
+ */
+void parseEngineName(const TCHAR* const engineName, DERIVATION_ENGINE* const pEngine, TCHAR* const errorBuffer, const int errorBufferSize) {
+	if (_tcsicmp(engineName, ENGINE_NAME_CNG) == 0)
+		*pEngine = ENGINE_CNG;
+	else if (_tcsicmp(engineName, ENGINE_NAME_SIMD) == 0)
+		*pEngine = ENGINE_SIMD;
+	else if (_tcsicmp(engineName, ENGINE_NAME_SHANI) == 0)
+		*pEngine = ENGINE_SHANI;
+	else if (_tcsicmp(engineName, ENGINE_NAME_PORTABLE) == 0)
+		*pEngine = ENGINE_PORTABLE;
+	else if (_tcsicmp(engineName, ENGINE_NAME_GPU) == 0)
+		*pEngine = ENGINE_GPU;
+	else
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown engine \"%s\"\n"), engineName);
+}
+
+/*
+ * Separate the options from the positional arguments. The positional arguments are returned
+ * in positionalArgs, which must have room for argc entries.
+ */
+void parseOptions(const int argc,
+						TCHAR* const argv[],
+						PROGRAM_OPTIONS* const pOptions,
+						TCHAR** const positionalArgs,
+						int* const pPositionalArgCount,
+						TCHAR* const errorBuffer,
+						const int errorBufferSize) {
+	RESET_ERROR_MSG;
+
+	pOptions->batchFileName = NULL;
+	pOptions->pipeName = NULL;
+	pOptions->threadCount = 1;
+	pOptions->isThreadCountSet = FALSE;
+	pOptions->derivedKeySize = 0;
+	pOptions->engine = ENGINE_CNG;
+	pOptions->outputFormat = OUTPUT_FORMAT_HEX;
+	pOptions->isProfiled = FALSE;
+	pOptions->isCompared = FALSE;
+	pOptions->compareEngine = ENGINE_PORTABLE;
+	pOptions->checkpointFileName = NULL;
+	pOptions->maxIterationCount = MAX_ITERATION_COUNT;
+	pOptions->isStateWritten = FALSE;
+	pOptions->extendStateText = NULL;
+	pOptions->cacheFileName = NULL;
+	pOptions->cacheEntryCount = DEFAULT_CACHE_ENTRY_COUNT;
+	pOptions->saltFileName = NULL;
+
+	pOptions->bench.repetitionCount = 0;
+	pOptions->bench.warmupCount = 1;
+	pOptions->bench.iterationCounts.value[0] = 1000;
+	pOptions->bench.iterationCounts.value[1] = 10000;
+	pOptions->bench.iterationCounts.value[2] = 100000;
+	pOptions->bench.iterationCounts.count = 3;
+	pOptions->bench.passwordSizes.value[0] = 16;
+	pOptions->bench.passwordSizes.count = 1;
+	pOptions->bench.saltSizes.value[0] = 16;
+	pOptions->bench.saltSizes.count = 1;
+
+	pOptions->gridRepetitionCount = 0;
+	pOptions->gridFormat = GRID_FORMAT_CSV;
+
+	pOptions->scalingRepetitionCount = 0;
+	pOptions->pinning = PINNING_SPREAD;
+
+	pOptions->inputCodePage = CP_ACP;
+
+	pOptions->scheduler.cpuBudget = MAX_CPU_BUDGET;
+	pOptions->scheduler.maxConcurrentCount = 0;
+	pOptions->scheduler.latencyTarget = 0;
+
+	pOptions->calibrationTarget = 0;
+
+	pOptions->expectedKeyText = NULL;
+	pOptions->isBatchVerify = FALSE;
+
+	*pPositionalArgCount = 0;
+
+	for (int argIndex = 1; (argIndex < argc) && IS_ERROR_MSG_NOT_SET; argIndex++) {
+		TCHAR* const arg = argv[argIndex];
+
+		if (_tcsncmp(arg, OPTION_PREFIX, OPTION_PREFIX_SIZE) == 0) {
+			TCHAR* const optionValue = getOptionValue(argc, argv, &argIndex, errorBuffer, errorBufferSize);
+
+			if (optionValue != NULL) {
+				if (_tcscmp(arg, BATCH_OPTION) == 0)
+					pOptions->batchFileName = optionValue;
+				else if (_tcscmp(arg, SERVER_OPTION) == 0)
+					pOptions->pipeName = optionValue;
+				else if (_tcscmp(arg, THREADS_OPTION) == 0) {
+					pOptions->threadCount = getIntegerArg(_T("threadCount"), optionValue, MIN_THREAD_COUNT, MAX_THREAD_COUNT, errorBuffer, errorBufferSize);
+
+					if (pOptions->threadCount == 0)
+						pOptions->threadCount = min((int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS), MAX_THREAD_COUNT);
+
+					pOptions->isThreadCountSet = TRUE;
+				} else if (_tcscmp(arg, ENGINE_OPTION) == 0)
+					parseEngineName(optionValue, &pOptions->engine, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, COMPARE_OPTION) == 0) {
+					parseEngineName(optionValue, &pOptions->compareEngine, errorBuffer, errorBufferSize);
+
+					pOptions->isCompared = TRUE;
+				} else if (_tcscmp(arg, CHECKPOINT_OPTION) == 0)
+					pOptions->checkpointFileName = optionValue;
+				else if (_tcscmp(arg, MAX_ITERATIONS_OPTION) == 0)
+					pOptions->maxIterationCount = getIntegerArg(_T("count"), optionValue, MIN_ITERATION_COUNT, MAX_CHECKPOINT_ITERATION_COUNT, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, STATE_OPTION) == 0) {
+					if (_tcsicmp(optionValue, PROFILE_VALUE_ON) == 0)
+						pOptions->isStateWritten = TRUE;
+					else if (_tcsicmp(optionValue, PROFILE_VALUE_OFF) == 0)
+						pOptions->isStateWritten = FALSE;
+					else
+						_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown state value \"%s\"\n"), optionValue);
+				} else if (_tcscmp(arg, EXTEND_OPTION) == 0)
+					pOptions->extendStateText = optionValue;
+				else if (_tcscmp(arg, CACHE_OPTION) == 0)
+					pOptions->cacheFileName = optionValue;
+				else if (_tcscmp(arg, CACHE_SIZE_OPTION) == 0)
+					pOptions->cacheEntryCount = getIntegerArg(_T("entryCount"), optionValue, MIN_CACHE_ENTRY_COUNT, MAX_CACHE_ENTRY_COUNT, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, SALTS_OPTION) == 0)
+					pOptions->saltFileName = optionValue;
+				else if (_tcscmp(arg, FORMAT_OPTION) == 0) {
+					if (_tcsicmp(optionValue, FORMAT_NAME_HEX) == 0)
+						pOptions->outputFormat = OUTPUT_FORMAT_HEX;
+					else if (_tcsicmp(optionValue, FORMAT_NAME_COMPACT) == 0)
+						pOptions->outputFormat = OUTPUT_FORMAT_COMPACT;
+					else if (_tcsicmp(optionValue, FORMAT_NAME_BASE64) == 0)
+						pOptions->outputFormat = OUTPUT_FORMAT_BASE64;
+					else if (_tcsicmp(optionValue, FORMAT_NAME_PHC) == 0)
+						pOptions->outputFormat = OUTPUT_FORMAT_PHC;
+					else if (_tcsicmp(optionValue, FORMAT_NAME_BINARY) == 0)
+						pOptions->outputFormat = OUTPUT_FORMAT_BINARY;
+					else
+						_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown format \"%s\"\n"), optionValue);
+				} else if (_tcscmp(arg, PROFILE_OPTION) == 0) {
+					if (_tcsicmp(optionValue, PROFILE_VALUE_ON) == 0)
+						pOptions->isProfiled = TRUE;
+					else if (_tcsicmp(optionValue, PROFILE_VALUE_OFF) == 0)
+						pOptions->isProfiled = FALSE;
+					else
+						_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown profile value \"%s\"\n"), optionValue);
+				} else if (_tcscmp(arg, BENCH_OPTION) == 0)
+					pOptions->bench.repetitionCount = getIntegerArg(_T("repetitions"), optionValue, MIN_REPETITION_COUNT, MAX_REPETITION_COUNT, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, GRID_OPTION) == 0)
+					pOptions->gridRepetitionCount = getIntegerArg(_T("repetitions"), optionValue, MIN_REPETITION_COUNT, MAX_REPETITION_COUNT, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, GRID_FORMAT_OPTION) == 0) {
+					if (_tcsicmp(optionValue, GRID_FORMAT_NAME_CSV) == 0)
+						pOptions->gridFormat = GRID_FORMAT_CSV;
+					else if (_tcsicmp(optionValue, GRID_FORMAT_NAME_JSON) == 0)
+						pOptions->gridFormat = GRID_FORMAT_JSON;
+					else
+						_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown grid format \"%s\"\n"), optionValue);
+				} else if (_tcscmp(arg, SCALING_OPTION) == 0)
+					pOptions->scalingRepetitionCount = getIntegerArg(_T("repetitions"), optionValue, MIN_REPETITION_COUNT, MAX_REPETITION_COUNT, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, PINNING_OPTION) == 0) {
+					if (_tcsicmp(optionValue, PINNING_NAME[PINNING_SPREAD]) == 0)
+						pOptions->pinning = PINNING_SPREAD;
+					else if (_tcsicmp(optionValue, PINNING_NAME[PINNING_COMPACT]) == 0)
+						pOptions->pinning = PINNING_COMPACT;
+					else if (_tcsicmp(optionValue, PINNING_NAME[PINNING_OFF]) == 0)
+						pOptions->pinning = PINNING_OFF;
+					else
+						_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown pinning \"%s\"\n"), optionValue);
+				} else if (_tcscmp(arg, INPUT_ENCODING_OPTION) == 0) {
+					if (_tcsicmp(optionValue, INPUT_ENCODING_NAME_ANSI) == 0)
+						pOptions->inputCodePage = CP_ACP;
+					else if (_tcsicmp(optionValue, INPUT_ENCODING_NAME_UTF8) == 0)
+						pOptions->inputCodePage = CP_UTF8;
+					else
+						_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown input encoding \"%s\"\n"), optionValue);
+				} else if (_tcscmp(arg, CPU_BUDGET_OPTION) == 0)
+					pOptions->scheduler.cpuBudget = getIntegerArg(_T("budget"), optionValue, MIN_CPU_BUDGET, MAX_CPU_BUDGET, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, MAX_CONCURRENT_OPTION) == 0)
+					pOptions->scheduler.maxConcurrentCount = getIntegerArg(_T("concurrentCount"), optionValue, MIN_THREAD_COUNT, MAX_THREAD_COUNT, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, LATENCY_TARGET_OPTION) == 0)
+					pOptions->scheduler.latencyTarget = getIntegerArg(_T("latencyTarget"), optionValue, MIN_LATENCY_TARGET, MAX_LATENCY_TARGET, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, WARMUP_OPTION) == 0)
+					pOptions->bench.warmupCount = getIntegerArg(_T("count"), optionValue, MIN_WARMUP_COUNT, MAX_WARMUP_COUNT, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, ITERATIONS_OPTION) == 0)
+					parseIntegerList(_T("iterations"), optionValue, MIN_ITERATION_COUNT, MAX_ITERATION_COUNT, &pOptions->bench.iterationCounts, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, PASSWORD_SIZES_OPTION) == 0)
+					parseIntegerList(_T("password-sizes"), optionValue, MIN_BENCH_PASSWORD_SIZE, MAX_BENCH_PASSWORD_SIZE, &pOptions->bench.passwordSizes, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, SALT_SIZES_OPTION) == 0)
+					parseIntegerList(_T("salt-sizes"), optionValue, MIN_BENCH_SALT_SIZE, MAX_BENCH_SALT_SIZE, &pOptions->bench.saltSizes, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, DKLEN_OPTION) == 0)
+					pOptions->derivedKeySize = getIntegerArg(_T("keySize"), optionValue, MIN_DERIVED_KEY_SIZE, MAX_DERIVED_KEY_SIZE, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, CALIBRATE_OPTION) == 0)
+					pOptions->calibrationTarget = getIntegerArg(_T("targetTime"), optionValue, MIN_CALIBRATION_TARGET, MAX_CALIBRATION_TARGET, errorBuffer, errorBufferSize);
+				else if (_tcscmp(arg, VERIFY_OPTION) == 0)
+					pOptions->expectedKeyText = optionValue;
+				else if (_tcscmp(arg, VERIFY_BATCH_OPTION) == 0) {
+					pOptions->batchFileName = optionValue;
+					pOptions->isBatchVerify = TRUE;
+				} else
+					_stprintf_s(errorBuffer, errorBufferSize, _T("Unknown option \"%s\"\n"), arg);
+			}
+		} else {
+			positionalArgs[*pPositionalArgCount] = arg;
+			(*pPositionalArgCount)++;
+		}
+	}
+}
+
+/*
+ * Check that the selected native or GPU engine can be used on this computer and yields the same results as CNG.
+ * If it can not be used a warning is written and CNG is used instead. The portable engine can always be used.
+ */
+void checkEngine(DERIVATION_ENGINE* const pEngine, const HANDLE errorHandle, const BOOLEAN isErrorRedirected) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];
+
+	if ((*pEngine != ENGINE_CNG) && (*pEngine != ENGINE_PORTABLE)) {
+		const DERIVATION_ENGINE engine = *pEngine;
+		const BOOLEAN isSupported = (engine == ENGINE_SIMD) ? (nativeGetMultiBufferLaneCount() > 0) : ((engine == ENGINE_GPU) ? gpuIsAvailable() : nativeIsShaNiSupported());
+
+		if (isSupported) {
+
+			if (!validateNativeEngine(engine, errorBuffer, ERROR_BUFFER_SIZE)) {
+				writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+				*pEngine = ENGINE_CNG;
+			}
+
+		} else
+			*pEngine = ENGINE_CNG;
+
+		if (*pEngine == ENGINE_CNG) {
+			_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("%s engine can not be used, falling back to CNG\n"), ENGINE_DISPLAY_NAME[engine]);
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+		}
+	}
+}
+
+/*
+ * The main program
+ */
+int _tmain(const int argc, TCHAR* const argv[]) {
+	TCHAR errorBuffer[ERROR_BUFFER_SIZE + 1];  // Bloody stupid null termination character
+	TCHAR resultBuffer[RESULT_BUFFER_SIZE + 1];
+
+	int returnValue = 0;
+
+	HANDLE outputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+	HANDLE errorHandle = GetStdHandle(STD_ERROR_HANDLE);
+
+	BOOLEAN isOutputRedirected = isHandleRedirected(outputHandle);
+	BOOLEAN isErrorRedirected = isHandleRedirected(errorHandle);
+
+	PROGRAM_OPTIONS options;
+
+	TCHAR** positionalArgs = (TCHAR**)malloc(argc * sizeof(TCHAR*));
+	int positionalArgCount;
+
+	if (positionalArgs == NULL) {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Could not allocate argument array\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		return 3;
+	}
+
+	// The derivation events are only written while a trace session listens to the provider
+	TraceLoggingRegister(traceProvider);
+
+	parseOptions(argc, argv, &options, positionalArgs, &positionalArgCount, errorBuffer, ERROR_BUFFER_SIZE);
+
+	// Binary results can not be written to the console
+	if (IS_ERROR_MSG_NOT_SET && (options.outputFormat == OUTPUT_FORMAT_BINARY) && !isOutputRedirected && (options.pipeName == NULL))
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The binary format needs an output that is redirected to a file\n"));
+
+	// A comparison is only made for a single record with a text result
+	if (IS_ERROR_MSG_NOT_SET && options.isCompared) {
+		if ((options.batchFileName != NULL) || (options.pipeName != NULL) || (options.bench.repetitionCount > 0) || (options.calibrationTarget > 0) || (options.expectedKeyText != NULL))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The comparison can only be used for a single record that is not verified\n"));
+		else if (options.outputFormat == OUTPUT_FORMAT_BINARY)
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The comparison can not be written in the binary format\n"));
+	}
+
+	// Checkpoints are only written for a single record, and only they allow a different iteration count limit
+	if (IS_ERROR_MSG_NOT_SET) {
+		if ((options.checkpointFileName != NULL) && ((options.batchFileName != NULL) || (options.pipeName != NULL) || (options.bench.repetitionCount > 0) || (options.calibrationTarget > 0) || (options.expectedKeyText != NULL) || options.isCompared))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Checkpoints can only be used for a single record that is not verified or compared\n"));
+		else if ((options.checkpointFileName == NULL) && (options.maxIterationCount != MAX_ITERATION_COUNT))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The iteration count limit can only be changed with checkpoints\n"));
+	}
+
+	// The chain state is only written for a single record as text
+	if (IS_ERROR_MSG_NOT_SET && (options.isStateWritten || (options.extendStateText != NULL))) {
+		if ((options.batchFileName != NULL) || (options.pipeName != NULL) || (options.bench.repetitionCount > 0) || (options.calibrationTarget > 0) || (options.expectedKeyText != NULL) || options.isCompared || (options.checkpointFileName != NULL))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The chain state can only be used for a single record that is not verified, compared or checkpointed\n"));
+		else if (options.outputFormat == OUTPUT_FORMAT_BINARY)
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The chain state can not be written in the binary format\n"));
+	}
+
+	// Cached keys would falsify measurements and comparisons, and the other modes do not derive their keys in one piece
+	if (IS_ERROR_MSG_NOT_SET) {
+		if ((options.cacheFileName != NULL) && ((options.bench.repetitionCount > 0) || (options.calibrationTarget > 0) || options.isCompared || (options.checkpointFileName != NULL) || options.isStateWritten || (options.extendStateText != NULL)))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The result cache can only be used for single records, batches and the server\n"));
+		else if ((options.cacheFileName == NULL) && (options.cacheEntryCount != DEFAULT_CACHE_ENTRY_COUNT))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The cache size can only be set with a cache file\n"));
+	}
+
+	// The keys of the salt sweep are not cached because they are derived with the prepared key of the password
+	if (IS_ERROR_MSG_NOT_SET && (options.saltFileName != NULL) &&
+		 ((options.batchFileName != NULL) || (options.pipeName != NULL) || (options.bench.repetitionCount > 0) || (options.calibrationTarget > 0) || (options.expectedKeyText != NULL) || options.isCompared || (options.checkpointFileName != NULL) || options.isStateWritten || (options.extendStateText != NULL) || (options.cacheFileName != NULL)))
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The salt sweep can not be combined with other modes or the result cache\n"));
+
+	// The parameter grid is a benchmark of its own that writes a matrix instead of results
+	if (IS_ERROR_MSG_NOT_SET) {
+		if ((options.gridRepetitionCount > 0) && ((options.batchFileName != NULL) || (options.pipeName != NULL) || (options.bench.repetitionCount > 0) || (options.calibrationTarget > 0) || (options.expectedKeyText != NULL) || options.isCompared || (options.checkpointFileName != NULL) || options.isStateWritten || (options.extendStateText != NULL) || (options.cacheFileName != NULL) || (options.saltFileName != NULL) || options.isProfiled))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The parameter grid can not be combined with other modes, the result cache or the profile\n"));
+		else if ((options.gridRepetitionCount == 0) && (options.gridFormat != GRID_FORMAT_CSV))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The grid format can only be set for the parameter grid\n"));
+	}
+
+	// The scaling benchmark measures the derivations itself, so it can not be combined with other modes
+	if (IS_ERROR_MSG_NOT_SET) {
+		if ((options.scalingRepetitionCount > 0) && ((options.batchFileName != NULL) || (options.pipeName != NULL) || (options.bench.repetitionCount > 0) || (options.gridRepetitionCount > 0) || (options.calibrationTarget > 0) || (options.expectedKeyText != NULL) || options.isCompared || (options.checkpointFileName != NULL) || options.isStateWritten || (options.extendStateText != NULL) || (options.cacheFileName != NULL) || (options.saltFileName != NULL) || options.isProfiled))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The scaling benchmark can not be combined with other modes, the result cache or the profile\n"));
+		else if ((options.scalingRepetitionCount == 0) && (options.pinning != PINNING_SPREAD))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The pinning can only be set for the scaling benchmark\n"));
+	}
+
+	// Only the records of batch files and server requests are read as text, all other passwords come from the command line
+	if (IS_ERROR_MSG_NOT_SET && (options.inputCodePage != CP_ACP)) {
+		if ((options.batchFileName == NULL) && (options.pipeName == NULL))
+			_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The input encoding can only be set for batches and the server\n"));
+		else
+			inputCodePage = options.inputCodePage;
+	}
+
+	// Only the requests of the server compete for the processors
+	if (IS_ERROR_MSG_NOT_SET && isSchedulerUsed(&options.scheduler) && (options.pipeName == NULL))
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("The CPU budget, the concurrency cap and the latency target can only be set for the server\n"));
+
+	if (IS_ERROR_MSG_NOT_SET) {
+		checkEngine(&options.engine, errorHandle, isErrorRedirected);
+
+		if (options.isCompared)
+			checkEngine(&options.compareEngine, errorHandle, isErrorRedirected);
+	}
+
+	RESULT_CACHE resultCache;
+
+	const BOOLEAN isCacheOpened = IS_ERROR_MSG_NOT_SET && (options.cacheFileName != NULL);
+
+	if (isCacheOpened && ((returnValue = cacheOpen(&resultCache, options.cacheFileName, options.cacheEntryCount, errorBuffer, ERROR_BUFFER_SIZE)) == 0))
+		pResultCache = &resultCache;
+
+	if (returnValue != 0) {
+		// The result cache could not be opened
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	} else if (IS_ERROR_MSG_SET) {
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		writeUsage(errorHandle, isErrorRedirected);
+
+		returnValue = 1;
+	} else if ((options.scalingRepetitionCount > 0) && (positionalArgCount >= 2)) {
+		BENCH_SETTINGS scalingSettings = options.bench;
+
+		scalingSettings.repetitionCount = options.scalingRepetitionCount;
+
+		// Without a thread count the levels go up to all logical processors
+		const int maxThreadCount = options.isThreadCountSet ? options.threadCount : min((int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS), MAX_THREAD_COUNT);
+
+		returnValue = processScaling(ARGV_HASH_TYPE, positionalArgs[1], &scalingSettings, maxThreadCount, options.pinning, options.engine, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if ((options.gridRepetitionCount > 0) && (positionalArgCount >= 1)) {
+		BENCH_SETTINGS gridSettings = options.bench;
+
+		gridSettings.repetitionCount = options.gridRepetitionCount;
+
+		returnValue = processGrid(&gridSettings, positionalArgs[0], options.threadCount, options.engine, options.gridFormat, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if (options.bench.repetitionCount > 0) {
+		returnValue = processBenchmark(&options.bench, options.engine, options.isProfiled, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if ((options.calibrationTarget > 0) && (positionalArgCount >= 1)) {
+		returnValue = processCalibration(ARGV_HASH_TYPE, options.calibrationTarget, options.engine, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if (options.pipeName != NULL) {
+		//Should I do it right or not?
+		BOOLEAN doItRight = (positionalArgCount >= 1);
+
+		returnValue = processServer(options.pipeName, doItRight, options.derivedKeySize, options.threadCount, options.engine, options.outputFormat, &options.scheduler, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if (options.batchFileName != NULL) {
+		//Should I do it right or not?
+		BOOLEAN doItRight = (positionalArgCount >= 1);
+
+		returnValue = processBatch(options.batchFileName, doItRight, options.derivedKeySize, options.isBatchVerify, options.threadCount, options.engine, options.outputFormat, options.isProfiled, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if ((options.saltFileName != NULL) && (positionalArgCount >= 3)) {
+		//Should I do it right or not?
+		BOOLEAN doItRight = (positionalArgCount >= 4);
+
+		returnValue = processSaltSweep(options.saltFileName, SWEEP_ARGV_HASH_TYPE, SWEEP_ARGV_ITERATION_COUNT, SWEEP_ARGV_PASSWORD, doItRight, options.derivedKeySize, options.engine, options.outputFormat, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if ((options.isStateWritten || (options.extendStateText != NULL)) && (positionalArgCount >= 4)) {
+		//Should I do it right or not?
+		BOOLEAN doItRight = (positionalArgCount >= 5);
+
+		returnValue = processStateRecord(ARGV_HASH_TYPE, ARGV_SALT, ARGV_ITERATION_COUNT, ARGV_PASSWORD, doItRight, options.derivedKeySize, options.extendStateText, options.outputFormat, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if ((options.checkpointFileName != NULL) && (positionalArgCount >= 4)) {
+		//Should I do it right or not?
+		BOOLEAN doItRight = (positionalArgCount >= 5);
+
+		returnValue = processCheckpointedRecord(ARGV_HASH_TYPE, ARGV_SALT, ARGV_ITERATION_COUNT, ARGV_PASSWORD, doItRight, options.derivedKeySize, options.maxIterationCount, options.checkpointFileName, options.outputFormat, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if (options.isCompared && (positionalArgCount >= 4)) {
+		//Should I do it right or not?
+		BOOLEAN doItRight = (positionalArgCount >= 5);
+
+		returnValue = processComparison(ARGV_HASH_TYPE, ARGV_SALT, ARGV_ITERATION_COUNT, ARGV_PASSWORD, doItRight, options.derivedKeySize, options.engine, options.compareEngine, options.outputFormat, outputHandle, isOutputRedirected, errorHandle, isErrorRedirected);
+	} else if (positionalArgCount >= 4) {
+		//Should I do it right or not?
+		BOOLEAN doItRight = (positionalArgCount >= 5);
+
+		PHASE_PROFILE profile;
+
+		initializePhaseProfile(&profile);
+
+		PHASE_PROFILE* const pProfile = options.isProfiled ? &profile : NULL;
+
+		double duration = 0.0;
+
+		int resultSize;
+
+		returnValue = processRecord(ARGV_HASH_TYPE, ARGV_SALT, ARGV_ITERATION_COUNT, ARGV_PASSWORD, doItRight, options.derivedKeySize, options.expectedKeyText, options.engine, options.outputFormat, pProfile, resultBuffer, RESULT_BUFFER_SIZE, &resultSize, &duration, errorBuffer, ERROR_BUFFER_SIZE);
+
+		// A failed verification is not an error, so its result is printed, too
+		if ((returnValue == 0) || (returnValue == 5)) {
+			LARGE_INTEGER startTickValue;
+
+			// Print the parameters and the result
+			startPhase(pProfile, &startTickValue);
+
+			if (options.outputFormat == OUTPUT_FORMAT_BINARY)
+				writeBytes(outputHandle, resultBuffer, resultSize);
+			else
+				writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+			endPhase(pProfile, PHASE_OUTPUT, &startTickValue);
+
+			// Print the time measurement. It is text, so it is not mixed into a binary result.
+			_stprintf_s(resultBuffer, ERROR_BUFFER_SIZE, _T("Duration: %d ms\n"), lround(duration * 1000));
+
+			if (options.outputFormat == OUTPUT_FORMAT_BINARY) {
+				writeBuffer(errorHandle, isErrorRedirected, resultBuffer);
+
+				if (options.isProfiled)
+					writePhaseProfile(&profile, errorHandle, isErrorRedirected);
+			} else {
+				writeBuffer(outputHandle, isOutputRedirected, resultBuffer);
+
+				if (options.isProfiled)
+					writePhaseProfile(&profile, outputHandle, isOutputRedirected);
+			}
+		} else
+			writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+	} else {
+		_tcscpy_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Not enough arguments\n"));
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		writeUsage(errorHandle, isErrorRedirected);
+
+		returnValue = 1;
+	}
+
+	free((void*)positionalArgs);
+
+	// The statistics go to the error output, so that the results are the same with and without the cache
+	if (pResultCache != NULL) {
+		_stprintf_s(errorBuffer, ERROR_BUFFER_SIZE, _T("Cache: Hits: %ld, Misses: %ld\n"), pResultCache->hitCount, pResultCache->missCount);
+		writeBuffer(errorHandle, isErrorRedirected, errorBuffer);
+
+		pResultCache = NULL;
+	}
+
+	if (isCacheOpened)
+		cacheClose(&resultCache);
+
+	gpuRelease();
 
-	if (releaseSalt != NULL)
-		free((void*)releaseSalt);
+	pbkdf2_release();
 
-	if (releaseDerivedKey != NULL)
-		free((void*)releaseDerivedKey);
+	TraceLoggingUnregister(traceProvider);
 
 	return returnValue;
 }
@@ -0,0 +1,246 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Library interface to derive and verify PBKDF2 keys in caller-provided buffers
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Api.h"
+
+#include <bcrypt.h>
+
+/*
+ * DEFINES
+ */
+#define NT_SUCCESS(Status) ((NTSTATUS)(Status) >= 0)
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * Number of hash types
+ */
+#define HASH_TYPE_COUNT (PBKDF2_MAX_HASH_TYPE - PBKDF2_MIN_HASH_TYPE + 1)
+
+/*
+ * Algorithms of the hash types, indexed by the hash type minus PBKDF2_MIN_HASH_TYPE
+ */
+static const LPCWSTR PROVIDER_ALGORITHM[HASH_TYPE_COUNT] = { BCRYPT_SHA1_ALGORITHM, BCRYPT_SHA256_ALGORITHM, BCRYPT_SHA384_ALGORITHM, BCRYPT_SHA512_ALGORITHM, BCRYPT_SHA512_ALGORITHM };
+
+/*
+ * VARIABLES
+ */
+
+/*
+ * The shared HMAC algorithm providers. An algorithm handle may be used by several threads at the same time,
+ * so each provider is opened once by the first thread that needs it. A provider that could not be opened
+ * leaves its initialization incomplete, so that the next call tries again.
+ */
+static INIT_ONCE providerInitOnce[HASH_TYPE_COUNT] = { INIT_ONCE_STATIC_INIT, INIT_ONCE_STATIC_INIT, INIT_ONCE_STATIC_INIT, INIT_ONCE_STATIC_INIT, INIT_ONCE_STATIC_INIT };
+static BCRYPT_ALG_HANDLE providerHandle[HASH_TYPE_COUNT] = { NULL, NULL, NULL, NULL, NULL };
+static ULONG providerHashSize[HASH_TYPE_COUNT] = { 0, 0, 0, 0, 0 };
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+
+/*
+ * Open the algorithm provider of the index that is the parameter and get its hash size
+ */
+static BOOL CALLBACK openProvider(PINIT_ONCE pInitOnce, PVOID parameter, PVOID* pContext) {
+	UNREFERENCED_PARAMETER(pInitOnce);
+	UNREFERENCED_PARAMETER(pContext);
+
+	const int index = (int)(INT_PTR)parameter;
+
+	BCRYPT_ALG_HANDLE handle = NULL;
+
+	ULONG outputSize;
+
+	if (!NT_SUCCESS(BCryptOpenAlgorithmProvider(&handle, PROVIDER_ALGORITHM[index], NULL, BCRYPT_ALG_HANDLE_HMAC_FLAG)))
+		return FALSE;
+
+	if (!NT_SUCCESS(BCryptGetProperty(handle, BCRYPT_HASH_LENGTH, (PUCHAR)&providerHashSize[index], (ULONG)sizeof(ULONG), &outputSize, (ULONG)0))) {
+		BCryptCloseAlgorithmProvider(handle, (ULONG)0);
+
+		return FALSE;
+	}
+
+	providerHandle[index] = handle;
+
+	return TRUE;
+}
+
+/*
+ * Get the shared algorithm provider of a valid hash type. Returns NULL if it could not be opened.
+ */
+static BCRYPT_ALG_HANDLE getProvider(const int hashType) {
+	const int index = hashType - PBKDF2_MIN_HASH_TYPE;
+
+	if (!InitOnceExecuteOnce(&providerInitOnce[index], openProvider, (PVOID)(INT_PTR)index, NULL))
+		return NULL;
+
+	return providerHandle[index];
+}
+
+/*
+ * Check the arguments that pbkdf2_derive and pbkdf2_verify have in common
+ */
+static PBKDF2_RESULT checkArguments(const int hashType,
+												const TOCTET* const password,
+												const ULONG passwordSize,
+												const TOCTET* const salt,
+												const ULONG saltSize,
+												const ULONG iterationCount,
+												const TOCTET* const derivedKey,
+												const ULONG derivedKeySize) {
+	if ((hashType < PBKDF2_MIN_HASH_TYPE) || (hashType > PBKDF2_MAX_HASH_TYPE))
+		return PBKDF2_ERROR_HASH_TYPE;
+
+	if (iterationCount == 0)
+		return PBKDF2_ERROR_ITERATION_COUNT;
+
+	if (((password == NULL) && (passwordSize > 0)) || ((salt == NULL) && (saltSize > 0)) || (derivedKey == NULL) || (derivedKeySize == 0))
+		return PBKDF2_ERROR_ARGUMENT;
+
+	return PBKDF2_OK;
+}
+
+/*
+ * Derive a key with valid arguments
+ */
+static PBKDF2_RESULT deriveKey(const int hashType,
+										 const TOCTET* const password,
+										 const ULONG passwordSize,
+										 const TOCTET* const salt,
+										 const ULONG saltSize,
+										 const ULONG iterationCount,
+										 TOCTET* const derivedKey,
+										 const ULONG derivedKeySize) {
+	const BCRYPT_ALG_HANDLE handle = getProvider(hashType);
+
+	if (handle == NULL)
+		return PBKDF2_ERROR_PROVIDER;
+
+	if (!NT_SUCCESS(BCryptDeriveKeyPBKDF2(handle, (PUCHAR)password, passwordSize, (PUCHAR)salt, saltSize, (ULONGLONG)iterationCount, derivedKey, derivedKeySize, (ULONG)0)))
+		return PBKDF2_ERROR_DERIVATION;
+
+	return PBKDF2_OK;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+/*
+ * Derive a key of derivedKeySize bytes from a password and a salt into the buffer derivedKey
+ */
+PBKDF2_RESULT pbkdf2_derive(const int hashType,
+									 const TOCTET* const password,
+									 const ULONG passwordSize,
+									 const TOCTET* const salt,
+									 const ULONG saltSize,
+									 const ULONG iterationCount,
+									 TOCTET* const derivedKey,
+									 const ULONG derivedKeySize) {
+	const PBKDF2_RESULT result = checkArguments(hashType, password, passwordSize, salt, saltSize, iterationCount, derivedKey, derivedKeySize);
+
+	if (result != PBKDF2_OK)
+		return result;
+
+	return deriveKey(hashType, password, passwordSize, salt, saltSize, iterationCount, derivedKey, derivedKeySize);
+}
+
+/*
+ * Derive a key of expectedKeySize bytes and compare it with the expected key in constant time.
+ * The workBuffer must have room for expectedKeySize bytes. It is cleared before the function returns.
+ */
+PBKDF2_RESULT pbkdf2_verify(const int hashType,
+									 const TOCTET* const password,
+									 const ULONG passwordSize,
+									 const TOCTET* const salt,
+									 const ULONG saltSize,
+									 const ULONG iterationCount,
+									 const TOCTET* const expectedKey,
+									 const ULONG expectedKeySize,
+									 TOCTET* const workBuffer) {
+	PBKDF2_RESULT result = checkArguments(hashType, password, passwordSize, salt, saltSize, iterationCount, workBuffer, expectedKeySize);
+
+	if ((result == PBKDF2_OK) && (expectedKey == NULL))
+		result = PBKDF2_ERROR_ARGUMENT;
+
+	if (result != PBKDF2_OK)
+		return result;
+
+	result = deriveKey(hashType, password, passwordSize, salt, saltSize, iterationCount, workBuffer, expectedKeySize);
+
+	if ((result == PBKDF2_OK) && !pbkdf2_is_equal(workBuffer, expectedKey, expectedKeySize))
+		result = PBKDF2_MISMATCH;
+
+	SecureZeroMemory(workBuffer, expectedKeySize);
+
+	return result;
+}
+
+/*
+ * Get the size of the hash value of a hash type, which is the default size of a derived key
+ */
+ULONG pbkdf2_get_hash_size(const int hashType) {
+	if ((hashType < PBKDF2_MIN_HASH_TYPE) || (hashType > PBKDF2_MAX_HASH_TYPE) || (getProvider(hashType) == NULL))
+		return 0;
+
+	return providerHashSize[hashType - PBKDF2_MIN_HASH_TYPE];
+}
+
+/*
+ * Compare two byte arrays in a time that only depends on their size and not on their contents
+ */
+BOOLEAN pbkdf2_is_equal(const TOCTET* const left, const TOCTET* const right, const ULONG size) {
+	volatile TOCTET difference = 0;
+
+	for (ULONG i = 0; i < size; i++)
+		difference |= left[i] ^ right[i];
+
+	return (difference == 0);
+}
+
+/*
+ * Close the algorithm providers
+ */
+void pbkdf2_release(void) {
+	for (int i = 0; i < HASH_TYPE_COUNT; i++)
+		if (providerHandle[i] != NULL) {
+			BCryptCloseAlgorithmProvider(providerHandle[i], (ULONG)0);
+
+			providerHandle[i] = NULL;
+			providerHashSize[i] = 0;
+
+			InitOnceInitialize(&providerInitOnce[i]);
+		}
+}
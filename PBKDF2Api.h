@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.1
+*
+* Library interface to derive and verify PBKDF2 keys in caller-provided buffers
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.0.1: Define TOCTET without the header of the native engine
+*/
+
+#pragma once
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * Range of the hash types. They have the same numbers as on the command line: 1=SHA-1, 2=SHA-256, 3=SHA-384, 5=SHA-512.
+ * Hash type 4 is SHA-512, too.
+ */
+#define PBKDF2_MIN_HASH_TYPE 1
+#define PBKDF2_MAX_HASH_TYPE 5
+
+/*
+ * TYPES
+ */
+
+/*
+ * TOCTET is a data type that defines 8 binary bits and is *not* a character.
+ * It is defined here, too, so that the library interface does not need the headers of the engines.
+ */
+#ifndef PBKDF2_TOCTET_DEFINED
+#define PBKDF2_TOCTET_DEFINED
+typedef UCHAR TOCTET;
+#endif
+
+/*
+ * Results of the library functions
+ */
+typedef enum {
+	PBKDF2_OK = 0,
+	PBKDF2_ERROR_ARGUMENT,         // A buffer is NULL or the size of the derived key is 0
+	PBKDF2_ERROR_HASH_TYPE,        // The hash type is not between PBKDF2_MIN_HASH_TYPE and PBKDF2_MAX_HASH_TYPE
+	PBKDF2_ERROR_ITERATION_COUNT,  // The iteration count is 0
+	PBKDF2_ERROR_PROVIDER,         // The algorithm provider of the hash type could not be opened
+	PBKDF2_ERROR_DERIVATION,       // BCryptDeriveKeyPBKDF2 failed
+	PBKDF2_MISMATCH                // The derived key differs from the expected key
+} PBKDF2_RESULT;
+
+/*
+ * FUNCTIONS
+ *
+ * All functions may be called by several threads at the same time, except pbkdf2_release.
+ * They do not allocate memory. The algorithm providers are opened on first use and shared by all threads.
+ * The password and the salt may be NULL if their size is 0.
+ */
+
+/*
+ * Derive a key of derivedKeySize bytes from a password and a salt into the buffer derivedKey
+ */
+PBKDF2_RESULT pbkdf2_derive(const int hashType,
+									 const TOCTET* const password,
+									 const ULONG passwordSize,
+									 const TOCTET* const salt,
+									 const ULONG saltSize,
+									 const ULONG iterationCount,
+									 TOCTET* const derivedKey,
+									 const ULONG derivedKeySize);
+
+/*
+ * Derive a key of expectedKeySize bytes and compare it with the expected key in constant time.
+ * The workBuffer must have room for expectedKeySize bytes. It is cleared before the function returns.
+ * Returns PBKDF2_OK if the keys are equal and PBKDF2_MISMATCH if they are not.
+ */
+PBKDF2_RESULT pbkdf2_verify(const int hashType,
+									 const TOCTET* const password,
+									 const ULONG passwordSize,
+									 const TOCTET* const salt,
+									 const ULONG saltSize,
+									 const ULONG iterationCount,
+									 const TOCTET* const expectedKey,
+									 const ULONG expectedKeySize,
+									 TOCTET* const workBuffer);
+
+/*
+ * Get the size of the hash value of a hash type, which is the default size of a derived key.
+ * Returns 0 if the hash type is invalid or its algorithm provider could not be opened.
+ */
+ULONG pbkdf2_get_hash_size(const int hashType);
+
+/*
+ * Compare two byte arrays in a time that only depends on their size and not on their contents,
+ * so that the time does not reveal how many leading bytes of a guessed key are correct
+ */
+BOOLEAN pbkdf2_is_equal(const TOCTET* const left, const TOCTET* const right, const ULONG size);
+
+/*
+ * Close the algorithm providers. No other function of the library may be running while this is called.
+ * The providers are opened again by the next call.
+ */
+void pbkdf2_release(void);
@@ -0,0 +1,194 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.1.0
+*
+* Conversion of byte arrays into Base64 strings and back
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.1.0: Conversion of Base64 strings into bytes
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Base64.h"
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * The Base64 alphabet of RFC 4648
+ */
+static const TCHAR BASE64_DIGITS[] = _T("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+
+/*
+ * Padding character for the last group of characters
+ */
+#define BASE64_PADDING _T('=')
+
+/*
+ * Value of a character that is not a Base64 character
+ */
+#define BASE64_INVALID 0xff
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+
+/*
+ * Get the value of a Base64 character. Returns BASE64_INVALID if it is not a Base64 character.
+ */
+static TOCTET getBase64Value(const TCHAR base64Char) {
+	if ((base64Char >= _T('A')) && (base64Char <= _T('Z')))
+		return (TOCTET)(base64Char - _T('A'));
+
+	if ((base64Char >= _T('a')) && (base64Char <= _T('z')))
+		return (TOCTET)(base64Char - _T('a') + 26);
+
+	if ((base64Char >= _T('0')) && (base64Char <= _T('9')))
+		return (TOCTET)(base64Char - _T('0') + 52);
+
+	if (base64Char == _T('+'))
+		return 62;
+
+	if (base64Char == _T('/'))
+		return 63;
+
+	return BASE64_INVALID;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+/*
+ * Get the size of the Base64 string of byteCount bytes
+ */
+int base64GetEncodedSize(const int byteCount, const BOOLEAN hasPadding) {
+	if (hasPadding)
+		return ((byteCount + 2) / 3) << 2;
+	else
+		return ((byteCount << 2) + 2) / 3;
+}
+
+/*
+ * Convert bytes into a Base64 string. Each group of 3 bytes yields 4 characters.
+ */
+void base64Encode(const TOCTET* const bytes, const int byteCount, TCHAR* const text, const BOOLEAN hasPadding) {
+	TCHAR* pActChar = text;
+
+	int i = 0;
+
+	for (; i + 3 <= byteCount; i += 3) {
+		const DWORD group = ((DWORD)bytes[i] << 16) | ((DWORD)bytes[i + 1] << 8) | bytes[i + 2];
+
+		pActChar[0] = BASE64_DIGITS[group >> 18];
+		pActChar[1] = BASE64_DIGITS[(group >> 12) & 0x3f];
+		pActChar[2] = BASE64_DIGITS[(group >> 6) & 0x3f];
+		pActChar[3] = BASE64_DIGITS[group & 0x3f];
+
+		pActChar += 4;
+	}
+
+	// The last 1 or 2 bytes yield 2 or 3 characters
+	const int remainingCount = byteCount - i;
+
+	if (remainingCount > 0) {
+		const DWORD group = ((DWORD)bytes[i] << 16) | ((remainingCount > 1) ? ((DWORD)bytes[i + 1] << 8) : 0);
+
+		pActChar[0] = BASE64_DIGITS[group >> 18];
+		pActChar[1] = BASE64_DIGITS[(group >> 12) & 0x3f];
+
+		if (remainingCount > 1)
+			pActChar[2] = BASE64_DIGITS[(group >> 6) & 0x3f];
+		else if (hasPadding)
+			pActChar[2] = BASE64_PADDING;
+
+		pActChar += (remainingCount > 1) ? 3 : (hasPadding ? 3 : 2);
+
+		if (hasPadding) {
+			*pActChar = BASE64_PADDING;
+			pActChar++;
+		}
+	}
+
+	*pActChar = _T('\0');
+}
+
+/*
+ * Convert a Base64 string into bytes. Each group of 4 characters yields 3 bytes.
+ */
+int base64Decode(const TCHAR* const text, const int textSize, TOCTET* const bytes, int* const pByteCount) {
+	int dataSize = textSize;
+
+	// A padded string has a size that is a multiple of 4 and ends with up to 2 padding characters
+	if (((textSize & 3) == 0) && (textSize > 0) && (text[textSize - 1] == BASE64_PADDING)) {
+		dataSize--;
+
+		if (text[dataSize - 1] == BASE64_PADDING)
+			dataSize--;
+	}
+
+	// A single character in the last group does not yield a byte
+	if ((dataSize & 3) == 1)
+		return dataSize - 1;
+
+	int byteCount = 0;
+
+	DWORD group = 0;
+
+	for (int i = 0; i < dataSize; i++) {
+		const TOCTET value = getBase64Value(text[i]);
+
+		if (value == BASE64_INVALID)
+			return i;
+
+		group = (group << 6) | value;
+
+		if ((i & 3) == 3) {
+			bytes[byteCount] = (TOCTET)(group >> 16);
+			bytes[byteCount + 1] = (TOCTET)(group >> 8);
+			bytes[byteCount + 2] = (TOCTET)group;
+
+			byteCount += 3;
+			group = 0;
+		}
+	}
+
+	// The last 2 or 3 characters yield 1 or 2 bytes
+	const int remainingCount = dataSize & 3;
+
+	if (remainingCount == 2) {
+		bytes[byteCount] = (TOCTET)(group >> 4);
+		byteCount++;
+	} else if (remainingCount == 3) {
+		bytes[byteCount] = (TOCTET)(group >> 10);
+		bytes[byteCount + 1] = (TOCTET)(group >> 2);
+		byteCount += 2;
+	}
+
+	*pByteCount = byteCount;
+
+	return -1;
+}
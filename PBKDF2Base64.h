@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.1.0
+*
+* Conversion of byte arrays into Base64 strings and back
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.1.0: Conversion of Base64 strings into bytes
+*/
+
+#pragma once
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+
+#include <tchar.h>
+
+#include "PBKDF2Native.h"
+
+/*
+ * FUNCTIONS
+ */
+
+/*
+ * Get the number of characters of the Base64 string of byteCount bytes without the null termination character.
+ * Without padding the string does not end with '=' characters.
+ */
+int base64GetEncodedSize(const int byteCount, const BOOLEAN hasPadding);
+
+/*
+ * Convert bytes into a Base64 string with the standard alphabet of RFC 4648 that is padded with '=' if hasPadding is set.
+ * The text buffer must have room for base64GetEncodedSize + 1 characters.
+ */
+void base64Encode(const TOCTET* const bytes, const int byteCount, TCHAR* const text, const BOOLEAN hasPadding);
+
+/*
+ * Convert a Base64 string of textSize characters with the standard alphabet of RFC 4648 into bytes. The padding is optional.
+ * The bytes buffer must have room for textSize * 3 / 4 bytes. The number of bytes is stored in pByteCount.
+ * Returns -1 on success or the position of the first invalid character, starting with 0.
+ */
+int base64Decode(const TCHAR* const text, const int textSize, TOCTET* const bytes, int* const pByteCount);
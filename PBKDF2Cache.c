@@ -0,0 +1,521 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.1.0
+*
+* Memory-mapped cache of derived keys, keyed by a keyed hash of the inputs of the derivation
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.1.0: Keys protected with DPAPI outside of the entries and derived keys encrypted with AES-GCM
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Cache.h"
+
+#include <dpapi.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * DEFINES
+ */
+#define NT_SUCCESS(Status) ((NTSTATUS)(Status) >= 0)
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * Identification of a cache file
+ */
+#define CACHE_MAGIC      "PBKDF2RC"
+#define CACHE_MAGIC_SIZE 8
+#define CACHE_VERSION    2
+
+/*
+ * Number of bytes of an integer in the input of a tag
+ */
+#define TAG_INTEGER_SIZE 4
+
+/*
+ * Size of the keys of a cache file before they are protected: the tag key followed by the encryption key
+ */
+#define CACHE_KEYS_SIZE (CACHE_TAG_SIZE + CACHE_ENCRYPTION_KEY_SIZE)
+
+/*
+ * Description of the protected keys
+ */
+#define PROTECTED_KEY_DESCRIPTION L"PBKDF2 result cache"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+
+/*
+ * Get the size of a cache file with entryCount entries
+ */
+static LONGLONG getCacheFileSize(const UINT32 entryCount) {
+	return (LONGLONG)sizeof(CACHE_HEADER) + (LONGLONG)entryCount * (LONGLONG)sizeof(CACHE_ENTRY);
+}
+
+/*
+ * Map the whole cache file. Returns FALSE if the file can not be mapped.
+ */
+static BOOLEAN mapCacheFile(RESULT_CACHE* const pCache, const LONGLONG fileSize) {
+	pCache->mappingHandle = CreateFileMapping(pCache->fileHandle, NULL, PAGE_READWRITE, (DWORD)(fileSize >> 32), (DWORD)(fileSize & 0xffffffff), NULL);
+
+	if (pCache->mappingHandle == NULL)
+		return FALSE;
+
+	pCache->pHeader = (CACHE_HEADER*)MapViewOfFile(pCache->mappingHandle, FILE_MAP_WRITE, 0, 0, (SIZE_T)fileSize);
+
+	return (pCache->pHeader != NULL);
+}
+
+/*
+ * Hash an integer in big endian byte order, so that the tags do not depend on the byte order of the processor
+ */
+static BOOLEAN hashInteger(const BCRYPT_HASH_HANDLE hashHandle, const int value) {
+	TOCTET bytes[TAG_INTEGER_SIZE];
+
+	bytes[0] = (TOCTET)((UINT32)value >> 24);
+	bytes[1] = (TOCTET)((UINT32)value >> 16);
+	bytes[2] = (TOCTET)((UINT32)value >> 8);
+	bytes[3] = (TOCTET)value;
+
+	return NT_SUCCESS(BCryptHashData(hashHandle, bytes, sizeof(bytes), 0));
+}
+
+/*
+ * Create new random keys of a cache file and store them in its header, protected with DPAPI for the current user.
+ * Returns 0 on success or the return value of the error.
+ */
+static int createCacheKeys(RESULT_CACHE* const pCache, TOCTET* const keys, const TCHAR* const fileName, TCHAR* const errorBuffer, const int errorBufferSize) {
+	NTSTATUS status;
+
+	if (!NT_SUCCESS(status = BCryptGenRandom(NULL, keys, CACHE_KEYS_SIZE, BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Error 0x%x returned by %s\n"), status, _T("BCryptGenRandom"));
+
+		return 3;
+	}
+
+	DATA_BLOB keysBlob;
+	DATA_BLOB protectedBlob;
+
+	keysBlob.pbData = keys;
+	keysBlob.cbData = CACHE_KEYS_SIZE;
+
+	if (!CryptProtectData(&keysBlob, PROTECTED_KEY_DESCRIPTION, NULL, NULL, NULL, CRYPTPROTECT_UI_FORBIDDEN, &protectedBlob)) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not protect the keys of cache file \"%s\": %lu\n"), fileName, GetLastError());
+
+		return 3;
+	}
+
+	int result = 0;
+
+	if (protectedBlob.cbData <= CACHE_MAX_PROTECTED_KEY_SIZE) {
+		memcpy(pCache->pHeader->protectedKey, protectedBlob.pbData, protectedBlob.cbData);
+		pCache->pHeader->protectedKeySize = protectedBlob.cbData;
+	} else {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("The protected keys of cache file \"%s\" are too large\n"), fileName);
+
+		result = 3;
+	}
+
+	LocalFree(protectedBlob.pbData);
+
+	return result;
+}
+
+/*
+ * Get the keys of a cache file from its header.
+ * Returns 0 on success or 4 if the keys have been protected by another user or on another machine.
+ */
+static int unprotectCacheKeys(const RESULT_CACHE* const pCache, TOCTET* const keys, const TCHAR* const fileName, TCHAR* const errorBuffer, const int errorBufferSize) {
+	DATA_BLOB protectedBlob;
+	DATA_BLOB keysBlob;
+
+	protectedBlob.pbData = (BYTE*)pCache->pHeader->protectedKey;
+	protectedBlob.cbData = pCache->pHeader->protectedKeySize;
+
+	if (!CryptUnprotectData(&protectedBlob, NULL, NULL, NULL, NULL, CRYPTPROTECT_UI_FORBIDDEN, &keysBlob)) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("The keys of cache file \"%s\" can not be unprotected by this user: %lu\n"), fileName, GetLastError());
+
+		return 4;
+	}
+
+	int result = 0;
+
+	if (keysBlob.cbData == CACHE_KEYS_SIZE)
+		memcpy(keys, keysBlob.pbData, CACHE_KEYS_SIZE);
+	else {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("\"%s\" is not a cache file of this program\n"), fileName);
+
+		result = 4;
+	}
+
+	SecureZeroMemory(keysBlob.pbData, keysBlob.cbData);
+	LocalFree(keysBlob.pbData);
+
+	return result;
+}
+
+/*
+ * Create the AES-GCM key that encrypts the derived keys of the entries. Returns 0 on success or 3 on an error.
+ */
+static int createEncryptionKey(RESULT_CACHE* const pCache, const TOCTET* const encryptionKey, TCHAR* const errorBuffer, const int errorBufferSize) {
+	NTSTATUS status;
+
+	if (!NT_SUCCESS(status = BCryptOpenAlgorithmProvider(&pCache->aesHandle, BCRYPT_AES_ALGORITHM, NULL, 0))) {
+		pCache->aesHandle = NULL;
+
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Error 0x%x returned by %s\n"), status, _T("BCryptOpenAlgorithmProvider"));
+
+		return 3;
+	}
+
+	if (!NT_SUCCESS(status = BCryptSetProperty(pCache->aesHandle, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM, sizeof(BCRYPT_CHAIN_MODE_GCM), 0))) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Error 0x%x returned by %s\n"), status, _T("BCryptSetProperty"));
+
+		return 3;
+	}
+
+	if (!NT_SUCCESS(status = BCryptGenerateSymmetricKey(pCache->aesHandle, &pCache->encryptionKeyHandle, NULL, 0, (PUCHAR)encryptionKey, CACHE_ENCRYPTION_KEY_SIZE, 0))) {
+		pCache->encryptionKeyHandle = NULL;
+
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Error 0x%x returned by %s\n"), status, _T("BCryptGenerateSymmetricKey"));
+
+		return 3;
+	}
+
+	return 0;
+}
+
+/*
+ * Prepare the authenticated cipher mode information of an entry. The tag of the entry is authenticated with the key,
+ * so that an encrypted key can not be moved to another entry.
+ */
+static void initializeCipherModeInfo(BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO* const pInfo, CACHE_ENTRY* const pEntry, TOCTET* const tag) {
+	BCRYPT_INIT_AUTH_MODE_INFO(*pInfo);
+
+	pInfo->pbNonce = pEntry->nonce;
+	pInfo->cbNonce = CACHE_NONCE_SIZE;
+	pInfo->pbAuthData = tag;
+	pInfo->cbAuthData = CACHE_TAG_SIZE;
+	pInfo->pbTag = pEntry->authenticationTag;
+	pInfo->cbTag = CACHE_AUTHENTICATION_TAG_SIZE;
+}
+
+/*
+ * Get the set of a tag
+ */
+static CACHE_ENTRY* getSet(const RESULT_CACHE* const pCache, const TOCTET* const tag) {
+	UINT32 setIndex;
+
+	memcpy(&setIndex, tag, sizeof(setIndex));
+
+	return &pCache->entries[(setIndex % pCache->setCount) * CACHE_WAY_COUNT];
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+/*
+ * Open a cache file or create it with entryCount entries, rounded up to a multiple of CACHE_WAY_COUNT.
+ * An existing file keeps the number of entries that it has been created with.
+ * The file is opened without sharing, as the entries are not synchronized between processes.
+ * The tag and encryption keys are only kept in the file protected with DPAPI, so that the file alone
+ * can neither be used to test passwords against the tags nor to read the derived keys.
+ * Returns 0 on success, 3 if the keyed hash or the encryption is not available and 4 if the file can not be opened,
+ * is not a cache file or its keys can not be unprotected by the current user.
+ */
+int cacheOpen(RESULT_CACHE* const pCache, const TCHAR* const fileName, const int entryCount, TCHAR* const errorBuffer, const int errorBufferSize) {
+	NTSTATUS status;
+	LARGE_INTEGER fileSize;
+
+	TOCTET keys[CACHE_KEYS_SIZE];
+
+	pCache->fileHandle = INVALID_HANDLE_VALUE;
+	pCache->mappingHandle = NULL;
+	pCache->pHeader = NULL;
+	pCache->entries = NULL;
+	pCache->setCount = 0;
+	pCache->hmacHandle = NULL;
+	pCache->aesHandle = NULL;
+	pCache->encryptionKeyHandle = NULL;
+	pCache->hitCount = 0;
+	pCache->missCount = 0;
+
+	InitializeSRWLock(&pCache->lock);
+
+	if (!NT_SUCCESS(status = BCryptOpenAlgorithmProvider(&pCache->hmacHandle, BCRYPT_SHA256_ALGORITHM, NULL, BCRYPT_ALG_HANDLE_HMAC_FLAG))) {
+		pCache->hmacHandle = NULL;
+
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Error 0x%x returned by %s\n"), status, _T("BCryptOpenAlgorithmProvider"));
+
+		return 3;
+	}
+
+	pCache->fileHandle = CreateFile(fileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (pCache->fileHandle == INVALID_HANDLE_VALUE) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not open cache file \"%s\": %lu\n"), fileName, GetLastError());
+
+		return 4;
+	}
+
+	if (!GetFileSizeEx(pCache->fileHandle, &fileSize)) {
+		_stprintf_s(errorBuffer, errorBufferSize, _T("Could not get the size of cache file \"%s\": %lu\n"), fileName, GetLastError());
+
+		return 4;
+	}
+
+	if (fileSize.QuadPart == 0) {
+		// A new file is enlarged by the mapping and filled with zeros, i.e. all entries are empty
+		const UINT32 newEntryCount = (UINT32)((entryCount + CACHE_WAY_COUNT - 1) / CACHE_WAY_COUNT) * CACHE_WAY_COUNT;
+
+		if (!mapCacheFile(pCache, getCacheFileSize(newEntryCount))) {
+			_stprintf_s(errorBuffer, errorBufferSize, _T("Could not map cache file \"%s\": %lu\n"), fileName, GetLastError());
+
+			return 4;
+		}
+
+		const int result = createCacheKeys(pCache, keys, fileName, errorBuffer, errorBufferSize);
+
+		if (result != 0) {
+			SecureZeroMemory(keys, sizeof(keys));
+
+			return result;
+		}
+
+		memcpy(pCache->pHeader->magic, CACHE_MAGIC, CACHE_MAGIC_SIZE);
+		pCache->pHeader->version = CACHE_VERSION;
+		pCache->pHeader->entryCount = newEntryCount;
+		pCache->pHeader->useCounter = 0;
+	} else {
+		CACHE_HEADER header;
+		DWORD bytesRead = 0;
+
+		const BOOL isRead = ReadFile(pCache->fileHandle, &header, sizeof(header), &bytesRead, NULL);
+
+		if (!isRead || (bytesRead != sizeof(header)) ||
+			 (memcmp(header.magic, CACHE_MAGIC, CACHE_MAGIC_SIZE) != 0) || (header.version != CACHE_VERSION) ||
+			 (header.entryCount == 0) || ((header.entryCount % CACHE_WAY_COUNT) != 0) || (fileSize.QuadPart != getCacheFileSize(header.entryCount)) ||
+			 (header.protectedKeySize == 0) || (header.protectedKeySize > CACHE_MAX_PROTECTED_KEY_SIZE)) {
+			_stprintf_s(errorBuffer, errorBufferSize, _T("\"%s\" is not a cache file of this program\n"), fileName);
+
+			return 4;
+		}
+
+		if (!mapCacheFile(pCache, fileSize.QuadPart)) {
+			_stprintf_s(errorBuffer, errorBufferSize, _T("Could not map cache file \"%s\": %lu\n"), fileName, GetLastError());
+
+			return 4;
+		}
+
+		const int result = unprotectCacheKeys(pCache, keys, fileName, errorBuffer, errorBufferSize);
+
+		if (result != 0)
+			return result;
+	}
+
+	memcpy(pCache->tagKey, keys, CACHE_TAG_SIZE);
+
+	const int result = createEncryptionKey(pCache, &keys[CACHE_TAG_SIZE], errorBuffer, errorBufferSize);
+
+	SecureZeroMemory(keys, sizeof(keys));
+
+	pCache->entries = (CACHE_ENTRY*)(pCache->pHeader + 1);
+	pCache->setCount = pCache->pHeader->entryCount / CACHE_WAY_COUNT;
+
+	return result;
+}
+
+/*
+ * Calculate the tag of the inputs of a derivation. The sizes are part of the input, so that
+ * different splits of the same bytes into salt and password have different tags.
+ * Returns FALSE if the keyed hash could not be calculated.
+ */
+BOOLEAN cacheGetTag(RESULT_CACHE* const pCache,
+						  const int hashType,
+						  const int iterationCount,
+						  const TOCTET* const salt,
+						  const int saltSize,
+						  const TOCTET* const password,
+						  const int passwordSize,
+						  const int derivedKeySize,
+						  TOCTET* const tag) {
+	BCRYPT_HASH_HANDLE hashHandle;
+
+	if (!NT_SUCCESS(BCryptCreateHash(pCache->hmacHandle, &hashHandle, NULL, 0, pCache->tagKey, CACHE_TAG_SIZE, 0)))
+		return FALSE;
+
+	const BOOLEAN result = hashInteger(hashHandle, hashType) &&
+		hashInteger(hashHandle, iterationCount) &&
+		hashInteger(hashHandle, derivedKeySize) &&
+		hashInteger(hashHandle, saltSize) &&
+		NT_SUCCESS(BCryptHashData(hashHandle, (PUCHAR)salt, (ULONG)saltSize, 0)) &&
+		hashInteger(hashHandle, passwordSize) &&
+		NT_SUCCESS(BCryptHashData(hashHandle, (PUCHAR)password, (ULONG)passwordSize, 0)) &&
+		NT_SUCCESS(BCryptFinishHash(hashHandle, tag, CACHE_TAG_SIZE, 0));
+
+	BCryptDestroyHash(hashHandle);
+
+	return result;
+}
+
+/*
+ * Look up the derived key of a tag. A hit makes the entry the most recently used one of its set.
+ * Returns FALSE if the cache does not contain the tag with a key of derivedKeySize bytes
+ * or if the encrypted key has been modified.
+ */
+BOOLEAN cacheLookup(RESULT_CACHE* const pCache, const TOCTET* const tag, TOCTET* const derivedKey, const int derivedKeySize) {
+	CACHE_ENTRY* const set = getSet(pCache, tag);
+
+	BOOLEAN isFound = FALSE;
+
+	AcquireSRWLockExclusive(&pCache->lock);
+
+	for (int i = 0; (i < CACHE_WAY_COUNT) && !isFound; i++) {
+		CACHE_ENTRY* const pEntry = &set[i];
+
+		if ((pEntry->lastUse != 0) && (pEntry->derivedKeySize == (UINT32)derivedKeySize) && (memcmp(pEntry->tag, tag, CACHE_TAG_SIZE) == 0)) {
+			BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO info;
+			ULONG decryptedSize;
+
+			initializeCipherModeInfo(&info, pEntry, pEntry->tag);
+
+			if (NT_SUCCESS(BCryptDecrypt(pCache->encryptionKeyHandle, pEntry->derivedKey, (ULONG)derivedKeySize, &info, NULL, 0, derivedKey, (ULONG)derivedKeySize, &decryptedSize, 0))) {
+				pCache->pHeader->useCounter++;
+				pEntry->lastUse = pCache->pHeader->useCounter;
+
+				isFound = TRUE;
+			} else
+				SecureZeroMemory(derivedKey, derivedKeySize);
+
+			break;
+		}
+	}
+
+	ReleaseSRWLockExclusive(&pCache->lock);
+
+	InterlockedIncrement(isFound ? &pCache->hitCount : &pCache->missCount);
+
+	return isFound;
+}
+
+/*
+ * Store the derived key of a tag. If the set of the tag is full, its least recently used entry is replaced.
+ * The key is encrypted with a new random nonce. If it can not be encrypted it is not stored.
+ */
+void cacheStore(RESULT_CACHE* const pCache, const TOCTET* const tag, const TOCTET* const derivedKey, const int derivedKeySize) {
+	if ((derivedKeySize <= 0) || (derivedKeySize > CACHE_MAX_DERIVED_KEY_SIZE))
+		return;
+
+	TOCTET nonce[CACHE_NONCE_SIZE];
+
+	if (!NT_SUCCESS(BCryptGenRandom(NULL, nonce, CACHE_NONCE_SIZE, BCRYPT_USE_SYSTEM_PREFERRED_RNG)))
+		return;
+
+	CACHE_ENTRY* const set = getSet(pCache, tag);
+
+	AcquireSRWLockExclusive(&pCache->lock);
+
+	// An entry with the same tag is overwritten, otherwise the oldest entry. Empty entries are the oldest ones.
+	CACHE_ENTRY* pVictim = &set[0];
+
+	for (int i = 0; i < CACHE_WAY_COUNT; i++) {
+		CACHE_ENTRY* const pEntry = &set[i];
+
+		if ((pEntry->lastUse != 0) && (memcmp(pEntry->tag, tag, CACHE_TAG_SIZE) == 0)) {
+			pVictim = pEntry;
+			break;
+		}
+
+		if (pEntry->lastUse < pVictim->lastUse)
+			pVictim = pEntry;
+	}
+
+	BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO info;
+	ULONG encryptedSize;
+
+	memcpy(pVictim->tag, tag, CACHE_TAG_SIZE);
+	memcpy(pVictim->nonce, nonce, CACHE_NONCE_SIZE);
+
+	initializeCipherModeInfo(&info, pVictim, pVictim->tag);
+
+	if (NT_SUCCESS(BCryptEncrypt(pCache->encryptionKeyHandle, (PUCHAR)derivedKey, (ULONG)derivedKeySize, &info, NULL, 0, pVictim->derivedKey, (ULONG)derivedKeySize, &encryptedSize, 0))) {
+		SecureZeroMemory(pVictim->derivedKey + derivedKeySize, CACHE_MAX_DERIVED_KEY_SIZE - derivedKeySize);
+
+		pVictim->derivedKeySize = (UINT32)derivedKeySize;
+
+		pCache->pHeader->useCounter++;
+		pVictim->lastUse = pCache->pHeader->useCounter;
+	} else {
+		// A replaced entry is left empty, as its old key does not belong to the new tag
+		SecureZeroMemory(pVictim, sizeof(CACHE_ENTRY));
+	}
+
+	ReleaseSRWLockExclusive(&pCache->lock);
+}
+
+/*
+ * Write the cache file and close it
+ */
+void cacheClose(RESULT_CACHE* const pCache) {
+	if (pCache->pHeader != NULL) {
+		FlushViewOfFile(pCache->pHeader, 0);
+		UnmapViewOfFile(pCache->pHeader);
+		pCache->pHeader = NULL;
+	}
+
+	if (pCache->mappingHandle != NULL) {
+		CloseHandle(pCache->mappingHandle);
+		pCache->mappingHandle = NULL;
+	}
+
+	if (pCache->fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(pCache->fileHandle);
+		pCache->fileHandle = INVALID_HANDLE_VALUE;
+	}
+
+	if (pCache->hmacHandle != NULL) {
+		BCryptCloseAlgorithmProvider(pCache->hmacHandle, 0);
+		pCache->hmacHandle = NULL;
+	}
+
+	if (pCache->encryptionKeyHandle != NULL) {
+		BCryptDestroyKey(pCache->encryptionKeyHandle);
+		pCache->encryptionKeyHandle = NULL;
+	}
+
+	if (pCache->aesHandle != NULL) {
+		BCryptCloseAlgorithmProvider(pCache->aesHandle, 0);
+		pCache->aesHandle = NULL;
+	}
+
+	SecureZeroMemory(pCache->tagKey, sizeof(pCache->tagKey));
+}
@@ -0,0 +1,166 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.1.0
+*
+* Memory-mapped cache of derived keys, keyed by a keyed hash of the inputs of the derivation
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.1.0: Keys protected with DPAPI outside of the entries and derived keys encrypted with AES-GCM
+*/
+
+#pragma once
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+#include <bcrypt.h>
+
+#include <tchar.h>
+
+#include "PBKDF2Native.h"
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * Size of the tag of an entry. The tag is the HMAC-SHA-256 of the inputs with the tag key of the cache file.
+ */
+#define CACHE_TAG_SIZE 32
+
+/*
+ * Size of the key that encrypts the derived keys with AES-256-GCM
+ */
+#define CACHE_ENCRYPTION_KEY_SIZE 32
+
+/*
+ * Sizes of the nonce and the authentication tag of an encrypted derived key
+ */
+#define CACHE_NONCE_SIZE              12
+#define CACHE_AUTHENTICATION_TAG_SIZE 16
+
+/*
+ * Maximum size of the keys of a cache file after they have been protected with DPAPI
+ */
+#define CACHE_MAX_PROTECTED_KEY_SIZE 512
+
+/*
+ * Maximum size of a derived key in the cache
+ */
+#define CACHE_MAX_DERIVED_KEY_SIZE 256
+
+/*
+ * Number of entries of a set. An entry can only be stored in the set that its tag selects.
+ */
+#define CACHE_WAY_COUNT 8
+
+/*
+ * TYPEDEFS
+ */
+
+/*
+ * Header of a cache file
+ */
+typedef struct {
+	char magic[8];
+	UINT32 version;
+	UINT32 entryCount;
+	UINT64 useCounter;                   // Incremented with every use of an entry, so that the least recently used entry of a set can be found
+	UINT32 protectedKeySize;
+	UINT32 reserved;
+	TOCTET protectedKey[CACHE_MAX_PROTECTED_KEY_SIZE];   // Random tag and encryption keys, protected with DPAPI for the current user
+} CACHE_HEADER;
+
+/*
+ * One entry of a cache file. An entry with a lastUse of 0 is empty.
+ */
+typedef struct {
+	TOCTET tag[CACHE_TAG_SIZE];
+	UINT64 lastUse;
+	UINT32 derivedKeySize;
+	UINT32 reserved;
+	TOCTET nonce[CACHE_NONCE_SIZE];
+	TOCTET authenticationTag[CACHE_AUTHENTICATION_TAG_SIZE];
+	TOCTET reserved2[4];
+	TOCTET derivedKey[CACHE_MAX_DERIVED_KEY_SIZE];   // Encrypted with the tag of the entry as additional authenticated data
+} CACHE_ENTRY;
+
+/*
+ * An open cache file. The cache may be used by several threads at the same time.
+ */
+typedef struct {
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+	CACHE_HEADER* pHeader;     // The mapped view of the whole file
+	CACHE_ENTRY* entries;
+	UINT32 setCount;
+	BCRYPT_ALG_HANDLE hmacHandle;
+	BCRYPT_ALG_HANDLE aesHandle;
+	BCRYPT_KEY_HANDLE encryptionKeyHandle;
+	TOCTET tagKey[CACHE_TAG_SIZE];
+	SRWLOCK lock;
+	volatile LONG hitCount;
+	volatile LONG missCount;
+} RESULT_CACHE;
+
+/*
+ * FUNCTIONS
+ */
+
+/*
+ * Open a cache file or create it with entryCount entries, rounded up to a multiple of CACHE_WAY_COUNT.
+ * An existing file keeps the number of entries that it has been created with.
+ * Returns 0 on success, 3 if the keyed hash or the encryption is not available and 4 if the file can not be opened,
+ * is not a cache file or its keys can not be unprotected by the current user.
+ */
+int cacheOpen(RESULT_CACHE* const pCache, const TCHAR* const fileName, const int entryCount, TCHAR* const errorBuffer, const int errorBufferSize);
+
+/*
+ * Calculate the tag of the inputs of a derivation. Returns FALSE if the keyed hash could not be calculated.
+ */
+BOOLEAN cacheGetTag(RESULT_CACHE* const pCache,
+						  const int hashType,
+						  const int iterationCount,
+						  const TOCTET* const salt,
+						  const int saltSize,
+						  const TOCTET* const password,
+						  const int passwordSize,
+						  const int derivedKeySize,
+						  TOCTET* const tag);
+
+/*
+ * Look up the derived key of a tag. Returns FALSE if the cache does not contain the tag with a key of derivedKeySize bytes
+ * or if the encrypted key has been modified.
+ */
+BOOLEAN cacheLookup(RESULT_CACHE* const pCache, const TOCTET* const tag, TOCTET* const derivedKey, const int derivedKeySize);
+
+/*
+ * Store the derived key of a tag. If the set of the tag is full, its least recently used entry is replaced.
+ */
+void cacheStore(RESULT_CACHE* const pCache, const TOCTET* const tag, const TOCTET* const derivedKey, const int derivedKeySize);
+
+/*
+ * Write the cache file and close it
+ */
+void cacheClose(RESULT_CACHE* const pCache);
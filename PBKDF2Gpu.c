@@ -0,0 +1,564 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.1.0
+*
+* GPU engine that calculates the PBKDF2 iterations of SHA-1 and SHA-256 in a Direct3D 11 compute shader
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.0.1: Write access to the buffer that the blocks are read back from, as it is cleared after the read
+*     2026-10-14: V1.1.0: Block buffers that are created once per device and filled in place instead of heap buffers per call
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Gpu.h"
+
+#define COBJMACROS
+#include <d3d11.h>
+#include <d3dcompiler.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * Number of threads of a thread group of the compute shader. Each thread calculates one block.
+ */
+#define GPU_THREAD_GROUP_SIZE 64
+
+/*
+ * Number of blocks in the buffers of the device. A call with more blocks is calculated in several rounds.
+ * The thread groups of one round must not exceed the limit of one dispatch.
+ */
+#define GPU_BUFFER_BLOCK_COUNT 65536
+
+#if (GPU_BUFFER_BLOCK_COUNT / GPU_THREAD_GROUP_SIZE) > D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION
+#error GPU_BUFFER_BLOCK_COUNT needs more thread groups than one dispatch can have
+#endif
+
+/*
+ * Maximum number of iterations of one dispatch, so that no dispatch runs into the timeout of the GPU driver
+ */
+#define GPU_DISPATCH_ITERATION_COUNT 16384
+
+/*
+ * TYPEDEFS
+ */
+
+/*
+ * State of one block in the buffer of the compute shader
+ */
+typedef struct {
+	UINT32 innerState[8];
+	UINT32 outerState[8];
+	UINT32 u[8];
+	UINT32 t[8];
+} GPU_BLOCK;
+
+/*
+ * Constant buffer of the compute shader. Its size must be a multiple of 16 bytes.
+ */
+typedef struct {
+	UINT32 blockCount;
+	UINT32 iterationCount;
+	UINT32 padding[2];
+} GPU_PARAMETERS;
+
+/*
+ * Source of the compute shader. It is compiled once per hash function with the macros COMPRESS, WORD_COUNT and MESSAGE_BIT_COUNT.
+ * Just like the native kernels, the message of each compression is the previous digest followed by the fixed padding
+ * of a message that is one block plus one digest long, as the HMAC key block has already been processed.
+ */
+static const char SHADER_SOURCE[] =
+	"struct GpuBlock {\n"
+	"	uint innerState[8];\n"
+	"	uint outerState[8];\n"
+	"	uint u[8];\n"
+	"	uint t[8];\n"
+	"};\n"
+	"\n"
+	"RWStructuredBuffer<GpuBlock> blocks : register(u0);\n"
+	"\n"
+	"cbuffer Parameters : register(b0) {\n"
+	"	uint blockCount;\n"
+	"	uint iterationCount;\n"
+	"	uint2 padding;\n"
+	"};\n"
+	"\n"
+	"static const uint SHA256_K[64] = {\n"
+	"	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,\n"
+	"	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,\n"
+	"	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,\n"
+	"	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,\n"
+	"	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,\n"
+	"	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,\n"
+	"	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,\n"
+	"	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2\n"
+	"};\n"
+	"\n"
+	"uint rotl(uint x, uint n) { return (x << n) | (x >> (32 - n)); }\n"
+	"uint rotr(uint x, uint n) { return (x >> n) | (x << (32 - n)); }\n"
+	"\n"
+	"void sha1Compress(inout uint s[8], uint w[16]) {\n"
+	"	uint a = s[0]; uint b = s[1]; uint c = s[2]; uint d = s[3]; uint e = s[4];\n"
+	"	[unroll] for (uint r = 0; r < 80; r++) {\n"
+	"		if (r >= 16)\n"
+	"			w[r & 15] = rotl(w[(r + 13) & 15] ^ w[(r + 8) & 15] ^ w[(r + 2) & 15] ^ w[r & 15], 1);\n"
+	"		uint f; uint k;\n"
+	"		if (r < 20) { f = (b & c) | (~b & d); k = 0x5a827999; }\n"
+	"		else if (r < 40) { f = b ^ c ^ d; k = 0x6ed9eba1; }\n"
+	"		else if (r < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }\n"
+	"		else { f = b ^ c ^ d; k = 0xca62c1d6; }\n"
+	"		uint temp = rotl(a, 5) + f + e + k + w[r & 15];\n"
+	"		e = d; d = c; c = rotl(b, 30); b = a; a = temp;\n"
+	"	}\n"
+	"	s[0] += a; s[1] += b; s[2] += c; s[3] += d; s[4] += e;\n"
+	"}\n"
+	"\n"
+	"void sha256Compress(inout uint s[8], uint w[16]) {\n"
+	"	uint v[8];\n"
+	"	[unroll] for (uint i = 0; i < 8; i++) v[i] = s[i];\n"
+	"	[unroll] for (uint r = 0; r < 64; r++) {\n"
+	"		if (r >= 16) {\n"
+	"			uint w15 = w[(r + 1) & 15];\n"
+	"			uint w2 = w[(r + 14) & 15];\n"
+	"			w[r & 15] += (rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3)) + w[(r + 9) & 15] + (rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10));\n"
+	"		}\n"
+	"		uint t1 = v[7] + (rotr(v[4], 6) ^ rotr(v[4], 11) ^ rotr(v[4], 25)) + ((v[4] & v[5]) ^ (~v[4] & v[6])) + SHA256_K[r] + w[r & 15];\n"
+	"		uint t2 = (rotr(v[0], 2) ^ rotr(v[0], 13) ^ rotr(v[0], 22)) + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));\n"
+	"		v[7] = v[6]; v[6] = v[5]; v[5] = v[4]; v[4] = v[3] + t1;\n"
+	"		v[3] = v[2]; v[2] = v[1]; v[1] = v[0]; v[0] = t1 + t2;\n"
+	"	}\n"
+	"	[unroll] for (uint j = 0; j < 8; j++) s[j] += v[j];\n"
+	"}\n"
+	"\n"
+	"[numthreads(64, 1, 1)]\n"
+	"void iterate(uint3 id : SV_DispatchThreadID) {\n"
+	"	if (id.x >= blockCount)\n"
+	"		return;\n"
+	"\n"
+	"	GpuBlock block = blocks[id.x];\n"
+	"\n"
+	"	uint w[16];\n"
+	"	uint s[8];\n"
+	"\n"
+	"	[unroll] for (uint i = 0; i < 16; i++) w[i] = 0;\n"
+	"	[unroll] for (uint j = 0; j < 8; j++) s[j] = 0;\n"
+	"\n"
+	"	w[WORD_COUNT] = 0x80000000;\n"
+	"	w[15] = MESSAGE_BIT_COUNT;\n"
+	"\n"
+	"	for (uint iteration = 0; iteration < iterationCount; iteration++) {\n"
+	"		[unroll] for (uint k = 0; k < WORD_COUNT; k++) { w[k] = block.u[k]; s[k] = block.innerState[k]; }\n"
+	"		COMPRESS(s, w);\n"
+	"		[unroll] for (uint m = 0; m < WORD_COUNT; m++) { w[m] = s[m]; s[m] = block.outerState[m]; }\n"
+	"		COMPRESS(s, w);\n"
+	"		[unroll] for (uint n = 0; n < WORD_COUNT; n++) { block.u[n] = s[n]; block.t[n] ^= s[n]; }\n"
+	"	}\n"
+	"\n"
+	"	blocks[id.x] = block;\n"
+	"}\n";
+
+/*
+ * Shader macros per hash function, indexed by NATIVE_HASH. The message bit count is the size of one block plus one digest in bits.
+ */
+static const char* const SHADER_COMPRESS[NATIVE_HASH_COUNT] = { "sha1Compress", "sha256Compress" };
+static const char* const SHADER_WORD_COUNT[NATIVE_HASH_COUNT] = { "5", "8" };
+static const char* const SHADER_MESSAGE_BIT_COUNT[NATIVE_HASH_COUNT] = { "672", "768" };
+
+/*
+ * The device with its shaders and buffers. The immediate context must not be used by several threads at the same time,
+ * so all GPU calls after the initialization are made while holding the device lock.
+ * The blocks are written into the staging buffer, copied into the block buffer that the shader works on and copied back
+ * into the staging buffer to be read, so the buffers are the same for all calls.
+ */
+static INIT_ONCE deviceInitOnce = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION deviceLock;
+static ID3D11Device* device = NULL;
+static ID3D11DeviceContext* deviceContext = NULL;
+static ID3D11ComputeShader* shaders[NATIVE_HASH_COUNT] = { NULL, NULL };
+static ID3D11Buffer* parameterBuffer = NULL;
+static ID3D11Buffer* blockBuffer = NULL;
+static ID3D11UnorderedAccessView* blockView = NULL;
+static ID3D11Buffer* stagingBuffer = NULL;
+static volatile BOOLEAN isDeviceAvailable = FALSE;
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+
+/*
+ * Release the device objects
+ */
+static void releaseDevice(void) {
+	if (stagingBuffer != NULL) {
+		ID3D11Buffer_Release(stagingBuffer);
+		stagingBuffer = NULL;
+	}
+
+	if (blockView != NULL) {
+		ID3D11UnorderedAccessView_Release(blockView);
+		blockView = NULL;
+	}
+
+	if (blockBuffer != NULL) {
+		ID3D11Buffer_Release(blockBuffer);
+		blockBuffer = NULL;
+	}
+
+	if (parameterBuffer != NULL) {
+		ID3D11Buffer_Release(parameterBuffer);
+		parameterBuffer = NULL;
+	}
+
+	for (int hash = 0; hash < NATIVE_HASH_COUNT; hash++)
+		if (shaders[hash] != NULL) {
+			ID3D11ComputeShader_Release(shaders[hash]);
+			shaders[hash] = NULL;
+		}
+
+	if (deviceContext != NULL) {
+		ID3D11DeviceContext_Release(deviceContext);
+		deviceContext = NULL;
+	}
+
+	if (device != NULL) {
+		ID3D11Device_Release(device);
+		device = NULL;
+	}
+
+	isDeviceAvailable = FALSE;
+}
+
+/*
+ * Compile the compute shader of a hash function
+ */
+static BOOLEAN createShader(const NATIVE_HASH hash, ID3D11ComputeShader** const pShader) {
+	const D3D_SHADER_MACRO defines[] = {
+		{ "COMPRESS", SHADER_COMPRESS[hash] },
+		{ "WORD_COUNT", SHADER_WORD_COUNT[hash] },
+		{ "MESSAGE_BIT_COUNT", SHADER_MESSAGE_BIT_COUNT[hash] },
+		{ NULL, NULL }
+	};
+
+	ID3DBlob* code = NULL;
+	ID3DBlob* errors = NULL;
+
+	BOOLEAN result = SUCCEEDED(D3DCompile(SHADER_SOURCE, sizeof(SHADER_SOURCE) - 1, "PBKDF2Gpu", defines, NULL, "iterate", "cs_5_0", D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &code, &errors));
+
+	if (result)
+		result = SUCCEEDED(ID3D11Device_CreateComputeShader(device, ID3D10Blob_GetBufferPointer(code), ID3D10Blob_GetBufferSize(code), NULL, pShader));
+
+	if (code != NULL)
+		ID3D10Blob_Release(code);
+
+	if (errors != NULL)
+		ID3D10Blob_Release(errors);
+
+	return result;
+}
+
+/*
+ * Create the buffer of the blocks that the shader works on and the staging buffer that the CPU writes and reads the blocks in
+ */
+static BOOLEAN createBlockBuffers(void) {
+	D3D11_BUFFER_DESC description;
+
+	memset(&description, 0, sizeof(description));
+
+	description.ByteWidth = (UINT)(GPU_BUFFER_BLOCK_COUNT * sizeof(GPU_BLOCK));
+	description.Usage = D3D11_USAGE_DEFAULT;
+	description.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	description.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	description.StructureByteStride = sizeof(GPU_BLOCK);
+
+	BOOLEAN result = SUCCEEDED(ID3D11Device_CreateBuffer(device, &description, NULL, &blockBuffer)) &&
+		SUCCEEDED(ID3D11Device_CreateUnorderedAccessView(device, (ID3D11Resource*)blockBuffer, NULL, &blockView));
+
+	if (result) {
+		// The CPU writes the blocks into the staging buffer, reads the results and clears them
+		description.Usage = D3D11_USAGE_STAGING;
+		description.BindFlags = 0;
+		description.CPUAccessFlags = D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE;
+
+		result = SUCCEEDED(ID3D11Device_CreateBuffer(device, &description, NULL, &stagingBuffer));
+	}
+
+	return result;
+}
+
+/*
+ * Create the device, the shaders and the buffers. This is called once.
+ * A GPU that does not support feature level 11.0 can not be used.
+ */
+static BOOL CALLBACK initializeDevice(PINIT_ONCE pInitOnce, PVOID parameter, PVOID* pContext) {
+	UNREFERENCED_PARAMETER(pInitOnce);
+	UNREFERENCED_PARAMETER(parameter);
+	UNREFERENCED_PARAMETER(pContext);
+
+	const D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_11_0;
+
+	InitializeCriticalSection(&deviceLock);
+
+	BOOLEAN result = SUCCEEDED(D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, 0, &featureLevel, 1, D3D11_SDK_VERSION, &device, NULL, &deviceContext));
+
+	for (int hash = 0; (hash < NATIVE_HASH_COUNT) && result; hash++)
+		result = createShader((NATIVE_HASH)hash, &shaders[hash]);
+
+	if (result) {
+		D3D11_BUFFER_DESC description;
+
+		memset(&description, 0, sizeof(description));
+
+		description.ByteWidth = sizeof(GPU_PARAMETERS);
+		description.Usage = D3D11_USAGE_DEFAULT;
+		description.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+		result = SUCCEEDED(ID3D11Device_CreateBuffer(device, &description, NULL, &parameterBuffer));
+	}
+
+	if (result)
+		result = createBlockBuffers();
+
+	if (result)
+		isDeviceAvailable = TRUE;
+	else
+		releaseDevice();
+
+	return TRUE;
+}
+
+/*
+ * Perform iterationCount iterations on the first blockCount blocks of the staging buffer on the GPU.
+ * The blocks are copied into the block buffer and back, and the iterations are split into several dispatches.
+ * The device lock must be held.
+ */
+static void iterateBlocksOnGpu(const NATIVE_HASH hash, const int blockCount, const ULONG iterationCount) {
+	ID3D11UnorderedAccessView* const noView = NULL;
+
+	D3D11_BOX region;
+
+	memset(&region, 0, sizeof(region));
+
+	region.right = (UINT)(blockCount * sizeof(GPU_BLOCK));
+	region.bottom = 1;
+	region.back = 1;
+
+	const UINT threadGroupCount = (UINT)((blockCount + GPU_THREAD_GROUP_SIZE - 1) / GPU_THREAD_GROUP_SIZE);
+
+	ID3D11DeviceContext_CopySubresourceRegion(deviceContext, (ID3D11Resource*)blockBuffer, 0, 0, 0, 0, (ID3D11Resource*)stagingBuffer, 0, &region);
+
+	ID3D11DeviceContext_CSSetShader(deviceContext, shaders[hash], NULL, 0);
+	ID3D11DeviceContext_CSSetConstantBuffers(deviceContext, 0, 1, &parameterBuffer);
+	ID3D11DeviceContext_CSSetUnorderedAccessViews(deviceContext, 0, 1, &blockView, NULL);
+
+	ULONG remainingIterationCount = iterationCount;
+
+	while (remainingIterationCount > 0) {
+		GPU_PARAMETERS parameters;
+
+		memset(&parameters, 0, sizeof(parameters));
+
+		parameters.blockCount = (UINT32)blockCount;
+		parameters.iterationCount = min(remainingIterationCount, GPU_DISPATCH_ITERATION_COUNT);
+
+		ID3D11DeviceContext_UpdateSubresource(deviceContext, (ID3D11Resource*)parameterBuffer, 0, NULL, &parameters, 0, 0);
+		ID3D11DeviceContext_Dispatch(deviceContext, threadGroupCount, 1, 1);
+
+		remainingIterationCount -= parameters.iterationCount;
+	}
+
+	ID3D11DeviceContext_CSSetUnorderedAccessViews(deviceContext, 0, 1, &noView, NULL);
+	ID3D11DeviceContext_CopySubresourceRegion(deviceContext, (ID3D11Resource*)stagingBuffer, 0, 0, 0, 0, (ID3D11Resource*)blockBuffer, 0, &region);
+}
+
+/*
+ * Calculate the HMAC keys and the first iteration of the blocks of the requests from position (requestIndex, offset) on the CPU
+ * and write them into the staging buffer until it is full. Returns the number of blocks and moves the position behind the last one.
+ */
+static int writeBlocks(const NATIVE_HASH hash,
+							  GPU_BLOCK* const gpuBlocks,
+							  const NATIVE_PBKDF2_REQUEST* const requests,
+							  const int requestCount,
+							  int* const pRequestIndex,
+							  ULONG* const pOffset) {
+	const ULONG digestSize = (ULONG)nativeGetDigestSize(hash);
+
+	NATIVE_HMAC_KEY key;
+	NATIVE_BLOCK_STATE block;
+
+	int blockCount = 0;
+
+	while ((*pRequestIndex < requestCount) && (blockCount < GPU_BUFFER_BLOCK_COUNT)) {
+		const NATIVE_PBKDF2_REQUEST* const pRequest = &requests[*pRequestIndex];
+
+		nativePrepareHmacKey(&key, hash, pRequest->password, pRequest->passwordSize);
+
+		for (; (*pOffset < pRequest->derivedKeySize) && (blockCount < GPU_BUFFER_BLOCK_COUNT); *pOffset += digestSize) {
+			nativeInitializeBlock(&block, &key, pRequest->salt, pRequest->saltSize, *pOffset / digestSize + 1);
+
+			GPU_BLOCK* const pGpuBlock = &gpuBlocks[blockCount];
+
+			for (int j = 0; j < 8; j++) {
+				pGpuBlock->innerState[j] = key.innerState.w32[j];
+				pGpuBlock->outerState[j] = key.outerState.w32[j];
+				pGpuBlock->u[j] = block.u.w32[j];
+				pGpuBlock->t[j] = block.t.w32[j];
+			}
+
+			blockCount++;
+		}
+
+		if (*pOffset >= pRequest->derivedKeySize) {
+			(*pRequestIndex)++;
+			*pOffset = 0;
+		}
+	}
+
+	SecureZeroMemory(&key, sizeof(key));
+	SecureZeroMemory(&block, sizeof(block));
+
+	return blockCount;
+}
+
+/*
+ * Store the results of the blocks in the staging buffer in the derived keys of the requests from position (requestIndex, offset) on
+ */
+static void readBlocks(const NATIVE_HASH hash,
+							  const GPU_BLOCK* const gpuBlocks,
+							  const int blockCount,
+							  NATIVE_PBKDF2_REQUEST* const requests,
+							  int requestIndex,
+							  ULONG offset) {
+	const ULONG digestSize = (ULONG)nativeGetDigestSize(hash);
+
+	NATIVE_BLOCK_STATE block;
+
+	for (int i = 0; i < blockCount; i++) {
+		// Requests without a key are skipped, so that the position is at a block
+		while (offset >= requests[requestIndex].derivedKeySize) {
+			requestIndex++;
+			offset = 0;
+		}
+
+		for (int j = 0; j < 8; j++)
+			block.t.w32[j] = gpuBlocks[i].t[j];
+
+		nativeGetBlockResult(&block, &requests[requestIndex].derivedKey[offset], min(digestSize, requests[requestIndex].derivedKeySize - offset));
+
+		offset += digestSize;
+	}
+
+	SecureZeroMemory(&block, sizeof(block));
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+/*
+ * Check if there is a GPU that can run the compute shaders. The device and the shaders are created on the first call.
+ */
+BOOLEAN gpuIsAvailable(void) {
+	InitOnceExecuteOnce(&deviceInitOnce, initializeDevice, NULL, NULL);
+
+	return isDeviceAvailable;
+}
+
+/*
+ * Calculate PBKDF2 for several independent requests with the same hash function and iteration count.
+ * The HMAC keys and the first iteration are calculated on the CPU and all further iterations of all blocks on the GPU.
+ * Calls from several threads are serialized on the one device, so the requests should be given in as few calls as possible.
+ * The blocks are written straight into the staging buffer of the device, so there are no heap calls.
+ * If there are more than GPU_BUFFER_BLOCK_COUNT blocks, they are calculated in several rounds.
+ * Returns FALSE if the hash function is not supported, there is no GPU or the GPU failed.
+ */
+BOOLEAN gpuPBKDF2(const NATIVE_HASH hash,
+						const ULONG iterationCount,
+						NATIVE_PBKDF2_REQUEST* const requests,
+						const int requestCount) {
+	if ((hash < 0) || (hash >= NATIVE_HASH_COUNT) || !gpuIsAvailable())
+		return FALSE;
+
+	int requestIndex = 0;
+	ULONG offset = 0;
+
+	EnterCriticalSection(&deviceLock);
+
+	BOOLEAN result = isDeviceAvailable;
+
+	while (result && (requestIndex < requestCount)) {
+		const int roundRequestIndex = requestIndex;
+		const ULONG roundOffset = offset;
+
+		D3D11_MAPPED_SUBRESOURCE mappedBuffer;
+
+		result = SUCCEEDED(ID3D11DeviceContext_Map(deviceContext, (ID3D11Resource*)stagingBuffer, 0, D3D11_MAP_WRITE, 0, &mappedBuffer));
+
+		if (!result)
+			break;
+
+		const int blockCount = writeBlocks(hash, (GPU_BLOCK*)mappedBuffer.pData, requests, requestCount, &requestIndex, &offset);
+
+		ID3D11DeviceContext_Unmap(deviceContext, (ID3D11Resource*)stagingBuffer, 0);
+
+		// The first iteration has been done while initializing the blocks
+		if ((blockCount > 0) && (iterationCount > 1))
+			iterateBlocksOnGpu(hash, blockCount, iterationCount - 1);
+
+		// Map waits until the GPU is done
+		result = SUCCEEDED(ID3D11DeviceContext_Map(deviceContext, (ID3D11Resource*)stagingBuffer, 0, D3D11_MAP_READ_WRITE, 0, &mappedBuffer));
+
+		if (result) {
+			readBlocks(hash, (const GPU_BLOCK*)mappedBuffer.pData, blockCount, requests, roundRequestIndex, roundOffset);
+
+			SecureZeroMemory(mappedBuffer.pData, blockCount * sizeof(GPU_BLOCK));
+
+			ID3D11DeviceContext_Unmap(deviceContext, (ID3D11Resource*)stagingBuffer, 0);
+		}
+	}
+
+	if (!result)
+		isDeviceAvailable = FALSE;
+
+	LeaveCriticalSection(&deviceLock);
+
+	return result;
+}
+
+/*
+ * Release the device and the shaders
+ */
+void gpuRelease(void) {
+	if (device != NULL) {
+		EnterCriticalSection(&deviceLock);
+
+		releaseDevice();
+
+		LeaveCriticalSection(&deviceLock);
+	}
+}
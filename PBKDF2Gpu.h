@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* GPU engine that calculates the PBKDF2 iterations of SHA-1 and SHA-256 in a Direct3D 11 compute shader
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*/
+
+#pragma once
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+
+#include "PBKDF2Native.h"
+
+/*
+ * FUNCTIONS
+ */
+
+/*
+ * Check if there is a GPU that can run the compute shaders. The device and the shaders are created on the first call.
+ */
+BOOLEAN gpuIsAvailable(void);
+
+/*
+ * Calculate PBKDF2 for several independent requests with the same hash function and iteration count.
+ * The HMAC keys and the first iteration are calculated on the CPU and all further iterations of all blocks on the GPU.
+ * Calls from several threads are serialized on the one device, so the requests should be given in as few calls as possible.
+ * Returns FALSE if the hash function is not supported, there is no GPU or the GPU failed.
+ */
+BOOLEAN gpuPBKDF2(const NATIVE_HASH hash,
+						const ULONG iterationCount,
+						NATIVE_PBKDF2_REQUEST* const requests,
+						const int requestCount);
+
+/*
+ * Release the device and the shaders
+ */
+void gpuRelease(void);
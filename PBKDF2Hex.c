@@ -0,0 +1,344 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Conversion of byte arrays from and to hex strings.
+* The conversions use SSE4.1 if the processor supports it and lookup tables otherwise and for the remainders.
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created with SSE4.1 and lookup table conversions
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Hex.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * Value of a character that is not a hex character in HEX_VALUE
+ */
+#define HEX_INVALID 0xff
+
+#define HEX_INVALID_ROW \
+	HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, \
+	HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID
+
+/*
+ * Value of each character code below 256 as a hex digit
+ */
+static const TOCTET HEX_VALUE[256] = {
+	HEX_INVALID_ROW,
+	HEX_INVALID_ROW,
+	HEX_INVALID_ROW,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID,
+	HEX_INVALID, 10, 11, 12, 13, 14, 15, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID,
+	HEX_INVALID_ROW,
+	HEX_INVALID, 10, 11, 12, 13, 14, 15, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID,
+	HEX_INVALID_ROW,
+	HEX_INVALID_ROW, HEX_INVALID_ROW, HEX_INVALID_ROW, HEX_INVALID_ROW,
+	HEX_INVALID_ROW, HEX_INVALID_ROW, HEX_INVALID_ROW, HEX_INVALID_ROW
+};
+
+#define HEX_PAIR_ROW(high) \
+	{ high, _T('0') }, { high, _T('1') }, { high, _T('2') }, { high, _T('3') }, \
+	{ high, _T('4') }, { high, _T('5') }, { high, _T('6') }, { high, _T('7') }, \
+	{ high, _T('8') }, { high, _T('9') }, { high, _T('A') }, { high, _T('B') }, \
+	{ high, _T('C') }, { high, _T('D') }, { high, _T('E') }, { high, _T('F') }
+
+/*
+ * The two hex characters of each byte value
+ */
+static const TCHAR HEX_PAIR[256][2] = {
+	HEX_PAIR_ROW(_T('0')), HEX_PAIR_ROW(_T('1')), HEX_PAIR_ROW(_T('2')), HEX_PAIR_ROW(_T('3')),
+	HEX_PAIR_ROW(_T('4')), HEX_PAIR_ROW(_T('5')), HEX_PAIR_ROW(_T('6')), HEX_PAIR_ROW(_T('7')),
+	HEX_PAIR_ROW(_T('8')), HEX_PAIR_ROW(_T('9')), HEX_PAIR_ROW(_T('A')), HEX_PAIR_ROW(_T('B')),
+	HEX_PAIR_ROW(_T('C')), HEX_PAIR_ROW(_T('D')), HEX_PAIR_ROW(_T('E')), HEX_PAIR_ROW(_T('F'))
+};
+
+/*
+ * Result of the processor feature detection. A value of -1 means "not yet detected".
+ */
+static volatile LONG sse41Support = -1;
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+
+/*
+ * Detect with CPUID if the processor supports SSSE3 and SSE4.1
+ */
+static LONG detectSse41Support(void) {
+	int cpuInfo[4];
+
+	const int REGISTER_ECX = 2;
+
+	const int SSSE3_BIT = 1 << 9;
+	const int SSE41_BIT = 1 << 19;
+
+	__cpuid(cpuInfo, 1);
+
+	return (((cpuInfo[REGISTER_ECX] & SSSE3_BIT) != 0) && ((cpuInfo[REGISTER_ECX] & SSE41_BIT) != 0)) ? 1 : 0;
+}
+
+/*
+ * Check if the SSE4.1 conversions can be used
+ */
+static BOOLEAN isSse41Supported(void) {
+	if (sse41Support < 0)
+		InterlockedExchange(&sse41Support, detectSse41Support());
+
+	return (BOOLEAN)(sse41Support != 0);
+}
+
+/*
+ * Get the value of a hex character. Returns HEX_INVALID if it is not a hex character.
+ */
+static TOCTET getHexValue(const TCHAR hexChar) {
+#ifdef _UNICODE
+	if (hexChar > 0xff)
+		return HEX_INVALID;
+#endif
+
+	return HEX_VALUE[(TOCTET)hexChar];
+}
+
+/*
+ * Store 16 characters that are given as bytes in a register
+ */
+static void storeChars(TCHAR* const text, const __m128i chars) {
+#ifdef _UNICODE
+	_mm_storeu_si128((__m128i*)text, _mm_cvtepu8_epi16(chars));
+	_mm_storeu_si128((__m128i*)(text + 8), _mm_cvtepu8_epi16(_mm_srli_si128(chars, 8)));
+#else
+	_mm_storeu_si128((__m128i*)text, chars);
+#endif
+}
+
+/*
+ * Store the lower 8 characters that are given as bytes in a register
+ */
+static void storeHalfChars(TCHAR* const text, const __m128i chars) {
+#ifdef _UNICODE
+	_mm_storeu_si128((__m128i*)text, _mm_cvtepu8_epi16(chars));
+#else
+	_mm_storel_epi64((__m128i*)text, chars);
+#endif
+}
+
+/*
+ * Load 16 characters as bytes into a register. Characters above 255 become 255, which is not a hex character.
+ */
+static __m128i loadChars(const TCHAR* const text) {
+#ifdef _UNICODE
+	return _mm_packus_epi16(_mm_loadu_si128((const __m128i*)text), _mm_loadu_si128((const __m128i*)(text + 8)));
+#else
+	return _mm_loadu_si128((const __m128i*)text);
+#endif
+}
+
+/*
+ * Convert 16 bytes into two registers with the 16 hex characters of 8 bytes each
+ */
+static void encodeBlockSse41(const TOCTET* const bytes, __m128i* const pLowChars, __m128i* const pHighChars) {
+	const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+	const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+
+	const __m128i value = _mm_loadu_si128((const __m128i*)bytes);
+	const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(value, 4), nibbleMask);
+	const __m128i lowNibbles = _mm_and_si128(value, nibbleMask);
+
+	*pLowChars = _mm_shuffle_epi8(digits, _mm_unpacklo_epi8(highNibbles, lowNibbles));
+	*pHighChars = _mm_shuffle_epi8(digits, _mm_unpackhi_epi8(highNibbles, lowNibbles));
+}
+
+/*
+ * Write the 16 hex characters of 8 bytes with a blank after each byte, i.e. 24 characters
+ */
+static void storeSeparatedChars(TCHAR* const text, const __m128i chars) {
+	// Positions of the hex characters in the first 16 and the last 8 output characters. 0x80 yields a zero, which becomes a blank.
+	const __m128i firstShuffle = _mm_setr_epi8(0, 1, -128, 2, 3, -128, 4, 5, -128, 6, 7, -128, 8, 9, -128, 10);
+	const __m128i lastShuffle = _mm_setr_epi8(11, -128, 12, 13, -128, 14, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+	const __m128i firstBlanks = _mm_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0);
+	const __m128i lastBlanks = _mm_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0);
+
+	storeChars(text, _mm_or_si128(_mm_shuffle_epi8(chars, firstShuffle), firstBlanks));
+	storeHalfChars(text + 16, _mm_or_si128(_mm_shuffle_epi8(chars, lastShuffle), lastBlanks));
+}
+
+/*
+ * Convert the bytes in blocks of 16 with SSE4.1. Returns the number of bytes that have been converted.
+ */
+static int encodeSse41(const TOCTET* const bytes, const int byteCount, TCHAR* const text, const BOOLEAN hasSeparator) {
+	const int blockCount = byteCount >> 4;
+
+	TCHAR* pActText = text;
+
+	for (int i = 0; i < blockCount; i++) {
+		__m128i lowChars;
+		__m128i highChars;
+
+		encodeBlockSse41(bytes + (i << 4), &lowChars, &highChars);
+
+		if (hasSeparator) {
+			storeSeparatedChars(pActText, lowChars);
+			storeSeparatedChars(pActText + 24, highChars);
+
+			pActText += 48;
+		} else {
+			storeChars(pActText, lowChars);
+			storeChars(pActText + 16, highChars);
+
+			pActText += 32;
+		}
+	}
+
+	return blockCount << 4;
+}
+
+/*
+ * Convert 16 hex characters into 8 bytes with SSE4.1. Returns FALSE if there is an invalid character.
+ */
+static BOOLEAN decodeBlockSse41(const TCHAR* const text, TOCTET* const bytes) {
+	const __m128i chars = loadChars(text);
+
+	// Digits are '0' to '9'. Letters are 'A' to 'F' or 'a' to 'f', which are the same with bit 5 set.
+	const __m128i digitValues = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+	const __m128i letterValues = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+
+	const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digitValues, _mm_set1_epi8(9)), digitValues);
+	const __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letterValues, _mm_set1_epi8(5)), letterValues);
+
+	if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xffff)
+		return FALSE;
+
+	const __m128i nibbles = _mm_blendv_epi8(_mm_add_epi8(letterValues, _mm_set1_epi8(10)), digitValues, isDigit);
+
+	// Each pair of nibbles becomes high * 16 + low
+	const __m128i values = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+
+	_mm_storel_epi64((__m128i*)bytes, _mm_packus_epi16(values, values));
+
+	return TRUE;
+}
+
+/*
+ * Convert pairs of hex characters in blocks of 16 characters with SSE4.1.
+ * Returns the number of bytes that have been converted. It stops before a block with an invalid character.
+ */
+static int decodeSse41(const TCHAR* const text, const int pairCount, TOCTET* const bytes) {
+	int byteCount = 0;
+
+	while ((byteCount + 8 <= pairCount) && decodeBlockSse41(text + (byteCount << 1), bytes + byteCount))
+		byteCount += 8;
+
+	return byteCount;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+/*
+ * Get the number of characters of the hex string of byteCount bytes without the null termination character.
+ * With a separator the bytes are separated by blanks.
+ */
+int hexGetEncodedSize(const int byteCount, const BOOLEAN hasSeparator) {
+	if (byteCount <= 0)
+		return 0;
+
+	return hasSeparator ? byteCount * 3 - 1 : byteCount * 2;
+}
+
+/*
+ * Convert bytes into a string of upper case hex characters that are separated by blanks if hasSeparator is set.
+ * The text buffer must have room for hexGetEncodedSize + 1 characters.
+ */
+void hexEncode(const TOCTET* const bytes, const int byteCount, TCHAR* const text, const BOOLEAN hasSeparator) {
+	const int charsPerByte = hasSeparator ? 3 : 2;
+
+	int i = isSse41Supported() ? encodeSse41(bytes, byteCount, text, hasSeparator) : 0;
+
+	TCHAR* pActText = text + i * charsPerByte;
+
+	for (; i < byteCount; i++) {
+		const TCHAR* const pPair = HEX_PAIR[bytes[i]];
+
+		pActText[0] = pPair[0];
+		pActText[1] = pPair[1];
+
+		if (hasSeparator)
+			pActText[2] = _T(' ');
+
+		pActText += charsPerByte;
+	}
+
+	// The blank after the last byte is replaced by the terminator
+	text[hexGetEncodedSize(byteCount, hasSeparator)] = _T('\0');
+}
+
+/*
+ * Convert a string of textSize upper or lower case hex characters into (textSize + 1) / 2 bytes.
+ * If textSize is odd the first character is the low nibble of the first byte.
+ * Returns -1 on success or the position of the first invalid character, starting with 0.
+ */
+int hexDecode(const TCHAR* const text, const int textSize, TOCTET* const bytes) {
+	const TCHAR* pActText = text;
+	TOCTET* pActByte = bytes;
+
+	if ((textSize & 1) != 0) {
+		const TOCTET value = getHexValue(*pActText);
+
+		if (value == HEX_INVALID)
+			return 0;
+
+		*pActByte = value;
+
+		pActText++;
+		pActByte++;
+	}
+
+	const int pairCount = textSize >> 1;
+
+	int i = isSse41Supported() ? decodeSse41(pActText, pairCount, pActByte) : 0;
+
+	for (; i < pairCount; i++) {
+		const TOCTET highValue = getHexValue(pActText[i << 1]);
+		const TOCTET lowValue = getHexValue(pActText[(i << 1) + 1]);
+
+		if (highValue == HEX_INVALID)
+			return (int)(pActText - text) + (i << 1);
+
+		if (lowValue == HEX_INVALID)
+			return (int)(pActText - text) + (i << 1) + 1;
+
+		pActByte[i] = (TOCTET)((highValue << 4) | lowValue);
+	}
+
+	return -1;
+}
@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Conversion of byte arrays from and to hex strings
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created with SSE4.1 and lookup table conversions
+*/
+
+#pragma once
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+
+#include <tchar.h>
+
+#include "PBKDF2Native.h"
+
+/*
+ * FUNCTIONS
+ */
+
+/*
+ * Get the number of characters of the hex string of byteCount bytes without the null termination character.
+ * With a separator the bytes are separated by blanks.
+ */
+int hexGetEncodedSize(const int byteCount, const BOOLEAN hasSeparator);
+
+/*
+ * Convert bytes into a string of upper case hex characters that are separated by blanks if hasSeparator is set.
+ * The text buffer must have room for hexGetEncodedSize + 1 characters.
+ */
+void hexEncode(const TOCTET* const bytes, const int byteCount, TCHAR* const text, const BOOLEAN hasSeparator);
+
+/*
+ * Convert a string of textSize upper or lower case hex characters into (textSize + 1) / 2 bytes.
+ * If textSize is odd the first character is the low nibble of the first byte.
+ * Returns -1 on success or the position of the first invalid character, starting with 0.
+ */
+int hexDecode(const TCHAR* const text, const int textSize, TOCTET* const bytes);
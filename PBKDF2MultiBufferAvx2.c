@@ -0,0 +1,60 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Multi-buffer PBKDF2 kernels with AVX2 (8 lanes of 32 bit words)
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Native.h"
+
+#include <immintrin.h>
+
+/*
+ * DEFINES
+ */
+#define VECTOR     __m256i
+#define LANE_COUNT 8
+
+#define KERNEL_SHA1            multiBufferSha1Avx2
+#define KERNEL_SHA256          multiBufferSha256Avx2
+#define KERNEL_SHA1_COMPRESS   sha1CompressAvx2
+#define KERNEL_SHA256_COMPRESS sha256CompressAvx2
+
+#define V_SET1(x)      _mm256_set1_epi32((int)(x))
+#define V_LOAD(p)      _mm256_loadu_si256((const __m256i*)(p))
+#define V_STORE(p, v)  _mm256_storeu_si256((__m256i*)(p), v)
+#define V_ADD(a, b)    _mm256_add_epi32(a, b)
+#define V_AND(a, b)    _mm256_and_si256(a, b)
+#define V_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define V_OR(a, b)     _mm256_or_si256(a, b)
+#define V_XOR(a, b)    _mm256_xor_si256(a, b)
+#define V_SHR(x, n)    _mm256_srli_epi32(x, n)
+#define V_ROTL(x, n)   _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+#define V_ROTR(x, n)   _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+#include "PBKDF2MultiBufferKernel.inl"
@@ -0,0 +1,65 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Multi-buffer PBKDF2 kernels with AVX-512 (16 lanes of 32 bit words)
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Native.h"
+
+#include <immintrin.h>
+
+/*
+ * DEFINES
+ */
+#define VECTOR     __m512i
+#define LANE_COUNT 16
+
+#define KERNEL_SHA1            multiBufferSha1Avx512
+#define KERNEL_SHA256          multiBufferSha256Avx512
+#define KERNEL_SHA1_COMPRESS   sha1CompressAvx512
+#define KERNEL_SHA256_COMPRESS sha256CompressAvx512
+
+#define V_SET1(x)      _mm512_set1_epi32((int)(x))
+#define V_LOAD(p)      _mm512_loadu_si512((const void*)(p))
+#define V_STORE(p, v)  _mm512_storeu_si512((void*)(p), v)
+#define V_ADD(a, b)    _mm512_add_epi32(a, b)
+#define V_AND(a, b)    _mm512_and_si512(a, b)
+#define V_ANDNOT(a, b) _mm512_andnot_si512(a, b)
+#define V_OR(a, b)     _mm512_or_si512(a, b)
+#define V_XOR(a, b)    _mm512_xor_si512(a, b)
+#define V_SHR(x, n)    _mm512_srli_epi32(x, n)
+#define V_ROTL(x, n)   _mm512_rol_epi32(x, n)
+#define V_ROTR(x, n)   _mm512_ror_epi32(x, n)
+
+// AVX-512 has native rotations and calculates the three input boolean functions in one instruction
+#define V_CH(x, y, z)   _mm512_ternarylogic_epi32(x, y, z, 0xca)
+#define V_MAJ(x, y, z)  _mm512_ternarylogic_epi32(x, y, z, 0xe8)
+#define V_XOR3(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+
+#include "PBKDF2MultiBufferKernel.inl"
@@ -0,0 +1,269 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Multi-buffer PBKDF2 iteration kernels for SHA-1 and SHA-256.
+*
+* This file is included by the files for the specific instruction sets. Before including it they define
+* the vector type VECTOR, the number of lanes LANE_COUNT, the kernel names KERNEL_SHA1 and KERNEL_SHA256
+* and the vector operation macros V_*. Each lane holds one 32 bit word of an independent block calculation.
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*/
+
+/*
+ * Default implementations of the boolean functions of the hash functions.
+ * An instruction set that has a better way to calculate them defines them before including this file.
+ */
+#ifndef V_CH
+#define V_CH(x, y, z) V_XOR(V_AND(x, y), V_ANDNOT(x, z))
+#endif
+
+#ifndef V_MAJ
+#define V_MAJ(x, y, z) V_OR(V_AND(x, y), V_AND(z, V_OR(x, y)))
+#endif
+
+#ifndef V_XOR3
+#define V_XOR3(x, y, z) V_XOR(V_XOR(x, y), z)
+#endif
+
+/*
+ * SHA-256 round constants
+ */
+static const UINT32 KERNEL_SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * Load one state word of all lanes into a vector
+ */
+#define LOAD_LANES(vector, blocks, member, wordIndex) { \
+	UINT32 laneWords[LANE_COUNT]; \
+	for (int lane = 0; lane < LANE_COUNT; lane++) \
+		laneWords[lane] = blocks[lane]->member.w32[wordIndex]; \
+	vector = V_LOAD(laneWords); \
+}
+
+/*
+ * Store one state word of a vector into all lanes
+ */
+#define STORE_LANES(vector, blocks, member, wordIndex) { \
+	UINT32 laneWords[LANE_COUNT]; \
+	V_STORE(laneWords, vector); \
+	for (int lane = 0; lane < LANE_COUNT; lane++) \
+		blocks[lane]->member.w32[wordIndex] = laneWords[lane]; \
+}
+
+/*
+ * SHA-1 compression of one block of 16 words in all lanes
+ */
+static void KERNEL_SHA1_COMPRESS(VECTOR* const state, VECTOR* const w) {
+	VECTOR a = state[0];
+	VECTOR b = state[1];
+	VECTOR c = state[2];
+	VECTOR d = state[3];
+	VECTOR e = state[4];
+	VECTOR temp;
+
+#define SHA1_SCHEDULE(i) ((i) < 16 ? w[i] : (w[(i) & 15] = V_ROTL(V_XOR(V_XOR3(w[((i) - 3) & 15], w[((i) - 8) & 15], w[((i) - 14) & 15]), w[(i) & 15]), 1)))
+
+#define SHA1_ROUND(i, f, k) \
+	temp = V_ADD(V_ADD(V_ROTL(a, 5), f), V_ADD(V_ADD(e, k), SHA1_SCHEDULE(i))); \
+	e = d; \
+	d = c; \
+	c = V_ROTL(b, 30); \
+	b = a; \
+	a = temp;
+
+	const VECTOR k0 = V_SET1(0x5a827999);
+	const VECTOR k1 = V_SET1(0x6ed9eba1);
+	const VECTOR k2 = V_SET1(0x8f1bbcdc);
+	const VECTOR k3 = V_SET1(0xca62c1d6);
+
+	for (int i = 0; i < 20; i++) {
+		SHA1_ROUND(i, V_CH(b, c, d), k0)
+	}
+
+	for (int i = 20; i < 40; i++) {
+		SHA1_ROUND(i, V_XOR3(b, c, d), k1)
+	}
+
+	for (int i = 40; i < 60; i++) {
+		SHA1_ROUND(i, V_MAJ(b, c, d), k2)
+	}
+
+	for (int i = 60; i < 80; i++) {
+		SHA1_ROUND(i, V_XOR3(b, c, d), k3)
+	}
+
+#undef SHA1_ROUND
+#undef SHA1_SCHEDULE
+
+	state[0] = V_ADD(state[0], a);
+	state[1] = V_ADD(state[1], b);
+	state[2] = V_ADD(state[2], c);
+	state[3] = V_ADD(state[3], d);
+	state[4] = V_ADD(state[4], e);
+}
+
+/*
+ * SHA-256 compression of one block of 16 words in all lanes
+ */
+static void KERNEL_SHA256_COMPRESS(VECTOR* const state, VECTOR* const w) {
+	VECTOR a = state[0];
+	VECTOR b = state[1];
+	VECTOR c = state[2];
+	VECTOR d = state[3];
+	VECTOR e = state[4];
+	VECTOR f = state[5];
+	VECTOR g = state[6];
+	VECTOR h = state[7];
+
+	for (int i = 0; i < 64; i++) {
+		VECTOR wi;
+
+		if (i < 16)
+			wi = w[i];
+		else {
+			const VECTOR w15 = w[(i + 1) & 15];
+			const VECTOR w2 = w[(i + 14) & 15];
+			const VECTOR s0 = V_XOR3(V_ROTR(w15, 7), V_ROTR(w15, 18), V_SHR(w15, 3));
+			const VECTOR s1 = V_XOR3(V_ROTR(w2, 17), V_ROTR(w2, 19), V_SHR(w2, 10));
+
+			wi = V_ADD(V_ADD(w[i & 15], s0), V_ADD(w[(i + 9) & 15], s1));
+			w[i & 15] = wi;
+		}
+
+		const VECTOR s1 = V_XOR3(V_ROTR(e, 6), V_ROTR(e, 11), V_ROTR(e, 25));
+		const VECTOR temp1 = V_ADD(V_ADD(V_ADD(h, s1), V_CH(e, f, g)), V_ADD(V_SET1(KERNEL_SHA256_K[i]), wi));
+		const VECTOR s0 = V_XOR3(V_ROTR(a, 2), V_ROTR(a, 13), V_ROTR(a, 22));
+		const VECTOR temp2 = V_ADD(s0, V_MAJ(a, b, c));
+
+		h = g;
+		g = f;
+		f = e;
+		e = V_ADD(d, temp1);
+		d = c;
+		c = b;
+		b = a;
+		a = V_ADD(temp1, temp2);
+	}
+
+	state[0] = V_ADD(state[0], a);
+	state[1] = V_ADD(state[1], b);
+	state[2] = V_ADD(state[2], c);
+	state[3] = V_ADD(state[3], d);
+	state[4] = V_ADD(state[4], e);
+	state[5] = V_ADD(state[5], f);
+	state[6] = V_ADD(state[6], g);
+	state[7] = V_ADD(state[7], h);
+}
+
+/*
+ * Iterate all lanes. The message of each compression is the previous digest followed by the padding
+ * of a message that is one block and one digest long, as the HMAC key block is already in the states.
+ */
+#define KERNEL_BODY(wordCount, digestSize, compress) { \
+	VECTOR innerState[wordCount]; \
+	VECTOR outerState[wordCount]; \
+	VECTOR u[wordCount]; \
+	VECTOR t[wordCount]; \
+	VECTOR state[wordCount]; \
+	VECTOR w[16]; \
+\
+	for (int i = 0; i < wordCount; i++) { \
+		LOAD_LANES(u[i], blocks, u, i) \
+		LOAD_LANES(t[i], blocks, t, i) \
+		\
+		UINT32 laneWords[LANE_COUNT]; \
+		for (int lane = 0; lane < LANE_COUNT; lane++) \
+			laneWords[lane] = blocks[lane]->pKey->innerState.w32[i]; \
+		innerState[i] = V_LOAD(laneWords); \
+		for (int lane = 0; lane < LANE_COUNT; lane++) \
+			laneWords[lane] = blocks[lane]->pKey->outerState.w32[i]; \
+		outerState[i] = V_LOAD(laneWords); \
+	} \
+\
+	const VECTOR padding = V_SET1(0x80000000); \
+	const VECTOR zero = V_SET1(0); \
+	const VECTOR messageBits = V_SET1((64 + (digestSize)) << 3); \
+\
+	for (ULONG iteration = 0; iteration < iterationCount; iteration++) { \
+		for (int i = 0; i < wordCount; i++) { \
+			w[i] = u[i]; \
+			state[i] = innerState[i]; \
+		} \
+		w[wordCount] = padding; \
+		for (int i = wordCount + 1; i < 15; i++) \
+			w[i] = zero; \
+		w[15] = messageBits; \
+\
+		compress(state, w); \
+\
+		for (int i = 0; i < wordCount; i++) { \
+			w[i] = state[i]; \
+			state[i] = outerState[i]; \
+		} \
+		w[wordCount] = padding; \
+		for (int i = wordCount + 1; i < 15; i++) \
+			w[i] = zero; \
+		w[15] = messageBits; \
+\
+		compress(state, w); \
+\
+		for (int i = 0; i < wordCount; i++) { \
+			u[i] = state[i]; \
+			t[i] = V_XOR(t[i], state[i]); \
+		} \
+	} \
+\
+	for (int i = 0; i < wordCount; i++) { \
+		STORE_LANES(u[i], blocks, u, i) \
+		STORE_LANES(t[i], blocks, t, i) \
+	} \
+}
+
+/*
+ * Perform iterationCount PBKDF2-HMAC-SHA1 iterations on LANE_COUNT blocks
+ */
+void KERNEL_SHA1(NATIVE_BLOCK_STATE* const blocks[], const ULONG iterationCount) {
+	KERNEL_BODY(5, 20, KERNEL_SHA1_COMPRESS)
+}
+
+/*
+ * Perform iterationCount PBKDF2-HMAC-SHA256 iterations on LANE_COUNT blocks
+ */
+void KERNEL_SHA256(NATIVE_BLOCK_STATE* const blocks[], const ULONG iterationCount) {
+	KERNEL_BODY(8, 32, KERNEL_SHA256_COMPRESS)
+}
+
+#undef KERNEL_BODY
+#undef LOAD_LANES
+#undef STORE_LANES
@@ -0,0 +1,855 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.4.1
+*
+* Native PBKDF2 engine that does not use the CNG API
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created with multi-buffer SIMD kernels for SHA-1 and SHA-256
+*     2026-10-14: V1.1.0: Single-stream kernels with the SHA extensions
+*     2026-10-14: V1.2.0: Calculate the blocks of multi-block keys in parallel
+*     2026-10-14: V1.3.0: Calculate several salts with an HMAC key that is prepared once per password
+*     2026-10-14: V1.4.0: Scalar kernels for SHA-1 and SHA-256 that are specialized at compile time
+*     2026-10-14: V1.4.1: Multi-buffer blocks in a buffer on the stack instead of the heap
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Native.h"
+
+#include <tchar.h>
+
+#include <intrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * DEFINES
+ */
+
+/*
+ * Lane counts of the multi-buffer kernels
+ */
+#define AVX2_LANE_COUNT   8
+#define AVX512_LANE_COUNT 16
+
+/*
+ * If at most this number of blocks is left over after all full lane groups
+ * they are calculated with the scalar code, as a kernel call would cost more.
+ * A kernel call costs between one and two scalar block calculations.
+ */
+#define MAX_SCALAR_REMAINDER 1
+
+/*
+ * Number of blocks that the multi-buffer kernels calculate from one buffer on the stack.
+ * It is a multiple of both lane counts, so only the last buffer of a call can have a partial lane group.
+ */
+#define MULTI_BUFFER_CHUNK_SIZE (2 * AVX512_LANE_COUNT)
+
+/*
+ * Rotation and byte order macros
+ */
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define LOAD_BIG_ENDIAN_32(p) (((UINT32)(p)[0] << 24) | ((UINT32)(p)[1] << 16) | ((UINT32)(p)[2] << 8) | (UINT32)(p)[3])
+
+#define STORE_BIG_ENDIAN_32(p, v) { (p)[0] = (TOCTET)((v) >> 24); (p)[1] = (TOCTET)((v) >> 16); (p)[2] = (TOCTET)((v) >> 8); (p)[3] = (TOCTET)(v); }
+
+/*
+ * Properties of the hash functions
+ */
+typedef struct {
+	int blockSize;
+	int digestSize;
+	int stateWordCount;
+	void (*compress)(NATIVE_HASH_STATE* const pState, const UINT32* const w);
+	NATIVE_HASH_STATE initialState;
+} NATIVE_HASH_INFO;
+
+/*
+ * Streaming hash context for the messages that are not a fixed size, i.e. the password and the salt
+ */
+typedef struct {
+	const NATIVE_HASH_INFO* pInfo;
+	NATIVE_HASH_STATE state;
+	TOCTET buffer[NATIVE_MAX_BLOCK_SIZE];
+	int bufferSize;
+	UINT64 messageSize;
+} NATIVE_HASH_CONTEXT;
+
+/*
+ * SHA-256 round constants
+ */
+static const UINT32 SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * Process one block of 16 words with SHA-1
+ */
+static __forceinline void sha1Compress(NATIVE_HASH_STATE* const pState, const UINT32* const block) {
+	UINT32 w[80];
+
+	for (int i = 0; i < 16; i++)
+		w[i] = block[i];
+
+	for (int i = 16; i < 80; i++)
+		w[i] = ROTL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	UINT32 a = pState->w32[0];
+	UINT32 b = pState->w32[1];
+	UINT32 c = pState->w32[2];
+	UINT32 d = pState->w32[3];
+	UINT32 e = pState->w32[4];
+
+	for (int i = 0; i < 80; i++) {
+		UINT32 f;
+		UINT32 k;
+
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+
+		const UINT32 temp = ROTL32(a, 5) + f + e + k + w[i];
+
+		e = d;
+		d = c;
+		c = ROTL32(b, 30);
+		b = a;
+		a = temp;
+	}
+
+	pState->w32[0] += a;
+	pState->w32[1] += b;
+	pState->w32[2] += c;
+	pState->w32[3] += d;
+	pState->w32[4] += e;
+}
+
+/*
+ * Process one block of 16 words with SHA-256
+ */
+static __forceinline void sha256Compress(NATIVE_HASH_STATE* const pState, const UINT32* const block) {
+	UINT32 w[64];
+
+	for (int i = 0; i < 16; i++)
+		w[i] = block[i];
+
+	for (int i = 16; i < 64; i++) {
+		const UINT32 s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const UINT32 s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	UINT32 a = pState->w32[0];
+	UINT32 b = pState->w32[1];
+	UINT32 c = pState->w32[2];
+	UINT32 d = pState->w32[3];
+	UINT32 e = pState->w32[4];
+	UINT32 f = pState->w32[5];
+	UINT32 g = pState->w32[6];
+	UINT32 h = pState->w32[7];
+
+	for (int i = 0; i < 64; i++) {
+		const UINT32 s1 = ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25);
+		const UINT32 ch = (e & f) ^ (~e & g);
+		const UINT32 temp1 = h + s1 + ch + SHA256_K[i] + w[i];
+		const UINT32 s0 = ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22);
+		const UINT32 maj = (a & b) ^ (a & c) ^ (b & c);
+		const UINT32 temp2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+	}
+
+	pState->w32[0] += a;
+	pState->w32[1] += b;
+	pState->w32[2] += c;
+	pState->w32[3] += d;
+	pState->w32[4] += e;
+	pState->w32[5] += f;
+	pState->w32[6] += g;
+	pState->w32[7] += h;
+}
+
+/*
+ * Properties of the hash functions, indexed by NATIVE_HASH
+ */
+static const NATIVE_HASH_INFO HASH_INFO[NATIVE_HASH_COUNT] = {
+	{ 64, 20, 5, sha1Compress, { { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 } } },
+	{ 64, 32, 8, sha256Compress, { { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 } } }
+};
+
+/*
+ * Start a hash calculation from a given state after a given number of message bytes have already been processed
+ */
+static void hashInitialize(NATIVE_HASH_CONTEXT* const pContext, const NATIVE_HASH hash, const NATIVE_HASH_STATE* const pState, const UINT64 processedSize) {
+	pContext->pInfo = &HASH_INFO[hash];
+	pContext->state = *pState;
+	pContext->bufferSize = 0;
+	pContext->messageSize = processedSize;
+}
+
+/*
+ * Process the full buffer of a hash context
+ */
+static void hashProcessBuffer(NATIVE_HASH_CONTEXT* const pContext) {
+	UINT32 w[16];
+
+	for (int i = 0; i < 16; i++)
+		w[i] = LOAD_BIG_ENDIAN_32(&pContext->buffer[i << 2]);
+
+	pContext->pInfo->compress(&pContext->state, w);
+
+	pContext->bufferSize = 0;
+}
+
+/*
+ * Add message bytes to a hash calculation
+ */
+static void hashUpdate(NATIVE_HASH_CONTEXT* const pContext, const TOCTET* data, ULONG dataSize) {
+	const int blockSize = pContext->pInfo->blockSize;
+
+	pContext->messageSize += dataSize;
+
+	while (dataSize > 0) {
+		ULONG copySize = (ULONG)(blockSize - pContext->bufferSize);
+
+		if (copySize > dataSize)
+			copySize = dataSize;
+
+		memcpy(&pContext->buffer[pContext->bufferSize], data, copySize);
+
+		pContext->bufferSize += (int)copySize;
+		data += copySize;
+		dataSize -= copySize;
+
+		if (pContext->bufferSize == blockSize)
+			hashProcessBuffer(pContext);
+	}
+}
+
+/*
+ * Finish a hash calculation and return the digest as state words
+ */
+static void hashFinalize(NATIVE_HASH_CONTEXT* const pContext, NATIVE_HASH_STATE* const pDigest) {
+	const int blockSize = pContext->pInfo->blockSize;
+	const UINT64 messageBits = pContext->messageSize << 3;
+
+	pContext->buffer[pContext->bufferSize] = 0x80;
+	pContext->bufferSize++;
+
+	if (pContext->bufferSize > blockSize - 8) {
+		memset(&pContext->buffer[pContext->bufferSize], 0, blockSize - pContext->bufferSize);
+		hashProcessBuffer(pContext);
+	}
+
+	memset(&pContext->buffer[pContext->bufferSize], 0, blockSize - 8 - pContext->bufferSize);
+
+	STORE_BIG_ENDIAN_32(&pContext->buffer[blockSize - 8], (UINT32)(messageBits >> 32));
+	STORE_BIG_ENDIAN_32(&pContext->buffer[blockSize - 4], (UINT32)messageBits);
+
+	hashProcessBuffer(pContext);
+
+	*pDigest = pContext->state;
+}
+
+/*
+ * Write the digest words of a state as bytes
+ */
+static void stateToBytes(const NATIVE_HASH_STATE* const pState, TOCTET* const output, const ULONG outputSize) {
+	for (ULONG i = 0; i < outputSize; i++)
+		output[i] = (TOCTET)(pState->w32[i >> 2] >> (24 - ((i & 3) << 3)));
+}
+
+/*
+ * Get the digest size of a hash function in bytes
+ */
+int nativeGetDigestSize(const NATIVE_HASH hash) {
+	return HASH_INFO[hash].digestSize;
+}
+
+/*
+ * Calculate the HMAC key states of a password
+ */
+void nativePrepareHmacKey(NATIVE_HMAC_KEY* const pKey, const NATIVE_HASH hash, const TOCTET* const password, const ULONG passwordSize) {
+	const NATIVE_HASH_INFO* const pInfo = &HASH_INFO[hash];
+
+	TOCTET key[NATIVE_MAX_BLOCK_SIZE];
+	TOCTET pad[NATIVE_MAX_BLOCK_SIZE];
+	UINT32 w[16];
+
+	NATIVE_HASH_CONTEXT context;
+
+	memset(key, 0, sizeof(key));
+
+	// Keys that are longer than the block size are replaced by their hash
+	if (passwordSize > (ULONG)pInfo->blockSize) {
+		NATIVE_HASH_STATE digest;
+
+		hashInitialize(&context, hash, &pInfo->initialState, 0);
+		hashUpdate(&context, password, passwordSize);
+		hashFinalize(&context, &digest);
+
+		stateToBytes(&digest, key, (ULONG)pInfo->digestSize);
+	} else
+		memcpy(key, password, passwordSize);
+
+	pKey->hash = hash;
+
+	for (int i = 0; i < pInfo->blockSize; i++)
+		pad[i] = key[i] ^ 0x36;
+
+	for (int i = 0; i < 16; i++)
+		w[i] = LOAD_BIG_ENDIAN_32(&pad[i << 2]);
+
+	pKey->innerState = pInfo->initialState;
+	pInfo->compress(&pKey->innerState, w);
+
+	for (int i = 0; i < pInfo->blockSize; i++)
+		pad[i] = key[i] ^ 0x5c;
+
+	for (int i = 0; i < 16; i++)
+		w[i] = LOAD_BIG_ENDIAN_32(&pad[i << 2]);
+
+	pKey->outerState = pInfo->initialState;
+	pInfo->compress(&pKey->outerState, w);
+
+	SecureZeroMemory(key, sizeof(key));
+	SecureZeroMemory(pad, sizeof(pad));
+	SecureZeroMemory(w, sizeof(w));
+}
+
+/*
+ * Initialize the state of block number blockNumber with U_1 = HMAC(password, salt || INT(blockNumber))
+ */
+void nativeInitializeBlock(NATIVE_BLOCK_STATE* const pBlock, const NATIVE_HMAC_KEY* const pKey, const TOCTET* const salt, const ULONG saltSize, const ULONG blockNumber) {
+	const NATIVE_HASH_INFO* const pInfo = &HASH_INFO[pKey->hash];
+
+	TOCTET blockNumberBytes[4];
+	TOCTET innerDigest[NATIVE_MAX_DIGEST_SIZE];
+
+	NATIVE_HASH_CONTEXT context;
+	NATIVE_HASH_STATE digest;
+
+	STORE_BIG_ENDIAN_32(blockNumberBytes, blockNumber);
+
+	hashInitialize(&context, pKey->hash, &pKey->innerState, (UINT64)pInfo->blockSize);
+	hashUpdate(&context, salt, saltSize);
+	hashUpdate(&context, blockNumberBytes, sizeof(blockNumberBytes));
+	hashFinalize(&context, &digest);
+
+	stateToBytes(&digest, innerDigest, (ULONG)pInfo->digestSize);
+
+	hashInitialize(&context, pKey->hash, &pKey->outerState, (UINT64)pInfo->blockSize);
+	hashUpdate(&context, innerDigest, (ULONG)pInfo->digestSize);
+	hashFinalize(&context, &digest);
+
+	pBlock->pKey = pKey;
+	pBlock->u = digest;
+	pBlock->t = digest;
+}
+
+/*
+ * Define a scalar kernel that performs further iterations on one block with one hash function.
+ * The message of each compression is the previous digest followed by the fixed padding of a
+ * message that is one block plus one digest long, as the HMAC key block has already been processed.
+ * The compression function and the sizes are constants of each kernel, so the compression is inlined,
+ * the word loops are unrolled and U_j stays in the message words instead of being copied through the block state.
+ */
+#define DEFINE_SCALAR_KERNEL(KERNEL_NAME, COMPRESS, WORD_COUNT, BLOCK_SIZE) \
+static void KERNEL_NAME(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount) { \
+	const NATIVE_HMAC_KEY* const pKey = pBlock->pKey; \
+	\
+	NATIVE_HASH_STATE state; \
+	UINT32 t[WORD_COUNT]; \
+	UINT32 w[16]; \
+	\
+	for (int i = 0; i < WORD_COUNT; i++) { \
+		w[i] = pBlock->u.w32[i]; \
+		t[i] = pBlock->t.w32[i]; \
+	} \
+	\
+	w[WORD_COUNT] = 0x80000000; \
+	\
+	for (int i = WORD_COUNT + 1; i < 15; i++) \
+		w[i] = 0; \
+	\
+	w[15] = (UINT32)(((BLOCK_SIZE) + (WORD_COUNT) * 4) << 3); \
+	\
+	for (ULONG iteration = 0; iteration < iterationCount; iteration++) { \
+		for (int i = 0; i < WORD_COUNT; i++) \
+			state.w32[i] = pKey->innerState.w32[i]; \
+		\
+		COMPRESS(&state, w); \
+		\
+		for (int i = 0; i < WORD_COUNT; i++) { \
+			w[i] = state.w32[i]; \
+			state.w32[i] = pKey->outerState.w32[i]; \
+		} \
+		\
+		COMPRESS(&state, w); \
+		\
+		for (int i = 0; i < WORD_COUNT; i++) { \
+			w[i] = state.w32[i]; \
+			t[i] ^= state.w32[i]; \
+		} \
+	} \
+	\
+	for (int i = 0; i < WORD_COUNT; i++) { \
+		pBlock->u.w32[i] = w[i]; \
+		pBlock->t.w32[i] = t[i]; \
+	} \
+	\
+	SecureZeroMemory(&state, sizeof(state)); \
+	SecureZeroMemory(t, sizeof(t)); \
+	SecureZeroMemory(w, sizeof(w)); \
+}
+
+DEFINE_SCALAR_KERNEL(scalarIterateSha1, sha1Compress, 5, 64)
+DEFINE_SCALAR_KERNEL(scalarIterateSha256, sha256Compress, 8, 64)
+
+/*
+ * Scalar kernels, indexed by NATIVE_HASH
+ */
+static const NATIVE_SINGLE_STREAM_KERNEL SCALAR_KERNELS[NATIVE_HASH_COUNT] = { scalarIterateSha1, scalarIterateSha256 };
+
+/*
+ * Perform further iterations on one block with the scalar kernel of its hash function.
+ * The engine functions select the kernel of their hash function only once for all of their blocks.
+ */
+void nativeIterateBlockScalar(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount) {
+	SCALAR_KERNELS[pBlock->pKey->hash](pBlock, iterationCount);
+}
+
+/*
+ * Write T of a block as bytes
+ */
+void nativeGetBlockResult(const NATIVE_BLOCK_STATE* const pBlock, TOCTET* const output, const ULONG outputSize) {
+	stateToBytes(&pBlock->t, output, outputSize);
+}
+
+/*
+ * Multi-buffer kernels per hash function for each instruction set, indexed by NATIVE_HASH
+ */
+static const NATIVE_MULTI_BUFFER_KERNEL AVX2_KERNELS[NATIVE_HASH_COUNT] = { multiBufferSha1Avx2, multiBufferSha256Avx2 };
+static const NATIVE_MULTI_BUFFER_KERNEL AVX512_KERNELS[NATIVE_HASH_COUNT] = { multiBufferSha1Avx512, multiBufferSha256Avx512 };
+
+/*
+ * Single-stream kernels with the SHA extensions, indexed by NATIVE_HASH
+ */
+static const NATIVE_SINGLE_STREAM_KERNEL SHA_NI_KERNELS[NATIVE_HASH_COUNT] = { shaNiIterateSha1, shaNiIterateSha256 };
+
+/*
+ * Results of the processor feature detection. A value of -1 means "not yet detected".
+ */
+static volatile LONG multiBufferLaneCount = -1;
+static volatile LONG shaNiSupport = -1;
+
+/*
+ * Detect which multi-buffer kernels can be used with CPUID and XGETBV.
+ * The kernels need the processor support and the operating system has to save the vector registers.
+ */
+static int detectMultiBufferLaneCount(void) {
+	int cpuInfo[4];
+
+	const int REGISTER_EBX = 1;
+	const int REGISTER_ECX = 2;
+
+	const int OSXSAVE_BIT = 1 << 27;
+	const int AVX_BIT = 1 << 28;
+	const int AVX2_BIT = 1 << 5;
+	const int AVX512F_BIT = 1 << 16;
+
+	// XMM and YMM state, and additionally the opmask and ZMM state
+	const unsigned long long XCR0_AVX_STATE = 0x06;
+	const unsigned long long XCR0_AVX512_STATE = 0xe6;
+
+	__cpuid(cpuInfo, 0);
+
+	if (cpuInfo[0] < 7)
+		return 0;
+
+	__cpuid(cpuInfo, 1);
+
+	if (((cpuInfo[REGISTER_ECX] & OSXSAVE_BIT) == 0) || ((cpuInfo[REGISTER_ECX] & AVX_BIT) == 0))
+		return 0;
+
+	const unsigned long long xcr0 = _xgetbv(0);
+
+	if ((xcr0 & XCR0_AVX_STATE) != XCR0_AVX_STATE)
+		return 0;
+
+	__cpuidex(cpuInfo, 7, 0);
+
+	if (((cpuInfo[REGISTER_EBX] & AVX512F_BIT) != 0) && ((xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE))
+		return AVX512_LANE_COUNT;
+
+	if ((cpuInfo[REGISTER_EBX] & AVX2_BIT) != 0)
+		return AVX2_LANE_COUNT;
+
+	return 0;
+}
+
+/*
+ * Detect with CPUID if the SHA extensions and the SSE instructions that the single-stream kernels use are available
+ */
+static LONG detectShaNiSupport(void) {
+	int cpuInfo[4];
+
+	const int REGISTER_EBX = 1;
+	const int REGISTER_ECX = 2;
+
+	const int SSSE3_BIT = 1 << 9;
+	const int SSE41_BIT = 1 << 19;
+	const int SHA_BIT = 1 << 29;
+
+	__cpuid(cpuInfo, 0);
+
+	if (cpuInfo[0] < 7)
+		return 0;
+
+	__cpuid(cpuInfo, 1);
+
+	if (((cpuInfo[REGISTER_ECX] & SSSE3_BIT) == 0) || ((cpuInfo[REGISTER_ECX] & SSE41_BIT) == 0))
+		return 0;
+
+	__cpuidex(cpuInfo, 7, 0);
+
+	return ((cpuInfo[REGISTER_EBX] & SHA_BIT) != 0) ? 1 : 0;
+}
+
+/*
+ * Check if the processor supports the SHA extensions that the single-stream kernels need
+ */
+BOOLEAN nativeIsShaNiSupported(void) {
+	if (shaNiSupport < 0)
+		InterlockedExchange(&shaNiSupport, detectShaNiSupport());
+
+	return (BOOLEAN)(shaNiSupport != 0);
+}
+
+/*
+ * Get the number of SIMD lanes of the multi-buffer kernels on this processor. 0 means that there are no usable kernels.
+ */
+int nativeGetMultiBufferLaneCount(void) {
+	if (multiBufferLaneCount < 0)
+		InterlockedExchange(&multiBufferLaneCount, detectMultiBufferLaneCount());
+
+	return (int)multiBufferLaneCount;
+}
+
+/*
+ * Get the name of the instruction set of the multi-buffer kernels
+ */
+const TCHAR* nativeGetMultiBufferInstructionSet(void) {
+	switch (nativeGetMultiBufferLaneCount()) {
+	case AVX512_LANE_COUNT:
+		return _T("AVX-512");
+
+	case AVX2_LANE_COUNT:
+		return _T("AVX2");
+
+	default:
+		return _T("none");
+	}
+}
+
+/*
+ * Calculate PBKDF2 for several requests on the lanes of the multi-buffer kernels.
+ * If pSharedKey is not NULL all requests use this key and their passwords are ignored.
+ * Otherwise the key of each request is calculated from its password.
+ * The blocks of the requests are calculated in buffers of MULTI_BUFFER_CHUNK_SIZE blocks on the stack, so there are no heap calls.
+ * A request whose blocks do not fit into one buffer is continued in the next one with a copy of its key.
+ */
+static BOOLEAN multiBufferRequests(const NATIVE_HASH hash,
+											  const NATIVE_HMAC_KEY* const pSharedKey,
+											  const ULONG iterationCount,
+											  NATIVE_PBKDF2_REQUEST* const requests,
+											  const int requestCount) {
+	const int laneCount = nativeGetMultiBufferLaneCount();
+
+	if ((hash < 0) || (hash >= NATIVE_HASH_COUNT) || (laneCount == 0))
+		return FALSE;
+
+	const NATIVE_MULTI_BUFFER_KERNEL kernel = (laneCount == AVX512_LANE_COUNT) ? AVX512_KERNELS[hash] : AVX2_KERNELS[hash];
+	const NATIVE_SINGLE_STREAM_KERNEL scalarKernel = SCALAR_KERNELS[hash];
+
+	const ULONG digestSize = (ULONG)HASH_INFO[hash].digestSize;
+
+	// The first iteration is done while initializing the blocks
+	const ULONG kernelIterationCount = iterationCount - 1;
+
+	NATIVE_HMAC_KEY keys[MULTI_BUFFER_CHUNK_SIZE];
+	NATIVE_BLOCK_STATE blocks[MULTI_BUFFER_CHUNK_SIZE];
+	TOCTET* outputs[MULTI_BUFFER_CHUNK_SIZE];
+	ULONG outputSizes[MULTI_BUFFER_CHUNK_SIZE];
+
+	NATIVE_BLOCK_STATE* lanes[AVX512_LANE_COUNT];
+	NATIVE_BLOCK_STATE dummyBlocks[AVX512_LANE_COUNT];
+
+	int requestIndex = 0;
+	ULONG offset = 0;         // Offset of the next block in the derived key of the current request
+	int keyIndex = 0;         // Index of the key of the current request
+
+	while (requestIndex < requestCount) {
+		int blockCount = 0;
+		int keyCount = 0;
+
+		// Fill the buffer with the next blocks in the order of the requests
+		while ((requestIndex < requestCount) && (blockCount < MULTI_BUFFER_CHUNK_SIZE)) {
+			NATIVE_PBKDF2_REQUEST* const pRequest = &requests[requestIndex];
+
+			const NATIVE_HMAC_KEY* pKey = pSharedKey;
+
+			if (pKey == NULL) {
+				if (offset == 0)
+					nativePrepareHmacKey(&keys[keyCount], hash, pRequest->password, pRequest->passwordSize);
+				else if (keyIndex != keyCount)
+					keys[keyCount] = keys[keyIndex];
+
+				keyIndex = keyCount;
+				pKey = &keys[keyCount];
+				keyCount++;
+			}
+
+			for (; (offset < pRequest->derivedKeySize) && (blockCount < MULTI_BUFFER_CHUNK_SIZE); offset += digestSize) {
+				nativeInitializeBlock(&blocks[blockCount], pKey, pRequest->salt, pRequest->saltSize, offset / digestSize + 1);
+
+				outputs[blockCount] = &pRequest->derivedKey[offset];
+				outputSizes[blockCount] = min(digestSize, pRequest->derivedKeySize - offset);
+
+				blockCount++;
+			}
+
+			if (offset >= pRequest->derivedKeySize) {
+				requestIndex++;
+				offset = 0;
+			}
+		}
+
+		/*
+		 * The blocks are processed in groups of laneCount blocks. A partial last group
+		 * is filled up with copies of its last block whose results are not used.
+		 */
+		for (int groupStart = 0; groupStart < blockCount; groupStart += laneCount) {
+			const int groupSize = min(laneCount, blockCount - groupStart);
+
+			if (groupSize <= MAX_SCALAR_REMAINDER)
+				for (int i = 0; i < groupSize; i++)
+					scalarKernel(&blocks[groupStart + i], kernelIterationCount);
+			else {
+				for (int i = 0; i < laneCount; i++)
+					if (i < groupSize)
+						lanes[i] = &blocks[groupStart + i];
+					else {
+						dummyBlocks[i] = blocks[groupStart + groupSize - 1];
+						lanes[i] = &dummyBlocks[i];
+					}
+
+				kernel(lanes, kernelIterationCount);
+			}
+		}
+
+		for (int i = 0; i < blockCount; i++)
+			nativeGetBlockResult(&blocks[i], outputs[i], outputSizes[i]);
+	}
+
+	SecureZeroMemory(keys, sizeof(keys));
+	SecureZeroMemory(blocks, sizeof(blocks));
+	SecureZeroMemory(dummyBlocks, sizeof(dummyBlocks));
+
+	return TRUE;
+}
+
+/*
+ * Calculate PBKDF2 for several independent requests with the same hash function and iteration count.
+ * The blocks of all requests are distributed over the lanes of the multi-buffer kernels.
+ * Returns FALSE if the hash function is not supported or there are no multi-buffer kernels.
+ */
+BOOLEAN nativePBKDF2MultiBuffer(const NATIVE_HASH hash,
+										  const ULONG iterationCount,
+										  NATIVE_PBKDF2_REQUEST* const requests,
+										  const int requestCount) {
+	return multiBufferRequests(hash, NULL, iterationCount, requests, requestCount);
+}
+
+/*
+ * The blocks of one request that are calculated by the single-stream kernels.
+ * Each thread takes the next block number until all blocks are calculated.
+ */
+typedef struct {
+	NATIVE_SINGLE_STREAM_KERNEL kernel;
+	const NATIVE_HMAC_KEY* pKey;
+	NATIVE_PBKDF2_REQUEST* pRequest;
+	ULONG iterationCount;
+	ULONG digestSize;
+	LONG blockCount;
+	volatile LONG lastBlockNumber;
+} SINGLE_STREAM_BLOCKS;
+
+/*
+ * Calculate blocks of a request until there are no more blocks left
+ */
+static void calculateSingleStreamBlocks(SINGLE_STREAM_BLOCKS* const pBlocks) {
+	NATIVE_PBKDF2_REQUEST* const pRequest = pBlocks->pRequest;
+
+	NATIVE_BLOCK_STATE block;
+
+	LONG blockNumber;
+
+	while ((blockNumber = InterlockedIncrement(&pBlocks->lastBlockNumber)) <= pBlocks->blockCount) {
+		const ULONG offset = (ULONG)(blockNumber - 1) * pBlocks->digestSize;
+
+		nativeInitializeBlock(&block, pBlocks->pKey, pRequest->salt, pRequest->saltSize, (ULONG)blockNumber);
+
+		// The first iteration has been done while initializing the block
+		pBlocks->kernel(&block, pBlocks->iterationCount - 1);
+
+		nativeGetBlockResult(&block, &pRequest->derivedKey[offset], min(pBlocks->digestSize, pRequest->derivedKeySize - offset));
+	}
+
+	SecureZeroMemory(&block, sizeof(block));
+}
+
+/*
+ * Thread pool callback that calculates blocks of a request
+ */
+static VOID CALLBACK singleStreamBlocksCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work) {
+	UNREFERENCED_PARAMETER(instance);
+	UNREFERENCED_PARAMETER(work);
+
+	calculateSingleStreamBlocks((SINGLE_STREAM_BLOCKS*)context);
+}
+
+/*
+ * Calculate PBKDF2 for one request with the SHA extensions.
+ * The blocks of the request are independent of each other. If isParallel is set and the request has more than one block
+ * the blocks are calculated at the same time by the calling thread and threads of the default thread pool.
+ * Otherwise they are calculated one after the other.
+ * Returns FALSE if the hash function or the SHA extensions are not supported.
+ */
+BOOLEAN nativePBKDF2ShaNi(const NATIVE_HASH hash,
+								  const ULONG iterationCount,
+								  NATIVE_PBKDF2_REQUEST* const pRequest,
+								  const BOOLEAN isParallel) {
+	if ((hash < 0) || (hash >= NATIVE_HASH_COUNT) || !nativeIsShaNiSupported())
+		return FALSE;
+
+	NATIVE_HMAC_KEY key;
+	SINGLE_STREAM_BLOCKS blocks;
+
+	// The pad states are calculated only once for all blocks and iterations
+	nativePrepareHmacKey(&key, hash, pRequest->password, pRequest->passwordSize);
+
+	blocks.kernel = SHA_NI_KERNELS[hash];
+	blocks.pKey = &key;
+	blocks.pRequest = pRequest;
+	blocks.iterationCount = iterationCount;
+	blocks.digestSize = (ULONG)HASH_INFO[hash].digestSize;
+	blocks.blockCount = (LONG)((pRequest->derivedKeySize + blocks.digestSize - 1) / blocks.digestSize);
+	blocks.lastBlockNumber = 0;
+
+	PTP_WORK work = NULL;
+
+	// If the work can not be created all blocks are calculated by the calling thread
+	if (isParallel && (blocks.blockCount > 1))
+		work = CreateThreadpoolWork(singleStreamBlocksCallback, &blocks, NULL);
+
+	if (work != NULL)
+		for (LONG i = 1; i < blocks.blockCount; i++)
+			SubmitThreadpoolWork(work);
+
+	calculateSingleStreamBlocks(&blocks);
+
+	if (work != NULL) {
+		WaitForThreadpoolWorkCallbacks(work, FALSE);
+		CloseThreadpoolWork(work);
+	}
+
+	SecureZeroMemory(&key, sizeof(key));
+
+	return TRUE;
+}
+
+/*
+ * Calculate PBKDF2 for several requests with an HMAC key that has been prepared once for their common password.
+ * The passwords of the requests are ignored. Several requests are distributed over the lanes of the multi-buffer kernels.
+ * A single request, or all requests if there are no multi-buffer kernels, are calculated one after the other
+ * with the SHA extensions or with the portable scalar code.
+ * Returns FALSE if the hash function is not supported.
+ */
+BOOLEAN nativePBKDF2WithKey(const NATIVE_HMAC_KEY* const pKey,
+									 const ULONG iterationCount,
+									 NATIVE_PBKDF2_REQUEST* const requests,
+									 const int requestCount) {
+	const NATIVE_HASH hash = pKey->hash;
+
+	if ((hash < 0) || (hash >= NATIVE_HASH_COUNT))
+		return FALSE;
+
+	if ((requestCount > 1) && (nativeGetMultiBufferLaneCount() != 0))
+		return multiBufferRequests(hash, pKey, iterationCount, requests, requestCount);
+
+	SINGLE_STREAM_BLOCKS blocks;
+
+	blocks.kernel = nativeIsShaNiSupported() ? SHA_NI_KERNELS[hash] : SCALAR_KERNELS[hash];
+	blocks.pKey = pKey;
+	blocks.iterationCount = iterationCount;
+	blocks.digestSize = (ULONG)HASH_INFO[hash].digestSize;
+
+	for (int i = 0; i < requestCount; i++) {
+		blocks.pRequest = &requests[i];
+		blocks.blockCount = (LONG)((requests[i].derivedKeySize + blocks.digestSize - 1) / blocks.digestSize);
+		blocks.lastBlockNumber = 0;
+
+		calculateSingleStreamBlocks(&blocks);
+	}
+
+	return TRUE;
+}
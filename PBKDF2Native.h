@@ -0,0 +1,206 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.4.0
+*
+* Native PBKDF2 engine that does not use the CNG API
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created with multi-buffer SIMD kernels for SHA-1 and SHA-256
+*     2026-10-14: V1.1.0: Single-stream kernels with the SHA extensions
+*     2026-10-14: V1.2.0: Calculate the blocks of multi-block keys in parallel
+*     2026-10-14: V1.3.0: Calculate several salts with an HMAC key that is prepared once per password
+*     2026-10-14: V1.4.0: Scalar kernels for SHA-1 and SHA-256 that are specialized at compile time
+*/
+
+#pragma once
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+
+/*
+ * TYPEDEFS
+ */
+
+/*
+ * TOCTET is a data type that defines 8 binary bits and is *not* a character
+ * (Welcome to the strange world of C).
+ */
+#ifndef PBKDF2_TOCTET_DEFINED
+#define PBKDF2_TOCTET_DEFINED
+typedef UCHAR TOCTET;
+#endif
+
+/*
+ * Hash functions of the native engine
+ */
+typedef enum {
+	NATIVE_HASH_NONE = -1,
+	NATIVE_HASH_SHA1 = 0,
+	NATIVE_HASH_SHA256 = 1
+} NATIVE_HASH;
+
+#define NATIVE_HASH_COUNT 2
+
+/*
+ * Maximum sizes of the supported hash functions
+ */
+#define NATIVE_MAX_BLOCK_SIZE  64
+#define NATIVE_MAX_DIGEST_SIZE 32
+
+/*
+ * The chaining state of a hash function, which is also used for a digest in word form
+ */
+typedef union {
+	UINT32 w32[8];
+	UINT64 w64[8];
+} NATIVE_HASH_STATE;
+
+/*
+ * HMAC key of a password in the form of the hash states after the inner and the outer pad have been processed.
+ * It only needs to be calculated once per password.
+ */
+typedef struct {
+	NATIVE_HASH hash;
+	NATIVE_HASH_STATE innerState;
+	NATIVE_HASH_STATE outerState;
+} NATIVE_HMAC_KEY;
+
+/*
+ * State of the calculation of one PBKDF2 block T_i: The last U_j and the XOR of all U_j so far.
+ */
+typedef struct {
+	const NATIVE_HMAC_KEY* pKey;
+	NATIVE_HASH_STATE u;
+	NATIVE_HASH_STATE t;
+} NATIVE_BLOCK_STATE;
+
+/*
+ * A multi-buffer kernel performs a number of PBKDF2 iterations on all of its lanes at the same time
+ */
+typedef void (*NATIVE_MULTI_BUFFER_KERNEL)(NATIVE_BLOCK_STATE* const blocks[], const ULONG iterationCount);
+
+/*
+ * A single-stream kernel performs a number of PBKDF2 iterations on one block
+ */
+typedef void (*NATIVE_SINGLE_STREAM_KERNEL)(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount);
+
+/*
+ * One derivation of the native engine
+ */
+typedef struct {
+	const TOCTET* password;
+	ULONG passwordSize;
+	const TOCTET* salt;
+	ULONG saltSize;
+	TOCTET* derivedKey;
+	ULONG derivedKeySize;
+} NATIVE_PBKDF2_REQUEST;
+
+/*
+ * FUNCTIONS
+ */
+
+/*
+ * Get the digest size of a hash function in bytes
+ */
+int nativeGetDigestSize(const NATIVE_HASH hash);
+
+/*
+ * Get the number of SIMD lanes of the multi-buffer kernels on this processor. 0 means that there are no usable kernels.
+ */
+int nativeGetMultiBufferLaneCount(void);
+
+/*
+ * Get the name of the instruction set of the multi-buffer kernels
+ */
+const TCHAR* nativeGetMultiBufferInstructionSet(void);
+
+/*
+ * Check if the processor supports the SHA extensions that the single-stream kernels need
+ */
+BOOLEAN nativeIsShaNiSupported(void);
+
+/*
+ * Calculate the HMAC key states of a password
+ */
+void nativePrepareHmacKey(NATIVE_HMAC_KEY* const pKey, const NATIVE_HASH hash, const TOCTET* const password, const ULONG passwordSize);
+
+/*
+ * Initialize the state of block number blockNumber with U_1 = HMAC(password, salt || INT(blockNumber))
+ */
+void nativeInitializeBlock(NATIVE_BLOCK_STATE* const pBlock, const NATIVE_HMAC_KEY* const pKey, const TOCTET* const salt, const ULONG saltSize, const ULONG blockNumber);
+
+/*
+ * Perform further iterations on one block with the scalar kernel of its hash function
+ */
+void nativeIterateBlockScalar(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount);
+
+/*
+ * Write T of a block as bytes
+ */
+void nativeGetBlockResult(const NATIVE_BLOCK_STATE* const pBlock, TOCTET* const output, const ULONG outputSize);
+
+/*
+ * Calculate PBKDF2 for several independent requests with the same hash function and iteration count.
+ * The blocks of all requests are distributed over the lanes of the multi-buffer kernels.
+ * Returns FALSE if the hash function is not supported or there are no multi-buffer kernels.
+ */
+BOOLEAN nativePBKDF2MultiBuffer(const NATIVE_HASH hash,
+										  const ULONG iterationCount,
+										  NATIVE_PBKDF2_REQUEST* const requests,
+										  const int requestCount);
+
+/*
+ * Calculate PBKDF2 for one request with the SHA extensions.
+ * If isParallel is set the blocks of a multi-block key are calculated at the same time on threads of the default thread pool.
+ * Returns FALSE if the hash function or the SHA extensions are not supported.
+ */
+BOOLEAN nativePBKDF2ShaNi(const NATIVE_HASH hash,
+								  const ULONG iterationCount,
+								  NATIVE_PBKDF2_REQUEST* const pRequest,
+								  const BOOLEAN isParallel);
+
+/*
+ * Calculate PBKDF2 for several requests with an HMAC key that has been prepared once for their common password.
+ * The passwords of the requests are ignored.
+ * Returns FALSE if the hash function is not supported.
+ */
+BOOLEAN nativePBKDF2WithKey(const NATIVE_HMAC_KEY* const pKey,
+									 const ULONG iterationCount,
+									 NATIVE_PBKDF2_REQUEST* const requests,
+									 const int requestCount);
+
+/*
+ * Multi-buffer kernels. These are only called by the native engine.
+ */
+void multiBufferSha1Avx2(NATIVE_BLOCK_STATE* const blocks[], const ULONG iterationCount);
+void multiBufferSha256Avx2(NATIVE_BLOCK_STATE* const blocks[], const ULONG iterationCount);
+void multiBufferSha1Avx512(NATIVE_BLOCK_STATE* const blocks[], const ULONG iterationCount);
+void multiBufferSha256Avx512(NATIVE_BLOCK_STATE* const blocks[], const ULONG iterationCount);
+
+/*
+ * Single-stream kernels with the SHA extensions. These are only called by the native engine.
+ */
+void shaNiIterateSha1(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount);
+void shaNiIterateSha256(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount);
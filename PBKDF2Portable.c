@@ -0,0 +1,677 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.4.0
+*
+* Portable reference implementation of PBKDF2 with HMAC-SHA-1, HMAC-SHA-256, HMAC-SHA-384 and HMAC-SHA-512.
+* The hash functions work on bytes with no hardware specific code so that this engine is independent of CNG and of the native engine.
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.1.0: Chain state that can be continued in steps, saved and resumed
+*     2026-10-14: V1.2.0: Start and extend the U and T of single blocks
+*     2026-10-14: V1.3.0: Identify a chain by a hash of its parameters and salt instead of a value of the password
+*     2026-10-14: V1.4.0: HMAC key that is prepared once and used for many salts
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Portable.h"
+
+#include <string.h>
+
+/*
+ * MACROS
+ */
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+/*
+ * TYPEDEFS
+ */
+
+/*
+ * Compression function of a hash function
+ */
+typedef void (*PORTABLE_COMPRESS)(PORTABLE_HASH_STATE* const pState, const TOCTET* const block);
+
+/*
+ * Properties of a hash function
+ */
+typedef struct PORTABLE_HASH_INFO {
+	int blockSize;
+	int digestSize;
+	int wordSize;
+	PORTABLE_COMPRESS compress;
+	PORTABLE_HASH_STATE initialState;
+} PORTABLE_HASH_INFO;
+
+/*
+ * Round constants of SHA-256
+ */
+static const UINT32 SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * Round constants of SHA-384 and SHA-512
+ */
+static const UINT64 SHA512_K[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+
+/*
+ * Read a big endian 32 bit word
+ */
+static UINT32 loadBigEndian32(const TOCTET* const p) {
+	return ((UINT32)p[0] << 24) | ((UINT32)p[1] << 16) | ((UINT32)p[2] << 8) | (UINT32)p[3];
+}
+
+/*
+ * Read a big endian 64 bit word
+ */
+static UINT64 loadBigEndian64(const TOCTET* const p) {
+	return ((UINT64)loadBigEndian32(p) << 32) | (UINT64)loadBigEndian32(p + 4);
+}
+
+/*
+ * Process one block with the SHA-1 compression function
+ */
+static void sha1Compress(PORTABLE_HASH_STATE* const pState, const TOCTET* const block) {
+	UINT32 w[80];
+
+	for (int i = 0; i < 16; i++)
+		w[i] = loadBigEndian32(&block[i << 2]);
+
+	for (int i = 16; i < 80; i++)
+		w[i] = ROTL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	UINT32 a = pState->w32[0];
+	UINT32 b = pState->w32[1];
+	UINT32 c = pState->w32[2];
+	UINT32 d = pState->w32[3];
+	UINT32 e = pState->w32[4];
+
+	for (int i = 0; i < 80; i++) {
+		UINT32 f;
+		UINT32 k;
+
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		}
+		else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		}
+		else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		}
+		else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+
+		const UINT32 t = ROTL32(a, 5) + f + e + k + w[i];
+
+		e = d;
+		d = c;
+		c = ROTL32(b, 30);
+		b = a;
+		a = t;
+	}
+
+	pState->w32[0] += a;
+	pState->w32[1] += b;
+	pState->w32[2] += c;
+	pState->w32[3] += d;
+	pState->w32[4] += e;
+}
+
+/*
+ * Process one block with the SHA-256 compression function
+ */
+static void sha256Compress(PORTABLE_HASH_STATE* const pState, const TOCTET* const block) {
+	UINT32 w[64];
+
+	for (int i = 0; i < 16; i++)
+		w[i] = loadBigEndian32(&block[i << 2]);
+
+	for (int i = 16; i < 64; i++) {
+		const UINT32 s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const UINT32 s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	UINT32 v[8];
+
+	for (int i = 0; i < 8; i++)
+		v[i] = pState->w32[i];
+
+	for (int i = 0; i < 64; i++) {
+		const UINT32 s1 = ROTR32(v[4], 6) ^ ROTR32(v[4], 11) ^ ROTR32(v[4], 25);
+		const UINT32 ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+		const UINT32 t1 = v[7] + s1 + ch + SHA256_K[i] + w[i];
+		const UINT32 s0 = ROTR32(v[0], 2) ^ ROTR32(v[0], 13) ^ ROTR32(v[0], 22);
+		const UINT32 maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = v[3] + t1;
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = t1 + s0 + maj;
+	}
+
+	for (int i = 0; i < 8; i++)
+		pState->w32[i] += v[i];
+}
+
+/*
+ * Process one block with the SHA-384 and SHA-512 compression function
+ */
+static void sha512Compress(PORTABLE_HASH_STATE* const pState, const TOCTET* const block) {
+	UINT64 w[80];
+
+	for (int i = 0; i < 16; i++)
+		w[i] = loadBigEndian64(&block[i << 3]);
+
+	for (int i = 16; i < 80; i++) {
+		const UINT64 s0 = ROTR64(w[i - 15], 1) ^ ROTR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+		const UINT64 s1 = ROTR64(w[i - 2], 19) ^ ROTR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	UINT64 v[8];
+
+	for (int i = 0; i < 8; i++)
+		v[i] = pState->w64[i];
+
+	for (int i = 0; i < 80; i++) {
+		const UINT64 s1 = ROTR64(v[4], 14) ^ ROTR64(v[4], 18) ^ ROTR64(v[4], 41);
+		const UINT64 ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+		const UINT64 t1 = v[7] + s1 + ch + SHA512_K[i] + w[i];
+		const UINT64 s0 = ROTR64(v[0], 28) ^ ROTR64(v[0], 34) ^ ROTR64(v[0], 39);
+		const UINT64 maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = v[3] + t1;
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = t1 + s0 + maj;
+	}
+
+	for (int i = 0; i < 8; i++)
+		pState->w64[i] += v[i];
+}
+
+/*
+ * Properties of the hash functions in the order of PORTABLE_HASH
+ */
+static const PORTABLE_HASH_INFO HASH_INFO[PORTABLE_HASH_COUNT] = {
+	{ 64, 20, 4, sha1Compress,
+	  { .w32 = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 } } },
+	{ 64, 32, 4, sha256Compress,
+	  { .w32 = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 } } },
+	{ 128, 48, 8, sha512Compress,
+	  { .w64 = { 0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL, 0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+	             0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL, 0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL } } },
+	{ 128, 64, 8, sha512Compress,
+	  { .w64 = { 0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	             0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL } } }
+};
+
+/*
+ * Start a hash calculation
+ */
+static void hashInitialize(PORTABLE_HASH_CONTEXT* const pContext, const PORTABLE_HASH hash) {
+	pContext->pInfo = &HASH_INFO[hash];
+	pContext->state = pContext->pInfo->initialState;
+	pContext->bufferSize = 0;
+	pContext->messageSize = 0;
+}
+
+/*
+ * Add message bytes to a hash calculation
+ */
+static void hashUpdate(PORTABLE_HASH_CONTEXT* const pContext, const TOCTET* data, ULONG dataSize) {
+	const int blockSize = pContext->pInfo->blockSize;
+
+	pContext->messageSize += dataSize;
+
+	while (dataSize > 0) {
+		ULONG copySize = (ULONG)(blockSize - pContext->bufferSize);
+
+		if (copySize > dataSize)
+			copySize = dataSize;
+
+		memcpy(&pContext->buffer[pContext->bufferSize], data, copySize);
+
+		pContext->bufferSize += (int)copySize;
+		data += copySize;
+		dataSize -= copySize;
+
+		if (pContext->bufferSize == blockSize) {
+			pContext->pInfo->compress(&pContext->state, pContext->buffer);
+			pContext->bufferSize = 0;
+		}
+	}
+}
+
+/*
+ * Finish a hash calculation and write the digest as bytes.
+ * The length field is 8 bytes for SHA-1 and SHA-256 and 16 bytes for SHA-384 and SHA-512.
+ */
+static void hashFinalize(PORTABLE_HASH_CONTEXT* const pContext, TOCTET* const digest) {
+	const PORTABLE_HASH_INFO* const pInfo = pContext->pInfo;
+	const int blockSize = pInfo->blockSize;
+	const int lengthSize = pInfo->wordSize << 1;
+	const UINT64 messageBits = pContext->messageSize << 3;
+
+	pContext->buffer[pContext->bufferSize] = 0x80;
+	pContext->bufferSize++;
+
+	if (pContext->bufferSize > blockSize - lengthSize) {
+		memset(&pContext->buffer[pContext->bufferSize], 0, blockSize - pContext->bufferSize);
+		pInfo->compress(&pContext->state, pContext->buffer);
+		pContext->bufferSize = 0;
+	}
+
+	memset(&pContext->buffer[pContext->bufferSize], 0, blockSize - pContext->bufferSize);
+
+	for (int i = 0; i < 8; i++)
+		pContext->buffer[blockSize - 1 - i] = (TOCTET)(messageBits >> (i << 3));
+
+	pInfo->compress(&pContext->state, pContext->buffer);
+
+	for (int i = 0; i < pInfo->digestSize; i++)
+		if (pInfo->wordSize == 4)
+			digest[i] = (TOCTET)(pContext->state.w32[i >> 2] >> (24 - ((i & 3) << 3)));
+		else
+			digest[i] = (TOCTET)(pContext->state.w64[i >> 3] >> (56 - ((i & 7) << 3)));
+}
+
+/*
+ * Calculate the HMAC of a message that consists of two parts. The second part may be empty.
+ */
+static void calculateHmac(const PORTABLE_HMAC_KEY* const pKey,
+								  const TOCTET* const part1, const ULONG part1Size,
+								  const TOCTET* const part2, const ULONG part2Size,
+								  TOCTET* const mac) {
+	PORTABLE_HASH_CONTEXT context = pKey->inner;
+
+	hashUpdate(&context, part1, part1Size);
+	hashUpdate(&context, part2, part2Size);
+	hashFinalize(&context, mac);
+
+	context = pKey->outer;
+
+	hashUpdate(&context, mac, (ULONG)context.pInfo->digestSize);
+	hashFinalize(&context, mac);
+
+	SecureZeroMemory(&context, sizeof(context));
+}
+
+/*
+ * Calculate U_1 = HMAC(password, salt || INT(blockNumber))
+ */
+static void calculateFirstIteration(const PORTABLE_HMAC_KEY* const pKey, const TOCTET* const salt, const ULONG saltSize, const ULONG blockNumber, TOCTET* const u) {
+	TOCTET blockNumberBytes[4];
+
+	blockNumberBytes[0] = (TOCTET)(blockNumber >> 24);
+	blockNumberBytes[1] = (TOCTET)(blockNumber >> 16);
+	blockNumberBytes[2] = (TOCTET)(blockNumber >> 8);
+	blockNumberBytes[3] = (TOCTET)blockNumber;
+
+	calculateHmac(pKey, salt, saltSize, blockNumberBytes, sizeof(blockNumberBytes), u);
+}
+
+/*
+ * Perform further iterations U_j = HMAC(password, U_(j-1)) and T = T xor U_j
+ */
+static void iterateBlock(const PORTABLE_HMAC_KEY* const pKey, TOCTET* const u, TOCTET* const t, const ULONG digestSize, const ULONG iterationCount) {
+	for (ULONG j = 0; j < iterationCount; j++) {
+		calculateHmac(pKey, u, digestSize, NULL, 0, u);
+
+		for (ULONG i = 0; i < digestSize; i++)
+			t[i] ^= u[i];
+	}
+}
+
+/*
+ * Copy T of a block into its place in the derived key. The last block may be shorter than the digest.
+ */
+static void storeBlockResult(const TOCTET* const t, const ULONG digestSize, const ULONG blockNumber, TOCTET* const derivedKey, const ULONG derivedKeySize) {
+	const ULONG offset = (blockNumber - 1) * digestSize;
+
+	ULONG copySize = derivedKeySize - offset;
+
+	if (copySize > digestSize)
+		copySize = digestSize;
+
+	memcpy(&derivedKey[offset], t, copySize);
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+/*
+ * Get the digest size of a hash function in bytes
+ */
+int portableGetDigestSize(const PORTABLE_HASH hash) {
+	return HASH_INFO[hash].digestSize;
+}
+
+/*
+ * Calculate the HMAC key states of a password
+ */
+void portablePrepareHmacKey(PORTABLE_HMAC_KEY* const pKey, const PORTABLE_HASH hash, const TOCTET* const password, const ULONG passwordSize) {
+	const PORTABLE_HASH_INFO* const pInfo = &HASH_INFO[hash];
+
+	TOCTET key[PORTABLE_MAX_BLOCK_SIZE];
+	TOCTET pad[PORTABLE_MAX_BLOCK_SIZE];
+
+	memset(key, 0, sizeof(key));
+
+	// Keys that are longer than the block size are replaced by their hash
+	if (passwordSize > (ULONG)pInfo->blockSize) {
+		hashInitialize(&pKey->inner, hash);
+		hashUpdate(&pKey->inner, password, passwordSize);
+		hashFinalize(&pKey->inner, key);
+	}
+	else
+		memcpy(key, password, passwordSize);
+
+	for (int i = 0; i < pInfo->blockSize; i++)
+		pad[i] = key[i] ^ 0x36;
+
+	hashInitialize(&pKey->inner, hash);
+	hashUpdate(&pKey->inner, pad, (ULONG)pInfo->blockSize);
+
+	for (int i = 0; i < pInfo->blockSize; i++)
+		pad[i] = key[i] ^ 0x5c;
+
+	hashInitialize(&pKey->outer, hash);
+	hashUpdate(&pKey->outer, pad, (ULONG)pInfo->blockSize);
+
+	SecureZeroMemory(key, sizeof(key));
+	SecureZeroMemory(pad, sizeof(pad));
+}
+
+/*
+ * Calculate PBKDF2 with an HMAC key that has been prepared once for the password, so that each salt only pays for its iterations
+ */
+void portablePBKDF2WithKey(const PORTABLE_HMAC_KEY* const pKey,
+									const TOCTET* const salt,
+									const ULONG saltSize,
+									const ULONG iterationCount,
+									TOCTET* const derivedKey,
+									const ULONG derivedKeySize) {
+	const ULONG digestSize = (ULONG)pKey->inner.pInfo->digestSize;
+
+	const ULONG blockCount = (derivedKeySize + digestSize - 1) / digestSize;
+
+	TOCTET u[PORTABLE_MAX_DIGEST_SIZE];
+	TOCTET t[PORTABLE_MAX_DIGEST_SIZE];
+
+	for (ULONG blockNumber = 1; blockNumber <= blockCount; blockNumber++) {
+		calculateFirstIteration(pKey, salt, saltSize, blockNumber, u);
+		memcpy(t, u, digestSize);
+
+		iterateBlock(pKey, u, t, digestSize, iterationCount - 1);
+
+		storeBlockResult(t, digestSize, blockNumber, derivedKey, derivedKeySize);
+	}
+
+	SecureZeroMemory(u, sizeof(u));
+	SecureZeroMemory(t, sizeof(t));
+}
+
+/*
+ * Calculate PBKDF2 with the portable engine
+ */
+void portablePBKDF2(const PORTABLE_HASH hash,
+						  const TOCTET* const password,
+						  const ULONG passwordSize,
+						  const TOCTET* const salt,
+						  const ULONG saltSize,
+						  const ULONG iterationCount,
+						  TOCTET* const derivedKey,
+						  const ULONG derivedKeySize) {
+	PORTABLE_HMAC_KEY key;
+
+	portablePrepareHmacKey(&key, hash, password, passwordSize);
+
+	portablePBKDF2WithKey(&key, salt, saltSize, iterationCount, derivedKey, derivedKeySize);
+
+	SecureZeroMemory(&key, sizeof(key));
+}
+
+/*
+ * Add an integer in big endian byte order to a hash calculation
+ */
+static void hashInteger(PORTABLE_HASH_CONTEXT* const pContext, const ULONG value) {
+	TOCTET bytes[4];
+
+	bytes[0] = (TOCTET)(value >> 24);
+	bytes[1] = (TOCTET)(value >> 16);
+	bytes[2] = (TOCTET)(value >> 8);
+	bytes[3] = (TOCTET)value;
+
+	hashUpdate(pContext, bytes, sizeof(bytes));
+}
+
+/*
+ * Calculate the identification of the record of a chain. It does not depend on the password,
+ * so that a saved chain does not contain a cheap test of a password guess.
+ */
+static void calculateRecordId(const PORTABLE_PBKDF2_CHAIN* const pChain, const TOCTET* const salt, const ULONG saltSize, TOCTET* const recordId) {
+	PORTABLE_HASH_CONTEXT context;
+
+	hashInitialize(&context, PORTABLE_HASH_SHA256);
+	hashInteger(&context, (ULONG)pChain->hash);
+	hashInteger(&context, pChain->iterationCount);
+	hashInteger(&context, pChain->derivedKeySize);
+	hashInteger(&context, saltSize);
+	hashUpdate(&context, salt, saltSize);
+	hashFinalize(&context, recordId);
+}
+
+/*
+ * Start a PBKDF2 calculation in steps
+ */
+void portableStartChain(PORTABLE_PBKDF2_CHAIN* const pChain,
+								const PORTABLE_HASH hash,
+								const TOCTET* const salt,
+								const ULONG saltSize,
+								const ULONG iterationCount,
+								const ULONG derivedKeySize) {
+	memset(pChain, 0, sizeof(PORTABLE_PBKDF2_CHAIN));
+
+	pChain->hash = hash;
+	pChain->iterationCount = iterationCount;
+	pChain->derivedKeySize = derivedKeySize;
+	pChain->blockNumber = 1;
+	pChain->completedIterationCount = 0;
+
+	calculateRecordId(pChain, salt, saltSize, pChain->recordId);
+}
+
+/*
+ * Check if a chain has been started with a salt and the parameters of the chain.
+ * The password can not be checked, as the chain does not keep any value of it besides U and T.
+ */
+BOOLEAN portableIsChainOf(const PORTABLE_PBKDF2_CHAIN* const pChain,
+								  const TOCTET* const salt,
+								  const ULONG saltSize) {
+	TOCTET recordId[PORTABLE_RECORD_ID_SIZE];
+
+	calculateRecordId(pChain, salt, saltSize, recordId);
+
+	return (BOOLEAN)(memcmp(recordId, pChain->recordId, PORTABLE_RECORD_ID_SIZE) == 0);
+}
+
+/*
+ * Perform at most stepIterationCount iterations of a chain. The blocks that are finished are written into derivedKey,
+ * which must keep the blocks of the previous steps. Returns TRUE if the derived key is complete.
+ */
+BOOLEAN portableContinueChain(PORTABLE_PBKDF2_CHAIN* const pChain,
+										const TOCTET* const password,
+										const ULONG passwordSize,
+										const TOCTET* const salt,
+										const ULONG saltSize,
+										const ULONG stepIterationCount,
+										TOCTET* const derivedKey) {
+	const ULONG digestSize = (ULONG)HASH_INFO[pChain->hash].digestSize;
+	const ULONG blockCount = (pChain->derivedKeySize + digestSize - 1) / digestSize;
+
+	PORTABLE_HMAC_KEY key;
+
+	portablePrepareHmacKey(&key, pChain->hash, password, passwordSize);
+
+	ULONG remainingIterationCount = stepIterationCount;
+
+	while ((pChain->blockNumber <= blockCount) && (remainingIterationCount > 0)) {
+		if (pChain->completedIterationCount == 0) {
+			calculateFirstIteration(&key, salt, saltSize, pChain->blockNumber, pChain->u);
+			memcpy(pChain->t, pChain->u, digestSize);
+
+			pChain->completedIterationCount = 1;
+			remainingIterationCount--;
+		}
+
+		ULONG iterationCount = pChain->iterationCount - pChain->completedIterationCount;
+
+		if (iterationCount > remainingIterationCount)
+			iterationCount = remainingIterationCount;
+
+		iterateBlock(&key, pChain->u, pChain->t, digestSize, iterationCount);
+
+		pChain->completedIterationCount += iterationCount;
+		remainingIterationCount -= iterationCount;
+
+		if (pChain->completedIterationCount == pChain->iterationCount) {
+			storeBlockResult(pChain->t, digestSize, pChain->blockNumber, derivedKey, pChain->derivedKeySize);
+
+			pChain->blockNumber++;
+			pChain->completedIterationCount = 0;
+		}
+	}
+
+	SecureZeroMemory(&key, sizeof(key));
+
+	return (BOOLEAN)(pChain->blockNumber > blockCount);
+}
+
+/*
+ * Get the share of the iterations of a chain that are done, from 0 to 1
+ */
+double portableGetChainProgress(const PORTABLE_PBKDF2_CHAIN* const pChain) {
+	const ULONG digestSize = (ULONG)HASH_INFO[pChain->hash].digestSize;
+	const ULONG blockCount = (pChain->derivedKeySize + digestSize - 1) / digestSize;
+
+	const double totalIterationCount = (double)blockCount * pChain->iterationCount;
+	const double doneIterationCount = (double)(pChain->blockNumber - 1) * pChain->iterationCount + pChain->completedIterationCount;
+
+	return (doneIterationCount < totalIterationCount) ? doneIterationCount / totalIterationCount : 1.0;
+}
+
+/*
+ * Calculate U_1 = HMAC(password, salt || INT(blockNumber)) of a block and set T = U_1.
+ * u and t must have room for the digest size.
+ */
+void portableStartBlock(const PORTABLE_HASH hash,
+								const TOCTET* const password,
+								const ULONG passwordSize,
+								const TOCTET* const salt,
+								const ULONG saltSize,
+								const ULONG blockNumber,
+								TOCTET* const u,
+								TOCTET* const t) {
+	PORTABLE_HMAC_KEY key;
+
+	portablePrepareHmacKey(&key, hash, password, passwordSize);
+
+	calculateFirstIteration(&key, salt, saltSize, blockNumber, u);
+	memcpy(t, u, (size_t)HASH_INFO[hash].digestSize);
+
+	SecureZeroMemory(&key, sizeof(key));
+}
+
+/*
+ * Perform further iterations on U and T of a block, so that U_n and T_n become U_(n + iterationCount) and T_(n + iterationCount)
+ */
+void portableExtendBlock(const PORTABLE_HASH hash,
+								 const TOCTET* const password,
+								 const ULONG passwordSize,
+								 const ULONG iterationCount,
+								 TOCTET* const u,
+								 TOCTET* const t) {
+	PORTABLE_HMAC_KEY key;
+
+	portablePrepareHmacKey(&key, hash, password, passwordSize);
+
+	iterateBlock(&key, u, t, (ULONG)HASH_INFO[hash].digestSize, iterationCount);
+
+	SecureZeroMemory(&key, sizeof(key));
+}
@@ -0,0 +1,209 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.4.0
+*
+* Portable reference implementation of PBKDF2 with HMAC-SHA-1, HMAC-SHA-256, HMAC-SHA-384 and HMAC-SHA-512.
+* It is deliberately independent of CNG and of the native engine so that it can be used as an oracle for both.
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*     2026-10-14: V1.1.0: Chain state that can be continued in steps, saved and resumed
+*     2026-10-14: V1.2.0: Start and extend the U and T of single blocks
+*     2026-10-14: V1.3.0: Identify a chain by a hash of its parameters and salt instead of a value of the password
+*     2026-10-14: V1.4.0: HMAC key that is prepared once and used for many salts
+*/
+
+#pragma once
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+
+#include "PBKDF2Native.h"
+
+/*
+ * TYPEDEFS
+ */
+
+/*
+ * Hash functions of the portable engine
+ */
+typedef enum {
+	PORTABLE_HASH_SHA1 = 0,
+	PORTABLE_HASH_SHA256 = 1,
+	PORTABLE_HASH_SHA384 = 2,
+	PORTABLE_HASH_SHA512 = 3
+} PORTABLE_HASH;
+
+#define PORTABLE_HASH_COUNT 4
+
+/*
+ * Maximum digest size of the hash functions
+ */
+#define PORTABLE_MAX_DIGEST_SIZE 64
+
+/*
+ * Maximum block size of the hash functions
+ */
+#define PORTABLE_MAX_BLOCK_SIZE 128
+
+/*
+ * Size of the identification of the record of a chain
+ */
+#define PORTABLE_RECORD_ID_SIZE 32
+
+/*
+ * Chaining state of a hash calculation
+ */
+typedef union {
+	UINT32 w32[8];
+	UINT64 w64[8];
+} PORTABLE_HASH_STATE;
+
+/*
+ * State of a running hash calculation
+ */
+typedef struct {
+	const struct PORTABLE_HASH_INFO* pInfo;
+	PORTABLE_HASH_STATE state;
+	TOCTET buffer[PORTABLE_MAX_BLOCK_SIZE];
+	int bufferSize;
+	UINT64 messageSize;
+} PORTABLE_HASH_CONTEXT;
+
+/*
+ * State of the inner and outer hash after the padded HMAC key has been processed
+ */
+typedef struct {
+	PORTABLE_HASH_CONTEXT inner;
+	PORTABLE_HASH_CONTEXT outer;
+} PORTABLE_HMAC_KEY;
+
+/*
+ * State of a PBKDF2 calculation that is done in steps. It contains no pointers, so it can be saved and loaded again.
+ * The password and the salt are not part of the state. They are given to each step.
+ */
+typedef struct {
+	PORTABLE_HASH hash;
+	ULONG iterationCount;
+	ULONG derivedKeySize;
+	ULONG blockNumber;                        // Number of the block that is calculated, starting with 1
+	ULONG completedIterationCount;            // Number of the iterations of the block that are done
+	TOCTET u[PORTABLE_MAX_DIGEST_SIZE];       // U_i of the last iteration that is done
+	TOCTET t[PORTABLE_MAX_DIGEST_SIZE];       // T = U_1 xor ... xor U_i
+	TOCTET recordId[PORTABLE_RECORD_ID_SIZE]; // SHA-256 of the hash, the iteration count, the key size and the salt, but not of the password
+} PORTABLE_PBKDF2_CHAIN;
+
+/*
+ * FUNCTIONS
+ */
+
+/*
+ * Get the digest size of a hash function in bytes
+ */
+int portableGetDigestSize(const PORTABLE_HASH hash);
+
+/*
+ * Calculate PBKDF2 with the portable engine
+ */
+void portablePBKDF2(const PORTABLE_HASH hash,
+						  const TOCTET* const password,
+						  const ULONG passwordSize,
+						  const TOCTET* const salt,
+						  const ULONG saltSize,
+						  const ULONG iterationCount,
+						  TOCTET* const derivedKey,
+						  const ULONG derivedKeySize);
+
+/*
+ * Calculate the HMAC key states of a password
+ */
+void portablePrepareHmacKey(PORTABLE_HMAC_KEY* const pKey, const PORTABLE_HASH hash, const TOCTET* const password, const ULONG passwordSize);
+
+/*
+ * Calculate PBKDF2 with an HMAC key that has been prepared once for the password, so that each salt only pays for its iterations
+ */
+void portablePBKDF2WithKey(const PORTABLE_HMAC_KEY* const pKey,
+									const TOCTET* const salt,
+									const ULONG saltSize,
+									const ULONG iterationCount,
+									TOCTET* const derivedKey,
+									const ULONG derivedKeySize);
+
+/*
+ * Start a PBKDF2 calculation in steps
+ */
+void portableStartChain(PORTABLE_PBKDF2_CHAIN* const pChain,
+								const PORTABLE_HASH hash,
+								const TOCTET* const salt,
+								const ULONG saltSize,
+								const ULONG iterationCount,
+								const ULONG derivedKeySize);
+
+/*
+ * Check if a chain has been started with a salt and the parameters of the chain.
+ * The password can not be checked, as the chain does not keep any value of it besides U and T.
+ */
+BOOLEAN portableIsChainOf(const PORTABLE_PBKDF2_CHAIN* const pChain,
+								  const TOCTET* const salt,
+								  const ULONG saltSize);
+
+/*
+ * Perform at most stepIterationCount iterations of a chain. The blocks that are finished are written into derivedKey,
+ * which must keep the blocks of the previous steps. Returns TRUE if the derived key is complete.
+ */
+BOOLEAN portableContinueChain(PORTABLE_PBKDF2_CHAIN* const pChain,
+										const TOCTET* const password,
+										const ULONG passwordSize,
+										const TOCTET* const salt,
+										const ULONG saltSize,
+										const ULONG stepIterationCount,
+										TOCTET* const derivedKey);
+
+/*
+ * Get the share of the iterations of a chain that are done, from 0 to 1
+ */
+double portableGetChainProgress(const PORTABLE_PBKDF2_CHAIN* const pChain);
+
+/*
+ * Calculate U_1 = HMAC(password, salt || INT(blockNumber)) of a block and set T = U_1.
+ * u and t must have room for the digest size.
+ */
+void portableStartBlock(const PORTABLE_HASH hash,
+								const TOCTET* const password,
+								const ULONG passwordSize,
+								const TOCTET* const salt,
+								const ULONG saltSize,
+								const ULONG blockNumber,
+								TOCTET* const u,
+								TOCTET* const t);
+
+/*
+ * Perform further iterations on U and T of a block, so that U_n and T_n become U_(n + iterationCount) and T_(n + iterationCount)
+ */
+void portableExtendBlock(const PORTABLE_HASH hash,
+								 const TOCTET* const password,
+								 const ULONG passwordSize,
+								 const ULONG iterationCount,
+								 TOCTET* const u,
+								 TOCTET* const t);
@@ -0,0 +1,248 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Single-stream PBKDF2 kernels for SHA-1 and SHA-256 with the Intel SHA extensions
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*/
+
+/*
+ * INCLUDES
+ */
+#include "PBKDF2Native.h"
+
+#include <immintrin.h>
+
+/*
+ * SHA-256 round constants
+ */
+static const UINT32 SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * SHA-1 compression of one block.
+ * The state is held as ABCD with A in the highest lane and E in the highest lane of another register.
+ * The message words are in the same order, i.e. the first word of each group of four is in the highest lane.
+ */
+static void sha1CompressShaNi(__m128i* const pAbcd, __m128i* const pE, __m128i m0, __m128i m1, __m128i m2, __m128i m3) {
+	__m128i message[4] = { m0, m1, m2, m3 };
+
+	const __m128i abcdSave = *pAbcd;
+	const __m128i eSave = *pE;
+
+	__m128i abcd = abcdSave;
+	__m128i previousAbcd = abcd;
+
+	__m128i e = _mm_add_epi32(eSave, message[0]);
+
+	abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+
+	for (int q = 1; q < 20; q++) {
+		// W[t] = ROTL1(W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]) for the next four words
+		if (q >= 4)
+			message[q & 3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(message[q & 3], message[(q - 3) & 3]), message[(q - 2) & 3]), message[(q - 1) & 3]);
+
+		e = _mm_sha1nexte_epu32(previousAbcd, message[q & 3]);
+		previousAbcd = abcd;
+
+		switch (q / 5) {
+		case 0:
+			abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+			break;
+
+		case 1:
+			abcd = _mm_sha1rnds4_epu32(abcd, e, 1);
+			break;
+
+		case 2:
+			abcd = _mm_sha1rnds4_epu32(abcd, e, 2);
+			break;
+
+		default:
+			abcd = _mm_sha1rnds4_epu32(abcd, e, 3);
+		}
+	}
+
+	*pE = _mm_sha1nexte_epu32(previousAbcd, eSave);
+	*pAbcd = _mm_add_epi32(abcd, abcdSave);
+}
+
+/*
+ * Perform iterationCount PBKDF2-HMAC-SHA1 iterations on one block with the SHA extensions.
+ * The digest that is the message of the next compression stays in the registers in which the compression returns it.
+ */
+void shaNiIterateSha1(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount) {
+	const NATIVE_HMAC_KEY* const pKey = pBlock->pKey;
+
+	const __m128i innerAbcd = _mm_set_epi32((int)pKey->innerState.w32[0], (int)pKey->innerState.w32[1], (int)pKey->innerState.w32[2], (int)pKey->innerState.w32[3]);
+	const __m128i innerE = _mm_set_epi32((int)pKey->innerState.w32[4], 0, 0, 0);
+	const __m128i outerAbcd = _mm_set_epi32((int)pKey->outerState.w32[0], (int)pKey->outerState.w32[1], (int)pKey->outerState.w32[2], (int)pKey->outerState.w32[3]);
+	const __m128i outerE = _mm_set_epi32((int)pKey->outerState.w32[4], 0, 0, 0);
+
+	// Padding of a message that is one block and one digest long
+	const __m128i padding = _mm_set_epi32(0, (int)0x80000000, 0, 0);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i messageBits = _mm_set_epi32(0, 0, 0, (64 + 20) << 3);
+
+	__m128i uAbcd = _mm_set_epi32((int)pBlock->u.w32[0], (int)pBlock->u.w32[1], (int)pBlock->u.w32[2], (int)pBlock->u.w32[3]);
+	__m128i uE = _mm_set_epi32((int)pBlock->u.w32[4], 0, 0, 0);
+	__m128i tAbcd = _mm_set_epi32((int)pBlock->t.w32[0], (int)pBlock->t.w32[1], (int)pBlock->t.w32[2], (int)pBlock->t.w32[3]);
+	__m128i tE = _mm_set_epi32((int)pBlock->t.w32[4], 0, 0, 0);
+
+	for (ULONG iteration = 0; iteration < iterationCount; iteration++) {
+		__m128i abcd = innerAbcd;
+		__m128i e = innerE;
+
+		sha1CompressShaNi(&abcd, &e, uAbcd, _mm_blend_epi16(padding, uE, 0xc0), zero, messageBits);
+
+		uAbcd = outerAbcd;
+		uE = outerE;
+
+		sha1CompressShaNi(&uAbcd, &uE, abcd, _mm_blend_epi16(padding, e, 0xc0), zero, messageBits);
+
+		tAbcd = _mm_xor_si128(tAbcd, uAbcd);
+		tE = _mm_xor_si128(tE, uE);
+	}
+
+	UINT32 words[4];
+
+	_mm_storeu_si128((__m128i*)words, uAbcd);
+
+	for (int i = 0; i < 4; i++)
+		pBlock->u.w32[i] = words[3 - i];
+
+	pBlock->u.w32[4] = (UINT32)_mm_extract_epi32(uE, 3);
+
+	_mm_storeu_si128((__m128i*)words, tAbcd);
+
+	for (int i = 0; i < 4; i++)
+		pBlock->t.w32[i] = words[3 - i];
+
+	pBlock->t.w32[4] = (UINT32)_mm_extract_epi32(tE, 3);
+}
+
+/*
+ * SHA-256 compression of one block.
+ * The state is held in the form that the SHA-256 rounds instruction needs, i.e. as ABEF and CDGH.
+ * The message words are in memory order, i.e. the first word of each group of four is in the lowest lane.
+ */
+static void sha256CompressShaNi(__m128i* const pAbef, __m128i* const pCdgh, __m128i m0, __m128i m1, __m128i m2, __m128i m3) {
+	__m128i message[4] = { m0, m1, m2, m3 };
+
+	__m128i abef = *pAbef;
+	__m128i cdgh = *pCdgh;
+
+	for (int q = 0; q < 16; q++) {
+		// W[t] = W[t-16] + s0(W[t-15]) + W[t-7] + s1(W[t-2]) for the next four words
+		if (q >= 4)
+			message[q & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(message[q & 3], message[(q - 3) & 3]), _mm_alignr_epi8(message[(q - 1) & 3], message[(q - 2) & 3], 4)), message[(q - 1) & 3]);
+
+		const __m128i roundInput = _mm_add_epi32(message[q & 3], _mm_loadu_si128((const __m128i*)&SHA256_K[q << 2]));
+
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, roundInput);
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(roundInput, 0x0e));
+	}
+
+	*pAbef = _mm_add_epi32(*pAbef, abef);
+	*pCdgh = _mm_add_epi32(*pCdgh, cdgh);
+}
+
+/*
+ * Convert a SHA-256 state from ABCD and EFGH in memory order into ABEF and CDGH
+ */
+static void sha256ToRoundForm(const NATIVE_HASH_STATE* const pState, __m128i* const pAbef, __m128i* const pCdgh) {
+	const __m128i abcd = _mm_loadu_si128((const __m128i*)&pState->w32[0]);
+	const __m128i efgh = _mm_loadu_si128((const __m128i*)&pState->w32[4]);
+
+	const __m128i cdab = _mm_shuffle_epi32(abcd, 0xb1);
+	const __m128i hgfe = _mm_shuffle_epi32(efgh, 0x1b);
+
+	*pAbef = _mm_alignr_epi8(cdab, hgfe, 8);
+	*pCdgh = _mm_blend_epi16(hgfe, cdab, 0xf0);
+}
+
+/*
+ * Convert a SHA-256 state from ABEF and CDGH into ABCD and EFGH in memory order
+ */
+static void sha256FromRoundForm(const __m128i abef, const __m128i cdgh, __m128i* const pAbcd, __m128i* const pEfgh) {
+	const __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+	const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+
+	*pAbcd = _mm_blend_epi16(feba, dchg, 0xf0);
+	*pEfgh = _mm_alignr_epi8(dchg, feba, 8);
+}
+
+/*
+ * Perform iterationCount PBKDF2-HMAC-SHA256 iterations on one block with the SHA extensions
+ */
+void shaNiIterateSha256(NATIVE_BLOCK_STATE* const pBlock, const ULONG iterationCount) {
+	__m128i innerAbef;
+	__m128i innerCdgh;
+	__m128i outerAbef;
+	__m128i outerCdgh;
+
+	sha256ToRoundForm(&pBlock->pKey->innerState, &innerAbef, &innerCdgh);
+	sha256ToRoundForm(&pBlock->pKey->outerState, &outerAbef, &outerCdgh);
+
+	// Padding of a message that is one block and one digest long
+	const __m128i padding = _mm_set_epi32(0, 0, 0, (int)0x80000000);
+	const __m128i messageBits = _mm_set_epi32((64 + 32) << 3, 0, 0, 0);
+
+	__m128i u0 = _mm_loadu_si128((const __m128i*)&pBlock->u.w32[0]);
+	__m128i u1 = _mm_loadu_si128((const __m128i*)&pBlock->u.w32[4]);
+	__m128i t0 = _mm_loadu_si128((const __m128i*)&pBlock->t.w32[0]);
+	__m128i t1 = _mm_loadu_si128((const __m128i*)&pBlock->t.w32[4]);
+
+	for (ULONG iteration = 0; iteration < iterationCount; iteration++) {
+		__m128i abef = innerAbef;
+		__m128i cdgh = innerCdgh;
+		__m128i d0;
+		__m128i d1;
+
+		sha256CompressShaNi(&abef, &cdgh, u0, u1, padding, messageBits);
+		sha256FromRoundForm(abef, cdgh, &d0, &d1);
+
+		abef = outerAbef;
+		cdgh = outerCdgh;
+
+		sha256CompressShaNi(&abef, &cdgh, d0, d1, padding, messageBits);
+		sha256FromRoundForm(abef, cdgh, &u0, &u1);
+
+		t0 = _mm_xor_si128(t0, u0);
+		t1 = _mm_xor_si128(t1, u1);
+	}
+
+	_mm_storeu_si128((__m128i*)&pBlock->u.w32[0], u0);
+	_mm_storeu_si128((__m128i*)&pBlock->u.w32[4], u1);
+	_mm_storeu_si128((__m128i*)&pBlock->t.w32[0], t0);
+	_mm_storeu_si128((__m128i*)&pBlock->t.w32[4], t1);
+}
@@ -0,0 +1,620 @@
+/*
+* Copyright (c) 2026, Frank Schwab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+* in the documentation and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+* BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+* OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+* EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Author: Frank Schwab
+*
+* Version: 1.0.0
+*
+* Known-answer tests of the PBKDF2 engines and of the hex and Base64 conversions.
+* The engines are checked with the vectors of RFC 6070 and RFC 7914 and against the CNG keys of the library.
+* Returns 0 if all checks passed and 5 if a check failed.
+*
+* Changes:
+*     2026-10-14: V1.0.0: Created
+*/
+
+/*
+ * INCLUDES
+ */
+#include <Windows.h>
+
+#include <tchar.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "PBKDF2Api.h"
+#include "PBKDF2Base64.h"
+#include "PBKDF2Gpu.h"
+#include "PBKDF2Hex.h"
+#include "PBKDF2Native.h"
+#include "PBKDF2Portable.h"
+
+/*
+ * CONSTANTS
+ */
+
+/*
+ * Return codes
+ */
+#define RC_OK       0
+#define RC_MISMATCH 5
+
+/*
+ * Size of the description of a check and of an output line in characters
+ */
+#define DESCRIPTION_SIZE 200
+#define LINE_BUFFER_SIZE 300
+
+/*
+ * Largest key that is derived by a test
+ */
+#define MAX_TEST_KEY_SIZE (5 * PORTABLE_MAX_DIGEST_SIZE)
+
+/*
+ * Largest password or salt of a test
+ */
+#define MAX_TEST_DATA_SIZE 256
+
+/*
+ * Largest number of requests in one call of a native engine. This is more than twice the lanes of the AVX-512 kernels.
+ */
+#define MAX_TEST_REQUEST_COUNT 40
+
+/*
+ * Largest byte count of the encoding tests
+ */
+#define MAX_ENCODING_TEST_SIZE 40
+
+/*
+ * Portable hash functions of the hash types of the library
+ */
+static const PORTABLE_HASH PORTABLE_HASH_OF_HASH_TYPE[] = { PORTABLE_HASH_SHA1, PORTABLE_HASH_SHA256, PORTABLE_HASH_SHA384, PORTABLE_HASH_SHA512, PORTABLE_HASH_SHA512 };
+
+/*
+ * Names of the hash types of the library
+ */
+static const TCHAR* const HASH_TYPE_NAME[] = { _T("SHA-1"), _T("SHA-256"), _T("SHA-384"), _T("SHA-512"), _T("SHA-512") };
+
+/*
+ * Iteration counts of the engine comparisons
+ */
+static const ULONG ENGINE_ITERATION_COUNTS[] = { 1, 3, 1024 };
+
+/*
+ * Password sizes of the engine comparisons. They are shorter and longer than the blocks of all hash functions.
+ */
+static const ULONG ENGINE_PASSWORD_SIZES[] = { 1, 20, 64, 65, 129 };
+
+/*
+ * Salt sizes of the engine comparisons
+ */
+static const ULONG ENGINE_SALT_SIZES[] = { 1, 16, 100 };
+
+/*
+ * TYPES
+ */
+
+/*
+ * A known answer of a standard
+ */
+typedef struct {
+	int hashType;
+	const char* password;
+	ULONG passwordSize;
+	const char* salt;
+	ULONG saltSize;
+	ULONG iterationCount;
+	const TCHAR* expectedKey;
+	BOOLEAN isLibraryOnly;   // The iteration count is too high to check all engines in acceptable time
+} KNOWN_ANSWER;
+
+/*
+ * A known Base64 encoding of RFC 4648
+ */
+typedef struct {
+	const char* bytes;
+	const TCHAR* paddedText;
+	const TCHAR* unpaddedText;
+} BASE64_ANSWER;
+
+/*
+ * Known answers of RFC 6070 (PBKDF2-HMAC-SHA1) and RFC 7914 section 11 (PBKDF2-HMAC-SHA256)
+ */
+static const KNOWN_ANSWER KNOWN_ANSWERS[] = {
+	{ 1, "password", 8, "salt", 4, 1, _T("0c60c80f961f0e71f3a9b524af6012062fe037a6"), FALSE },
+	{ 1, "password", 8, "salt", 4, 2, _T("ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957"), FALSE },
+	{ 1, "password", 8, "salt", 4, 4096, _T("4b007901b765489abead49d926f721d065a429c1"), FALSE },
+	{ 1, "password", 8, "salt", 4, 16777216, _T("eefe3d61cd4da4e4e9945b3d6ba2158c2634e984"), TRUE },
+	{ 1, "passwordPASSWORDpassword", 24, "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096, _T("3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038"), FALSE },
+	{ 1, "pass\0word", 9, "sa\0lt", 5, 4096, _T("56fa6aa75548099dcc37d7f03425e0c3"), FALSE },
+	{ 2, "passwd", 6, "salt", 4, 1, _T("55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783"), FALSE },
+	{ 2, "Password", 8, "NaCl", 4, 80000, _T("4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d"), FALSE }
+};
+
+/*
+ * Known Base64 encodings of RFC 4648 section 10
+ */
+static const BASE64_ANSWER BASE64_ANSWERS[] = {
+	{ "", _T(""), _T("") },
+	{ "f", _T("Zg=="), _T("Zg") },
+	{ "fo", _T("Zm8="), _T("Zm8") },
+	{ "foo", _T("Zm9v"), _T("Zm9v") },
+	{ "foob", _T("Zm9vYg=="), _T("Zm9vYg") },
+	{ "fooba", _T("Zm9vYmE="), _T("Zm9vYmE") },
+	{ "foobar", _T("Zm9vYmFy"), _T("Zm9vYmFy") }
+};
+
+/*
+ * GLOBAL VARIABLES
+ */
+
+/*
+ * Number of all checks and of the failed checks
+ */
+static int checkCount = 0;
+static int failureCount = 0;
+
+/*
+ * Number of engine checks that were skipped because the processor or the GPU does not support the engine
+ */
+static int skipCount = 0;
+
+/*
+ * Handle of the standard output and whether it is redirected to a file
+ */
+static HANDLE outputHandle;
+static BOOLEAN isOutputRedirected;
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+
+/*
+ * Write a text to the standard output like the tester does
+ */
+static void writeText(TCHAR* const text) {
+	DWORD charsWritten;
+
+	if (!isOutputRedirected) {
+#ifndef _UNICODE
+		// WriteConsoleA expects OEM encoded strings
+		CharToOem(text, text);
+#endif
+
+		WriteConsole(outputHandle, text, (DWORD)_tcslen(text), &charsWritten, NULL);
+	} else
+		WriteFile(outputHandle, text, (DWORD)(_tcslen(text) * sizeof(TCHAR)), &charsWritten, NULL);
+}
+
+/*
+ * Count a check and write the description if it failed
+ */
+static void check(const BOOLEAN isPassed, const TCHAR* const format, ...) {
+	checkCount++;
+
+	if (!isPassed) {
+		failureCount++;
+
+		TCHAR lineBuffer[LINE_BUFFER_SIZE + 1];
+		TCHAR description[DESCRIPTION_SIZE + 1];
+
+		va_list arguments;
+
+		va_start(arguments, format);
+		_vstprintf_s(description, DESCRIPTION_SIZE, format, arguments);
+		va_end(arguments);
+
+		_stprintf_s(lineBuffer, LINE_BUFFER_SIZE, _T("FAILED: %s\n"), description);
+		writeText(lineBuffer);
+	}
+}
+
+/*
+ * Fill a buffer with a pattern that depends on the seed
+ */
+static void fillPattern(TOCTET* const buffer, const ULONG size, const ULONG seed) {
+	for (ULONG i = 0; i < size; i++)
+		buffer[i] = (TOCTET)((i * 7) + (seed * 13) + 3);
+}
+
+/*
+ * Check that a native engine call succeeded and derived the expected key
+ */
+static void checkNativeKey(const BOOLEAN isDone, const TOCTET* const key, const TOCTET* const expectedKey, const ULONG keySize, const TCHAR* const engineName, const TCHAR* const description) {
+	check(isDone && (memcmp(key, expectedKey, keySize) == 0), _T("%s: %s"), engineName, description);
+}
+
+/*
+ * Derive a key with all engines that support the hash type and compare them with the expected key
+ */
+static void checkAllEngines(const int hashType,
+									 const TOCTET* const password,
+									 const ULONG passwordSize,
+									 const TOCTET* const salt,
+									 const ULONG saltSize,
+									 const ULONG iterationCount,
+									 const TOCTET* const expectedKey,
+									 const ULONG keySize,
+									 const TCHAR* const description) {
+	TOCTET key[MAX_TEST_KEY_SIZE];
+
+	const PORTABLE_HASH portableHash = PORTABLE_HASH_OF_HASH_TYPE[hashType - PBKDF2_MIN_HASH_TYPE];
+
+	memset(key, 0, keySize);
+	portablePBKDF2(portableHash, password, passwordSize, salt, saltSize, iterationCount, key, keySize);
+	check(memcmp(key, expectedKey, keySize) == 0, _T("portable: %s"), description);
+
+	PORTABLE_HMAC_KEY portableKey;
+
+	portablePrepareHmacKey(&portableKey, portableHash, password, passwordSize);
+
+	memset(key, 0, keySize);
+	portablePBKDF2WithKey(&portableKey, salt, saltSize, iterationCount, key, keySize);
+	check(memcmp(key, expectedKey, keySize) == 0, _T("portable with prepared key: %s"), description);
+
+	SecureZeroMemory(&portableKey, sizeof(portableKey));
+
+	// The native engines only have SHA-1 and SHA-256
+	if (hashType > 2)
+		return;
+
+	const NATIVE_HASH nativeHash = (hashType == 1) ? NATIVE_HASH_SHA1 : NATIVE_HASH_SHA256;
+
+	NATIVE_PBKDF2_REQUEST request = { password, passwordSize, salt, saltSize, key, keySize };
+
+	if (nativeIsShaNiSupported()) {
+		memset(key, 0, keySize);
+		checkNativeKey(nativePBKDF2ShaNi(nativeHash, iterationCount, &request, FALSE), key, expectedKey, keySize, _T("shani"), description);
+
+		memset(key, 0, keySize);
+		checkNativeKey(nativePBKDF2ShaNi(nativeHash, iterationCount, &request, TRUE), key, expectedKey, keySize, _T("shani parallel"), description);
+	} else
+		skipCount += 2;
+
+	if (nativeGetMultiBufferLaneCount() > 0) {
+		memset(key, 0, keySize);
+		checkNativeKey(nativePBKDF2MultiBuffer(nativeHash, iterationCount, &request, 1), key, expectedKey, keySize, _T("simd"), description);
+	} else
+		skipCount++;
+
+	NATIVE_HMAC_KEY nativeKey;
+
+	nativePrepareHmacKey(&nativeKey, nativeHash, password, passwordSize);
+
+	memset(key, 0, keySize);
+	checkNativeKey(nativePBKDF2WithKey(&nativeKey, iterationCount, &request, 1), key, expectedKey, keySize, _T("native with prepared key"), description);
+
+	SecureZeroMemory(&nativeKey, sizeof(nativeKey));
+
+	if (gpuIsAvailable()) {
+		memset(key, 0, keySize);
+		checkNativeKey(gpuPBKDF2(nativeHash, iterationCount, &request, 1), key, expectedKey, keySize, _T("gpu"), description);
+	} else
+		skipCount++;
+
+	SecureZeroMemory(key, sizeof(key));
+}
+
+/*
+ * Check the known answers of RFC 6070 and RFC 7914 with the library and all other engines
+ */
+static void testKnownAnswers(void) {
+	TCHAR description[DESCRIPTION_SIZE + 1];
+
+	TOCTET expectedKey[MAX_TEST_KEY_SIZE];
+	TOCTET key[MAX_TEST_KEY_SIZE];
+
+	for (int i = 0; i < (int)(sizeof(KNOWN_ANSWERS) / sizeof(KNOWN_ANSWERS[0])); i++) {
+		const KNOWN_ANSWER* const pAnswer = &KNOWN_ANSWERS[i];
+
+		const int hexSize = (int)_tcslen(pAnswer->expectedKey);
+		const ULONG keySize = (ULONG)(hexSize / 2);
+
+		_stprintf_s(description, DESCRIPTION_SIZE, _T("known answer %d: %s with %lu iterations"), i + 1, HASH_TYPE_NAME[pAnswer->hashType - PBKDF2_MIN_HASH_TYPE], pAnswer->iterationCount);
+
+		hexDecode(pAnswer->expectedKey, hexSize, expectedKey);
+
+		const PBKDF2_RESULT result = pbkdf2_derive(pAnswer->hashType,
+																 (const TOCTET*)pAnswer->password, pAnswer->passwordSize,
+																 (const TOCTET*)pAnswer->salt, pAnswer->saltSize,
+																 pAnswer->iterationCount,
+																 key, keySize);
+
+		check((result == PBKDF2_OK) && (memcmp(key, expectedKey, keySize) == 0), _T("cng: %s"), description);
+
+		if (!pAnswer->isLibraryOnly)
+			checkAllEngines(pAnswer->hashType,
+								 (const TOCTET*)pAnswer->password, pAnswer->passwordSize,
+								 (const TOCTET*)pAnswer->salt, pAnswer->saltSize,
+								 pAnswer->iterationCount,
+								 expectedKey, keySize,
+								 description);
+	}
+}
+
+/*
+ * Compare the keys of all engines and hash types with the keys of the library.
+ * The key sizes cover partial, exact and several blocks, so that the blocks of one key are calculated in parallel.
+ */
+static void testEnginesAgainstLibrary(void) {
+	TCHAR description[DESCRIPTION_SIZE + 1];
+
+	TOCTET password[MAX_TEST_DATA_SIZE];
+	TOCTET salt[MAX_TEST_DATA_SIZE];
+	TOCTET expectedKey[MAX_TEST_KEY_SIZE];
+
+	for (int hashType = PBKDF2_MIN_HASH_TYPE; hashType <= PBKDF2_MAX_HASH_TYPE; hashType++) {
+		const ULONG digestSize = pbkdf2_get_hash_size(hashType);
+
+		const ULONG keySizes[] = { 1, digestSize - 1, digestSize, digestSize + 1, 2 * digestSize, (3 * digestSize) + 7, 5 * digestSize };
+
+		for (int p = 0; p < (int)(sizeof(ENGINE_PASSWORD_SIZES) / sizeof(ENGINE_PASSWORD_SIZES[0])); p++)
+			for (int s = 0; s < (int)(sizeof(ENGINE_SALT_SIZES) / sizeof(ENGINE_SALT_SIZES[0])); s++)
+				for (int c = 0; c < (int)(sizeof(ENGINE_ITERATION_COUNTS) / sizeof(ENGINE_ITERATION_COUNTS[0])); c++)
+					for (int k = 0; k < (int)(sizeof(keySizes) / sizeof(keySizes[0])); k++) {
+						const ULONG passwordSize = ENGINE_PASSWORD_SIZES[p];
+						const ULONG saltSize = ENGINE_SALT_SIZES[s];
+						const ULONG iterationCount = ENGINE_ITERATION_COUNTS[c];
+						const ULONG keySize = keySizes[k];
+
+						fillPattern(password, passwordSize, (ULONG)(hashType + p));
+						fillPattern(salt, saltSize, (ULONG)(hashType + s + 100));
+
+						_stprintf_s(description, DESCRIPTION_SIZE, _T("%s with password size %lu, salt size %lu, %lu iterations and key size %lu"),
+										HASH_TYPE_NAME[hashType - PBKDF2_MIN_HASH_TYPE], passwordSize, saltSize, iterationCount, keySize);
+
+						const PBKDF2_RESULT result = pbkdf2_derive(hashType, password, passwordSize, salt, saltSize, iterationCount, expectedKey, keySize);
+
+						check(result == PBKDF2_OK, _T("cng: %s"), description);
+
+						if (result == PBKDF2_OK)
+							checkAllEngines(hashType, password, passwordSize, salt, saltSize, iterationCount, expectedKey, keySize, description);
+					}
+	}
+
+	SecureZeroMemory(password, sizeof(password));
+}
+
+/*
+ * Compare the keys of several requests in one call of the multi-buffer, prepared key and GPU engines with the keys of the library.
+ * The request counts fill the lanes of the multi-buffer kernels once, twice and with one more request.
+ */
+static void testRequestGroups(void) {
+	TCHAR description[DESCRIPTION_SIZE + 1];
+
+	TOCTET passwords[MAX_TEST_REQUEST_COUNT][MAX_TEST_DATA_SIZE];
+	TOCTET salts[MAX_TEST_REQUEST_COUNT][MAX_TEST_DATA_SIZE];
+	TOCTET keys[MAX_TEST_REQUEST_COUNT][MAX_TEST_KEY_SIZE];
+	TOCTET expectedKeys[MAX_TEST_REQUEST_COUNT][MAX_TEST_KEY_SIZE];
+
+	NATIVE_PBKDF2_REQUEST requests[MAX_TEST_REQUEST_COUNT];
+
+	const int laneCount = nativeGetMultiBufferLaneCount();
+	const BOOLEAN isGpuAvailable = gpuIsAvailable();
+
+	const int maxRequestCount = (laneCount > 0) ? (2 * laneCount) + 1 : 9;
+
+	const ULONG iterationCount = 1000;
+
+	for (int hashType = 1; hashType <= 2; hashType++) {
+		const NATIVE_HASH nativeHash = (hashType == 1) ? NATIVE_HASH_SHA1 : NATIVE_HASH_SHA256;
+		const ULONG digestSize = (ULONG)nativeGetDigestSize(nativeHash);
+
+		// Every request has its own password, salt and key size, so that the requests have different numbers of blocks
+		for (int i = 0; i < maxRequestCount; i++) {
+			requests[i].password = passwords[i];
+			requests[i].passwordSize = 1 + (ULONG)((i * 11) % 100);
+			requests[i].salt = salts[i];
+			requests[i].saltSize = 1 + (ULONG)((i * 5) % 40);
+			requests[i].derivedKey = keys[i];
+			requests[i].derivedKeySize = 1 + (ULONG)((i * (digestSize + 3)) % (4 * digestSize));
+
+			fillPattern(passwords[i], requests[i].passwordSize, (ULONG)i);
+			fillPattern(salts[i], requests[i].saltSize, (ULONG)(i + 50));
+
+			pbkdf2_derive(hashType, requests[i].password, requests[i].passwordSize, requests[i].salt, requests[i].saltSize, iterationCount, expectedKeys[i], requests[i].derivedKeySize);
+		}
+
+		for (int requestCount = 1; requestCount <= maxRequestCount; requestCount++) {
+			if (laneCount > 0) {
+				memset(keys, 0, sizeof(keys));
+
+				const BOOLEAN isDone = nativePBKDF2MultiBuffer(nativeHash, iterationCount, requests, requestCount);
+
+				for (int i = 0; i < requestCount; i++) {
+					_stprintf_s(description, DESCRIPTION_SIZE, _T("%s request %d of %d"), HASH_TYPE_NAME[hashType - 1], i + 1, requestCount);
+					checkNativeKey(isDone, keys[i], expectedKeys[i], requests[i].derivedKeySize, _T("simd"), description);
+				}
+			} else
+				skipCount++;
+
+			if (isGpuAvailable) {
+				memset(keys, 0, sizeof(keys));
+
+				const BOOLEAN isDone = gpuPBKDF2(nativeHash, iterationCount, requests, requestCount);
+
+				for (int i = 0; i < requestCount; i++) {
+					_stprintf_s(description, DESCRIPTION_SIZE, _T("%s request %d of %d"), HASH_TYPE_NAME[hashType - 1], i + 1, requestCount);
+					checkNativeKey(isDone, keys[i], expectedKeys[i], requests[i].derivedKeySize, _T("gpu"), description);
+				}
+			} else
+				skipCount++;
+		}
+
+		// A prepared key serves requests with the same password and different salts
+		NATIVE_HMAC_KEY nativeKey;
+
+		nativePrepareHmacKey(&nativeKey, nativeHash, passwords[0], requests[0].passwordSize);
+
+		for (int i = 0; i < maxRequestCount; i++)
+			pbkdf2_derive(hashType, passwords[0], requests[0].passwordSize, requests[i].salt, requests[i].saltSize, iterationCount, expectedKeys[i], requests[i].derivedKeySize);
+
+		memset(keys, 0, sizeof(keys));
+
+		const BOOLEAN isDone = nativePBKDF2WithKey(&nativeKey, iterationCount, requests, maxRequestCount);
+
+		for (int i = 0; i < maxRequestCount; i++) {
+			_stprintf_s(description, DESCRIPTION_SIZE, _T("%s salt %d of %d"), HASH_TYPE_NAME[hashType - 1], i + 1, maxRequestCount);
+			checkNativeKey(isDone, keys[i], expectedKeys[i], requests[i].derivedKeySize, _T("native with prepared key"), description);
+		}
+
+		SecureZeroMemory(&nativeKey, sizeof(nativeKey));
+	}
+
+	SecureZeroMemory(passwords, sizeof(passwords));
+}
+
+/*
+ * Check the hex conversions with known strings, odd lengths, invalid characters and round trips
+ */
+static void testHex(void) {
+	TCHAR text[(3 * MAX_ENCODING_TEST_SIZE) + 1];
+
+	TOCTET bytes[MAX_ENCODING_TEST_SIZE];
+	TOCTET decodedBytes[MAX_ENCODING_TEST_SIZE];
+
+	const TOCTET knownBytes[] = { 0x01, 0xab, 0xcd, 0xef };
+
+	hexEncode(knownBytes, sizeof(knownBytes), text, FALSE);
+	check(_tcscmp(text, _T("01ABCDEF")) == 0, _T("hex: encoding of 01abcdef is %s"), text);
+
+	hexEncode(knownBytes, sizeof(knownBytes), text, TRUE);
+	check(_tcscmp(text, _T("01 AB CD EF")) == 0, _T("hex: encoding of 01abcdef with separator is %s"), text);
+
+	check(hexGetEncodedSize(3, FALSE) == 6, _T("hex: encoded size of 3 bytes is %d"), hexGetEncodedSize(3, FALSE));
+	check(hexGetEncodedSize(3, TRUE) == 8, _T("hex: encoded size of 3 bytes with separator is %d"), hexGetEncodedSize(3, TRUE));
+
+	int position = hexDecode(_T("01aBcD"), 6, decodedBytes);
+	check((position == -1) && (decodedBytes[0] == 0x01) && (decodedBytes[1] == 0xab) && (decodedBytes[2] == 0xcd), _T("hex: decoding of mixed case"));
+
+	position = hexDecode(_T("abc"), 3, decodedBytes);
+	check((position == -1) && (decodedBytes[0] == 0x0a) && (decodedBytes[1] == 0xbc), _T("hex: decoding of an odd length"));
+
+	position = hexDecode(_T("12g4"), 4, decodedBytes);
+	check(position == 2, _T("hex: position of the invalid character is %d"), position);
+
+	for (int byteCount = 0; byteCount <= MAX_ENCODING_TEST_SIZE; byteCount++) {
+		fillPattern(bytes, (ULONG)byteCount, (ULONG)byteCount);
+
+		hexEncode(bytes, byteCount, text, FALSE);
+
+		const int textSize = (int)_tcslen(text);
+
+		check(textSize == hexGetEncodedSize(byteCount, FALSE), _T("hex: encoded size of %d bytes"), byteCount);
+
+		memset(decodedBytes, 0, sizeof(decodedBytes));
+		position = hexDecode(text, textSize, decodedBytes);
+		check((position == -1) && (memcmp(bytes, decodedBytes, byteCount) == 0), _T("hex: round trip of %d bytes"), byteCount);
+	}
+}
+
+/*
+ * Check the Base64 conversions with the known encodings of RFC 4648, invalid strings and round trips
+ */
+static void testBase64(void) {
+	TCHAR text[(4 * MAX_ENCODING_TEST_SIZE / 3) + 5];
+
+	TOCTET bytes[MAX_ENCODING_TEST_SIZE];
+	TOCTET decodedBytes[MAX_ENCODING_TEST_SIZE];
+
+	int byteCount;
+	int position;
+
+	for (int i = 0; i < (int)(sizeof(BASE64_ANSWERS) / sizeof(BASE64_ANSWERS[0])); i++) {
+		const BASE64_ANSWER* const pAnswer = &BASE64_ANSWERS[i];
+
+		const int answerByteCount = (int)strlen(pAnswer->bytes);
+
+		base64Encode((const TOCTET*)pAnswer->bytes, answerByteCount, text, TRUE);
+		check(_tcscmp(text, pAnswer->paddedText) == 0, _T("base64: encoding of \"%hs\" is %s"), pAnswer->bytes, text);
+
+		base64Encode((const TOCTET*)pAnswer->bytes, answerByteCount, text, FALSE);
+		check(_tcscmp(text, pAnswer->unpaddedText) == 0, _T("base64: encoding of \"%hs\" without padding is %s"), pAnswer->bytes, text);
+
+		byteCount = -1;
+		position = base64Decode(pAnswer->paddedText, (int)_tcslen(pAnswer->paddedText), decodedBytes, &byteCount);
+		check((position == -1) && (byteCount == answerByteCount) && (memcmp(decodedBytes, pAnswer->bytes, answerByteCount) == 0), _T("base64: decoding of %s"), pAnswer->paddedText);
+
+		byteCount = -1;
+		position = base64Decode(pAnswer->unpaddedText, (int)_tcslen(pAnswer->unpaddedText), decodedBytes, &byteCount);
+		check((position == -1) && (byteCount == answerByteCount) && (memcmp(decodedBytes, pAnswer->bytes, answerByteCount) == 0), _T("base64: decoding of %s"), pAnswer->unpaddedText);
+	}
+
+	position = base64Decode(_T("Zm9v!mFy"), 8, decodedBytes, &byteCount);
+	check(position == 4, _T("base64: position of the invalid character is %d"), position);
+
+	position = base64Decode(_T("Zm9vY"), 5, decodedBytes, &byteCount);
+	check(position == 4, _T("base64: position of the single character of the last group is %d"), position);
+
+	for (byteCount = 0; byteCount <= MAX_ENCODING_TEST_SIZE; byteCount++) {
+		fillPattern(bytes, (ULONG)byteCount, (ULONG)byteCount);
+
+		for (int hasPadding = 0; hasPadding <= 1; hasPadding++) {
+			base64Encode(bytes, byteCount, text, (BOOLEAN)hasPadding);
+
+			const int textSize = (int)_tcslen(text);
+
+			check(textSize == base64GetEncodedSize(byteCount, (BOOLEAN)hasPadding), _T("base64: encoded size of %d bytes"), byteCount);
+
+			int decodedByteCount = -1;
+
+			memset(decodedBytes, 0, sizeof(decodedBytes));
+			position = base64Decode(text, textSize, decodedBytes, &decodedByteCount);
+			check((position == -1) && (decodedByteCount == byteCount) && (memcmp(bytes, decodedBytes, byteCount) == 0), _T("base64: round trip of %d bytes"), byteCount);
+		}
+	}
+}
+
+/*
+ * MAIN FUNCTION
+ */
+
+int _tmain(void) {
+	TCHAR lineBuffer[LINE_BUFFER_SIZE + 1];
+
+	DWORD mode;
+
+	outputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+
+	// GetConsoleMode only returns 0 if the handle does not point to the console
+	isOutputRedirected = (GetConsoleMode(outputHandle, &mode) == 0);
+
+	_stprintf_s(lineBuffer, LINE_BUFFER_SIZE, _T("Multi-buffer lanes: %d (%s), SHA extensions: %s, GPU: %s\n"),
+				nativeGetMultiBufferLaneCount(),
+				nativeGetMultiBufferInstructionSet(),
+				nativeIsShaNiSupported() ? _T("yes") : _T("no"),
+				gpuIsAvailable() ? _T("yes") : _T("no"));
+	writeText(lineBuffer);
+
+	testHex();
+	testBase64();
+	testKnownAnswers();
+	testEnginesAgainstLibrary();
+	testRequestGroups();
+
+	gpuRelease();
+	pbkdf2_release();
+
+	_stprintf_s(lineBuffer, LINE_BUFFER_SIZE, _T("Checks: %d, failed: %d, skipped engine checks: %d\n"), checkCount, failureCount, skipCount);
+	writeText(lineBuffer);
+
+	return (failureCount == 0) ? RC_OK : RC_MISMATCH;
+}